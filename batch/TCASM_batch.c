@@ -0,0 +1,371 @@
+#define _POSIX_C_SOURCE 200809L
+
+/*
+ * Driver de compilacao em lote. Cada arquivo fonte passa por montagem,
+ * traducao para ELF (opcional) e desmontagem para NASM (opcional) em uma
+ * thread de um pool, tudo em memoria. As saidas, os diagnosticos de todos os
+ * arquivos e os tempos de cada um sao escritos no fim, na ordem dos
+ * arquivos na linha de comando.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../trabalho1/TCASM_assembler/TCASM_assembler.h"
+#include "../trabalho2/TCASM_IA-32_ELF_generator/TCASM_IA-32_ELF_generator.h"
+#include "../trabalho2/TCASM_IA-32_disassembler/TCASM_IA-32_disassembler.h"
+
+/**
+ * Enumeracao das etapas medidas de cada arquivo.
+ */
+typedef enum {
+  TCASM_BATCH_STEP_READ = 0,
+  TCASM_BATCH_STEP_ASSEMBLE,
+  TCASM_BATCH_STEP_ELF,
+  TCASM_BATCH_STEP_NASM,
+  TCASM_BATCH_STEP_COUNT
+} TCASM_batch_step_t;
+
+/**
+ * Struct com um arquivo do lote. As saidas ficam em memoria ate o fim.
+ */
+typedef struct {
+  /// Arquivo fonte.
+  const char* source;
+  
+  /// Nomes dos arquivos de saida (codigo montado, executavel ELF e fonte
+  /// NASM).
+  char* bin_path;
+  char* elf_path;
+  char* nasm_path;
+  
+  /// Indica se a montagem terminou sem erros.
+  bool ok;
+  
+  /// Codigo montado.
+  uint16_t* code;
+  size_t code_size;
+  
+  /// Executavel ELF, ou NULL.
+  uint8_t* elf;
+  size_t elf_size;
+  
+  /// Fonte NASM, ou NULL.
+  char* nasm;
+  size_t nasm_size;
+  
+  /// Diagnosticos ja formatados, com o nome do arquivo na frente.
+  char* diagnostics;
+  size_t diagnostics_size;
+  
+  /// Tempo de cada etapa, em nanossegundos.
+  uint64_t time[TCASM_BATCH_STEP_COUNT];
+} TCASM_batch_job_t;
+
+/**
+ * Struct com o lote inteiro, compartilhado pelas threads.
+ */
+typedef struct {
+  TCASM_batch_job_t* jobs;
+  size_t jobs_size;
+  
+  /// Proximo arquivo a ser pego por uma thread (incrementado atomicamente).
+  size_t next;
+  
+  /// Etapas opcionais pedidas.
+  bool elf;
+  bool nasm;
+} TCASM_batch_t;
+
+/**
+ * Struct com o buffer de leitura de uma thread, reaproveitado entre os
+ * arquivos.
+ */
+typedef struct {
+  char* data;
+  size_t capacity;
+} TCASM_batch_buffer_t;
+
+/**
+ * Funcao que retorna o tempo monotonico atual.
+ * @return Retorna o tempo em nanossegundos.
+ */
+static uint64_t TCASM_batch_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Funcao que junta o nome base das saidas com uma extensao.
+ * @param base Nome base.
+ * @param extension Extensao, com o ponto.
+ * @return Retorna o nome, alocado com malloc.
+ */
+static char* TCASM_batch_path(const char* base, const char* extension) {
+  char* path = (char*) malloc(strlen(base) + strlen(extension) + 1);
+  sprintf(path, "%s%s", base, extension);
+  return path;
+}
+
+/**
+ * Funcao para escolher os nomes das saidas de um arquivo: o nome do fonte
+ * sem a extensao, no diretorio outdir se dado, com .bin, .elf e .nasm.
+ * @param job Arquivo do lote.
+ * @param outdir Diretorio das saidas, ou NULL para usar o do fonte.
+ */
+static void TCASM_batch_paths(TCASM_batch_job_t* job, const char* outdir) {
+  const char* slash = strrchr(job->source, '/');
+  const char* name = slash != NULL ? slash + 1 : job->source;
+  const char* dot = strrchr(name, '.');
+  int name_size = dot != NULL ? (int) (dot - name) : (int) strlen(name);
+  
+  char* base;
+  if (outdir != NULL) {
+    base = (char*) malloc(strlen(outdir) + name_size + 2);
+    sprintf(base, "%s/%.*s", outdir, name_size, name);
+  }
+  else {
+    base = (char*) malloc(strlen(job->source) + 1);
+    sprintf(base, "%.*s", (int) (name - job->source) + name_size, job->source);
+  }
+  
+  job->bin_path = TCASM_batch_path(base, ".bin");
+  job->elf_path = TCASM_batch_path(base, ".elf");
+  job->nasm_path = TCASM_batch_path(base, ".nasm");
+  free(base);
+}
+
+/**
+ * Funcao para ler um arquivo fonte inteiro para o buffer da thread.
+ * @param path Nome do arquivo.
+ * @param buffer Buffer da thread.
+ * @param size Ponteiro para a funcao retornar o tamanho lido.
+ * @return Retorna false se o arquivo nao pode ser aberto.
+ */
+static bool TCASM_batch_read(const char* path, TCASM_batch_buffer_t* buffer, size_t* size) {
+  FILE* fin;
+  if ((fin = fopen(path, "rb")) == NULL)
+    return false;
+  
+  size_t read;
+  *size = 0;
+  if (buffer->capacity == 0)
+    buffer->data = (char*) malloc(buffer->capacity = 65536);
+  while ((read = fread(buffer->data + *size, 1, buffer->capacity - *size, fin)) > 0) {
+    *size += read;
+    if (*size == buffer->capacity)
+      buffer->data = (char*) realloc(buffer->data, buffer->capacity *= 2);
+  }
+  fclose(fin);
+  return true;
+}
+
+/**
+ * Funcao que processa um arquivo do lote: le, monta e, se pedido, traduz
+ * para ELF e desmonta para NASM, guardando tudo no proprio job.
+ * @param batch Lote.
+ * @param job Arquivo do lote.
+ * @param asm_ptr Contexto de montagem da thread.
+ * @param buffer Buffer de leitura da thread.
+ */
+static void TCASM_batch_run(const TCASM_batch_t* batch, TCASM_batch_job_t* job, TCASM_assembler_t* asm_ptr, TCASM_batch_buffer_t* buffer) {
+  FILE* diagnostics = open_memstream(&job->diagnostics, &job->diagnostics_size);
+  
+  uint64_t start = TCASM_batch_now();
+  size_t size;
+  if (!TCASM_batch_read(job->source, buffer, &size)) {
+    fprintf(diagnostics, "%s: Erro: Nao foi possivel abrir o arquivo \"%s\" para leitura\n", job->source, job->source);
+    fclose(diagnostics);
+    return;
+  }
+  uint64_t now = TCASM_batch_now();
+  job->time[TCASM_BATCH_STEP_READ] = now - start;
+  
+  start = now;
+  job->ok = TCASM_assembler_run(asm_ptr, buffer->data, size);
+  TCASM_assembler_print_diagnostics(asm_ptr, job->source, diagnostics);
+  fclose(diagnostics);
+  if (job->ok) {
+    job->code_size = asm_ptr->code_size;
+    job->code = (uint16_t*) malloc(job->code_size*sizeof(uint16_t));
+    memcpy(job->code, asm_ptr->code, job->code_size*sizeof(uint16_t));
+  }
+  now = TCASM_batch_now();
+  job->time[TCASM_BATCH_STEP_ASSEMBLE] = now - start;
+  if (!job->ok)
+    return;
+  
+  // o mapa passa pela mesma serializacao de --map, mas em memoria
+  if (batch->elf) {
+    start = now;
+    char* map;
+    size_t map_size;
+    FILE* out = open_memstream(&map, &map_size);
+    TCASM_map_serialize(&asm_ptr->map, out, job->source, job->code_size);
+    fclose(out);
+    job->elf = TCASM_generate_elf(job->code, job->code_size, (const uint8_t*) map, map_size, job->bin_path, &job->elf_size);
+    free(map);
+    now = TCASM_batch_now();
+    job->time[TCASM_BATCH_STEP_ELF] = now - start;
+  }
+  
+  if (batch->nasm) {
+    start = now;
+    FILE* out = open_memstream(&job->nasm, &job->nasm_size);
+    TCASM_disassemble(job->code, job->code_size, out);
+    fclose(out);
+    job->time[TCASM_BATCH_STEP_NASM] = TCASM_batch_now() - start;
+  }
+}
+
+/**
+ * Funcao de cada thread do pool: pega o proximo arquivo livre ate acabarem.
+ * O contexto de montagem e o buffer de leitura sao da thread e sao
+ * reaproveitados entre os arquivos.
+ * @param arg Lote.
+ */
+static void* TCASM_batch_worker(void* arg) {
+  TCASM_batch_t* batch = (TCASM_batch_t*) arg;
+  TCASM_assembler_t assembler;
+  TCASM_assembler_init(&assembler);
+  if (batch->elf)
+    TCASM_map_enable(&assembler.map);
+  TCASM_batch_buffer_t buffer = {NULL, 0};
+  
+  size_t i;
+  while ((i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED)) < batch->jobs_size)
+    TCASM_batch_run(batch, &batch->jobs[i], &assembler, &buffer);
+  
+  free(buffer.data);
+  TCASM_assembler_destroy(&assembler);
+  return NULL;
+}
+
+/**
+ * Funcao para escrever um arquivo de saida inteiro.
+ * @param path Nome do arquivo.
+ * @param data Conteudo.
+ * @param size Tamanho do conteudo.
+ * @return Retorna false se o arquivo nao pode ser aberto.
+ */
+static bool TCASM_batch_write(const char* path, const void* data, size_t size) {
+  FILE* out;
+  if ((out = fopen(path, "wb")) == NULL) {
+    fprintf(stderr, "Erro: Nao foi possivel abrir o arquivo \"%s\" para escrita\n", path);
+    return false;
+  }
+  fwrite(data, 1, size, out);
+  fclose(out);
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  TCASM_batch_t batch = {NULL, 0, 0, false, false};
+  const char* outdir = NULL;
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  
+  // opcoes antes dos arquivos de entrada
+  int arg = 1;
+  for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; ++arg) {
+    if (strcmp(argv[arg], "--elf") == 0)
+      batch.elf = true;
+    else if (strcmp(argv[arg], "--nasm") == 0)
+      batch.nasm = true;
+    else if (strcmp(argv[arg], "--jobs") == 0 && arg + 1 < argc)
+      threads = atol(argv[++arg]);
+    else if (strcmp(argv[arg], "--outdir") == 0 && arg + 1 < argc)
+      outdir = argv[++arg];
+    else
+      break;
+  }
+  
+  if (arg == argc || strncmp(argv[arg], "--", 2) == 0 || threads < 1) {
+    fprintf(stderr, "Erro: Argumentos incorretos. Forma de utilizacao: ./TCASM_batch [--elf] [--nasm] [--jobs <threads>] [--outdir <diretorio>] <arquivo_entrada>...\n");
+    exit(EXIT_FAILURE);
+  }
+  
+  batch.jobs_size = argc - arg;
+  batch.jobs = (TCASM_batch_job_t*) calloc(batch.jobs_size, sizeof(TCASM_batch_job_t));
+  for (size_t i = 0; i < batch.jobs_size; ++i) {
+    batch.jobs[i].source = argv[arg + i];
+    TCASM_batch_paths(&batch.jobs[i], outdir);
+  }
+  if ((size_t) threads > batch.jobs_size)
+    threads = (long) batch.jobs_size;
+  
+  // pool de threads; a principal tambem trabalha
+  uint64_t start = TCASM_batch_now();
+  pthread_t* pool = (pthread_t*) malloc(threads*sizeof(pthread_t));
+  for (long i = 1; i < threads; ++i)
+    pthread_create(&pool[i], NULL, TCASM_batch_worker, &batch);
+  TCASM_batch_worker(&batch);
+  for (long i = 1; i < threads; ++i)
+    pthread_join(pool[i], NULL);
+  free(pool);
+  uint64_t wall = TCASM_batch_now() - start;
+  
+  // diagnosticos e saidas, na ordem da linha de comando
+  bool ok = true;
+  for (size_t i = 0; i < batch.jobs_size; ++i) {
+    TCASM_batch_job_t* job = &batch.jobs[i];
+    fwrite(job->diagnostics, 1, job->diagnostics_size, stderr);
+    if (!job->ok) {
+      ok = false;
+      continue;
+    }
+    
+    ok = TCASM_batch_write(job->bin_path, job->code, job->code_size*sizeof(uint16_t)) && ok;
+    if (job->elf != NULL) {
+      if (TCASM_batch_write(job->elf_path, job->elf, job->elf_size))
+        chmod(job->elf_path, 0775);
+      else
+        ok = false;
+    }
+    if (job->nasm != NULL)
+      ok = TCASM_batch_write(job->nasm_path, job->nasm, job->nasm_size) && ok;
+  }
+  
+  // tempos de cada arquivo, em milissegundos
+  uint64_t total[TCASM_BATCH_STEP_COUNT] = {0};
+  printf("%-10s %10s %10s %10s %10s  %s\n", "leitura", "montagem", "elf", "nasm", "total", "arquivo");
+  for (size_t i = 0; i < batch.jobs_size; ++i) {
+    TCASM_batch_job_t* job = &batch.jobs[i];
+    uint64_t sum = 0;
+    for (int step = 0; step < TCASM_BATCH_STEP_COUNT; ++step) {
+      printf("%10.3f ", job->time[step]/1e6);
+      total[step] += job->time[step];
+      sum += job->time[step];
+    }
+    printf("%10.3f  %s%s\n", sum/1e6, job->source, job->ok ? "" : " (erro)");
+  }
+  uint64_t sum = 0;
+  for (int step = 0; step < TCASM_BATCH_STEP_COUNT; ++step) {
+    printf("%10.3f ", total[step]/1e6);
+    sum += total[step];
+  }
+  printf("%10.3f  soma de %zu arquivos\n", sum/1e6, batch.jobs_size);
+  printf("%10.3f ms de parede com %ld threads\n", wall/1e6, threads);
+  
+  for (size_t i = 0; i < batch.jobs_size; ++i) {
+    TCASM_batch_job_t* job = &batch.jobs[i];
+    free(job->bin_path);
+    free(job->elf_path);
+    free(job->nasm_path);
+    free(job->code);
+    free(job->elf);
+    free(job->nasm);
+    free(job->diagnostics);
+  }
+  free(batch.jobs);
+  
+  return ok ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,117 @@
+#ifndef TCASM_BENCH_H_
+#define TCASM_BENCH_H_
+
+/**
+ * Harness minimo dos microbenchmarks. Cada benchmark eh uma funcao que
+ * executa uma quantidade pedida de iteracoes; o harness calibra essa
+ * quantidade para que cada amostra dure cerca de TCASM_BENCH_SAMPLE_NS,
+ * mede TCASM_BENCH_SAMPLES amostras e imprime uma linha JSON por benchmark
+ * em stdout:
+ *
+ *   {"benchmark": "<nome>", "ns_per_op": <mediana>, "min_ns_per_op": <minimo>,
+ *    "ops": <operacoes por amostra>, "samples": <amostras>}
+ *
+ * Os nomes sao estaveis e servem de chave para acompanhar regressoes.
+ * Usado tanto pelo benchmark do montador (C) quanto pelo da maquina (C++).
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TCASM_BENCH_SAMPLES 7
+#define TCASM_BENCH_SAMPLE_NS 50000000ull
+
+/**
+ * Funcao de benchmark: executa iterations iteracoes sobre ctx.
+ */
+typedef void (*TCASM_bench_fn_t)(void* ctx, size_t iterations);
+
+/**
+ * Arquivo onde os resultados sao escritos (stdout por padrao).
+ */
+static FILE* TCASM_bench_out;
+
+/**
+ * Filtro de nomes passado na linha de comando, ou NULL.
+ */
+static const char* TCASM_bench_filter;
+
+/**
+ * Funcao que retorna o tempo monotonico atual.
+ * @return Retorna o tempo em nanossegundos.
+ */
+static uint64_t TCASM_bench_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Funcao para ordenar amostras com qsort.
+ */
+static int TCASM_bench_compare(const void* a, const void* b) {
+  double x = *(const double*) a, y = *(const double*) b;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * Funcao para ler os argumentos comuns: [--quick] [filtro]. Com --quick,
+ * cada amostra dura um decimo do normal.
+ * @return Retorna a duracao alvo de uma amostra em nanossegundos.
+ */
+static uint64_t TCASM_bench_init(int argc, char* argv[]) {
+  uint64_t sample_ns = TCASM_BENCH_SAMPLE_NS;
+  TCASM_bench_out = stdout;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--quick") == 0)
+      sample_ns /= 10;
+    else
+      TCASM_bench_filter = argv[i];
+  }
+  return sample_ns;
+}
+
+/**
+ * Funcao para executar e relatar um benchmark.
+ * @param name Nome estavel do benchmark.
+ * @param fn Funcao de benchmark.
+ * @param ctx Contexto passado para fn.
+ * @param ops_per_iteration Operacoes medidas em cada iteracao de fn.
+ * @param sample_ns Duracao alvo de uma amostra.
+ */
+static void TCASM_bench_run(const char* name, TCASM_bench_fn_t fn, void* ctx, double ops_per_iteration, uint64_t sample_ns) {
+  if (TCASM_bench_filter != NULL && strstr(name, TCASM_bench_filter) == NULL)
+    return;
+  
+  // calibra: dobra as iteracoes ate uma rodada durar 1/10 da amostra
+  size_t iterations = 1;
+  uint64_t elapsed;
+  while (true) {
+    uint64_t start = TCASM_bench_now();
+    fn(ctx, iterations);
+    elapsed = TCASM_bench_now() - start;
+    if (elapsed >= sample_ns/10 || iterations >= ((size_t) 1 << 40))
+      break;
+    iterations *= 2;
+  }
+  iterations = (size_t) (iterations*((double) sample_ns/(elapsed ? elapsed : 1)));
+  if (iterations == 0)
+    iterations = 1;
+  
+  double samples[TCASM_BENCH_SAMPLES];
+  for (int i = 0; i < TCASM_BENCH_SAMPLES; ++i) {
+    uint64_t start = TCASM_bench_now();
+    fn(ctx, iterations);
+    samples[i] = (TCASM_bench_now() - start)/(iterations*ops_per_iteration);
+  }
+  qsort(samples, TCASM_BENCH_SAMPLES, sizeof(double), TCASM_bench_compare);
+  
+  fprintf(TCASM_bench_out, "{\"benchmark\": \"%s\", \"ns_per_op\": %.3f, \"min_ns_per_op\": %.3f, \"ops\": %.0f, \"samples\": %d}\n",
+          name, samples[TCASM_BENCH_SAMPLES/2], samples[0], iterations*ops_per_iteration, TCASM_BENCH_SAMPLES);
+  fflush(TCASM_bench_out);
+}
+
+#endif /* TCASM_BENCH_H_ */
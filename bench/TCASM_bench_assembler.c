@@ -0,0 +1,536 @@
+#define _POSIX_C_SOURCE 200112L
+
+/*
+ * Microbenchmarks das estruturas de dados e da leitura de caracteres do
+ * montador. O montador eh incluido diretamente para que as funcoes estaticas
+ * de leitura (TCASM_read_char, TCASM_read_symbol) e de varredura
+ * (TCASM_scan.h) possam ser medidas.
+ */
+
+#include "../trabalho1/TCASM_assembler/TCASM_assembler.c"
+
+#include <pthread.h>
+
+#include "../trabalho1/TCASM_assembler/TCASM_chashtable.h"
+#include "TCASM_bench.h"
+
+/**
+ * Struct de contexto dos benchmarks da tabela hash.
+ */
+typedef struct {
+  TCASM_hashtable_t table;
+  char** keys;
+  size_t keys_size;
+} TCASM_bench_hashtable_t;
+
+/**
+ * Struct de contexto dos benchmarks da tabela hash concorrente. As threads
+ * usam as chaves de um TCASM_bench_hashtable_t.
+ */
+typedef struct {
+  TCASM_chashtable_t table;
+  const TCASM_bench_hashtable_t* keys;
+  int threads;
+  
+  /// true para inserir em uma tabela nova a cada iteracao, false para buscar
+  /// chaves existentes em table.
+  bool insert;
+  
+  /// Iteracoes pedidas pelo harness.
+  size_t iterations;
+  
+  /// Barreira entre as threads (apenas insercao).
+  pthread_barrier_t barrier;
+} TCASM_bench_chashtable_t;
+
+/**
+ * Struct de argumento de cada thread dos benchmarks e do teste de estresse
+ * da tabela hash concorrente.
+ */
+typedef struct {
+  TCASM_bench_chashtable_t* bench;
+  int index;
+  
+  /// Teste de estresse: no obtido para cada chave e quantas chaves esta
+  /// thread criou.
+  TCASM_hashtable_node_t** nodes;
+  size_t created;
+} TCASM_bench_chashtable_thread_t;
+
+/**
+ * Struct de contexto do benchmark de leitura.
+ */
+typedef struct {
+  char* source;
+  size_t source_size;
+  size_t symbols;
+  TCASM_assembler_t assembler;
+} TCASM_bench_reader_t;
+
+/**
+ * Funcoes de varredura usadas por TCASM_bench_scan_walk.
+ */
+typedef struct {
+  const char* (*identifier)(const char* p, const char* end);
+  const char* (*blanks)(const char* p, const char* end);
+  const char* (*line_end)(const char* p, const char* end);
+} TCASM_bench_scanner_t;
+
+/**
+ * Resultado de uma varredura: quantidade de palavras e de linhas, e um hash
+ * das posicoes onde cada varredura parou.
+ */
+typedef struct {
+  size_t words;
+  size_t lines;
+  uint64_t boundaries;
+} TCASM_bench_scan_result_t;
+
+/**
+ * Funcao para criar uma tabela com chaves de um dado tamanho.
+ * @param ctx Contexto a ser preenchido.
+ * @param key_size Tamanho de cada chave.
+ * @param keys_size Quantidade de chaves.
+ */
+static void TCASM_bench_hashtable_init(TCASM_bench_hashtable_t* ctx, size_t key_size, size_t keys_size) {
+  TCASM_hashtable_init(&ctx->table, sizeof(int), 0);
+  ctx->keys = (char**) malloc(keys_size*sizeof(char*));
+  ctx->keys_size = keys_size;
+  for (size_t i = 0; i < keys_size; ++i) {
+    ctx->keys[i] = (char*) malloc(key_size + 1);
+    // prefixo comum longo, como em rotulos gerados, e sufixo distinto
+    memset(ctx->keys[i], 'K', key_size);
+    ctx->keys[i][key_size] = '\0';
+    for (size_t j = 0, k = i; j < key_size && k != 0; ++j, k /= 26)
+      ctx->keys[i][key_size - 1 - j] = (char) ('A' + k % 26);
+    bool created;
+    TCASM_hashtable_get(&ctx->table, ctx->keys[i], key_size, &created);
+  }
+}
+
+static void TCASM_bench_hashtable_get(void* ctx, size_t iterations) {
+  TCASM_bench_hashtable_t* bench = (TCASM_bench_hashtable_t*) ctx;
+  size_t key_size = strlen(bench->keys[0]);
+  bool created;
+  for (size_t i = 0; i < iterations; ++i)
+    for (size_t j = 0; j < bench->keys_size; ++j)
+      TCASM_hashtable_get(&bench->table, bench->keys[j], key_size, &created);
+}
+
+static void TCASM_bench_hashtable_get_node(void* ctx, size_t iterations) {
+  TCASM_bench_hashtable_t* bench = (TCASM_bench_hashtable_t*) ctx;
+  size_t key_size = strlen(bench->keys[0]);
+  bool created;
+  for (size_t i = 0; i < iterations; ++i)
+    for (size_t j = 0; j < bench->keys_size; ++j)
+      TCASM_hashtable_get_node(&bench->table, bench->keys[j], key_size, &created);
+}
+
+/**
+ * Cria uma tabela vazia, com a capacidade padrao, e insere todas as chaves do
+ * contexto, incluindo o custo de crescer a tabela.
+ */
+static void TCASM_bench_hashtable_insert(void* ctx, size_t iterations) {
+  TCASM_bench_hashtable_t* bench = (TCASM_bench_hashtable_t*) ctx;
+  size_t key_size = strlen(bench->keys[0]);
+  bool created;
+  for (size_t i = 0; i < iterations; ++i) {
+    TCASM_hashtable_t table;
+    TCASM_hashtable_init(&table, sizeof(int), 0);
+    for (size_t j = 0; j < bench->keys_size; ++j)
+      TCASM_hashtable_get(&table, bench->keys[j], key_size, &created);
+    TCASM_hashtable_destroy(&table);
+  }
+}
+
+/**
+ * Corpo de cada thread dos benchmarks da tabela hash concorrente. Na busca,
+ * cada thread busca todas as chaves, comecando de um ponto diferente; na
+ * insercao, a thread 0 cria uma tabela vazia a cada iteracao e cada thread
+ * insere uma fatia disjunta das chaves.
+ */
+static void* TCASM_bench_chashtable_worker(void* arg) {
+  TCASM_bench_chashtable_thread_t* thread = (TCASM_bench_chashtable_thread_t*) arg;
+  TCASM_bench_chashtable_t* bench = thread->bench;
+  size_t keys_size = bench->keys->keys_size;
+  size_t key_size = strlen(bench->keys->keys[0]);
+  size_t first = keys_size*thread->index/bench->threads;
+  size_t last = keys_size*(thread->index + 1)/bench->threads;
+  bool created;
+  for (size_t i = 0; i < bench->iterations; ++i) {
+    if (!bench->insert) {
+      for (size_t j = 0, k = first; j < keys_size; ++j, k = (k + 1 == keys_size ? 0 : k + 1))
+        TCASM_chashtable_get(&bench->table, bench->keys->keys[k], key_size, &created);
+      continue;
+    }
+    if (thread->index == 0)
+      TCASM_chashtable_init(&bench->table, sizeof(int), 0);
+    pthread_barrier_wait(&bench->barrier);
+    for (size_t k = first; k < last; ++k)
+      TCASM_chashtable_get(&bench->table, bench->keys->keys[k], key_size, &created);
+    pthread_barrier_wait(&bench->barrier);
+    if (thread->index == 0)
+      TCASM_chashtable_destroy(&bench->table);
+  }
+  return NULL;
+}
+
+/**
+ * Executa TCASM_bench_chashtable_worker em bench->threads threads (a
+ * thread atual eh a thread 0).
+ */
+static void TCASM_bench_chashtable(void* ctx, size_t iterations) {
+  TCASM_bench_chashtable_t* bench = (TCASM_bench_chashtable_t*) ctx;
+  pthread_t tids[64];
+  TCASM_bench_chashtable_thread_t threads[64];
+  bench->iterations = iterations;
+  for (int i = 0; i < bench->threads; ++i) {
+    threads[i].bench = bench;
+    threads[i].index = i;
+    if (i > 0)
+      pthread_create(&tids[i], NULL, TCASM_bench_chashtable_worker, &threads[i]);
+  }
+  TCASM_bench_chashtable_worker(&threads[0]);
+  for (int i = 1; i < bench->threads; ++i)
+    pthread_join(tids[i], NULL);
+}
+
+/**
+ * Corpo de cada thread do teste de estresse: obtem todas as chaves, em uma
+ * ordem propria de cada thread, e incrementa o valor das que criou.
+ */
+static void* TCASM_bench_chashtable_stress_worker(void* arg) {
+  TCASM_bench_chashtable_thread_t* thread = (TCASM_bench_chashtable_thread_t*) arg;
+  TCASM_bench_chashtable_t* bench = thread->bench;
+  size_t keys_size = bench->keys->keys_size;
+  size_t key_size = strlen(bench->keys->keys[0]);
+  // cada thread comeca de um ponto; metade delas anda para tras
+  size_t first = keys_size*thread->index/bench->threads;
+  pthread_barrier_wait(&bench->barrier);
+  for (size_t j = 0; j < keys_size; ++j) {
+    size_t k = (first + (thread->index % 2 ? keys_size - 1 - j : j)) % keys_size;
+    bool created;
+    thread->nodes[k] = TCASM_chashtable_get_node(&bench->table, bench->keys->keys[k], key_size, &created);
+    if (created) {
+      __atomic_fetch_add((unsigned int*) thread->nodes[k]->value, 1, __ATOMIC_RELAXED);
+      ++thread->created;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Teste de estresse da tabela hash concorrente: varias threads disputam a
+ * criacao das mesmas chaves em uma tabela que comeca pequena e cresce
+ * durante a disputa. Cada chave deve ser criada por exatamente uma thread e
+ * todas as threads devem receber o mesmo no. Termina o programa se alguma
+ * verificacao falha.
+ * @param keys Chaves.
+ * @param threads_size Quantidade de threads (ate 64).
+ * @param rounds Quantidade de repeticoes com uma tabela nova.
+ */
+static void TCASM_bench_chashtable_stress(const TCASM_bench_hashtable_t* keys, int threads_size, int rounds) {
+  TCASM_bench_chashtable_t bench;
+  bench.keys = keys;
+  bench.threads = threads_size;
+  pthread_barrier_init(&bench.barrier, NULL, threads_size);
+  pthread_t tids[64];
+  TCASM_bench_chashtable_thread_t threads[64];
+  for (int i = 0; i < threads_size; ++i)
+    threads[i].nodes = (TCASM_hashtable_node_t**) malloc(keys->keys_size*sizeof(TCASM_hashtable_node_t*));
+  
+  for (int round = 0; round < rounds; ++round) {
+    TCASM_chashtable_init(&bench.table, sizeof(unsigned int), 1);
+    for (int i = 0; i < threads_size; ++i) {
+      threads[i].bench = &bench;
+      threads[i].index = i;
+      threads[i].created = 0;
+      pthread_create(&tids[i], NULL, TCASM_bench_chashtable_stress_worker, &threads[i]);
+    }
+    size_t created = 0;
+    for (int i = 0; i < threads_size; ++i) {
+      pthread_join(tids[i], NULL);
+      created += threads[i].created;
+    }
+    
+    // as chaves podem se repetir; a tabela de keys tem as distintas
+    bool ok = created == keys->table.size && TCASM_chashtable_size(&bench.table) == keys->table.size;
+    for (size_t k = 0; ok && k < keys->keys_size; ++k) {
+      TCASM_hashtable_node_t* node = threads[0].nodes[k];
+      ok = node != NULL && *(unsigned int*) node->value == 1 && strcmp(node->key, keys->keys[k]) == 0;
+      for (int i = 1; ok && i < threads_size; ++i)
+        ok = threads[i].nodes[k] == node;
+      bool again;
+      ok = ok && TCASM_chashtable_get_node(&bench.table, keys->keys[k], strlen(keys->keys[k]), &again) == node && !again;
+    }
+    if (!ok) {
+      fprintf(stderr, "Erro: tabela hash concorrente inconsistente com %d threads (rodada %d)\n", threads_size, round);
+      exit(EXIT_FAILURE);
+    }
+    TCASM_chashtable_destroy(&bench.table);
+  }
+  
+  for (int i = 0; i < threads_size; ++i)
+    free(threads[i].nodes);
+  pthread_barrier_destroy(&bench.barrier);
+}
+
+/**
+ * Insere 1000 elementos no fim de uma lista e os apaga a partir do inicio,
+ * um a um.
+ */
+static void TCASM_bench_list_insert_erase(void* ctx, size_t iterations) {
+  (void) ctx;
+  TCASM_list_pool_t pool;
+  TCASM_list_pool_init(&pool);
+  TCASM_list_t list;
+  TCASM_list_init(&list, &pool, sizeof(TCASM_datalist_node_t));
+  TCASM_datalist_node_t value = {0};
+  for (size_t i = 0; i < iterations; ++i) {
+    for (int j = 0; j < 1000; ++j)
+      TCASM_list_insert(&list, NULL, &value);
+    while (list.size != 0)
+      TCASM_list_erase(&list, list.first);
+  }
+  TCASM_list_pool_destroy(&pool);
+}
+
+/**
+ * Insere 1000 elementos no fim de uma lista, percorre a lista e a esvazia de
+ * uma vez, como a lista de dados do montador.
+ */
+static void TCASM_bench_list_insert_clear(void* ctx, size_t iterations) {
+  (void) ctx;
+  TCASM_list_pool_t pool;
+  TCASM_list_pool_init(&pool);
+  TCASM_list_t list;
+  TCASM_list_init(&list, &pool, sizeof(TCASM_datalist_node_t));
+  TCASM_datalist_node_t value = {0};
+  for (size_t i = 0; i < iterations; ++i) {
+    for (int j = 0; j < 1000; ++j)
+      TCASM_list_insert(&list, NULL, &value);
+    for (TCASM_list_node_t* node = list.first; node != NULL; node = node->next)
+      ((TCASM_datalist_node_t*) node->value)->value = (uint16_t) i;
+    TCASM_list_clear(&list);
+  }
+  TCASM_list_pool_destroy(&pool);
+}
+
+/**
+ * Funcao para preparar um contexto com operandos registrados como pela
+ * maquina de montagem, um a cada duas palavras, que referenciam 97 dados ja
+ * definidos (um vetor de 4 posicoes a cada 3 dados, os demais variaveis).
+ * @param asm_ptr Contexto a ser preenchido.
+ * @param fixups Quantidade de operandos.
+ */
+static void TCASM_bench_fixups_init(TCASM_assembler_t* asm_ptr, size_t fixups) {
+  char name[32];
+  uint32_t ids[97];
+  TCASM_assembler_init(asm_ptr);
+  asm_ptr->state = TCASM_STATE_REGULAR;
+  asm_ptr->opcode = TCASM_SYMBOL_INSTRUCTION_OPCODE_LOAD;
+  for (int i = 0; i < 97; ++i) {
+    bool created;
+    ids[i] = TCASM_symbol_lookup(&asm_ptr->symbols, name, sprintf(name, "DADO_%d", i), &created);
+    asm_ptr->symbols.type[ids[i]] = i % 3 == 0 ? TCASM_SYMBOL_ADDRESS_ARRAY : TCASM_SYMBOL_ADDRESS_VAR;
+    asm_ptr->symbols.value[ids[i]] = 4;
+    asm_ptr->symbols.addr[ids[i]] = (uint16_t) (2*fixups + 4*i);
+    asm_ptr->symbols.line[ids[i]] = 1;
+  }
+  for (size_t i = 0; i < fixups; ++i) {
+    asm_ptr->code_size = 2*i + 1;
+    asm_ptr->symbol_id = ids[i % 97];
+    asm_ptr->statement_line = (unsigned int) i + 1;
+    TCASM_record_fixup(asm_ptr, i % 97 % 3 == 0 ? (uint16_t) (i % 4) : 0);
+  }
+  asm_ptr->code_size = 2*fixups + 4*97;
+}
+
+/**
+ * Resolve todos os operandos do contexto com TCASM_resolve_fixups, como no
+ * fim da montagem.
+ */
+static void TCASM_bench_resolve_fixups(void* ctx, size_t iterations) {
+  TCASM_assembler_t* asm_ptr = (TCASM_assembler_t*) ctx;
+  for (size_t i = 0; i < iterations; ++i)
+    TCASM_resolve_fixups(asm_ptr, true);
+}
+
+/**
+ * Le todos os simbolos do fonte de contexto com TCASM_read_char e
+ * TCASM_read_symbol, como o laco principal do montador.
+ */
+static void TCASM_bench_read_symbols(void* ctx, size_t iterations) {
+  TCASM_bench_reader_t* bench = (TCASM_bench_reader_t*) ctx;
+  TCASM_assembler_t* asm_ptr = &bench->assembler;
+  asm_ptr->source_end = bench->source + bench->source_size;
+  for (size_t i = 0; i < iterations; ++i) {
+    asm_ptr->cursor = bench->source;
+    asm_ptr->line_start = bench->source;
+    while (TCASM_read_char(asm_ptr))
+      TCASM_read_symbol(asm_ptr);
+  }
+}
+
+/**
+ * Percorre o fonte de contexto como TCASM_read_char e TCASM_read_symbol,
+ * usando as funcoes de varredura dadas.
+ * @param bench Fonte a percorrer.
+ * @param scanner Funcoes de varredura.
+ * @return Retorna as palavras, as linhas e as posicoes encontradas.
+ */
+static TCASM_bench_scan_result_t TCASM_bench_scan_walk(const TCASM_bench_reader_t* bench, const TCASM_bench_scanner_t* scanner) {
+  TCASM_bench_scan_result_t result = {0, 0, 0};
+  const char* p = bench->source;
+  const char* end = bench->source + bench->source_size;
+  while (p != end) {
+    char c = *p++;
+    if (c == ' ' || c == '\t')
+      p = scanner->blanks(p, end);
+    else if (c == ';')
+      p = scanner->line_end(p, end);
+    else if (c == '\r' || c == '\n')
+      ++result.lines;
+    else if ((c >= 'A' && c <= 'Z') || c == '_') {
+      p = scanner->identifier(p, end);
+      ++result.words;
+    }
+    result.boundaries = result.boundaries*31 + (uint64_t) (p - bench->source);
+  }
+  return result;
+}
+
+static const TCASM_bench_scanner_t TCASM_bench_scanner = {TCASM_scan_identifier, TCASM_scan_blanks, TCASM_scan_line_end};
+static const TCASM_bench_scanner_t TCASM_bench_scanner_scalar = {TCASM_scan_identifier_scalar, TCASM_scan_blanks_scalar, TCASM_scan_line_end_scalar};
+
+static void TCASM_bench_scan(void* ctx, size_t iterations) {
+  for (size_t i = 0; i < iterations; ++i)
+    TCASM_bench_scan_walk((TCASM_bench_reader_t*) ctx, &TCASM_bench_scanner);
+}
+
+#ifdef TCASM_SCAN_WIDTH
+static void TCASM_bench_scan_scalar(void* ctx, size_t iterations) {
+  for (size_t i = 0; i < iterations; ++i)
+    TCASM_bench_scan_walk((TCASM_bench_reader_t*) ctx, &TCASM_bench_scanner_scalar);
+}
+#endif
+
+/**
+ * Funcao para escrever um identificador completado com '_' ate um tamanho.
+ * @param to Destino.
+ * @param prefix Prefixo do identificador.
+ * @param number Numero que segue o prefixo.
+ * @param size Tamanho minimo do identificador.
+ * @return Retorna a quantidade de chars escritos.
+ */
+static int TCASM_bench_identifier(char* to, const char* prefix, size_t number, size_t size) {
+  int written = sprintf(to, "%s%zu", prefix, number);
+  while ((size_t) written < size)
+    to[written++] = '_';
+  return written;
+}
+
+/**
+ * Funcao para gerar um fonte em memoria com sentencas de codigo TCASM, sem
+ * pontuacao, com comentarios e espacos como no fonte real. O fonte ja esta
+ * em maiusculas, como o montador deixa o codigo-fonte.
+ * @param ctx Contexto a ser preenchido.
+ * @param lines Quantidade de linhas.
+ * @param ident_size Tamanho minimo dos identificadores (completados com '_').
+ */
+static void TCASM_bench_reader_init(TCASM_bench_reader_t* ctx, size_t lines, size_t ident_size) {
+  static const char* opcodes[] = {"LOAD", "ADD", "SUB", "STORE", "JMPP", "OUTPUT"};
+  // cada linha tem no maximo 64 chars alem dos identificadores
+  ctx->source = (char*) malloc(lines*(64 + 2*ident_size) + 1);
+  ctx->source_size = 0;
+  ctx->symbols = 0;
+  TCASM_assembler_init(&ctx->assembler);
+  for (size_t i = 0; i < lines; ++i) {
+    char* line = ctx->source + ctx->source_size;
+    if (i % 5 == 0) {
+      line += TCASM_bench_identifier(line, "ROTULO_", i, ident_size);
+      *line++ = ' ';
+      ++ctx->symbols;
+    }
+    line += sprintf(line, "  %s ", opcodes[i % 6]);
+    line += TCASM_bench_identifier(line, "VARIAVEL_", i % 97, ident_size);
+    line += sprintf(line, i % 4 == 0 ? " ; COMENTARIO DA LINHA\n" : "\n");
+    ctx->source_size = line - ctx->source;
+    ctx->symbols += 2;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  uint64_t sample_ns = TCASM_bench_init(argc, argv);
+  char name[128];
+  
+  // tabela hash: tamanho de chave e quantidade de chaves (a tabela cresce)
+  static const size_t key_sizes[] = {4, 16, 64};
+  static const size_t keys_sizes[] = {1000, 100000};
+  for (size_t i = 0; i < sizeof(key_sizes)/sizeof(key_sizes[0]); ++i) {
+    for (size_t j = 0; j < sizeof(keys_sizes)/sizeof(keys_sizes[0]); ++j) {
+      TCASM_bench_hashtable_t ctx;
+      TCASM_bench_hashtable_init(&ctx, key_sizes[i], keys_sizes[j]);
+      sprintf(name, "hashtable_get/keylen=%zu/keys=%zu", key_sizes[i], keys_sizes[j]);
+      TCASM_bench_run(name, TCASM_bench_hashtable_get, &ctx, ctx.keys_size, sample_ns);
+      sprintf(name, "hashtable_get_node/keylen=%zu/keys=%zu", key_sizes[i], keys_sizes[j]);
+      TCASM_bench_run(name, TCASM_bench_hashtable_get_node, &ctx, ctx.keys_size, sample_ns);
+      sprintf(name, "hashtable_insert/keylen=%zu/keys=%zu", key_sizes[i], keys_sizes[j]);
+      TCASM_bench_run(name, TCASM_bench_hashtable_insert, &ctx, ctx.keys_size, sample_ns);
+    }
+  }
+  
+  // tabela hash concorrente: antes de medir, confere que cada chave disputada
+  // eh criada uma unica vez; depois mede busca e insercao com 1 a 8 threads
+  TCASM_bench_hashtable_t shared;
+  TCASM_bench_hashtable_init(&shared, 16, 100000);
+  TCASM_bench_chashtable_stress(&shared, 8, 10);
+  static const int threads[] = {1, 2, 4, 8};
+  for (size_t i = 0; i < sizeof(threads)/sizeof(threads[0]); ++i) {
+    TCASM_bench_chashtable_t ctx;
+    ctx.keys = &shared;
+    ctx.threads = threads[i];
+    pthread_barrier_init(&ctx.barrier, NULL, threads[i]);
+    TCASM_chashtable_init(&ctx.table, sizeof(int), 0);
+    for (size_t k = 0; k < shared.keys_size; ++k)
+      TCASM_chashtable_get(&ctx.table, shared.keys[k], 16, NULL);
+    ctx.insert = false;
+    sprintf(name, "chashtable_get/keylen=16/keys=100000/threads=%d", threads[i]);
+    TCASM_bench_run(name, TCASM_bench_chashtable, &ctx, (double) threads[i]*shared.keys_size, sample_ns);
+    TCASM_chashtable_destroy(&ctx.table);
+    ctx.insert = true;
+    sprintf(name, "chashtable_insert/keylen=16/keys=100000/threads=%d", threads[i]);
+    TCASM_bench_run(name, TCASM_bench_chashtable, &ctx, shared.keys_size, sample_ns);
+    pthread_barrier_destroy(&ctx.barrier);
+  }
+  
+  TCASM_bench_run("list_insert_erase/size=1000", TCASM_bench_list_insert_erase, NULL, 2000, sample_ns);
+  TCASM_bench_run("list_insert_clear/size=1000", TCASM_bench_list_insert_clear, NULL, 2000, sample_ns);
+  
+  TCASM_assembler_t fixups;
+  TCASM_bench_fixups_init(&fixups, 30000);
+  TCASM_bench_run("resolve_fixups/fixups=30000", TCASM_bench_resolve_fixups, &fixups, fixups.fixups_size, sample_ns);
+  TCASM_assembler_destroy(&fixups);
+  
+  TCASM_bench_reader_t reader;
+  TCASM_bench_reader_init(&reader, 10000, 0);
+  TCASM_bench_run("read_char_symbol/lines=10000", TCASM_bench_read_symbols, &reader, reader.symbols, sample_ns);
+  
+  // fonte de alguns MB, com identificadores longos como os gerados
+  TCASM_bench_reader_t large;
+  TCASM_bench_reader_init(&large, 65536, 32);
+  TCASM_bench_scan_result_t simd = TCASM_bench_scan_walk(&large, &TCASM_bench_scanner);
+  TCASM_bench_scan_result_t scalar = TCASM_bench_scan_walk(&large, &TCASM_bench_scanner_scalar);
+  if (simd.words != scalar.words || simd.lines != scalar.lines || simd.boundaries != scalar.boundaries || simd.words != large.symbols) {
+    fprintf(stderr, "Erro: varredura %s diverge da escalar\n", TCASM_SCAN_NAME);
+    exit(EXIT_FAILURE);
+  }
+  sprintf(name, "scan/%s/lines=65536/identlen=32", TCASM_SCAN_NAME);
+  TCASM_bench_run(name, TCASM_bench_scan, &large, large.source_size, sample_ns);
+#ifdef TCASM_SCAN_WIDTH
+  TCASM_bench_run("scan/scalar/lines=65536/identlen=32", TCASM_bench_scan_scalar, &large, large.source_size, sample_ns);
+#endif
+  TCASM_bench_run("read_char_symbol/lines=65536/identlen=32", TCASM_bench_read_symbols, &large, large.symbols, sample_ns);
+  
+  return 0;
+}
@@ -0,0 +1,112 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Microbenchmark of the machine's dispatch loop, one opcode at a time.
+
+ The machine is included directly so run() can be driven on
+ synthetic programs: Instructions copies of a single instruction
+ followed by STOP. Jumps target the next instruction so the program
+ stays straight-line. INPUT reads from a temporary file and OUTPUT
+ writes to /dev/null, so those two mostly measure stdio.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#define main TCASM_machine_main
+#include "../trabalho1/TCASM_machine/TCASM_machine.cpp"
+#undef main
+
+#include "TCASM_bench.h"
+
+static const unsigned Instructions = 8192;
+static const uword One = 0xF000;
+static const uword Scratch = 0xF001;
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Benchmarked instructions. prologue loads acc with 1 before the
+ copies, so conditional jumps can be taken or not.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+struct Opcode
+{
+  const char *name;
+  uword code;
+  bool prologue;
+};
+
+static const Opcode opcodes[] =
+{
+  { "ADD", 1, false },
+  { "SUB", 2, false },
+  { "MULT", 3, false },
+  { "DIV", 4, false },
+  { "JMP", 5, false },
+  { "JMPN_not_taken", 6, true },
+  { "JMPP_taken", 7, true },
+  { "JMPZ_taken", 8, false },
+  { "COPY", 9, false },
+  { "LOAD", 10, false },
+  { "STORE", 11, false },
+  { "INPUT", 12, false },
+  { "OUTPUT", 13, false },
+};
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Fills memory with the program for one opcode.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void loadProgram(const Opcode &opcode)
+{
+  memset(data, 0, sizeof(data));
+  data[One] = 1;
+
+  uword pc = 0;
+  if (opcode.prologue)
+  {
+    data[pc++] = 10;
+    data[pc++] = One;
+  }
+
+  for (unsigned i = 0; i < Instructions; i++)
+  {
+    data[pc++] = opcode.code;
+    if (opcode.code >= 5 && opcode.code <= 8)
+      data[pc] = pc + 1, pc++;
+    else if (opcode.code == 9)
+      data[pc++] = One, data[pc++] = Scratch;
+    else
+      data[pc++] = opcode.code == 11 || opcode.code == 12 ? Scratch : One;
+  }
+
+  data[pc] = 14;
+}
+
+static void runProgram(void *, size_t iterations)
+{
+  for (size_t i = 0; i < iterations; i++)
+  {
+    rewind(stdin);
+    run<false>();
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  uint64_t sampleNs = TCASM_bench_init(argc, argv);
+
+  // results keep going to the real stdout; the programs' OUTPUT does not
+  TCASM_bench_out = fdopen(dup(STDOUT_FILENO), "w");
+  if (TCASM_bench_out == NULL || freopen("/dev/null", "w", stdout) == NULL)
+  {
+    perror("stdout");
+    return 1;
+  }
+
+  FILE *input = tmpfile();
+  for (unsigned i = 0; i < Instructions; i++)
+    fputs("1\n", input);
+  fflush(input);
+  dup2(fileno(input), STDIN_FILENO);
+
+  for (unsigned i = 0; i < sizeof(opcodes) / sizeof(opcodes[0]); i++)
+  {
+    std::string name = std::string("machine_dispatch/op=") + opcodes[i].name;
+    loadProgram(opcodes[i]);
+    TCASM_bench_run(name.c_str(), runProgram, NULL, Instructions, sampleNs);
+  }
+
+  return 0;
+}
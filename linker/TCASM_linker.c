@@ -0,0 +1,85 @@
+/*
+ * Ligador de objetos relocaveis gerados por ./TCASM_assembler --object. Le
+ * os objetos na ordem da linha de comando, resolve os simbolos importados
+ * entre eles e escreve o codigo ligado no mesmo formato do montador.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../trabalho1/TCASM_assembler/TCASM_object.h"
+
+/**
+ * Quantidade de palavras da memoria da maquina hipotetica.
+ */
+#define TCASM_LINKER_MEMORY_SIZE 65536
+
+/**
+ * Funcao para ler um objeto de um arquivo.
+ * @param path Nome do arquivo.
+ * @param object_ptr Ponteiro do objeto, ja inicializado.
+ * @return Retorna false se o arquivo nao pode ser lido ou nao eh um objeto.
+ */
+static bool TCASM_linker_read(const char* path, TCASM_object_t* object_ptr) {
+  FILE* fin;
+  if ((fin = fopen(path, "rb")) == NULL) {
+    fprintf(stderr, "Erro: Nao foi possivel abrir o arquivo \"%s\"\n", path);
+    return false;
+  }
+  
+  bool ok = TCASM_object_deserialize(object_ptr, fin);
+  if (!ok)
+    fprintf(stderr, "Erro: O arquivo \"%s\" nao eh um objeto TCASM valido\n", path);
+  
+  fclose(fin);
+  return ok;
+}
+
+/**
+ * Funcao para escrever o codigo ligado.
+ * @param path Nome do arquivo de saida.
+ * @param code Codigo ligado.
+ * @param size Quantidade de palavras.
+ * @return Retorna false se o arquivo nao pode ser aberto.
+ */
+static bool TCASM_linker_write(const char* path, const uint16_t* code, size_t size) {
+  FILE* fout;
+  if ((fout = fopen(path, "wb")) == NULL) {
+    fprintf(stderr, "Erro: Nao foi possivel abrir o arquivo \"%s\" para escrita\n", path);
+    return false;
+  }
+  
+  fwrite(code, sizeof(uint16_t), size, fout);
+  
+  fclose(fout);
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    fprintf(stderr, "Erro: Argumentos incorretos. Forma de utilizacao: ./TCASM_linker <arquivo_saida> <objeto>...\n");
+    return EXIT_FAILURE;
+  }
+  
+  size_t count = (size_t) argc - 2;
+  const char* const* names = (const char* const*) &argv[2];
+  TCASM_object_t* objects = (TCASM_object_t*) malloc(count*sizeof(TCASM_object_t));
+  bool ok = true;
+  for (size_t i = 0; i < count; ++i) {
+    TCASM_object_init(&objects[i]);
+    ok = TCASM_linker_read(names[i], &objects[i]) && ok;
+  }
+  
+  uint16_t* code = (uint16_t*) malloc(TCASM_LINKER_MEMORY_SIZE*sizeof(uint16_t));
+  size_t size = 0;
+  ok = ok && TCASM_object_link(objects, names, count, code, &size, stderr) && TCASM_linker_write(argv[1], code, size);
+  
+  free(code);
+  for (size_t i = 0; i < count; ++i)
+    TCASM_object_destroy(&objects[i]);
+  free(objects);
+  return ok ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,358 @@
+#define _POSIX_C_SOURCE 200809L
+
+/*
+ * Servidor de montagem incremental. Recebe codigos-fonte por um socket Unix
+ * e guarda, para cada nome de arquivo, o contexto de montagem e a ultima
+ * imagem montada sem erros. Uma nova versao de um arquivo e montada com
+ * TCASM_assembler_update, que refaz apenas as linhas alteradas da secao de
+ * texto, e a resposta leva apenas os trechos da imagem que mudaram.
+ */
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../trabalho1/TCASM_assembler/TCASM_assembler.h"
+#include "../trabalho1/TCASM_assembler/TCASM_hashtable.h"
+
+/**
+ * Quantidade de palavras iguais que ainda ficam dentro de um trecho
+ * alterado. Um trecho novo custa 8 bytes de cabecalho, entao lacunas menores
+ * sao enviadas junto.
+ */
+#define TCASM_SERVER_RUN_GAP 4
+
+/**
+ * Tamanho maximo, em bytes, de um codigo-fonte recebido por ASSEMBLE. Um
+ * pedido maior eh recusado sem alocar nada.
+ */
+#define TCASM_SERVER_MAX_SOURCE (64*1024*1024)
+
+/**
+ * Struct com o estado de um arquivo fonte, guardado na tabela hash pelo
+ * nome.
+ */
+typedef struct {
+  /// Indica se o arquivo esta aberto (false depois de FORGET).
+  bool open;
+  
+  /// Contexto de montagem, reaproveitado entre as versoes do arquivo.
+  TCASM_assembler_t assembler;
+  
+  /// Ultima imagem montada sem erros, que o cliente ja recebeu.
+  uint16_t* image;
+  size_t image_size;
+} TCASM_server_file_t;
+
+/**
+ * Struct com o estado do servidor.
+ */
+typedef struct {
+  /// Arquivos, indexados pelo nome.
+  TCASM_hashtable_t files;
+  
+  /// Arquivos ja abertos alguma vez, para liberar no fim.
+  TCASM_server_file_t** opened;
+  size_t opened_size;
+  size_t opened_capacity;
+  
+  /// Buffer dos codigos-fonte recebidos.
+  char* source;
+  size_t source_capacity;
+} TCASM_server_t;
+
+/**
+ * Funcao que retorna o tempo monotonico atual.
+ * @return Retorna o tempo em nanossegundos.
+ */
+static uint64_t TCASM_server_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Funcao para escrever um inteiro de 16 bits em little-endian.
+ * @param out Arquivo de saida.
+ * @param value Valor.
+ */
+static void TCASM_server_put16(FILE* out, uint16_t value) {
+  fputc(value & 0xFF, out);
+  fputc(value >> 8, out);
+}
+
+/**
+ * Funcao para escrever um inteiro de 32 bits em little-endian.
+ * @param out Arquivo de saida.
+ * @param value Valor.
+ */
+static void TCASM_server_put32(FILE* out, uint32_t value) {
+  TCASM_server_put16(out, value & 0xFFFF);
+  TCASM_server_put16(out, value >> 16);
+}
+
+/**
+ * Funcao que acha o proximo trecho em que a imagem nova difere da anterior.
+ * Palavras alem do fim da imagem anterior sempre contam como diferentes.
+ * @param file Arquivo, com a imagem anterior.
+ * @param code Imagem nova.
+ * @param size Tamanho da imagem nova.
+ * @param addr Endereco onde a busca comeca; recebe o inicio do trecho.
+ * @return Retorna o tamanho do trecho, ou 0 se nao ha mais diferencas.
+ */
+static size_t TCASM_server_next_run(const TCASM_server_file_t* file, const uint16_t* code, size_t size, size_t* addr) {
+  size_t common = file->image_size < size ? file->image_size : size;
+  size_t i = *addr;
+  
+  // blocos iguais sao pulados com memcmp
+  while (i + 64 <= common && memcmp(code + i, file->image + i, 64*sizeof(uint16_t)) == 0)
+    i += 64;
+  while (i < common && code[i] == file->image[i])
+    ++i;
+  if (i == size)
+    return 0;
+  
+  // o trecho termina quando ha TCASM_SERVER_RUN_GAP palavras iguais seguidas
+  size_t begin = i, end = i + 1, equal = 0;
+  for (i = end; i < size && equal < TCASM_SERVER_RUN_GAP; ++i) {
+    if (i < common && code[i] == file->image[i])
+      ++equal;
+    else {
+      equal = 0;
+      end = i + 1;
+    }
+  }
+  *addr = begin;
+  return end - begin;
+}
+
+/**
+ * Funcao que escreve a resposta de uma montagem: o cabecalho, os
+ * diagnosticos e, se nao houve erros, os trechos da imagem que mudaram em
+ * relacao a ultima imagem enviada, que passa a ser a nova. Se a escrita
+ * falha, a imagem anterior continua valendo.
+ * @param file Arquivo montado.
+ * @param ok Indica se a montagem terminou sem erros.
+ * @param time Tempo da montagem, em nanossegundos.
+ * @param out Conexao com o cliente.
+ * @return Retorna false se a resposta nao pode ser escrita.
+ */
+static bool TCASM_server_reply(TCASM_server_file_t* file, bool ok, uint64_t time, FILE* out) {
+  const TCASM_assembler_t* asm_ptr = &file->assembler;
+  char* diagnostics = NULL;
+  size_t diagnostics_size = 0;
+  FILE* stream = open_memstream(&diagnostics, &diagnostics_size);
+  TCASM_assembler_print_diagnostics(asm_ptr, NULL, stream);
+  fclose(stream);
+  
+  size_t runs = 0;
+  if (ok) {
+    size_t addr = 0, run;
+    while ((run = TCASM_server_next_run(file, asm_ptr->code, asm_ptr->code_size, &addr)) > 0) {
+      ++runs;
+      addr += run;
+    }
+  }
+  fprintf(out, "%s %zu %s %llu %zu %zu\n", ok ? "OK" : "ERRO", ok ? asm_ptr->code_size : file->image_size, asm_ptr->incremental.reused ? "INCREMENTAL" : "COMPLETA", (unsigned long long) (time/1000), diagnostics_size, runs);
+  fwrite(diagnostics, 1, diagnostics_size, out);
+  free(diagnostics);
+  if (!ok)
+    return fflush(out) == 0;
+  
+  size_t addr = 0, run;
+  while ((run = TCASM_server_next_run(file, asm_ptr->code, asm_ptr->code_size, &addr)) > 0) {
+    TCASM_server_put32(out, (uint32_t) addr);
+    TCASM_server_put32(out, (uint32_t) run);
+    for (size_t i = addr; i < addr + run; ++i)
+      TCASM_server_put16(out, asm_ptr->code[i]);
+    addr += run;
+  }
+  if (fflush(out) != 0)
+    return false;
+  
+  if (file->image == NULL)
+    file->image = (uint16_t*) malloc(TCASM_ASSEMBLER_MEMORY_SIZE*sizeof(uint16_t));
+  memcpy(file->image, asm_ptr->code, asm_ptr->code_size*sizeof(uint16_t));
+  file->image_size = asm_ptr->code_size;
+  return true;
+}
+
+/**
+ * Funcao para obter o estado de um arquivo pelo nome, criando-o (fechado)
+ * se ainda nao existe.
+ * @param server Estado do servidor.
+ * @param name Nome do arquivo.
+ * @return Retorna o ponteiro do arquivo.
+ */
+static TCASM_server_file_t* TCASM_server_file(TCASM_server_t* server, const char* name) {
+  bool created;
+  TCASM_server_file_t* file = (TCASM_server_file_t*) TCASM_hashtable_get(&server->files, name, strlen(name), &created);
+  if (created) {
+    if (server->opened_size == server->opened_capacity) {
+      server->opened_capacity = server->opened_capacity == 0 ? 16 : server->opened_capacity*2;
+      server->opened = (TCASM_server_file_t**) realloc(server->opened, server->opened_capacity*sizeof(TCASM_server_file_t*));
+    }
+    server->opened[server->opened_size++] = file;
+  }
+  return file;
+}
+
+/**
+ * Funcao que trata o pedido ASSEMBLE: le o codigo-fonte da conexao, monta
+ * e responde. Um codigo-fonte maior que TCASM_SERVER_MAX_SOURCE, ou que nao
+ * cabe na memoria, eh respondido com ERRO sem ser lido, e a conexao deve ser
+ * fechada, porque os bytes dele continuam nela. A conexao tambem deve ser
+ * fechada se a resposta nao pode ser escrita.
+ * @param server Estado do servidor.
+ * @param name Nome do arquivo.
+ * @param size Tamanho do codigo-fonte.
+ * @param in Conexao com o cliente, para leitura.
+ * @param out Conexao com o cliente, para escrita.
+ * @return Retorna false se a conexao deve ser fechada.
+ */
+static bool TCASM_server_assemble(TCASM_server_t* server, const char* name, size_t size, FILE* in, FILE* out) {
+  if (size > TCASM_SERVER_MAX_SOURCE) {
+    fprintf(out, "ERRO Codigo-fonte maior que %d bytes\n", TCASM_SERVER_MAX_SOURCE);
+    return false;
+  }
+  if (server->source_capacity < size) {
+    char* source = (char*) realloc(server->source, size);
+    if (source == NULL) {
+      fprintf(out, "ERRO Memoria insuficiente\n");
+      return false;
+    }
+    server->source = source;
+    server->source_capacity = size;
+  }
+  if (fread(server->source, 1, size, in) != size)
+    return false;
+  
+  TCASM_server_file_t* file = TCASM_server_file(server, name);
+  if (!file->open) {
+    TCASM_assembler_init(&file->assembler);
+    file->open = true;
+  }
+  
+  uint64_t start = TCASM_server_now();
+  bool ok = TCASM_assembler_update(&file->assembler, server->source, size);
+  return TCASM_server_reply(file, ok, TCASM_server_now() - start, out);
+}
+
+/**
+ * Funcao que fecha um arquivo: o contexto e a imagem sao liberados, e a
+ * proxima montagem dele sera completa.
+ * @param file Arquivo.
+ */
+static void TCASM_server_forget(TCASM_server_file_t* file) {
+  if (!file->open)
+    return;
+  
+  TCASM_assembler_destroy(&file->assembler);
+  free(file->image);
+  file->image = NULL;
+  file->image_size = 0;
+  file->open = false;
+}
+
+/**
+ * Funcao que atende uma conexao ate o cliente fecha-la ou pedir SHUTDOWN.
+ * Cada pedido eh uma linha:
+ *   ASSEMBLE <nome> <tamanho>, seguida dos bytes do codigo-fonte;
+ *   FORGET <nome>;
+ *   SHUTDOWN.
+ * @param server Estado do servidor.
+ * @param fd Descritor da conexao.
+ * @return Retorna true se o cliente pediu SHUTDOWN.
+ */
+static bool TCASM_server_serve(TCASM_server_t* server, int fd) {
+  FILE* in = fdopen(fd, "rb");
+  FILE* out = fdopen(dup(fd), "wb");
+  char* line = NULL;
+  size_t line_capacity = 0;
+  bool shutdown = false;
+  
+  while (!shutdown && getline(&line, &line_capacity, in) > 0) {
+    char name[4096];
+    size_t size;
+    if (sscanf(line, "ASSEMBLE %4095s %zu", name, &size) == 2) {
+      if (!TCASM_server_assemble(server, name, size, in, out))
+        break;
+    }
+    else if (sscanf(line, "FORGET %4095s", name) == 1) {
+      TCASM_server_forget(TCASM_server_file(server, name));
+      fprintf(out, "OK\n");
+    }
+    else if (strcmp(line, "SHUTDOWN\n") == 0) {
+      fprintf(out, "OK\n");
+      shutdown = true;
+    }
+    else
+      fprintf(out, "ERRO Pedido invalido\n");
+    
+    // um cliente que fechou a conexao so derruba a propria conexao
+    if (fflush(out) != 0)
+      break;
+  }
+  
+  free(line);
+  fclose(out);
+  fclose(in);
+  return shutdown;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "Uso: %s <socket>\n", argv[0]);
+    return 1;
+  }
+  
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(argv[1]) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Erro: Caminho do socket muito longo\n");
+    return 1;
+  }
+  strcpy(addr.sun_path, argv[1]);
+  
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(argv[1]);
+  if (listener < 0 || bind(listener, (struct sockaddr*) &addr, sizeof(addr)) != 0 || listen(listener, 8) != 0) {
+    perror("Erro: Nao foi possivel abrir o socket");
+    return 1;
+  }
+  
+  // escrever em uma conexao ja fechada pelo cliente deve falhar com EPIPE, e
+  // nao encerrar o servidor
+  signal(SIGPIPE, SIG_IGN);
+  
+  TCASM_server_t server;
+  memset(&server, 0, sizeof(server));
+  TCASM_hashtable_init(&server.files, sizeof(TCASM_server_file_t), TCASM_HASHTABLE_DEFAULT_SIZE);
+  
+  // as conexoes sao atendidas uma de cada vez, entao os arquivos nao sao
+  // compartilhados entre threads
+  bool shutdown = false;
+  while (!shutdown) {
+    int fd = accept(listener, NULL, NULL);
+    if (fd >= 0)
+      shutdown = TCASM_server_serve(&server, fd);
+  }
+  
+  for (size_t i = 0; i < server.opened_size; ++i)
+    TCASM_server_forget(server.opened[i]);
+  free(server.opened);
+  free(server.source);
+  TCASM_hashtable_destroy(&server.files);
+  close(listener);
+  unlink(argv[1]);
+  return 0;
+}
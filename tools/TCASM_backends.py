@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""Runs one TCASM program through every available backend and compares them.
+
+Usage: TCASM_backends.py [--repeat N] [--cflags FLAGS] [--input VALUES]...
+                         [--input-file FILE]... <program.s|program.bin>
+
+Backends:
+  machine  the TCASM_machine interpreter;
+  elf      the native binary written by TCASM_IA-32_ELF_generator;
+  nasm     the NASM source written by TCASM_IA-32_disassembler, assembled
+           with nasm -f elf32 and linked with ld -m elf_i386.
+A backend whose tools are missing (nasm, ld) or whose binaries the host
+cannot execute is skipped with a note instead of failing the run.
+
+Every input set (--input "0 1 0" gives one number per line, --input-file is
+used verbatim; without either the program gets an empty input) is run N
+times on every backend. The standard output of each backend must match the
+interpreter's byte for byte; exit statuses are not compared, since a native
+program killed by SIGFPE and the interpreter reporting a division by zero
+are the same outcome. The exit status is 1 on any mismatch.
+
+Startup cost is the median wall time of a program made only of STOP on the
+same backend. The per-instruction cost is (median - startup) divided by the
+instructions the interpreter retires on that input (--metrics).
+"""
+
+import argparse
+import os
+import shutil
+import signal
+import statistics
+import subprocess
+import sys
+import tempfile
+
+from TCASM_bench_e2e import build, retired, timed
+
+BACKENDS = ["machine", "elf", "nasm"]
+
+
+def prepare(tools, backend, binary):
+    """Translates an assembled program for a backend.
+
+    Returns the command that runs it, or raises RuntimeError with the reason
+    the backend is unavailable.
+    """
+    base = os.path.splitext(binary)[0]
+    if backend == "machine":
+        return [tools["machine"], binary]
+    if backend == "elf":
+        elf = base + ".elf"
+        subprocess.run([tools["generator"], binary, elf], check=True, stdout=subprocess.DEVNULL)
+        return [elf]
+    for tool in ("nasm", "ld"):
+        if shutil.which(tool) is None:
+            raise RuntimeError("%s not found" % tool)
+    source = base + ".asm"
+    obj = base + ".o"
+    executable = base + ".nasm"
+    subprocess.run([tools["disassembler"], binary, source], check=True)
+    for command in (["nasm", "-f", "elf32", "-o", obj, source], ["ld", "-s", "-m", "elf_i386", "-o", executable, obj]):
+        process = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+        if process.returncode != 0:
+            raise RuntimeError("%s failed: %s" % (command[0], process.stdout.decode().strip()))
+    return [executable]
+
+
+def samples(command, stdin, repeat):
+    """Runs a command repeat times; returns (wall times, first completed process)."""
+    times = []
+    first = None
+    for _ in range(repeat):
+        seconds, process = timed(command, stdin)
+        times.append(seconds)
+        if first is None:
+            first = process
+    return times, first
+
+
+def outcome(process):
+    if process.returncode < 0:
+        return "killed by %s" % signal.Signals(-process.returncode).name
+    return "exit %d" % process.returncode
+
+
+def assemble(tools, source, binary):
+    process = subprocess.run([tools["assembler"], source, binary], stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+    if process.returncode != 0:
+        sys.exit("%s: assembler failed:\n%s" % (source, process.stdout.decode()))
+
+
+def inputs(args):
+    """Returns (label, bytes) for every input set given on the command line."""
+    sets = [("\"%s\"" % values, "".join(value + "\n" for value in values.replace(",", " ").split()).encode())
+            for values in args.input]
+    for path in args.input_file:
+        with open(path, "rb") as f:
+            sets.append((path, f.read()))
+    return sets or [("(empty)", b"")]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("program", help="TCASM source (.s, .asm) or assembled program (.bin)")
+    parser.add_argument("--repeat", type=int, default=5, help="runs of each backend per input (default 5)")
+    parser.add_argument("--cflags", default="-O2", help="compiler flags for the toolchain (default -O2)")
+    parser.add_argument("--input", action="append", default=[], metavar="VALUES",
+                        help="input numbers, separated by spaces or commas (repeatable)")
+    parser.add_argument("--input-file", action="append", default=[], metavar="FILE",
+                        help="file used verbatim as input (repeatable)")
+    args = parser.parse_args()
+
+    status = 0
+    with tempfile.TemporaryDirectory(prefix="tcasm-backends-") as workdir:
+        tools = build(workdir, args.cflags)
+
+        binary = os.path.join(workdir, "program.bin")
+        if args.program.endswith(".bin"):
+            shutil.copyfile(args.program, binary)
+        else:
+            assemble(tools, os.path.abspath(args.program), binary)
+        empty = os.path.join(workdir, "empty.s")
+        with open(empty, "w") as f:
+            f.write("SECTION TEXT\n  STOP\n")
+        assemble(tools, empty, os.path.join(workdir, "empty.bin"))
+
+        # Commands of every available backend and their startup cost.
+        commands = {}
+        startup = {}
+        for backend in BACKENDS:
+            try:
+                baseline = prepare(tools, backend, os.path.join(workdir, "empty.bin"))
+                command = prepare(tools, backend, binary)
+                startup[backend] = statistics.median(samples(baseline, b"", args.repeat)[0])
+                commands[backend] = command
+            except RuntimeError as error:
+                print("skipping %s: %s" % (backend, error))
+            except OSError as error:
+                print("skipping %s: cannot execute (%s)" % (backend, error.strerror))
+
+        for label, stdin in inputs(args):
+            count = retired(tools, binary, stdin, workdir)
+            print("\ninput %s: %d instructions" % (label, count))
+            print("  %-8s %12s %12s %14s  %s" % ("backend", "startup ms", "median ms", "ns/instruction", "output"))
+            reference = None
+            for backend in BACKENDS:
+                if backend not in commands:
+                    continue
+                times, process = samples(commands[backend], stdin, args.repeat)
+                median = statistics.median(times)
+                output = process.stdout
+                if reference is None:
+                    reference = output
+                    verdict = "reference (%d bytes)" % len(output)
+                elif output == reference:
+                    verdict = "matches"
+                else:
+                    verdict = "MISMATCH (%d bytes, %s)" % (len(output), outcome(process))
+                    status = 1
+                # programs shorter than the startup noise have no meaningful per-instruction cost
+                if count and median > startup[backend]:
+                    per_instruction = "%14.2f" % ((median - startup[backend]) / count * 1e9)
+                else:
+                    per_instruction = "%14s" % "-"
+                print("  %-8s %12.3f %12.3f %s  %s" % (
+                    backend, startup[backend] * 1e3, median * 1e3, per_instruction, verdict))
+
+    return status
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,292 @@
+#!/usr/bin/env python3
+"""End-to-end benchmark of the TCASM toolchain, with history and a regression gate.
+
+Usage: TCASM_bench_e2e.py [--repeat N] [--cflags FLAGS] [--history FILE]
+                          [--baseline FILE] [--save-baseline] [--no-history]
+                          [--alpha P] [--threshold RATIO] [--min-delta MS]
+
+Builds the assembler, the machine and the ELF generator, then for every
+program of a fixed corpus (bench.asm, The3n+1Problem.s, zerinho.s and two
+programs from TCASM_generate.py) times N runs of each stage: assemble,
+interpret, ELF-translate and run the native binary. Native runs are skipped when the
+host cannot execute 32-bit ELF files.
+
+Each run is appended to the history file (JSON) with wall times, instructions
+per second and output sizes. When a baseline file exists, every timed stage
+is compared against it with a one-sided Mann-Whitney U test: a stage is a
+regression if it is slower with p < --alpha and its median grew by more than
+--threshold and by more than --min-delta milliseconds (stages that take about
+a millisecond are dominated by process startup noise). Output sizes are deterministic, so any growth is a regression.
+The exit status is 1 when a regression is found, so this can gate a change.
+"""
+
+import argparse
+import datetime
+import json
+import os
+import platform
+import shlex
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+from TCASM_generate import generate
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+ASSEMBLER = os.path.join(ROOT, "trabalho1", "TCASM_assembler")
+MACHINE = os.path.join(ROOT, "trabalho1", "TCASM_machine")
+GENERATOR = os.path.join(ROOT, "trabalho2", "TCASM_IA-32_ELF_generator")
+DISASSEMBLER = os.path.join(ROOT, "trabalho2", "TCASM_IA-32_disassembler")
+EXAMPLES = os.path.join(ASSEMBLER, "programas_exemplo")
+
+ASSEMBLER_SOURCES = ["TCASM_main.c", "TCASM_assembler.c", "TCASM_hashtable.c", "TCASM_intern.c",
+                     "TCASM_list.c", "TCASM_map.c", "TCASM_object.c", "TCASM_stats.c", "TCASM_symbol.c"]
+
+STAGES = ["assemble", "interpret", "translate", "native"]
+SIZES = ["bin_bytes", "elf_bytes"]
+
+
+def corpus(workdir):
+    """Returns (name, source path, input) for every program of the corpus."""
+    programs = [
+        ("bench", os.path.join(ROOT, "trabalho1", "bench.asm"), "1\n"),
+        ("The3n+1Problem", os.path.join(EXAMPLES, "The3n+1Problem.s"), "27\n"),
+        # the generator supports a single STOP, as in the trabalho2 version of zerinho
+        ("zerinho", os.path.join(DISASSEMBLER, "programas_exemplo", "zerinho.s"), "0\n1\n0\n"),
+    ]
+    for name, words, iterations in (("generated_4k", 4096, "500\n"), ("generated_40k", 40960, "50\n")):
+        path = os.path.join(workdir, name + ".s")
+        with open(path, "w") as f:
+            f.write(generate(words, seed=words))
+        programs.append((name, path, iterations))
+    return programs
+
+
+def build(workdir, cflags):
+    """Builds the toolchain in workdir and returns the paths of the binaries."""
+    tools = {
+        "assembler": os.path.join(workdir, "TCASM_assembler"),
+        "machine": os.path.join(workdir, "TCASM_machine"),
+        "generator": os.path.join(workdir, "TCASM_IA-32_ELF_generator"),
+        "disassembler": os.path.join(workdir, "TCASM_IA-32_disassembler"),
+    }
+    flags = shlex.split(cflags)
+    commands = [
+        ["gcc", "-std=c99"] + flags + ASSEMBLER_SOURCES + ["-o", tools["assembler"]],
+        ["g++", "-std=c++0x"] + flags + [os.path.join(MACHINE, "TCASM_machine.cpp"), "-o", tools["machine"]],
+        ["g++", "-std=c++0x"] + flags + [os.path.join(GENERATOR, "TCASM_IA-32_ELF_generator.cpp"),
+                                         "-o", tools["generator"]],
+        ["gcc", "-std=c99"] + flags + [os.path.join(DISASSEMBLER, "TCASM_IA-32_disassembler.c"),
+                                       "-o", tools["disassembler"]],
+    ]
+    for command in commands:
+        subprocess.run(command, cwd=ASSEMBLER, check=True)
+    return tools
+
+
+def timed(command, stdin=b""):
+    """Runs a command and returns (seconds, completed process)."""
+    start = time.perf_counter()
+    process = subprocess.run(command, input=stdin, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    return time.perf_counter() - start, process
+
+
+def retired(tools, binary, stdin, workdir):
+    """Counts the instructions the machine retires on a program."""
+    metrics = os.path.join(workdir, "metrics.prom")
+    subprocess.run([tools["machine"], "--metrics", metrics, binary], input=stdin,
+                   stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    with open(metrics) as f:
+        for line in f:
+            if line.startswith("tcasm_instructions_retired_total "):
+                return int(line.split()[1])
+    return 0
+
+
+def measure(tools, name, source, stdin, repeat, workdir):
+    """Times every stage of one program and returns its result record."""
+    binary = os.path.join(workdir, name + ".bin")
+    elf = os.path.join(workdir, name + ".elf")
+    stdin = stdin.encode()
+    samples = {stage: [] for stage in STAGES}
+    native = True
+
+    for _ in range(repeat):
+        seconds, process = timed([tools["assembler"], source, binary])
+        if process.returncode != 0:
+            sys.exit("%s: assembler failed:\n%s" % (name, process.stderr.decode()))
+        samples["assemble"].append(seconds)
+        samples["interpret"].append(timed([tools["machine"], binary], stdin)[0])
+        samples["translate"].append(timed([tools["generator"], binary, elf])[0])
+        if native:
+            try:
+                samples["native"].append(timed([elf], stdin)[0])
+            except OSError:
+                native = False
+
+    count = retired(tools, binary, stdin, workdir)
+    result = {
+        "instructions": count,
+        "bin_bytes": os.path.getsize(binary),
+        "elf_bytes": os.path.getsize(elf),
+        "stages": {},
+    }
+    for stage in STAGES:
+        if not samples[stage]:
+            continue
+        median = statistics.median(samples[stage])
+        entry = {"samples": samples[stage], "median": median}
+        if stage in ("interpret", "native") and median > 0:
+            entry["ips"] = count / median
+        result["stages"][stage] = entry
+    return result
+
+
+def mann_whitney_greater(current, baseline):
+    """One-sided exact Mann-Whitney U test that `current` tends to be larger.
+
+    Ties count as half. Returns the p-value, computed from the exact null
+    distribution of U (rounded down, which is conservative with ties).
+    """
+    n, m = len(current), len(baseline)
+    u = sum(1.0 if c > b else 0.5 if c == b else 0.0 for c in current for b in baseline)
+
+    # ways[k] = number of orderings of n + m values whose U equals k
+    ways = [[[1] + [0] * (n * m) for _ in range(m + 1)] for _ in range(n + 1)]
+    for i in range(n + 1):
+        for j in range(m + 1):
+            if i == 0 or j == 0:
+                continue
+            for k in range(n * m + 1):
+                ways[i][j][k] = ways[i][j - 1][k] + (ways[i - 1][j][k - j] if k >= j else 0)
+    total = sum(ways[n][m])
+    return sum(ways[n][m][int(u):]) / total
+
+
+def compare(current, baseline, alpha, threshold, min_delta):
+    """Returns a list of regression messages of the current run against the baseline."""
+    regressions = []
+    for name, result in sorted(current["results"].items()):
+        base = baseline["results"].get(name)
+        if base is None:
+            continue
+        for size in SIZES:
+            if result[size] > base[size]:
+                regressions.append("%s %s: %d -> %d bytes" % (name, size, base[size], result[size]))
+        for stage, entry in sorted(result["stages"].items()):
+            base_entry = base["stages"].get(stage)
+            if base_entry is None:
+                continue
+            ratio = entry["median"] / base_entry["median"]
+            if ratio <= 1 + threshold or entry["median"] - base_entry["median"] <= min_delta:
+                continue
+            p = mann_whitney_greater(entry["samples"], base_entry["samples"])
+            if p < alpha:
+                regressions.append("%s %s: %.3f ms -> %.3f ms (%+.1f%%, p=%.3f)" % (
+                    name, stage, base_entry["median"] * 1e3, entry["median"] * 1e3, (ratio - 1) * 100, p))
+    return regressions
+
+
+def git_revision():
+    try:
+        revision = subprocess.run(["git", "rev-parse", "--short", "HEAD"], cwd=ROOT, stdout=subprocess.PIPE,
+                                  stderr=subprocess.DEVNULL, check=True).stdout.decode().strip()
+        dirty = subprocess.run(["git", "diff", "--quiet", "HEAD"], cwd=ROOT).returncode != 0
+        return revision + ("-dirty" if dirty else "")
+    except (OSError, subprocess.CalledProcessError):
+        return "unknown"
+
+
+def load_json(path, default):
+    if not os.path.exists(path):
+        return default
+    with open(path) as f:
+        return json.load(f)
+
+
+def save_json(path, value):
+    temporary = path + ".tmp"
+    with open(temporary, "w") as f:
+        json.dump(value, f, indent=1)
+        f.write("\n")
+    os.replace(temporary, path)
+
+
+def report(run):
+    print("%-16s %10s %10s %10s %10s %12s %12s %8s %8s" % (
+        "program", "asm ms", "vm ms", "elf ms", "native ms", "vm ips", "native ips", "bin B", "elf B"))
+    for name, result in run["results"].items():
+        stages = result["stages"]
+
+        def ms(stage):
+            return "%10.2f" % (stages[stage]["median"] * 1e3) if stage in stages else "%10s" % "-"
+
+        def ips(stage):
+            return "%12.3g" % stages[stage]["ips"] if "ips" in stages.get(stage, {}) else "%12s" % "-"
+
+        print("%-16s %s %s %s %s %s %s %8d %8d" % (
+            name, ms("assemble"), ms("interpret"), ms("translate"), ms("native"),
+            ips("interpret"), ips("native"), result["bin_bytes"], result["elf_bytes"]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--repeat", type=int, default=5, help="runs of each stage (default 5)")
+    parser.add_argument("--cflags", default="-O2", help="compiler flags for the toolchain (default -O2)")
+    parser.add_argument("--history", default=os.path.join(ROOT, "bench", "e2e_history.json"))
+    parser.add_argument("--baseline", default=os.path.join(ROOT, "bench", "e2e_baseline.json"))
+    parser.add_argument("--save-baseline", action="store_true", help="store this run as the new baseline")
+    parser.add_argument("--no-history", action="store_true", help="do not append this run to the history")
+    parser.add_argument("--alpha", type=float, default=0.05, help="significance level (default 0.05)")
+    parser.add_argument("--threshold", type=float, default=0.05,
+                        help="minimum median slowdown to report (default 0.05 = 5%%)")
+    parser.add_argument("--min-delta", type=float, default=1.0,
+                        help="minimum median slowdown to report, in milliseconds (default 1.0)")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory(prefix="tcasm-bench-") as workdir:
+        tools = build(workdir, args.cflags)
+        run = {
+            "timestamp": datetime.datetime.now(datetime.timezone.utc).isoformat(timespec="seconds"),
+            "revision": git_revision(),
+            "host": platform.node(),
+            "machine": platform.machine(),
+            "cflags": args.cflags,
+            "repeat": args.repeat,
+            "results": {},
+        }
+        for name, source, stdin in corpus(workdir):
+            run["results"][name] = measure(tools, name, source, stdin, args.repeat, workdir)
+
+    report(run)
+
+    if not args.no_history:
+        history = load_json(args.history, {"runs": []})
+        history["runs"].append(run)
+        save_json(args.history, history)
+
+    status = 0
+    baseline = load_json(args.baseline, None)
+    if baseline is not None and not args.save_baseline:
+        if baseline.get("cflags") != run["cflags"]:
+            print("\nbaseline was built with cflags %r, not %r; not comparing" % (baseline.get("cflags"), run["cflags"]))
+        else:
+            regressions = compare(run, baseline, args.alpha, args.threshold, args.min_delta / 1e3)
+            print("\nagainst baseline %s (%s):" % (baseline["revision"], baseline["timestamp"]))
+            for regression in regressions:
+                print("  REGRESSION " + regression)
+            if not regressions:
+                print("  no significant regression")
+            status = 1 if regressions else 0
+
+    if args.save_baseline:
+        save_json(args.baseline, run)
+        print("\nbaseline saved to %s" % args.baseline)
+
+    return status
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""Checks that the machine and the assembler carry their USDT probe notes.
+
+Usage: TCASM_check_probes.py [--cflags FLAGS]
+
+Builds TCASM_machine and TCASM_assembler in a temporary directory and reads
+their .note.stapsdt entries with readelf -n. Every probe of the "tcasm"
+provider listed below must be present in its binary; a missing one is
+reported and the exit status is 1.
+
+The probes only exist when <sys/sdt.h> (package systemtap-sdt-dev) is
+available, so without it the check is skipped with a message and exits 0.
+"""
+
+import argparse
+import os
+import shlex
+import shutil
+import subprocess
+import sys
+import tempfile
+
+from TCASM_bench_e2e import ASSEMBLER, ASSEMBLER_SOURCES, MACHINE
+
+PROVIDER = "tcasm"
+PROBES = {
+    "machine": ["load", "input", "output", "stop", "error"],
+    "assembler": ["assemble_start", "assemble_end", "symbol_resolve"],
+}
+
+
+def has_sdt(flags, workdir):
+    """Tells whether the compiler finds <sys/sdt.h>."""
+    source = os.path.join(workdir, "sdt.c")
+    with open(source, "w") as f:
+        f.write("#include <sys/sdt.h>\n")
+    process = subprocess.run(["gcc", "-fsyntax-only"] + flags + [source],
+                             stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    return process.returncode == 0
+
+
+def build(flags, workdir):
+    """Builds the machine and the assembler and returns their paths."""
+    tools = {
+        "machine": os.path.join(workdir, "TCASM_machine"),
+        "assembler": os.path.join(workdir, "TCASM_assembler"),
+    }
+    commands = [
+        ["g++", "-std=c++0x"] + flags + [os.path.join(MACHINE, "TCASM_machine.cpp"), "-o", tools["machine"]],
+        ["gcc", "-std=c99"] + flags + ASSEMBLER_SOURCES + ["-o", tools["assembler"]],
+    ]
+    for command in commands:
+        subprocess.run(command, cwd=ASSEMBLER, check=True)
+    return tools
+
+
+def notes(binary):
+    """Returns the (provider, name) pairs of the USDT notes of a binary."""
+    output = subprocess.run(["readelf", "-n", binary], stdout=subprocess.PIPE, check=True).stdout.decode()
+    found = set()
+    provider = None
+    for line in output.splitlines():
+        line = line.strip()
+        if line.startswith("Provider:"):
+            provider = line.split(":", 1)[1].strip()
+        elif line.startswith("Name:") and provider is not None:
+            found.add((provider, line.split(":", 1)[1].strip()))
+            provider = None
+    return found
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--cflags", default="-O2", help="compiler flags for the tools (default -O2)")
+    args = parser.parse_args()
+    flags = shlex.split(args.cflags)
+
+    if shutil.which("readelf") is None:
+        print("skipped: readelf not found")
+        return 0
+
+    with tempfile.TemporaryDirectory(prefix="tcasm-probes-") as workdir:
+        if not has_sdt(flags, workdir):
+            print("skipped: <sys/sdt.h> not found (install systemtap-sdt-dev), the tools have no probes")
+            return 0
+
+        tools = build(flags, workdir)
+        missing = 0
+        for tool, probes in sorted(PROBES.items()):
+            found = notes(tools[tool])
+            for probe in probes:
+                ok = (PROVIDER, probe) in found
+                missing += not ok
+                print("%-9s  %s:%-15s  %s" % (tool, PROVIDER, probe, "ok" if ok else "MISSING"))
+
+    if missing:
+        print("%d probe(s) missing" % missing)
+        return 1
+    print("all probes present")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,210 @@
+#!/usr/bin/env python3
+"""Generates large, valid TCASM programs for scale testing.
+
+Usage: TCASM_generate.py [--words N] [--seed S] [--ident-length L]
+                         [--label-density D] [--jump-ratio J]
+                         [--forward-ratio F] [--data-ratio R]
+                         [--array-ratio A] [--array-size K]
+                         [--layout before|after] [-o FILE]
+
+The program reads a repeat count from the input and runs a loop body of
+random instructions that many times, then prints a few variables and stops.
+It always terminates: forward jumps skip part of the body, and backward
+jumps are JMPN right after loading a positive constant, so they are
+assembled and translated but never taken. DIV only divides by non-zero
+constants, and stores only target SPACE data.
+
+--words        total size in words, code plus data (at most 65536)
+--ident-length length of every identifier, padded with '_' (at most 1000,
+               the assembler's TCASM_SYMBOL_MAX_IDENTIFIER_SIZE); names that
+               need more characters to be unique keep their natural length
+--label-density fraction of body instructions that carry a label
+--jump-ratio   fraction of body statements that are jumps
+--forward-ratio fraction of jumps whose label is defined later in the source
+--data-ratio   fraction of the words spent on data
+--array-ratio  fraction of the data words that belong to arrays, accessed
+               as NAME[i]; arrays have 2 to --array-size elements
+--layout       whether SECTION DATA comes before or after SECTION TEXT
+
+The same parameters and seed always produce the same program.
+"""
+
+import argparse
+import random
+import sys
+
+MAX_WORDS = 65536
+MAX_IDENTIFIER = 1000
+
+ARITHMETIC = ["ADD", "SUB", "MULT", "LOAD"]
+CONDITIONAL = ["JMPN", "JMPP", "JMPZ"]
+
+
+class Names:
+    """Identifiers of a fixed length, unique by their prefix and number."""
+
+    def __init__(self, length):
+        self.length = length
+
+    def __call__(self, prefix, number):
+        name = "%s%d" % (prefix, number)
+        return name + "_" * (self.length - len(name))
+
+
+def generate(words=4096, seed=0, ident_length=1, label_density=0.05, jump_ratio=0.05, forward_ratio=0.5,
+             data_ratio=0.125, array_ratio=0.25, array_size=16, layout="after"):
+    """Returns the source of a TCASM program of about `words` words."""
+    if not 64 <= words <= MAX_WORDS:
+        raise ValueError("words must be between 64 and %d" % MAX_WORDS)
+    if not 1 <= ident_length <= MAX_IDENTIFIER:
+        raise ValueError("identifier length must be between 1 and %d" % MAX_IDENTIFIER)
+    if array_size < 2:
+        raise ValueError("array size must be at least 2")
+    rng = random.Random(seed)
+    name = Names(ident_length)
+
+    # Data: the repeat count and the constant 1, then constants, variables
+    # and arrays. Constants are at least 2 in magnitude, so DIV never traps
+    # on -32768 / -1 in the native translation.
+    count = name("N", 0)
+    one = name("K", 0)
+    data = [(count, "SPACE"), (one, "CONST 1")]
+    budget = max(16, int(words * data_ratio)) - len(data)
+    constants = []
+    for i in range(max(4, budget // 16)):
+        constants.append((name("C", i), rng.choice([-1, 1]) * rng.randrange(2, 1000)))
+    budget -= len(constants)
+    arrays = []
+    array_budget = int(budget * array_ratio)
+    while array_budget >= 2:
+        size = min(array_budget, rng.randrange(2, array_size + 1))
+        arrays.append((name("A", len(arrays)), size))
+        array_budget -= size
+        budget -= size
+    variables = [name("V", i) for i in range(max(4, budget))]
+    data += [(constant, "CONST %d" % value) for constant, value in constants]
+    data += [(variable, "SPACE") for variable in variables]
+    data += [(array, "SPACE %d" % size) for array, size in arrays]
+    data_words = len(constants) + len(variables) + sum(size for _, size in arrays) + 2
+
+    # Operands are dealt from shuffled decks, so every declaration is used
+    # once the body is large enough and the assembler does not warn.
+    decks = {}
+
+    def deal(kind, items):
+        deck = decks.setdefault(kind, [])
+        if not deck:
+            deck.extend(items)
+            rng.shuffle(deck)
+        return deck.pop()
+
+    def element():
+        array, size = deal("arrays", arrays)
+        return "%s[%d]" % (array, rng.randrange(size))
+
+    def source():
+        if arrays and rng.random() < array_ratio:
+            return element()
+        if rng.randrange(4) == 0:
+            return deal("constants", constants)[0]
+        return deal("variables", variables)
+
+    def target():
+        if arrays and rng.random() < array_ratio:
+            return element()
+        return deal("variables", variables)
+
+    # Loop body entries: [label, statement, size in words, jump]. Jumps are
+    # resolved once labels are placed: a forward jump takes 2 words, a
+    # backward one 4 (LOAD of the constant 1, then JMPN).
+    outputs = variables[:4]
+    fixed_words = 2 + 8 + 2 * len(outputs) + 1
+    text_budget = words - data_words - fixed_words
+    if text_budget < 16:
+        raise ValueError("not enough words left for code; lower --data-ratio")
+    body = []
+    used = 0
+    while used + 4 <= text_budget:
+        kind = rng.random()
+        if kind < jump_ratio:
+            body.append([None, None, 4 if rng.random() >= forward_ratio else 2, "jump"])
+            used += body[-1][2]
+            continue
+        if kind < jump_ratio + 0.15:
+            statement = "COPY %s, %s" % (source(), target())
+            size = 3
+        elif kind < jump_ratio + 0.3:
+            statement = "STORE %s" % target()
+            size = 2
+        elif kind < jump_ratio + 0.35:
+            statement = "DIV %s" % deal("constants", constants)[0]
+            size = 2
+        else:
+            statement = "%s %s" % (rng.choice(ARITHMETIC), source())
+            size = 2
+        body.append([None, statement, size, None])
+        used += size
+
+    # Labels; the first entry starts the loop.
+    labels = []
+    for i, entry in enumerate(body):
+        if i == 0 or rng.random() < label_density:
+            entry[0] = name("L", len(labels))
+            labels.append(i)
+    loop = body[0][0]
+
+    # Forward jumps go to one of the next three labels, so they skip only a
+    # little of the body, or to the end of the loop past the last label.
+    end = name("E", 0)
+    lines = []
+    for i, (label, statement, size, jump) in enumerate(body):
+        prefix = "%s: " % label if label else "  "
+        if jump:
+            if size == 2:
+                later = [body[j][0] for j in labels if j > i][:3] or [end]
+                lines.append("%s%s %s" % (prefix, rng.choice(["JMP"] + CONDITIONAL), rng.choice(later)))
+                continue
+            earlier = [j for j in labels if j <= i]
+            lines.append("%sLOAD %s" % (prefix, one))
+            lines.append("  JMPN %s" % body[rng.choice(earlier)][0])
+            continue
+        lines.append(prefix + statement)
+
+    text = ["SECTION TEXT", "  INPUT %s" % count] + lines
+    text += ["%s: LOAD %s" % (end, count), "  SUB %s" % one, "  STORE %s" % count, "  JMPP %s" % loop]
+    text += ["  OUTPUT %s" % variable for variable in outputs]
+    text += ["  STOP"]
+    section = ["SECTION DATA"] + ["%s: %s" % entry for entry in data]
+    return "\n".join(section + text if layout == "before" else text + section) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--words", type=int, default=4096, help="program size in words (default 4096)")
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument("--ident-length", type=int, default=1, help="identifier length (default: shortest)")
+    parser.add_argument("--label-density", type=float, default=0.05, help="default 0.05")
+    parser.add_argument("--jump-ratio", type=float, default=0.05, help="default 0.05")
+    parser.add_argument("--forward-ratio", type=float, default=0.5, help="default 0.5")
+    parser.add_argument("--data-ratio", type=float, default=0.125, help="default 0.125")
+    parser.add_argument("--array-ratio", type=float, default=0.25, help="default 0.25")
+    parser.add_argument("--array-size", type=int, default=16, help="largest array (default 16)")
+    parser.add_argument("--layout", choices=["before", "after"], default="after")
+    parser.add_argument("-o", "--output", help="output file (default: standard output)")
+    args = parser.parse_args()
+
+    try:
+        program = generate(args.words, args.seed, args.ident_length, args.label_density, args.jump_ratio,
+                           args.forward_ratio, args.data_ratio, args.array_ratio, args.array_size, args.layout)
+    except ValueError as error:
+        parser.error(str(error))
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(program)
+    else:
+        sys.stdout.write(program)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
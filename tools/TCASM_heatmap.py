@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""Renders a TCASM_machine heatmap file (--heatmap) as text.
+
+Usage: TCASM_heatmap.py [--top N] [--width W] <heatmap_file>
+
+Without --top, prints every touched address in address order. With --top,
+prints only the N most accessed data words, which is usually what you want
+when looking for variables worth keeping in registers.
+"""
+
+import argparse
+import struct
+import sys
+
+HEADER = struct.Struct("<4sHHII")
+# Version 1 had 32-bit counters; version 2 widened them to 64 bits.
+RECORDS = {1: struct.Struct("<HBBIII"), 2: struct.Struct("<HBBQQQ")}
+
+CODE = 1
+DATA = 2
+KINDS = {CODE: "code", DATA: "data", CODE | DATA: "mixed"}
+
+
+def load(path):
+    with open(path, "rb") as f:
+        raw = f.read()
+    magic, version, _, image, count = HEADER.unpack_from(raw, 0)
+    if magic != b"TCHM" or version not in RECORDS:
+        sys.exit("%s: not a TCASM heatmap file" % path)
+    record = RECORDS[version]
+    records = []
+    for i in range(count):
+        addr, kind, _, fetches, reads, writes = record.unpack_from(raw, HEADER.size + i * record.size)
+        records.append((addr, kind, fetches, reads, writes))
+    return image, records
+
+
+def bar(value, peak, width):
+    if peak == 0:
+        return ""
+    return "#" * max(1 if value else 0, value * width // peak)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--top", type=int, default=0, help="show only the N hottest data words")
+    parser.add_argument("--width", type=int, default=40, help="width of the bars")
+    parser.add_argument("file")
+    args = parser.parse_args()
+
+    image, records = load(args.file)
+
+    code = [r for r in records if r[1] & CODE]
+    data = [r for r in records if r[1] & DATA]
+    print("image: %d words, touched: %d (code %d, data %d)" % (image, len(records), len(code), len(data)))
+    print("fetches: %d, reads: %d, writes: %d" % (
+        sum(r[2] for r in records), sum(r[3] for r in records), sum(r[4] for r in records)))
+    print()
+
+    if args.top:
+        records = sorted(data, key=lambda r: r[3] + r[4], reverse=True)[:args.top]
+
+    peak = max([r[2] + r[3] + r[4] for r in records] or [0])
+    print("%5s  %-5s  %10s  %10s  %10s  %s" % ("addr", "kind", "fetches", "reads", "writes", "heat"))
+    for addr, kind, fetches, reads, writes in records:
+        print("%5d  %-5s  %10d  %10d  %10d  %s" % (
+            addr, KINDS[kind], fetches, reads, writes, bar(fetches + reads + writes, peak, args.width)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""Finds the perfect hash used by TCASM_symbol_keyword and prints its table.
+
+Usage: TCASM_keyword_hash.py [--size N]
+
+The hash of a keyword of length L is
+
+    (L*A + word[0] + word[1]*B + word[L-1]*C) & (N - 1)
+
+and the search looks for the smallest A, B and C below N that give every
+reserved word its own slot. The output is the initializer of
+TCASM_symbol_keywords in trabalho1/TCASM_assembler/TCASM_symbol.c, preceded
+by the constants; after adding or renaming a keyword, paste the table there
+and update the constants in the hash expression of TCASM_symbol_keyword.
+The slot of a keyword is also its symbol id, so --size must stay equal to
+TCASM_SYMBOL_KEYWORDS_SIZE in TCASM_symbol.h.
+"""
+
+import argparse
+import itertools
+import sys
+
+# (name, symbol type, opcode constant suffix or None)
+KEYWORDS = [
+    ("SECTION", "DIRECTIVE_SECTION", None),
+    ("SPACE", "DIRECTIVE_SPACE", None),
+    ("CONST", "DIRECTIVE_CONST", None),
+    ("TEXT", "DIRECTIVE_SECTION_TYPE", None),
+    ("DATA", "DIRECTIVE_SECTION_TYPE", None),
+    ("ADD", "INSTRUCTION_REGULAR", "ADD"),
+    ("SUB", "INSTRUCTION_REGULAR", "SUB"),
+    ("MULT", "INSTRUCTION_REGULAR", "MULT"),
+    ("DIV", "INSTRUCTION_REGULAR", "DIV"),
+    ("JMP", "INSTRUCTION_REGULAR", "JMP"),
+    ("JMPN", "INSTRUCTION_REGULAR", "JMPN"),
+    ("JMPP", "INSTRUCTION_REGULAR", "JMPP"),
+    ("JMPZ", "INSTRUCTION_REGULAR", "JMPZ"),
+    ("COPY", "INSTRUCTION_COPY", "COPY"),
+    ("LOAD", "INSTRUCTION_REGULAR", "LOAD"),
+    ("STORE", "INSTRUCTION_REGULAR", "STORE"),
+    ("INPUT", "INSTRUCTION_REGULAR", "INPUT"),
+    ("OUTPUT", "INSTRUCTION_REGULAR", "OUTPUT"),
+    ("STOP", "INSTRUCTION_STOP", "STOP"),
+]
+
+
+def keyword_hash(word, a, b, c, size):
+    return (len(word) * a + ord(word[0]) + ord(word[1]) * b + ord(word[-1]) * c) & (size - 1)
+
+
+def search(size):
+    """Returns the first (a, b, c) that hashes every keyword to its own slot."""
+    for a, b, c in itertools.product(range(size), repeat=3):
+        slots = {keyword_hash(name, a, b, c, size) for name, _, _ in KEYWORDS}
+        if len(slots) == len(KEYWORDS):
+            return a, b, c
+    return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--size", type=int, default=32, help="table size, a power of two (default 32)")
+    args = parser.parse_args()
+    if args.size < len(KEYWORDS) or args.size & (args.size - 1):
+        parser.error("size must be a power of two of at least %d" % len(KEYWORDS))
+
+    constants = search(args.size)
+    if constants is None:
+        sys.exit("no perfect hash with table size %d; try a larger --size" % args.size)
+    a, b, c = constants
+    print("// A = %d, B = %d, C = %d, tamanho %d" % (a, b, c, args.size))
+    for name, kind, opcode in sorted(KEYWORDS, key=lambda k: keyword_hash(k[0], a, b, c, args.size)):
+        opcode = "TCASM_SYMBOL_INSTRUCTION_OPCODE_%s" % opcode if opcode else "0"
+        print("  [%d] = {\"%s\", %d, TCASM_SYMBOL_%s, %s}," % (
+            keyword_hash(name, a, b, c, args.size), name, len(name), kind, opcode))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
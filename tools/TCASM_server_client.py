@@ -0,0 +1,234 @@
+#!/usr/bin/env python3
+"""Edit-loop client and latency benchmark for the TCASM incremental assembler server.
+
+Usage: TCASM_server_client.py --socket PATH [--source FILE | --words N [--layout after|before]]
+                              [--edits N] [--seed S] [--assembler BINARY]
+
+Sends a program to a running TCASM_server, then makes --edits single-line edits
+to its text section and sends every version again, the way an editor would on
+each keystroke. Edits alternate between swapping an ADD and a SUB (same size)
+and inserting or removing a LOAD line (shifts every later address). The client
+keeps its own copy of the image by applying the delta runs of each reply.
+
+With --assembler, every version is also assembled by the command-line
+assembler, and the image kept by the client must match its output byte for
+byte. The report gives the server-side assembly time and the client round trip
+(median, p99 and maximum, in microseconds) and how many versions were assembled
+incrementally.
+
+Before the edits, the client checks that the server survives bad clients: an
+ASSEMBLE whose declared size is far above the server's limit must be refused
+with ERRO, and a client that hangs up before reading its reply must only lose
+its own connection. After each one, the server must still answer a new
+connection. It also checks that an edit the incremental assembler cannot take
+falls back to a full assembly: a label named like an unused data declaration
+must be refused as a redefinition.
+
+The exit status is 1 when an image does not match or a bad request is not
+handled.
+"""
+
+import argparse
+import os
+import random
+import re
+import socket
+import statistics
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+from TCASM_generate import generate
+
+STATEMENT = re.compile(rb"^(\s*(?:\w+:\s*)?)(ADD|SUB)(\s)", re.M)
+
+# exemplo.s without the only reference to N2, which is then declared but unused
+UNUSED_DECLARATION = b"""SECTION TEXT
+ROT: INPUT N1
+     COPY N1, N4
+     COPY N3[0], N3[1]
+     OUTPUT N3[1]
+     STOP
+
+SECTION DATA
+N1:  SPACE
+N2:  CONST -0x10
+N3:  SPACE 2
+N4:  SPACE
+"""
+
+
+class Connection:
+    """A connection to the server, with the image of each file it assembled."""
+
+    def __init__(self, path):
+        self.socket = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.socket.connect(path)
+        self.reader = self.socket.makefile("rb")
+        self.images = {}
+
+    def assemble(self, name, source):
+        """Sends a version of a file; returns (ok, incremental, microseconds, diagnostics)."""
+        self.socket.sendall(b"ASSEMBLE %s %d\n" % (name.encode(), len(source)) + source)
+        status, words, mode, micros, diagnostics_size, runs = self.reader.readline().split()
+        diagnostics = self.reader.read(int(diagnostics_size)).decode()
+        image = self.images.setdefault(name, bytearray())
+        if status == b"OK":
+            del image[2 * int(words):]
+            for _ in range(int(runs)):
+                addr, count = struct.unpack("<II", self.reader.read(8))
+                image.extend(bytes(max(0, 2 * (addr + count) - len(image))))
+                image[2 * addr:2 * (addr + count)] = self.reader.read(2 * count)
+        return status == b"OK", mode == b"INCREMENTAL", int(micros), diagnostics
+
+    def request(self, line):
+        """Sends a request without a body and returns the reply line."""
+        self.socket.sendall(line.encode() + b"\n")
+        return self.reader.readline().decode().strip()
+
+    def close(self):
+        self.reader.close()
+        self.socket.close()
+
+
+def alive(path, name):
+    """Tells whether the server still answers a request (FORGET name) on a new connection."""
+    try:
+        connection = Connection(path)
+        ok = connection.request("FORGET " + name) == "OK"
+        connection.close()
+    except OSError:
+        return False
+    return ok
+
+
+def check_oversized(path):
+    """Declares a source of 2**64 - 1 bytes; the server must refuse it with ERRO and keep running."""
+    connection = Connection(path)
+    connection.socket.sendall(b"ASSEMBLE oversized.s %d\n" % (2 ** 64 - 1))
+    reply = connection.reader.readline()
+    connection.close()
+    return reply.startswith(b"ERRO ") and alive(path, "oversized.s")
+
+
+def check_hangup(path, source):
+    """Sends a version and hangs up before the reply; the server must survive writing to it.
+
+    The read side is shut down before the request is sent, so the server's
+    reply always hits a closed connection, however fast the assembly is.
+    """
+    connection = Connection(path)
+    connection.socket.shutdown(socket.SHUT_RD)
+    connection.socket.sendall(b"ASSEMBLE hangup.s %d\n" % len(source) + source)
+    connection.close()
+    return alive(path, "hangup.s")
+
+
+def check_redefinition(path):
+    """Adds a label named like an unused data declaration; the server must refuse it."""
+    connection = Connection(path)
+    ok, _, _, _ = connection.assemble("redefinition.s", UNUSED_DECLARATION)
+    source = UNUSED_DECLARATION.replace(b"     STOP\n", b"N2:  OUTPUT N3[0]\n     STOP\n")
+    redefined, _, _, diagnostics = connection.assemble("redefinition.s", source)
+    connection.request("FORGET redefinition.s")
+    connection.close()
+    return ok and not redefined and "Redefinindo identificador" in diagnostics
+
+
+def edit(source, rng, inserted):
+    """Returns the source with one text line changed, and the new inserted-line offset."""
+    if inserted is not None:
+        end = source.index(b"\n", inserted) + 1
+        return source[:inserted] + source[end:], None
+    statements = list(STATEMENT.finditer(source))
+    match = rng.choice(statements)
+    if rng.random() < 0.5:
+        mnemonic = b"SUB" if match.group(2) == b"ADD" else b"ADD"
+        return source[:match.start(2)] + mnemonic + source[match.end(2):], None
+    line = source.rindex(b"\n", 0, match.start()) + 1 if match.start() > 0 else 0
+    operand = source[match.end():source.index(b"\n", match.end())].split(b";")[0].strip()
+    return source[:line] + b"  LOAD " + operand + b"\n" + source[line:], line
+
+
+def reference(assembler, source, workdir):
+    """Assembles a version with the command-line assembler and returns its image, or None."""
+    path = os.path.join(workdir, "version.s")
+    output = os.path.join(workdir, "version.bin")
+    with open(path, "wb") as f:
+        f.write(source)
+    if subprocess.run([assembler, path, output], stderr=subprocess.DEVNULL).returncode != 0:
+        return None
+    with open(output, "rb") as f:
+        return f.read()
+
+
+def percentile(values, fraction):
+    """Returns the value at a fraction of the sorted values."""
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(fraction * len(ordered)))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--socket", required=True, help="socket of a running TCASM_server")
+    parser.add_argument("--source", help="program to edit (default: a generated one)")
+    parser.add_argument("--words", type=int, default=60000, help="size of the generated program")
+    parser.add_argument("--layout", choices=["after", "before"], default="after",
+                        help="data section after or before the text in the generated program")
+    parser.add_argument("--edits", type=int, default=200)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--assembler", help="command-line assembler used to check every image")
+    args = parser.parse_args()
+
+    if args.source:
+        with open(args.source, "rb") as f:
+            source = f.read()
+    else:
+        source = generate(args.words, seed=args.seed, layout=args.layout).encode()
+    rng = random.Random(args.seed)
+
+    checks = (("oversized ASSEMBLE", lambda: check_oversized(args.socket)),
+              ("client hangs up before its reply", lambda: check_hangup(args.socket, source)),
+              ("label named like an unused declaration", lambda: check_redefinition(args.socket)))
+    for label, check in checks:
+        ok = check()
+        print("%s: %s" % (label, "handled" if ok else "FAILED"))
+        if not ok:
+            sys.exit(1)
+
+    connection = Connection(args.socket)
+    name = "client-%d.s" % os.getpid()
+
+    server_times, round_trips, incremental, mismatches = [], [], 0, 0
+    inserted = None
+    with tempfile.TemporaryDirectory() as workdir:
+        for version in range(args.edits + 1):
+            if version > 0:
+                source, inserted = edit(source, rng, inserted)
+            start = time.perf_counter()
+            ok, reused, micros, diagnostics = connection.assemble(name, source)
+            elapsed = (time.perf_counter() - start) * 1e6
+            if not ok:
+                sys.exit("version %d does not assemble:\n%s" % (version, diagnostics))
+            if version > 0:
+                server_times.append(micros)
+                round_trips.append(elapsed)
+                incremental += reused
+            if args.assembler and reference(args.assembler, source, workdir) != bytes(connection.images[name]):
+                mismatches += 1
+                print("version %d: image differs from the command-line assembler" % version)
+    connection.request("FORGET " + name)
+
+    print("%d edits, %d incremental" % (len(server_times), incremental))
+    for label, values in (("server", server_times), ("round trip", round_trips)):
+        print("%-10s median %8.1f us  p99 %8.1f us  max %8.1f us" % (
+            label, statistics.median(values), percentile(values, 0.99), max(values)))
+    if args.assembler:
+        print("%d images differ from the command-line assembler" % mismatches)
+    sys.exit(1 if mismatches else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -6,22 +6,34 @@
 C_SRCS += \
 ../TCASM_assembler.c \
 ../TCASM_hashtable.c \
+../TCASM_intern.c \
 ../TCASM_list.c \
 ../TCASM_main.c \
+../TCASM_map.c \
+../TCASM_object.c \
+../TCASM_stats.c \
 ../TCASM_symbol.c 
 
 OBJS += \
 ./TCASM_assembler.o \
 ./TCASM_hashtable.o \
+./TCASM_intern.o \
 ./TCASM_list.o \
 ./TCASM_main.o \
+./TCASM_map.o \
+./TCASM_object.o \
+./TCASM_stats.o \
 ./TCASM_symbol.o 
 
 C_DEPS += \
 ./TCASM_assembler.d \
 ./TCASM_hashtable.d \
+./TCASM_intern.d \
 ./TCASM_list.d \
 ./TCASM_main.d \
+./TCASM_map.d \
+./TCASM_object.d \
+./TCASM_stats.d \
 ./TCASM_symbol.d 
 
 
@@ -1,50 +1,27 @@
 #include "TCASM_assembler.h"
 
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "TCASM_hashtable.h"
 #include "TCASM_list.h"
+#include "TCASM_map.h"
+#include "TCASM_probes.h"
+#include "TCASM_scan.h"
+#include "TCASM_stats.h"
 #include "TCASM_symbol.h"
 
-// =============================================================================
-// enumeracoes privadas
-// =============================================================================
-
-/**
- * Enumeracao dos estados da maquina de montagem.
- */
-typedef enum {
-  TCASM_STATE_SECTION = 0,
-  TCASM_STATE_SECTION_TYPE,
-  TCASM_STATE_TEXT_STATEMENT,
-  TCASM_STATE_DATA_STATEMENT_DATABEFORE,
-  TCASM_STATE_DATA_STATEMENT_DATAAFTER,
-  TCASM_STATE_TEXT,
-  TCASM_STATE_DATA_CREATE_DATABEFORE,
-  TCASM_STATE_DATA_CREATE_DATAAFTER,
-  TCASM_STATE_DATA_DEFINE_VARCONST,
-  TCASM_STATE_DATA_DEFINE_ARRAY,
-  TCASM_STATE_REGULAR,
-  TCASM_STATE_BRANCH,
-  TCASM_STATE_COPY
-} TCASM_state_t;
-
 // =============================================================================
 // tipos privados
 // =============================================================================
 
-/**
- * Struct-valor da lista de referencias pendentes.
- */
-typedef struct {
-  /// Ponteiro para um simbolo que possui referencias pendentes.
-  TCASM_hashtable_node_t* sym;
-} TCASM_reflist_node_t;
-
 /**
  * Struct-valor da lista da dados. Usado apenas quando a secao de dados vem
  * antes da secao de codigo.
@@ -53,1239 +30,1481 @@ typedef struct {
   /// Indica se eh um dado anonimo ou um dado normal.
   bool anonymous;
   
-  /// Ponteiro para um simbolo que armazena informacoes de um dado.
-  TCASM_symbol_t* sym;
+  /// Id do simbolo do dado (apenas dados normais).
+  uint32_t sym;
+  
+  /// Tipo do dado (TCASM_SYMBOL_ADDRESS_VAR, _CONST ou _ARRAY).
+  TCASM_symbol_type_t type;
+  
+  /// Valor da constante ou tamanho do vetor.
+  uint16_t value;
+  
+  /// Linha da sentenca que declarou o dado.
+  unsigned int line;
+  
+  /// Coluna da sentenca que declarou o dado.
+  unsigned int col;
+  
+  /// Indice do simbolo no mapa de enderecos (apenas dados normais).
+  size_t map_symbol;
 } TCASM_datalist_node_t;
 
-// =============================================================================
-// declaracao de variaveis globais privadas
-// =============================================================================
-
 /**
- * Arquivo de entrada com assembly TCASM.
+ * Struct de um pedaco da secao de texto na montagem paralela. Cada pedaco
+ * comeca no inicio de uma linha e eh montado em um contexto proprio, com
+ * enderecos a partir de 0 e tabela de simbolos local.
  */
-static FILE* TCASM_fin;
-
-/**
- * Tabela de simbolos (identificadores ou palavras-chave).
- */
-static TCASM_hashtable_t TCASM_symbol_table;
-
-/**
- * Buffer com o tamanho exato da memoria da maquina hipotetica para armazenar
- * o codigo gerado.
- */
-static uint16_t TCASM_assembled_code[65536];
-
-/**
- * Contador de bytes utilizados na montagem.
- */
-static size_t TCASM_assembled_code_size = 0;
-
-/**
- * Contador de bytes de offset de dados, quando a secao de dados vem antes
- * da secao de texto.
- */
-static size_t TCASM_data_size = 0;
+typedef struct {
+  /// Contexto da montagem completa.
+  TCASM_assembler_t* parent;
+  
+  /// Contexto do pedaco.
+  TCASM_assembler_t context;
+  
+  /// Inicio do pedaco no codigo-fonte.
+  const char* begin;
+  
+  /// Fim do pedaco (uma posicao depois da quebra de linha final).
+  const char* end;
+  
+  /// Quantidade de quebras de linha no pedaco.
+  unsigned int lines;
+  
+  /// Linha em que o pedaco comeca.
+  unsigned int line;
+  
+  /// Endereco da primeira palavra do pedaco no codigo montado.
+  size_t base;
+  
+  /// Posicao do primeiro operando do pedaco na tabela de operandos da
+  /// montagem completa.
+  size_t fixups_base;
+  
+  /// Id na tabela de simbolos da montagem completa de cada identificador do
+  /// pedaco (indexado pelo id local - TCASM_SYMBOL_KEYWORDS_SIZE).
+  uint32_t* global_id;
+  
+  /// Indica se o pedaco foi montado sem erros e terminou entre sentencas.
+  bool ok;
+  
+  /// Thread que trata o pedaco na etapa atual.
+  pthread_t thread;
+  
+  /// Indica se a thread foi criada (senao a etapa roda na thread chamadora).
+  bool threaded;
+} TCASM_chunk_t;
 
-/**
- * Flag para dizer se a secao de codigo ja foi lida.
- */
-static bool TCASM_text_read = false;
+// =============================================================================
+// declaracao de funcoes privadas
+// =============================================================================
 
-/**
- * Flag para dizer se a secao de dados ja foi lida.
- */
-static bool TCASM_data_read = false;
+// util
+static void TCASM_write_uint16_zeroarray(uint16_t dst[], size_t pos, size_t count);
 
-/**
- * Variavel para armazenar o estado atual da maquina de montagem.
- */
-static TCASM_state_t TCASM_state = TCASM_STATE_SECTION;
+static void TCASM_assembler_reset(TCASM_assembler_t* asm_ptr);
+static bool TCASM_assembler_parse(TCASM_assembler_t* asm_ptr);
+static void TCASM_diagnostic_add(TCASM_assembler_t* asm_ptr, TCASM_diagnostic_severity_t severity, unsigned int line, const char* format, va_list args);
+static void TCASM_error(TCASM_assembler_t* asm_ptr, unsigned int line, const char* format, ...) __attribute__((noreturn, format(printf, 3, 4)));
+static void TCASM_warning(TCASM_assembler_t* asm_ptr, unsigned int line, const char* format, ...) __attribute__((format(printf, 3, 4)));
+static void TCASM_reserve_source(TCASM_assembler_t* asm_ptr, size_t size);
+static void TCASM_reserve_fixups(TCASM_assembler_t* asm_ptr, size_t size);
+static bool TCASM_load_source(TCASM_assembler_t* asm_ptr, const char* in);
+static void TCASM_read_source(TCASM_assembler_t* asm_ptr);
+static void TCASM_read_statements(TCASM_assembler_t* asm_ptr);
+static void TCASM_finish_source(TCASM_assembler_t* asm_ptr);
+static bool TCASM_write_file(TCASM_assembler_t* asm_ptr, const char* out);
+static bool TCASM_write_object(TCASM_assembler_t* asm_ptr, const char* out);
+static bool TCASM_read_char(TCASM_assembler_t* asm_ptr);
+static void TCASM_read_symbol(TCASM_assembler_t* asm_ptr);
+static void TCASM_lookup_symbol(TCASM_assembler_t* asm_ptr, bool* created);
+static bool TCASM_read_keyword(TCASM_assembler_t* asm_ptr, const char* rest, size_t size);
+static bool TCASM_read_int(TCASM_assembler_t* asm_ptr, int* value);
+static void TCASM_read_colon(TCASM_assembler_t* asm_ptr);
+static void TCASM_read_comma(TCASM_assembler_t* asm_ptr);
+static int TCASM_read_array_ref(TCASM_assembler_t* asm_ptr);
+static TCASM_symbol_type_t TCASM_read_data_type(TCASM_assembler_t* asm_ptr);
+static void TCASM_check_new_line(TCASM_assembler_t* asm_ptr);
+static void TCASM_check_same_line(TCASM_assembler_t* asm_ptr);
+static void TCASM_check_new_column(TCASM_assembler_t* asm_ptr);
+static void TCASM_dump_datalist(TCASM_assembler_t* asm_ptr);
+static void TCASM_resolve_fixups(TCASM_assembler_t* asm_ptr, bool finished);
+static void TCASM_datalist_insert(TCASM_assembler_t* asm_ptr, bool anonymous, TCASM_symbol_type_t type, uint16_t value);
+static void TCASM_map_statement(TCASM_assembler_t* asm_ptr, TCASM_state_t state, size_t first);
+static void TCASM_record_fixup(TCASM_assembler_t* asm_ptr, uint16_t offset);
+static void TCASM_create_anonymous_data_databefore(TCASM_assembler_t* asm_ptr);
+static void TCASM_create_anonymous_data_dataafter(TCASM_assembler_t* asm_ptr);
+static void TCASM_decode_instruction(TCASM_assembler_t* asm_ptr);
+static void TCASM_state_regular_create_ref(TCASM_assembler_t* asm_ptr);
+static void TCASM_state_regular_add_ref(TCASM_assembler_t* asm_ptr);
+static void TCASM_handle_state_section(TCASM_assembler_t* asm_ptr);
+static void TCASM_handle_state_section_type(TCASM_assembler_t* asm_ptr);
+static void TCASM_handle_state_text_statement(TCASM_assembler_t* asm_ptr);
+static void TCASM_handle_state_data_statement_databefore(TCASM_assembler_t* asm_ptr);
+static void TCASM_handle_state_data_statement_dataafter(TCASM_assembler_t* asm_ptr);
+static void TCASM_handle_state_text(TCASM_assembler_t* asm_ptr);
+static void TCASM_handle_state_data_create_databefore(TCASM_assembler_t* asm_ptr);
+static void TCASM_handle_state_data_create_dataafter(TCASM_assembler_t* asm_ptr);
+static void TCASM_handle_state_data_define_varconst(TCASM_assembler_t* asm_ptr);
+static void TCASM_handle_state_data_define_array(TCASM_assembler_t* asm_ptr);
+static void TCASM_handle_state_regular(TCASM_assembler_t* asm_ptr);
+static void TCASM_handle_state_branch(TCASM_assembler_t* asm_ptr);
+static void TCASM_handle_state_copy(TCASM_assembler_t* asm_ptr);
+
+// montagem paralela
+static bool TCASM_parallel_parse(TCASM_assembler_t* asm_ptr);
+static bool TCASM_parallel_run(TCASM_assembler_t* asm_ptr, TCASM_chunk_t* chunks, size_t count);
+static bool TCASM_line_is_section(const char* p, const char* end, const char* type);
+static bool TCASM_find_text_section(const TCASM_assembler_t* asm_ptr, const char** begin, const char** end);
+static void TCASM_chunks_run(TCASM_chunk_t* chunks, size_t count, void* (*step)(void*));
+static void* TCASM_chunk_count_lines(void* arg);
+static void* TCASM_chunk_parse(void* arg);
+static void* TCASM_chunk_relocate(void* arg);
+static bool TCASM_chunk_merge(TCASM_assembler_t* asm_ptr, TCASM_chunk_t* chunks, size_t count);
+static bool TCASM_chunk_merge_symbols(TCASM_assembler_t* asm_ptr, TCASM_chunk_t* chunk, uint32_t seeded);
+static void* TCASM_chunk_link(void* arg);
+
+// montagem incremental
+static bool TCASM_incremental_reuse(TCASM_assembler_t* asm_ptr, const char* source, size_t size);
+static bool TCASM_incremental_parse(TCASM_assembler_t* asm_ptr, const char* begin, const char* end, unsigned int line);
+static bool TCASM_incremental_link(TCASM_assembler_t* asm_ptr, uint32_t addr_begin, uint32_t addr_end);
+static void TCASM_incremental_build(TCASM_assembler_t* asm_ptr);
+static bool TCASM_incremental_lines(const char* source, size_t begin, size_t end, const uint16_t* code, size_t size, uint32_t base, uint32_t* offset, uint32_t* addr);
+static size_t TCASM_incremental_count_lines(const char* source, size_t begin, size_t end);
+static size_t TCASM_incremental_find_fixup(const TCASM_assembler_t* asm_ptr, uint32_t addr);
+static size_t TCASM_incremental_find_line(const TCASM_incremental_t* inc, size_t offset);
+static void TCASM_incremental_reserve_source(TCASM_incremental_t* inc, size_t size);
+static void TCASM_incremental_reserve_lines(TCASM_incremental_t* inc, size_t lines);
+static void TCASM_incremental_reserve_symbols(TCASM_incremental_t* inc, size_t size);
+static size_t TCASM_common_prefix(const char* a, const char* b, size_t size);
+static size_t TCASM_common_suffix(const char* a, const char* b, size_t size);
 
-/**
- * Linha sendo lida atualmente no arquivo fonte.
- */
-static unsigned int TCASM_line = 1;
+// =============================================================================
+// definicao de funcoes publicas
+// =============================================================================
 
 /**
- * Linha em que a ultima sentenca comecou.
- */
-static unsigned int TCASM_statement_line;
+ * Funcao para inicializar um contexto de montagem vazio, com o mapa de
+ * enderecos desligado.
+ * @param asm_ptr Ponteiro do contexto.
+ */
+void TCASM_assembler_init(TCASM_assembler_t* asm_ptr) {
+  asm_ptr->source = NULL;
+  asm_ptr->source_capacity = 0;
+  asm_ptr->source_end = NULL;
+  asm_ptr->code = (uint16_t*) malloc(TCASM_ASSEMBLER_MEMORY_SIZE*sizeof(uint16_t));
+  asm_ptr->code_size = 0;
+  TCASM_list_pool_init(&asm_ptr->list_pool);
+  TCASM_symbol_table_init(&asm_ptr->symbols, TCASM_HASHTABLE_DEFAULT_SIZE);
+  TCASM_map_init(&asm_ptr->map);
+  asm_ptr->fixups = NULL;
+  asm_ptr->fixups_size = 0;
+  asm_ptr->fixups_capacity = 0;
+  asm_ptr->diagnostics = NULL;
+  asm_ptr->diagnostics_size = 0;
+  asm_ptr->diagnostics_capacity = 0;
+  asm_ptr->jobs = 1;
+  asm_ptr->relocatable = false;
+  memset(&asm_ptr->incremental, 0, sizeof(TCASM_incremental_t));
+}
 
 /**
- * Caractere que foi lido por ultimo e esta sendo tratado.
- */
-static int TCASM_char;
+ * Funcao para liberar toda a memoria de um contexto de montagem. O codigo
+ * montado e os diagnosticos deixam de ser validos.
+ * @param asm_ptr Ponteiro do contexto.
+ */
+void TCASM_assembler_destroy(TCASM_assembler_t* asm_ptr) {
+  for (size_t i = 0; i < asm_ptr->diagnostics_size; ++i)
+    free(asm_ptr->diagnostics[i].message);
+  free(asm_ptr->source);
+  free(asm_ptr->code);
+  free(asm_ptr->fixups);
+  free(asm_ptr->diagnostics);
+  TCASM_list_pool_destroy(&asm_ptr->list_pool);
+  TCASM_symbol_table_destroy(&asm_ptr->symbols);
+  TCASM_map_destroy(&asm_ptr->map);
+  asm_ptr->source = NULL;
+  asm_ptr->code = NULL;
+  asm_ptr->fixups = NULL;
+  asm_ptr->diagnostics = NULL;
+  
+  TCASM_incremental_t* inc = &asm_ptr->incremental;
+  if (inc->scratch != NULL) {
+    TCASM_assembler_destroy(inc->scratch);
+    free(inc->scratch);
+  }
+  free(inc->source);
+  free(inc->line_offset);
+  free(inc->line_addr);
+  free(inc->uses);
+  free(inc->defined);
+  memset(inc, 0, sizeof(TCASM_incremental_t));
+}
 
 /**
- * Quantidade de caracteres retirados do arquivo na ultima leitura.
- */
-static size_t TCASM_read_chars;
+ * Monta um codigo-fonte que esta na memoria. O resultado fica no contexto:
+ * o codigo montado em code (code_size palavras) e os erros e avisos em
+ * diagnostics. Nada eh escrito na saida de erro.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param source Codigo-fonte. Nao precisa terminar em '\0' e nao eh
+ * alterado.
+ * @param size Tamanho do codigo-fonte.
+ * @return Retorna true se a montagem terminou sem erros.
+ */
+bool TCASM_assembler_run(TCASM_assembler_t* asm_ptr, const char* source, size_t size) {
+  TCASM_reserve_source(asm_ptr, size);
+  memcpy(asm_ptr->source, source, size);
+  asm_ptr->source_end = asm_ptr->source + size;
+  return TCASM_assembler_parse(asm_ptr);
+}
 
 /**
- * Quantidade de linhas retirados do arquivo na ultima leitura.
- */
-static unsigned int TCASM_read_lines;
+ * Monta um codigo-fonte que esta na memoria aproveitando a ultima montagem
+ * do mesmo contexto. Se apenas linhas da secao de texto mudaram, so elas sao
+ * montadas de novo, e so os operandos afetados sao resolvidos outra vez.
+ * Qualquer mudanca que nao se possa provar equivalente (em outra secao, com
+ * erro, com um simbolo novo ou que deixou de ser usado, etc.) faz uma
+ * montagem completa, entao o resultado e os diagnosticos sao sempre os de
+ * TCASM_assembler_run; asm_ptr->incremental.reused indica o caminho usado.
+ * O mapa de enderecos nao eh mantido: com ele ligado, a montagem eh sempre
+ * completa.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param source Codigo-fonte. Nao precisa terminar em '\0' e nao eh
+ * alterado.
+ * @param size Tamanho do codigo-fonte.
+ * @return Retorna true se a montagem terminou sem erros.
+ */
+bool TCASM_assembler_update(TCASM_assembler_t* asm_ptr, const char* source, size_t size) {
+  TCASM_incremental_t* inc = &asm_ptr->incremental;
+  inc->enabled = true;
+  inc->reused = inc->valid && TCASM_incremental_reuse(asm_ptr, source, size);
+  if (inc->reused)
+    return true;
+  
+  TCASM_incremental_reserve_source(inc, size);
+  memcpy(inc->source, source, size);
+  inc->source_size = size;
+  bool ok = TCASM_assembler_run(asm_ptr, source, size);
+  if (ok)
+    TCASM_incremental_build(asm_ptr);
+  return ok;
+}
 
 /**
- * Flag para indicar se houve uma mudanca de linha. Utilizar
- * check_new_line() para consultar esta flag.
- * @see TCASM_check_new_line
- */
-static bool TCASM_changed_line = false;
+ * Funcao para escrever os diagnosticos da ultima montagem no formato do
+ * montador de linha de comando.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param source Nome do arquivo fonte, escrito antes de cada diagnostico, ou
+ * NULL para nao escrever.
+ * @param out Arquivo de saida.
+ */
+void TCASM_assembler_print_diagnostics(const TCASM_assembler_t* asm_ptr, const char* source, FILE* out) {
+  for (size_t i = 0; i < asm_ptr->diagnostics_size; ++i) {
+    const TCASM_diagnostic_t* diagnostic = &asm_ptr->diagnostics[i];
+    const char* prefix = diagnostic->severity == TCASM_DIAGNOSTIC_ERROR ? "Erro" : "Aviso";
+    if (source != NULL)
+      fprintf(out, "%s: ", source);
+    if (diagnostic->line != TCASM_DIAGNOSTIC_NO_LINE)
+      fprintf(out, "%s linha %u: %s\n", prefix, diagnostic->line, diagnostic->message);
+    else
+      fprintf(out, "%s: %s\n", prefix, diagnostic->message);
+  }
+}
 
 /**
- * Palavra sendo lida atualmente.
- */
-static char TCASM_word[TCASM_SYMBOL_MAX_IDENTIFIER_SIZE + 1];
+ * Funcao que monta o objeto relocavel da ultima montagem, que precisa ter
+ * terminado sem erros com asm_ptr->relocatable ligado. Todos os rotulos e
+ * dados com nome sao exportados; os que nunca foram definidos sao
+ * importados, e o codigo dos seus operandos fica zerado.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param object_ptr Ponteiro do objeto, ja inicializado. O conteudo anterior
+ * eh liberado, e o objeto recebe copias do codigo e dos nomes.
+ */
+void TCASM_assembler_object(const TCASM_assembler_t* asm_ptr, TCASM_object_t* object_ptr) {
+  const TCASM_symbol_table_t* symbols = &asm_ptr->symbols;
+  TCASM_object_destroy(object_ptr);
+  object_ptr->code = (uint16_t*) malloc((asm_ptr->code_size + 1)*sizeof(uint16_t));
+  memcpy(object_ptr->code, asm_ptr->code, asm_ptr->code_size*sizeof(uint16_t));
+  object_ptr->code_size = asm_ptr->code_size;
+  object_ptr->text_size = asm_ptr->text_size;
+  
+  // indice de cada simbolo no objeto, na ordem dos ids
+  uint32_t* index = (uint32_t*) malloc((symbols->size - TCASM_SYMBOL_KEYWORDS_SIZE + 1)*sizeof(uint32_t));
+  object_ptr->symbols = (TCASM_object_symbol_t*) malloc((symbols->size - TCASM_SYMBOL_KEYWORDS_SIZE + 1)*sizeof(TCASM_object_symbol_t));
+  for (uint32_t id = TCASM_SYMBOL_KEYWORDS_SIZE; id < symbols->size; ++id) {
+    if (symbols->type[id] < TCASM_SYMBOL_ADDRESS_TEXT)
+      continue;
+    index[id - TCASM_SYMBOL_KEYWORDS_SIZE] = (uint32_t) object_ptr->symbols_size;
+    TCASM_object_symbol_t* symbol = &object_ptr->symbols[object_ptr->symbols_size++];
+    const char* name = TCASM_symbol_name(symbols, id);
+    size_t name_size = strlen(name);
+    symbol->name = (char*) malloc(name_size + 1);
+    memcpy(symbol->name, name, name_size + 1);
+    symbol->addr = symbols->addr[id];
+    symbol->size = 1;
+    if (symbols->line[id] == 0) {
+      symbol->kind = TCASM_OBJECT_SYMBOL_IMPORT;
+      symbol->addr = 0;
+      symbol->size = 0;
+    }
+    else if (symbols->type[id] == TCASM_SYMBOL_ADDRESS_TEXT) {
+      symbol->kind = TCASM_OBJECT_SYMBOL_LABEL;
+      symbol->size = 0;
+    }
+    else if (symbols->type[id] == TCASM_SYMBOL_ADDRESS_VAR)
+      symbol->kind = TCASM_OBJECT_SYMBOL_VAR;
+    else if (symbols->type[id] == TCASM_SYMBOL_ADDRESS_CONST)
+      symbol->kind = TCASM_OBJECT_SYMBOL_CONST;
+    else {
+      symbol->kind = TCASM_OBJECT_SYMBOL_ARRAY;
+      symbol->size = symbols->value[id];
+    }
+  }
+  
+  object_ptr->relocations = (TCASM_object_relocation_t*) malloc((asm_ptr->fixups_size + 1)*sizeof(TCASM_object_relocation_t));
+  object_ptr->relocations_size = asm_ptr->fixups_size;
+  for (size_t i = 0; i < asm_ptr->fixups_size; ++i) {
+    const TCASM_fixup_t* fixup = &asm_ptr->fixups[i];
+    TCASM_object_relocation_t* relocation = &object_ptr->relocations[i];
+    relocation->addr = fixup->addr;
+    relocation->symbol = index[fixup->symbol - TCASM_SYMBOL_KEYWORDS_SIZE];
+    relocation->line = fixup->line;
+    relocation->offset = fixup->offset;
+    relocation->use = fixup->use;
+    // num modulo todos os usos de um simbolo tem a mesma forma, entao o
+    // tipo do simbolo diz se o operando tem posicao de vetor
+    relocation->indexed = symbols->type[fixup->symbol] == TCASM_SYMBOL_ADDRESS_ARRAY;
+    if (object_ptr->symbols[relocation->symbol].kind == TCASM_OBJECT_SYMBOL_IMPORT)
+      object_ptr->code[fixup->addr] = 0;
+  }
+  free(index);
+}
 
 /**
- * Tamanho da palavra sendo lida atualmente.
- */
-static size_t TCASM_symbol_size;
+ * Monta o arquivo de entrada com assembly da maquina hipotetica. Os
+ * diagnosticos sao escritos na saida de erro.
+ * @param in Nome do arquivo fonte.
+ * @param out Nome do arquivo de saida para escrever o codigo montado.
+ * @param map_path Arquivo do mapa de enderecos binario, ou NULL.
+ * @param listing_path Arquivo da listagem, ou NULL.
+ * @param jobs Quantidade de threads para montar a secao de texto.
+ * @param object Indica se out recebe um objeto relocavel em vez do codigo
+ * montado.
+ * @return Retorna true se a montagem terminou sem erros e todas as saidas
+ * foram escritas.
+ */
+bool TCASM_assemble(const char* in, const char* out, const char* map_path, const char* listing_path, unsigned int jobs, bool object) {
+  TCASM_PROBE2(assemble_start, in, out);
+  TCASM_assembler_t assembler;
+  TCASM_assembler_init(&assembler);
+  assembler.jobs = jobs;
+  assembler.relocatable = object;
+  if (map_path != NULL || listing_path != NULL)
+    TCASM_map_enable(&assembler.map);
+  
+  bool ok = TCASM_load_source(&assembler, in) && TCASM_assembler_parse(&assembler);
+  TCASM_assembler_print_diagnostics(&assembler, NULL, stderr);
+  if (ok) {
+    TCASM_stats_phase_t phase = TCASM_stats_enter(TCASM_STATS_PHASE_WRITE);
+    ok = (object ? TCASM_write_object(&assembler, out) : TCASM_write_file(&assembler, out)) && TCASM_map_write(&assembler.map, map_path, listing_path, in, assembler.code, assembler.code_size);
+    TCASM_stats_leave(phase);
+  }
+  // todo assemble_start tem o seu assemble_end; uma falha tem 0 palavras
+  TCASM_PROBE2(assemble_end, in, ok ? assembler.code_size : 0);
+  if (ok && TCASM_stats.enabled)
+    TCASM_stats_print(stderr, &assembler.symbols.identifiers.table);
+  
+  TCASM_assembler_destroy(&assembler);
+  return ok;
+}
 
-/**
- * Ponteiro para no da lista de hash do simbolo que esta sendo definido.
- */
-static TCASM_hashtable_node_t* TCASM_hashnode;
+// =============================================================================
+// definicao de funcoes privadas
+// =============================================================================
 
 /**
- * Simbolo que esta sendo definido.
+ * Funcao para escrever o valor zero varias vezes em um vetor.
+ * @param dst Ponteiro do vetor.
+ * @param pos Posicao no vetor onde o inteiro sera escrito varias vezes.
+ * @param count Quantidade de repeticoes.
  */
-static TCASM_symbol_t* TCASM_symbol;
+inline void TCASM_write_uint16_zeroarray(uint16_t dst[], size_t pos, size_t count) {
+  for (size_t i = 0; i < count; ++i)
+    dst[pos + i] = 0;
+}
 
 /**
- * Lista de referencias pendentes.
- */
-static TCASM_list_t TCASM_reflist;
+ * Funcao para apagar o resultado da montagem anterior e voltar ao estado
+ * inicial. Mantem os buffers do codigo-fonte e do codigo montado.
+ * @param asm_ptr Ponteiro do contexto.
+ */
+void TCASM_assembler_reset(TCASM_assembler_t* asm_ptr) {
+  // libera de uma vez os nos de todas as listas e os simbolos
+  TCASM_list_pool_destroy(&asm_ptr->list_pool);
+  TCASM_symbol_table_destroy(&asm_ptr->symbols);
+  TCASM_symbol_table_init(&asm_ptr->symbols, TCASM_HASHTABLE_DEFAULT_SIZE);
+  TCASM_list_init(&asm_ptr->datalist, &asm_ptr->list_pool, sizeof(TCASM_datalist_node_t));
+  TCASM_map_clear(&asm_ptr->map);
+  for (size_t i = 0; i < asm_ptr->diagnostics_size; ++i)
+    free(asm_ptr->diagnostics[i].message);
+  asm_ptr->diagnostics_size = 0;
+  
+  asm_ptr->code_size = 0;
+  asm_ptr->text_size = 0;
+  asm_ptr->data_size = 0;
+  asm_ptr->text_read = false;
+  asm_ptr->data_read = false;
+  asm_ptr->state = TCASM_STATE_SECTION;
+  asm_ptr->line = 1;
+  asm_ptr->statement_line = 0;
+  asm_ptr->column = 0;
+  asm_ptr->statement_column = 0;
+  asm_ptr->ch = 0;
+  asm_ptr->read_chars = 0;
+  asm_ptr->read_lines = 0;
+  asm_ptr->changed_line = false;
+  asm_ptr->word = NULL;
+  asm_ptr->symbol_size = 0;
+  asm_ptr->symbol_id = 0;
+  asm_ptr->opcode = 0;
+  asm_ptr->second_op = false;
+  asm_ptr->fixups_size = 0;
+  asm_ptr->fixups_unchecked = false;
+  asm_ptr->incremental.valid = false;
+}
 
 /**
- * Lista de dados declarados. Usado apenas quando a secao de dados vem antes
- * da secao de texto.
+ * Funcao que monta o codigo-fonte que ja esta em asm_ptr->source, ate
+ * asm_ptr->source_end, convertendo as letras para maiusculas no proprio
+ * buffer. Um erro em qualquer ponto da montagem volta para ca. Com mais de
+ * uma thread, tenta primeiro a montagem paralela; se ela nao for possivel ou
+ * encontrar qualquer erro, a montagem sequencial refaz tudo, entao o
+ * resultado e os diagnosticos sao sempre os da montagem sequencial.
+ * @param asm_ptr Ponteiro do contexto.
+ * @return Retorna true se a montagem terminou sem erros.
  */
-static TCASM_list_t TCASM_datalist;
+bool TCASM_assembler_parse(TCASM_assembler_t* asm_ptr) {
+  TCASM_assembler_reset(asm_ptr);
+  for (char* p = asm_ptr->source; p != asm_ptr->source_end; ++p)
+    if (*p >= 'a' && *p <= 'z')
+      *p += 'A' - 'a';
+  
+  // a montagem paralela nao guarda o que a montagem incremental precisa, nem
+  // os simbolos pendentes do objeto relocavel
+  if (asm_ptr->jobs > 1 && !asm_ptr->incremental.enabled && !asm_ptr->relocatable) {
+    if (TCASM_parallel_parse(asm_ptr))
+      return true;
+    TCASM_assembler_reset(asm_ptr);
+  }
+  
+  asm_ptr->cursor = asm_ptr->source;
+  asm_ptr->line_start = asm_ptr->source;
+  
+  if (setjmp(asm_ptr->error_jump) != 0)
+    return false;
+  TCASM_read_source(asm_ptr);
+  return true;
+}
 
 /**
- * Opcode da instrucao que esta sendo montada.
+ * Funcao para acrescentar um diagnostico ao contexto.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param severity Gravidade do diagnostico.
+ * @param line Linha do codigo-fonte, ou TCASM_DIAGNOSTIC_NO_LINE.
+ * @param format Formato da mensagem, como no printf.
+ * @param args Argumentos do formato.
  */
-static uint16_t TCASM_opcode;
+void TCASM_diagnostic_add(TCASM_assembler_t* asm_ptr, TCASM_diagnostic_severity_t severity, unsigned int line, const char* format, va_list args) {
+  if (asm_ptr->diagnostics_size == asm_ptr->diagnostics_capacity) {
+    asm_ptr->diagnostics_capacity = asm_ptr->diagnostics_capacity ? 2*asm_ptr->diagnostics_capacity : 16;
+    asm_ptr->diagnostics = (TCASM_diagnostic_t*) realloc(asm_ptr->diagnostics, asm_ptr->diagnostics_capacity*sizeof(TCASM_diagnostic_t));
+  }
+  
+  va_list copy;
+  va_copy(copy, args);
+  int size = vsnprintf(NULL, 0, format, copy);
+  va_end(copy);
+  
+  TCASM_diagnostic_t* diagnostic = &asm_ptr->diagnostics[asm_ptr->diagnostics_size++];
+  diagnostic->severity = severity;
+  diagnostic->line = line;
+  diagnostic->message = (char*) malloc(size + 1);
+  vsnprintf(diagnostic->message, size + 1, format, args);
+}
 
 /**
- * Flag para indicar se esta lendo o segundo operando de um copy.
+ * Funcao para registrar um erro e interromper a montagem, voltando para
+ * TCASM_assembler_parse. Se algum dado foi definido depois da ultima
+ * conferencia dos operandos, confere antes, porque um erro nos operandos
+ * desse dado vem antes deste.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param line Linha do codigo-fonte, ou TCASM_DIAGNOSTIC_NO_LINE.
+ * @param format Formato da mensagem, como no printf.
  */
-static bool TCASM_second_op = false;
-
-// =============================================================================
-// declaracao de funcoes privadas
-// =============================================================================
-
-// util
-static void TCASM_write_uint16_zeroarray(uint16_t dst[], size_t pos, size_t count);
-static void TCASM_strinit(char* to, size_t* size, int from);
-static void TCASM_strinitempty(char* to, size_t* size);
-static void TCASM_strcat(char* to, size_t* size, int from);
-
-static void TCASM_read_file(const char* in);
-static void TCASM_write_file(const char* out);
-static int TCASM_ignore_line();
-static bool TCASM_read_char();
-static bool TCASM_read_char_from_file();
-static void TCASM_read_symbol();
-static void TCASM_read_colon();
-static void TCASM_read_comma();
-static int TCASM_read_array_ref();
-static TCASM_symbol_type_t TCASM_read_data_type();
-static void TCASM_check_new_line();
-static void TCASM_check_same_line();
-static void TCASM_check_new_column();
-static void TCASM_dump_text_reflist();
-static void TCASM_dump_varconst_reflist_databefore(TCASM_list_t* ref_list);
-static void TCASM_dump_var_reflist_dataafter();
-static void TCASM_dump_const_reflist_dataafter(int const_value);
-static void TCASM_dump_array_reflist_databefore(TCASM_list_t* ref_list);
-static void TCASM_dump_array_reflist_dataafter();
-static void TCASM_dump_datalist();
-static void TCASM_dump_reflist_databefore();
-static void TCASM_dump_reflist_dataafter();
-static void TCASM_create_anonymous_data_databefore();
-static void TCASM_create_anonymous_data_dataafter();
-static void TCASM_decode_instruction();
-static void TCASM_state_regular_create_ref_list();
-static void TCASM_state_regular_add_ref();
-static void TCASM_handle_state_section();
-static void TCASM_handle_state_section_type();
-static void TCASM_handle_state_text_statement();
-static void TCASM_handle_state_data_statement_databefore();
-static void TCASM_handle_state_data_statement_dataafter();
-static void TCASM_handle_state_text();
-static void TCASM_handle_state_data_create_databefore();
-static void TCASM_handle_state_data_create_dataafter();
-static void TCASM_handle_state_data_define_varconst();
-static void TCASM_handle_state_data_define_array();
-static void TCASM_handle_state_regular();
-static void TCASM_handle_state_branch();
-static void TCASM_handle_state_copy();
-
-// =============================================================================
-// definicao de funcoes publicas
-// =============================================================================
+void TCASM_error(TCASM_assembler_t* asm_ptr, unsigned int line, const char* format, ...) {
+  if (asm_ptr->fixups_unchecked)
+    TCASM_resolve_fixups(asm_ptr, false);
+  
+  va_list args;
+  va_start(args, format);
+  TCASM_diagnostic_add(asm_ptr, TCASM_DIAGNOSTIC_ERROR, line, format, args);
+  va_end(args);
+  longjmp(asm_ptr->error_jump, 1);
+}
 
 /**
- * Monta o arquivo de entrada com assembly da maquina hipotetica.
- * @param in Nome do arquivo fonte.
- * @param out Nome do arquivo de saida para escrever o codigo montado.
+ * Funcao para registrar um aviso, sem interromper a montagem.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param line Linha do codigo-fonte, ou TCASM_DIAGNOSTIC_NO_LINE.
+ * @param format Formato da mensagem, como no printf.
  */
-void TCASM_assemble(const char* in, const char* out) {
-  TCASM_hashtable_init(&TCASM_symbol_table, sizeof(TCASM_symbol_t), TCASM_HASHTABLE_DEFAULT_SIZE);
-  TCASM_symbol_init(&TCASM_symbol_table);
-  TCASM_list_init(&TCASM_reflist, sizeof(TCASM_reflist_node_t));
-  TCASM_list_init(&TCASM_datalist, sizeof(TCASM_datalist_node_t));
-  TCASM_read_file(in);
-  TCASM_write_file(out);
+void TCASM_warning(TCASM_assembler_t* asm_ptr, unsigned int line, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  TCASM_diagnostic_add(asm_ptr, TCASM_DIAGNOSTIC_WARNING, line, format, args);
+  va_end(args);
 }
 
-// =============================================================================
-// definicao de funcoes privadas
-// =============================================================================
-
 /**
- * Funcao para escrever o valor zero varias vezes em um vetor.
- * @param dst Ponteiro do vetor.
- * @param pos Posicao no vetor onde o inteiro sera escrito varias vezes.
- * @param count Quantidade de repeticoes.
+ * Funcao que garante espaco para um codigo-fonte de um dado tamanho no
+ * buffer do contexto.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param size Tamanho do codigo-fonte.
  */
-inline void TCASM_write_uint16_zeroarray(uint16_t dst[], size_t pos, size_t count) {
-  for (size_t i = 0; i < count; ++i)
-    dst[pos + i] = 0;
+void TCASM_reserve_source(TCASM_assembler_t* asm_ptr, size_t size) {
+  if (asm_ptr->source != NULL && asm_ptr->source_capacity >= size)
+    return;
+  if (asm_ptr->source_capacity == 0)
+    asm_ptr->source_capacity = 65536;
+  while (asm_ptr->source_capacity < size)
+    asm_ptr->source_capacity *= 2;
+  asm_ptr->source = (char*) realloc(asm_ptr->source, asm_ptr->source_capacity);
 }
 
 /**
- * Funcao para inicializar uma string com um char.
- * @param to Ponteiro da string que sera inicializada.
- * @param size Ponteiro do tamanho da string que sera inicializado com 1.
- * @param from Caractere que ira inicializar a string.
+ * Funcao que garante espaco para os operandos registrados no contexto,
+ * mantendo o conteudo.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param size Quantidade de operandos.
  */
-inline void TCASM_strinit(char* to, size_t* size, int from) {
-  to[0] = (char) from;
-  to[1] = '\0';
-  *size = 1;
+void TCASM_reserve_fixups(TCASM_assembler_t* asm_ptr, size_t size) {
+  if (asm_ptr->fixups_capacity >= size)
+    return;
+  if (asm_ptr->fixups_capacity == 0)
+    asm_ptr->fixups_capacity = 1024;
+  while (asm_ptr->fixups_capacity < size)
+    asm_ptr->fixups_capacity *= 2;
+  asm_ptr->fixups = (TCASM_fixup_t*) realloc(asm_ptr->fixups, asm_ptr->fixups_capacity*sizeof(TCASM_fixup_t));
 }
 
 /**
- * Funcao para inicializar uma string vazia.
- * @param to Ponteiro da string que sera inicializada.
- * @param size Ponteiro do tamanho da string que sera inicializado com 0.
+ * Funcao para ler o arquivo fonte inteiro para o buffer do contexto.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param in Nome do arquivo fonte.
+ * @return Retorna false se o arquivo nao pode ser aberto.
  */
-inline void TCASM_strinitempty(char* to, size_t* size) {
-  to[0] = '\0';
-  *size = 0;
+bool TCASM_load_source(TCASM_assembler_t* asm_ptr, const char* in) {
+  FILE* fin;
+  if ((fin = fopen(in, "rb")) == NULL) {
+    fprintf(stderr, "Erro: Nao foi possivel abrir o arquivo \"%s\" para leitura\n", in);
+    return false;
+  }
+  
+  // le em blocos, para funcionar tambem com pipes
+  size_t size = 0, read;
+  TCASM_reserve_source(asm_ptr, 1);
+  while ((read = fread(asm_ptr->source + size, 1, asm_ptr->source_capacity - size, fin)) > 0) {
+    size += read;
+    if (size == asm_ptr->source_capacity)
+      TCASM_reserve_source(asm_ptr, size + 1);
+  }
+  fclose(fin);
+  
+  asm_ptr->source_end = asm_ptr->source + size;
+  return true;
 }
 
 /**
- * Funcao para concatenar um caractere no final de uma string.
- * @param to Ponteiro da string que sera inicializada.
- * @param size Ponteiro do tamanho da string ira ser incrementado.
- * @param from Caractere que entrara no final da string.
+ * Realiza a etapa de analise do codigo-fonte.
+ * @param asm_ptr Ponteiro do contexto.
  */
-inline void TCASM_strcat(char* to, size_t* size, int from) {
-  to[(*size)++] = (char) from;
-  to[*size] = '\0';
+void TCASM_read_source(TCASM_assembler_t* asm_ptr) {
+  TCASM_read_statements(asm_ptr);
+  TCASM_finish_source(asm_ptr);
 }
 
 /**
- * Realiza a etapa de analise do arquivo fonte.
- * @param in Nome do arquivo fonte.
+ * Funcao que passa o codigo-fonte pela maquina de montagem, a partir de
+ * asm_ptr->cursor e ate asm_ptr->source_end.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_read_file(const char* in) {
-  if ((TCASM_fin = fopen(in, "r")) == NULL) {
-    fprintf(stderr, "Erro: Nao foi possivel abrir o arquivo \"%s\" para leitura\n", in);
-    exit(EXIT_FAILURE);
-  }
-  
+void TCASM_read_statements(TCASM_assembler_t* asm_ptr) {
   // loop para ler o arquivo fonte char por char
   while (true) {
     // encerra o loop se nao eh possivel ler mais caracteres
-    if (!TCASM_read_char())
+    if (!TCASM_read_char(asm_ptr))
       break;
     
+    TCASM_state_t state = asm_ptr->state;
+    size_t first = asm_ptr->code_size;
+    if (asm_ptr->map.enabled)
+      asm_ptr->column = (unsigned int) (asm_ptr->cursor - asm_ptr->line_start);
+    
     // chama a funcao do estado atual para tratar o char lido
-    switch (TCASM_state) {
+    switch (asm_ptr->state) {
       case TCASM_STATE_SECTION:
-        TCASM_handle_state_section();
+        TCASM_handle_state_section(asm_ptr);
         break;
         
       case TCASM_STATE_SECTION_TYPE:
-        TCASM_handle_state_section_type();
+        TCASM_handle_state_section_type(asm_ptr);
         break;
         
       case TCASM_STATE_TEXT_STATEMENT:
-        TCASM_handle_state_text_statement();
+        TCASM_handle_state_text_statement(asm_ptr);
         break;
         
       case TCASM_STATE_DATA_STATEMENT_DATABEFORE:
-        TCASM_handle_state_data_statement_databefore();
+        TCASM_handle_state_data_statement_databefore(asm_ptr);
         break;
         
       case TCASM_STATE_DATA_STATEMENT_DATAAFTER:
-        TCASM_handle_state_data_statement_dataafter();
+        TCASM_handle_state_data_statement_dataafter(asm_ptr);
         break;
         
       case TCASM_STATE_TEXT:
-        TCASM_handle_state_text();
+        TCASM_handle_state_text(asm_ptr);
         break;
         
       case TCASM_STATE_DATA_CREATE_DATABEFORE:
-        TCASM_handle_state_data_create_databefore();
+        TCASM_handle_state_data_create_databefore(asm_ptr);
         break;
         
       case TCASM_STATE_DATA_CREATE_DATAAFTER:
-        TCASM_handle_state_data_create_dataafter();
+        TCASM_handle_state_data_create_dataafter(asm_ptr);
         break;
         
       case TCASM_STATE_DATA_DEFINE_VARCONST:
-        TCASM_handle_state_data_define_varconst();
+        TCASM_handle_state_data_define_varconst(asm_ptr);
         break;
         
       case TCASM_STATE_DATA_DEFINE_ARRAY:
-        TCASM_handle_state_data_define_array();
+        TCASM_handle_state_data_define_array(asm_ptr);
         break;
         
       case TCASM_STATE_REGULAR:
-        TCASM_handle_state_regular();
+        TCASM_handle_state_regular(asm_ptr);
         break;
         
       case TCASM_STATE_BRANCH:
-        TCASM_handle_state_branch();
+        TCASM_handle_state_branch(asm_ptr);
         break;
         
       case TCASM_STATE_COPY:
-        TCASM_handle_state_copy();
+        TCASM_handle_state_copy(asm_ptr);
         break;
         
       default:
         break;
     }
+    
+    // registra a origem das palavras montadas pelo estado
+    if (asm_ptr->map.enabled && asm_ptr->code_size != first)
+      TCASM_map_statement(asm_ptr, state, first);
   }
+}
+
+/**
+ * Funcao que encerra a analise depois do fim do codigo-fonte: confere o
+ * estado final da maquina, aloca os dados declarados antes da secao de texto
+ * e resolve todos os operandos.
+ * @param asm_ptr Ponteiro do contexto.
+ */
+void TCASM_finish_source(TCASM_assembler_t* asm_ptr) {
+  if (asm_ptr->state == TCASM_STATE_SECTION || asm_ptr->state == TCASM_STATE_DATA_STATEMENT_DATABEFORE || asm_ptr->code_size == 0)
+    TCASM_error(asm_ptr, TCASM_DIAGNOSTIC_NO_LINE, "Arquivo fonte sem nenhuma instrucao");
   
-  fclose(TCASM_fin);
+  if (asm_ptr->state != TCASM_STATE_TEXT_STATEMENT && asm_ptr->state != TCASM_STATE_DATA_STATEMENT_DATAAFTER)
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Sentenca invalida");
   
-  if (TCASM_state == TCASM_STATE_SECTION || TCASM_state == TCASM_STATE_DATA_STATEMENT_DATABEFORE || TCASM_assembled_code_size == 0) {
-    fprintf(stderr, "Erro: Arquivo fonte sem nenhuma instrucao\n");
-    exit(EXIT_FAILURE);
-  }
+  // sem secao de dados depois do texto, o codigo montado ate aqui eh todo texto
+  if (asm_ptr->state == TCASM_STATE_TEXT_STATEMENT)
+    asm_ptr->text_size = asm_ptr->code_size;
   
-  if (TCASM_state != TCASM_STATE_TEXT_STATEMENT && TCASM_state != TCASM_STATE_DATA_STATEMENT_DATAAFTER) {
-    fprintf(stderr, "Erro linha %u: Sentenca invalida\n", TCASM_statement_line);
-    exit(EXIT_FAILURE);
-  }
-  
-  if (TCASM_data_read && TCASM_state == TCASM_STATE_TEXT_STATEMENT) {
-    TCASM_dump_datalist();
-    TCASM_dump_reflist_databefore();
-  }
-  else
-    TCASM_dump_reflist_dataafter();
+  if (asm_ptr->data_read && asm_ptr->state == TCASM_STATE_TEXT_STATEMENT)
+    TCASM_dump_datalist(asm_ptr);
+  TCASM_resolve_fixups(asm_ptr, true);
 }
 
 /**
  * Escreve o codigo montado no arquivo de saida.
+ * @param asm_ptr Ponteiro do contexto.
  * @param out Nome do arquivo de saida para escrever o codigo montado.
+ * @return Retorna false se o arquivo nao pode ser aberto.
  */
-void TCASM_write_file(const char* out) {
+bool TCASM_write_file(TCASM_assembler_t* asm_ptr, const char* out) {
   FILE* fout;
   if ((fout = fopen(out, "wb")) == NULL) {
     fprintf(stderr, "Erro: Nao foi possivel abrir o arquivo \"%s\" para escrita\n", out);
-    exit(EXIT_FAILURE);
+    return false;
   }
   
-  fwrite(TCASM_assembled_code, sizeof(uint16_t), TCASM_assembled_code_size, fout);
+  fwrite(asm_ptr->code, sizeof(uint16_t), asm_ptr->code_size, fout);
   
   fclose(fout);
+  return true;
 }
 
 /**
- * Funcao para consumir todos os caracteres ate o fim da linha atual.
- * @return Retorna a quantidade de caracteres retirados.
+ * Escreve o objeto relocavel da montagem no arquivo de saida.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param out Nome do arquivo de saida para escrever o objeto.
+ * @return Retorna false se o arquivo nao pode ser aberto.
  */
-int TCASM_ignore_line() {
-  int count = 0;
-  
-  do {
-    if (!TCASM_read_char_from_file())
-      return count;
-    ++count;
-  } while (TCASM_char != '\r' && TCASM_char != '\n');
-  
-  if (TCASM_char == '\r') {
-    if (!TCASM_read_char_from_file())
-      return count;
-    ++count;
+bool TCASM_write_object(TCASM_assembler_t* asm_ptr, const char* out) {
+  FILE* fout;
+  if ((fout = fopen(out, "wb")) == NULL) {
+    fprintf(stderr, "Erro: Nao foi possivel abrir o arquivo \"%s\" para escrita\n", out);
+    return false;
   }
   
-  return count;
+  TCASM_object_t object;
+  TCASM_object_init(&object);
+  TCASM_assembler_object(asm_ptr, &object);
+  TCASM_object_serialize(&object, fout);
+  TCASM_object_destroy(&object);
+  
+  fclose(fout);
+  return true;
 }
 
 /**
- * Retira caracteres do arquivo de entrada ate encontrar um que nao seja
+ * Retira caracteres do codigo-fonte ate encontrar um que nao seja
  * whitespace.
+ * @param asm_ptr Ponteiro do contexto.
  * @return Retorna true se foi possivel ler um char, ou false se nao foi.
  */
-bool TCASM_read_char() {
-  TCASM_read_chars = 0;
-  TCASM_read_lines = 0;
+bool TCASM_read_char(TCASM_assembler_t* asm_ptr) {
+  const char* cursor = asm_ptr->cursor;
+  const char* end = asm_ptr->source_end;
+  asm_ptr->read_lines = 0;
   
   // loop mantido ate ler um char valido, ou ate o arquivo acabar
-  while (true) {
-    if (TCASM_read_char_from_file())
-      ++TCASM_read_chars;
-    else
-      return false;
+  while (cursor != end) {
+    char c = *cursor++;
     
-    if (TCASM_char == ' ' || TCASM_char == '\t')
+    if (c == ' ' || c == '\t') {
+      cursor = TCASM_scan_blanks(cursor, end);
       continue;
+    }
     
-    // lida com comentario
-    if (TCASM_char == ';') {
-      TCASM_read_chars += TCASM_ignore_line();
-      if (feof(TCASM_fin))
-        return false;
-      ++TCASM_line;
-      ++TCASM_read_lines;
-      TCASM_changed_line = true;
-      continue;
+    // lida com comentario, que vai ate a quebra de linha
+    if (c == ';') {
+      cursor = TCASM_scan_line_end(cursor, end);
+      if (cursor == end)
+        break;
+      c = *cursor++;
     }
     
-    // lida com quebra de linha
-    if (TCASM_char == '\r' || TCASM_char == '\n') {
-      ++TCASM_line;
-      ++TCASM_read_lines;
-      TCASM_changed_line = true;
-      if (TCASM_char == '\r') {
-        if (!TCASM_read_char_from_file())
-          return false;
-        ++TCASM_read_chars;
+    // lida com quebra de linha ('\r' consome tambem o char seguinte)
+    if (c == '\r' || c == '\n') {
+      if (c == '\r') {
+        if (cursor == end)
+          break;
+        ++cursor;
       }
+      ++asm_ptr->line;
+      ++asm_ptr->read_lines;
+      asm_ptr->changed_line = true;
+      asm_ptr->line_start = cursor;
       continue;
     }
     
     // encerra o loop, pois o caractere lido eh valido
-    break;
+    asm_ptr->ch = (unsigned char) c;
+    asm_ptr->read_chars = cursor - asm_ptr->cursor;
+    asm_ptr->cursor = cursor;
+    return true;
   }
   
-  return true;
+  asm_ptr->read_chars = cursor - asm_ptr->cursor;
+  asm_ptr->cursor = cursor;
+  return false;
 }
 
 /**
- * Retira um caractere do arquivo fonte transformando em maiusculo se preciso.
- * @return Retorna true se foi possivel ler o char, ou false ao fim do arquivo.
+ * Funcao para ler uma palavra do codigo-fonte. Podera ser uma palavra-chave,
+ * ou um identificador. A palavra nao eh copiada: asm_ptr->word aponta para ela
+ * no proprio codigo-fonte.
+ * @param asm_ptr Ponteiro do contexto.
  */
-bool TCASM_read_char_from_file() {
-  int buf = fgetc(TCASM_fin);
+void TCASM_read_symbol(TCASM_assembler_t* asm_ptr) {
+  if ((asm_ptr->ch < 'A' || asm_ptr->ch > 'Z') && (asm_ptr->ch != '_'))
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Simbolo iniciado com caractere invalido");
   
-  if (feof(TCASM_fin))
-    return false;
+  asm_ptr->word = asm_ptr->cursor - 1;
+  const char* cursor = TCASM_scan_identifier(asm_ptr->cursor, asm_ptr->source_end);
   
-  TCASM_char = buf;
-  if (TCASM_char >= 'a' && TCASM_char <= 'z')
-    TCASM_char += 'A' - 'a';
+  if ((size_t) (cursor - asm_ptr->word) > TCASM_SYMBOL_MAX_IDENTIFIER_SIZE)
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Tentando criar identificador com mais de %d caracteres", TCASM_SYMBOL_MAX_IDENTIFIER_SIZE);
   
-  return true;
+  // a palavra precisa terminar antes do fim do arquivo
+  if (cursor == asm_ptr->source_end)
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Simbolo invalido");
+  
+  asm_ptr->symbol_size = cursor - asm_ptr->word;
+  asm_ptr->cursor = cursor;
+  asm_ptr->ch = (unsigned char) cursor[-1];
+}
+
+/**
+ * Funcao para procurar a ultima palavra lida na tabela de simbolos, que a
+ * cria se ainda nao existe. Atualiza asm_ptr->symbol_id.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param created Ponteiro para a funcao retornar true se o simbolo foi
+ * criado, ou false em caso contrario.
+ */
+void TCASM_lookup_symbol(TCASM_assembler_t* asm_ptr, bool* created) {
+  asm_ptr->symbol_id = TCASM_symbol_lookup(&asm_ptr->symbols, asm_ptr->word, asm_ptr->symbol_size, created);
 }
 
 /**
- * Funcao para ler uma palavra do arquivo fonte. Podera ser uma palavra-chave,
- * ou um identificador.
+ * Funcao para ler o restante de uma palavra-chave, cujo primeiro char eh o
+ * ultimo lido.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param rest Restante da palavra-chave, em maiusculas.
+ * @param size Tamanho do restante.
+ * @return Retorna true se o codigo-fonte continua com a palavra-chave.
  */
-void TCASM_read_symbol() {
-  if ((TCASM_char < 'A' || TCASM_char > 'Z') && (TCASM_char != '_')) {
-    fprintf(stderr, "Erro linha %u: Simbolo iniciado com caractere invalido\n", TCASM_statement_line);
-    exit(EXIT_FAILURE);
+bool TCASM_read_keyword(TCASM_assembler_t* asm_ptr, const char* rest, size_t size) {
+  if ((size_t) (asm_ptr->source_end - asm_ptr->cursor) < size || memcmp(asm_ptr->cursor, rest, size) != 0)
+    return false;
+  asm_ptr->cursor += size;
+  return true;
+}
+
+/**
+ * Funcao para ler um inteiro no formato do "%i" do scanf, a partir do
+ * proximo char: sinal opcional, seguido de um numero decimal, octal (prefixo
+ * 0) ou hexadecimal (prefixo 0x). Valores fora do intervalo de um int sao
+ * saturados.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param value Ponteiro para retornar o inteiro lido.
+ * @return Retorna true se foi possivel ler um inteiro, ou false se nao foi.
+ */
+bool TCASM_read_int(TCASM_assembler_t* asm_ptr, int* value) {
+  const char* cursor = asm_ptr->cursor;
+  const char* end = asm_ptr->source_end;
+  
+  bool negative = false;
+  if (cursor != end && (*cursor == '+' || *cursor == '-'))
+    negative = *cursor++ == '-';
+  
+  // um "0x" sem digitos depois vale 0, como no scanf da glibc
+  int base = 10;
+  const char* digits = cursor;
+  if (cursor != end && *cursor == '0') {
+    base = 8;
+    if (end - cursor > 1 && cursor[1] == 'X') {
+      base = 16;
+      cursor += 2;
+    }
   }
   
-  TCASM_strinit(TCASM_word, &TCASM_symbol_size, TCASM_char);
-  
-  // retira caracteres do arquivo para formar a palavra
-  while (true) {
-    if (!TCASM_read_char_from_file()) {
-      fprintf(stderr, "Erro linha %u: Simbolo invalido\n", TCASM_statement_line);
-      exit(EXIT_FAILURE);
-    }
-    
-    if ((TCASM_char < 'A' || TCASM_char > 'Z') && (TCASM_char != '_') && (TCASM_char < '0' || TCASM_char > '9')) {
-      TCASM_char = TCASM_word[TCASM_symbol_size - 1];
-      fseek(TCASM_fin, -1, SEEK_CUR);
-      return;
-    }
-    
-    if (TCASM_symbol_size == TCASM_SYMBOL_MAX_IDENTIFIER_SIZE) {
-      fprintf(stderr, "Erro linha %u: Tentando criar identificador com mais de %d caracteres\n", TCASM_statement_line, TCASM_SYMBOL_MAX_IDENTIFIER_SIZE);
-      exit(EXIT_FAILURE);
-    }
-    
-    TCASM_strcat(TCASM_word, &TCASM_symbol_size, TCASM_char);
+  long long result = 0;
+  for (; cursor != end; ++cursor) {
+    int digit;
+    if (*cursor >= '0' && *cursor <= '9')
+      digit = *cursor - '0';
+    else if (*cursor >= 'A' && *cursor <= 'F')
+      digit = *cursor - 'A' + 10;
+    else
+      break;
+    if (digit >= base)
+      break;
+    if (result <= 0x80000000LL)
+      result = result*base + digit;
   }
+  if (cursor == digits)
+    return false;
+  
+  if (negative)
+    result = -result;
+  if (result > 0x7FFFFFFFLL)
+    result = 0x7FFFFFFFLL;
+  else if (result < -0x80000000LL)
+    result = -0x80000000LL;
+  
+  *value = (int) result;
+  asm_ptr->cursor = cursor;
+  return true;
 }
 
 /**
  * Funcao para tentar ler um colon (dois-pontos) depois de um identificador.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_read_colon() {
-  if (TCASM_read_char()) {
-    TCASM_check_same_line();
-    if (TCASM_char == ':')
+void TCASM_read_colon(TCASM_assembler_t* asm_ptr) {
+  if (TCASM_read_char(asm_ptr)) {
+    TCASM_check_same_line(asm_ptr);
+    if (asm_ptr->ch == ':')
       return;
   }
   
-  // if (!TCASM_read_char() || TCASM_char != ':')
-  fprintf(stderr, "Erro linha %u: Sentenca invalida\n", TCASM_statement_line);
-  exit(EXIT_FAILURE);
+  // if (!TCASM_read_char(asm_ptr) || asm_ptr->ch != ':')
+  TCASM_error(asm_ptr, asm_ptr->statement_line, "Sentenca invalida");
 }
 
 /**
  * Funcao para tentar ler um comma (virgula).
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_read_comma() {
-  if (TCASM_read_char()) {
-    TCASM_check_same_line();
-    if (TCASM_char == ',')
+void TCASM_read_comma(TCASM_assembler_t* asm_ptr) {
+  if (TCASM_read_char(asm_ptr)) {
+    TCASM_check_same_line(asm_ptr);
+    if (asm_ptr->ch == ',')
       return;
   }
   
-  // if (!TCASM_read_char() || TCASM_char != ',')
-  fprintf(stderr, "Erro linha %u: Sentenca invalida\n", TCASM_statement_line);
-  exit(EXIT_FAILURE);
+  // if (!TCASM_read_char(asm_ptr) || asm_ptr->ch != ',')
+  TCASM_error(asm_ptr, asm_ptr->statement_line, "Sentenca invalida");
 }
 
 /**
  * Funcao para ler o offset em uma referencia a um vetor.
+ * @param asm_ptr Ponteiro do contexto.
  * @return Retorna o offset da referencia.
  */
-int TCASM_read_array_ref() {
-  bool bracket = TCASM_char == '[';
-  if (TCASM_char != '+' && !bracket) {
-    fprintf(stderr, "Erro linha %u: Sentenca invalida\n", TCASM_statement_line);
-    exit(EXIT_FAILURE);
-  }
+int TCASM_read_array_ref(TCASM_assembler_t* asm_ptr) {
+  bool bracket = asm_ptr->ch == '[';
+  if (asm_ptr->ch != '+' && !bracket)
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Sentenca invalida");
   
   // verificando se existem mais caracteres validos nesta linha (indice)
-  if (!TCASM_read_char()) {
-    fprintf(stderr, "Erro linha %u: Indice invalido de vetor\n", TCASM_statement_line);
-    exit(EXIT_FAILURE);
-  }
-  TCASM_check_same_line();
+  if (!TCASM_read_char(asm_ptr))
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Indice invalido de vetor");
+  TCASM_check_same_line(asm_ptr);
   
   // lendo o indice
-  fseek(TCASM_fin, -1, SEEK_CUR);
+  --asm_ptr->cursor;
   int i;
-  if (fscanf(TCASM_fin, "%i", &i) != 1) {
-    fprintf(stderr, "Erro linha %u: Indice invalido de vetor\n", TCASM_statement_line);
-    exit(EXIT_FAILURE);
-  }
+  if (!TCASM_read_int(asm_ptr, &i))
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Indice invalido de vetor");
   
   if (bracket) {
-    if (!TCASM_read_char()) {
-      fprintf(stderr, "Erro linha %u: Sentenca invalida\n", TCASM_statement_line);
-      exit(EXIT_FAILURE);
-    }
-    TCASM_check_same_line();
+    if (!TCASM_read_char(asm_ptr))
+      TCASM_error(asm_ptr, asm_ptr->statement_line, "Sentenca invalida");
+    TCASM_check_same_line(asm_ptr);
     
-    if (TCASM_char != ']') {
-      fprintf(stderr, "Erro linha %u: Sentenca invalida\n", TCASM_statement_line);
-      exit(EXIT_FAILURE);
-    }
+    if (asm_ptr->ch != ']')
+      TCASM_error(asm_ptr, asm_ptr->statement_line, "Sentenca invalida");
   }
   
   return i;
 }
 
 /**
- * Funcao para ler a palavra-chave que indica um tipo de dado.
+ * Funcao para ler a palavra-chave que indica um tipo de dado. Como na
+ * leitura char a char, o primeiro char que nao casa com SPACE eh consumido e
+ * ainda pode comecar um CONST (SPCONST eh lido como CONST).
+ * @param asm_ptr Ponteiro do contexto.
  * @return Retorna TCASM_SYMBOL_DIRECTIVE_SPACE ou TCASM_SYMBOL_DIRECTIVE_CONST.
  */
-TCASM_symbol_type_t TCASM_read_data_type() {
-  // nao reclame! eh otimizacao
-  if (TCASM_char == 'S') {
-    TCASM_char = fgetc(TCASM_fin);
-    if (TCASM_char == 'P' || TCASM_char == 'p') {
-      TCASM_char = fgetc(TCASM_fin);
-      if (TCASM_char == 'A' || TCASM_char == 'a') {
-        TCASM_char = fgetc(TCASM_fin);
-        if (TCASM_char == 'C' || TCASM_char == 'c') {
-          TCASM_char = fgetc(TCASM_fin);
-          if (!feof(TCASM_fin) && (TCASM_char == 'E' || TCASM_char == 'e'))
-            return TCASM_SYMBOL_DIRECTIVE_SPACE;
-        }
-      }
-    }
+TCASM_symbol_type_t TCASM_read_data_type(TCASM_assembler_t* asm_ptr) {
+  if (asm_ptr->ch == 'S') {
+    if (TCASM_read_keyword(asm_ptr, "PACE", 4))
+      return TCASM_SYMBOL_DIRECTIVE_SPACE;
+    
+    const char* cursor = asm_ptr->cursor;
+    size_t matched = 0;
+    while (cursor + matched != asm_ptr->source_end && cursor[matched] == "PACE"[matched])
+      ++matched;
+    if (cursor + matched == asm_ptr->source_end)
+      TCASM_error(asm_ptr, asm_ptr->statement_line, "Sentenca invalida");
+    asm_ptr->ch = (unsigned char) cursor[matched];
+    asm_ptr->cursor = cursor + matched + 1;
   }
   
-  if (TCASM_char == 'C') {
-    TCASM_char = fgetc(TCASM_fin);
-    if (TCASM_char == 'O' || TCASM_char == 'o') {
-      TCASM_char = fgetc(TCASM_fin);
-      if (TCASM_char == 'N' || TCASM_char == 'n') {
-        TCASM_char = fgetc(TCASM_fin);
-        if (TCASM_char == 'S' || TCASM_char == 's') {
-          TCASM_char = fgetc(TCASM_fin);
-          if (!feof(TCASM_fin) && (TCASM_char == 'T' || TCASM_char == 't'))
-            return TCASM_SYMBOL_DIRECTIVE_CONST;
-        }
-      }
-    }
-  }
+  if (asm_ptr->ch == 'C' && TCASM_read_keyword(asm_ptr, "ONST", 4))
+    return TCASM_SYMBOL_DIRECTIVE_CONST;
   
-  // if (feof(TCASM_fin) || (data_type != "SPACE" && data_type != "CONST"))
-  fprintf(stderr, "Erro linha %u: Sentenca invalida\n", TCASM_statement_line);
-  exit(EXIT_FAILURE);
+  // if (data_type != "SPACE" && data_type != "CONST")
+  TCASM_error(asm_ptr, asm_ptr->statement_line, "Sentenca invalida");
 }
 
 /**
  * Funcao que interrompe a montagem se o ultimo char valido lido nao esta
  * em uma nova linha.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_check_new_line() {
-  if (!TCASM_changed_line) {
-    fprintf(stderr, "Erro linha %u: Sentenca invalida\n", TCASM_statement_line);
-    exit(EXIT_FAILURE);
-  }
+void TCASM_check_new_line(TCASM_assembler_t* asm_ptr) {
+  if (!asm_ptr->changed_line)
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Sentenca invalida");
   
-  TCASM_changed_line = false;
-  TCASM_statement_line = TCASM_line;
+  asm_ptr->changed_line = false;
+  asm_ptr->statement_line = asm_ptr->line;
+  asm_ptr->statement_column = asm_ptr->column;
 }
 
 /**
  * Funcao que interrompe a montagem se o ultimo char valido lido nao esta
  * na mesma linha.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_check_same_line() {
-  if (TCASM_read_lines > 0) {
-    fprintf(stderr, "Erro linha %u: Sentenca invalida\n", TCASM_statement_line);
-    exit(EXIT_FAILURE);
-  }
+void TCASM_check_same_line(TCASM_assembler_t* asm_ptr) {
+  if (asm_ptr->read_lines > 0)
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Sentenca invalida");
 }
 
 /**
  * Funcao que interrompe a montagem se o ultimo char valido lido nao este
  * a pelo menos uma coluna de distancia.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_check_new_column() {
-  if (TCASM_read_chars == 0) {
-    fprintf(stderr, "Erro linha %u: Sentenca invalida\n", TCASM_statement_line);
-    exit(EXIT_FAILURE);
-  }
-}
-
-/**
- * Funcao que esvazia a lista de referencias do rotulo que acabou de ser
- * definido.
- */
-void TCASM_dump_text_reflist() {
-  TCASM_list_t* ref_list = &TCASM_symbol->sym_union.text.ref_list;
-  while (ref_list->size != 0) {
-    TCASM_assembled_code[((TCASM_symbol_address_reflist_t*) ref_list->first->value)->addr] = TCASM_assembled_code_size;
-    free(ref_list->first->value);
-    TCASM_list_erase(ref_list, ref_list->first);
-  }
-}
-
-/**
- * Funcao para esvaziar a lista de referencias a uma variavel ou constante
- * quando a secao de dados vem ANTES da secao de texto no codigo-fonte.
- * @param ref_list Ponteiro da lista de referencias.
- */
-void TCASM_dump_varconst_reflist_databefore(TCASM_list_t* ref_list) {
-  while (ref_list->size > 0) {
-    TCASM_assembled_code[((TCASM_symbol_address_reflist_t*) ref_list->first->value)->addr] = TCASM_assembled_code_size;
-    free(ref_list->first->value);
-    TCASM_list_erase(ref_list, ref_list->first);
-  }
-}
-
-/**
- * Funcao que esvazia a lista de referencias da variavel que acabou de ser
- * definida. Usada apenas quando a secao de dados vem DEPOIS
- * da secao de texto.
- */
-void TCASM_dump_var_reflist_dataafter() {
-  TCASM_list_t* ref_list = &TCASM_symbol->sym_union.varconst.ref_list;
-  while (ref_list->size > 0) {
-    TCASM_assembled_code[((TCASM_symbol_address_varconst_reflist_t*) ref_list->first->value)->op_addr] = TCASM_assembled_code_size;
-    free(ref_list->first->value);
-    TCASM_list_erase(ref_list, ref_list->first);
-  }
-}
-
-/**
- * Funcao que esvazia a lista de referencias da constante que acabou de ser
- * definida. Usada apenas quando a secao de dados vem DEPOIS
- * da secao de texto.
- * @param const_value Valor da constante.
- */
-void TCASM_dump_const_reflist_dataafter(int const_value) {
-  TCASM_list_t* ref_list = &TCASM_symbol->sym_union.varconst.ref_list;
-  TCASM_symbol_address_varconst_reflist_t* ref;
-  uint16_t opcode;
-  while (ref_list->size > 0) {
-    ref = (TCASM_symbol_address_varconst_reflist_t*) ref_list->first->value;
-    opcode = TCASM_assembled_code[ref->instr_addr];
-    if (opcode == TCASM_SYMBOL_INSTRUCTION_OPCODE_DIV && const_value == 0) {
-      fprintf(stderr, "Erro linha %u: Divisao por constante inicializada com valor zero\n", ref->line);
-      exit(EXIT_FAILURE);
-    }
-    else if ((opcode == TCASM_SYMBOL_INSTRUCTION_OPCODE_COPY && ref->instr_addr + 2 == ref->op_addr) ||
-              opcode == TCASM_SYMBOL_INSTRUCTION_OPCODE_STORE ||
-              opcode == TCASM_SYMBOL_INSTRUCTION_OPCODE_INPUT) {
-      fprintf(stderr, "Erro linha %u: Escrita em memoria reservada para armazenamento de constante\n", ref->line);
-      exit(EXIT_FAILURE);
-    }
-    TCASM_assembled_code[ref->op_addr] = TCASM_assembled_code_size;
-    free(ref);
-    TCASM_list_erase(ref_list, ref_list->first);
-  }
-}
-
-/**
- * Funcao para esvaziar as referencias a um vetor, apenas quando a secao de
- * dados vem ANTES da secao de texto no codigo-fonte.
- * @param ref_list Ponteiro da lista de referencias.
- */
-void TCASM_dump_array_reflist_databefore(TCASM_list_t* ref_list) {
-  uint16_t* array_size = &TCASM_symbol->sym_union.array.size;
-  TCASM_symbol_address_array_reflist_t* ref;
-  while (ref_list->size > 0) {
-    ref = (TCASM_symbol_address_array_reflist_t*) ref_list->first->value;
-    if (ref->offset >= *array_size) {
-      fprintf(stderr, "Erro linha %u: Acesso a posicao invalida do vetor\n", ref->line);
-      exit(EXIT_FAILURE);
-    }
-    TCASM_assembled_code[ref->addr] = TCASM_assembled_code_size + ref->offset;
-    free(ref);
-    TCASM_list_erase(ref_list, ref_list->first);
-  }
-}
-
-/**
- * Funcao que esvazia a lista de referencias do vetor que acabou de ser
- * definido. Usada apenas quando a secao de dados vem DEPOIS da secao de texto.
- */
-void TCASM_dump_array_reflist_dataafter() {
-  TCASM_list_t* ref_list = &TCASM_symbol->sym_union.array.ref_list;
-  uint16_t* array_size = &TCASM_symbol->sym_union.array.size;
-  TCASM_symbol_address_array_reflist_t* ref;
-  while (ref_list->size > 0) {
-    ref = (TCASM_symbol_address_array_reflist_t*) ref_list->first->value;
-    if (ref->offset >= *array_size) {
-      fprintf(stderr, "Erro linha %u: Acesso a posicao invalida do vetor\n", ref->line);
-      exit(EXIT_FAILURE);
-    }
-    TCASM_assembled_code[ref->addr] = TCASM_assembled_code_size + ref->offset;
-    free(ref);
-    TCASM_list_erase(ref_list, ref_list->first);
-  }
+void TCASM_check_new_column(TCASM_assembler_t* asm_ptr) {
+  if (asm_ptr->read_chars == 0)
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Sentenca invalida");
 }
 
 /**
  * Funcao para esvaziar a lista de dados (quando a secao de dados vem ANTES)
- * alocando os espacos e resolvendo referencias.
- */
-void TCASM_dump_datalist() {
-  while (TCASM_datalist.size != 0) {
-    TCASM_datalist_node_t* data = (TCASM_datalist_node_t*) TCASM_datalist.first->value;
-    switch (data->sym->type) {
+ * alocando os espacos e definindo o endereco de cada dado.
+ * @param asm_ptr Ponteiro do contexto.
+ */
+void TCASM_dump_datalist(TCASM_assembler_t* asm_ptr) {
+  TCASM_stats_phase_t phase = TCASM_stats_enter(TCASM_STATS_PHASE_RESOLVE);
+  for (TCASM_list_node_t* node = asm_ptr->datalist.first; node != NULL; node = node->next) {
+    TCASM_datalist_node_t* data = (TCASM_datalist_node_t*) node->value;
+    size_t first = asm_ptr->code_size;
+    if (!data->anonymous)
+      asm_ptr->symbols.addr[data->sym] = (uint16_t) first;
+    if (!data->anonymous && asm_ptr->map.enabled)
+      asm_ptr->map.symbols[data->map_symbol].addr = (uint16_t) first;
+    switch (data->type) {
       case TCASM_SYMBOL_ADDRESS_VAR:
-        TCASM_assembled_code[TCASM_assembled_code_size] = 0;
-        if (data->anonymous)
-          free(data->sym);
-        else
-          TCASM_dump_varconst_reflist_databefore(&data->sym->sym_union.var.ref_list);
-        TCASM_assembled_code_size++;
+        asm_ptr->code[asm_ptr->code_size++] = 0;
         break;
         
       case TCASM_SYMBOL_ADDRESS_CONST:
-        TCASM_assembled_code[TCASM_assembled_code_size] = data->sym->sym_union.constant.value;
-        if (data->anonymous)
-          free(data->sym);
-        else
-          TCASM_dump_varconst_reflist_databefore(&data->sym->sym_union.constant.ref_list);
-        TCASM_assembled_code_size++;
+        asm_ptr->code[asm_ptr->code_size++] = data->value;
         break;
         
       case TCASM_SYMBOL_ADDRESS_ARRAY:
-        TCASM_write_uint16_zeroarray(TCASM_assembled_code, TCASM_assembled_code_size, data->sym->sym_union.array.size);
-        if (data->anonymous)
-          free(data->sym);
-        else
-          TCASM_dump_array_reflist_databefore(&data->sym->sym_union.array.ref_list);
-        TCASM_assembled_code_size += data->sym->sym_union.array.size;
+        TCASM_write_uint16_zeroarray(asm_ptr->code, asm_ptr->code_size, data->value);
+        asm_ptr->code_size += data->value;
         break;
         
       default:
         break;
     }
-    free(TCASM_datalist.first->value);
-    TCASM_list_erase(&TCASM_datalist, TCASM_datalist.first);
+    TCASM_map_words(&asm_ptr->map, first, asm_ptr->code_size - first, data->line, data->col, TCASM_MAP_KIND_DATA);
   }
+  TCASM_list_clear(&asm_ptr->datalist);
+  TCASM_stats_leave(phase);
 }
 
 /**
- * Funcao para procurar uma referencia que nao foi resolvida e acusar erro,
- * apenas quando a secao de dados vem ANTES da secao de texto no codigo-fonte.
- */
-void TCASM_dump_reflist_databefore() {
-  if (TCASM_reflist.size == 0)
-    return;
+ * Funcao que resolve os operandos registrados em asm_ptr->fixups em uma
+ * unica passada, na ordem dos enderecos, com as conferencias que dependem da
+ * definicao do simbolo: escrita ou divisao por zero em constante e posicao
+ * invalida de vetor. Entre os erros, vale o do simbolo de menor endereco e,
+ * nele, o do primeiro operando, que eh o erro que a maquina de montagem
+ * encontraria ao definir os dados em ordem; os avisos de linhas depois da
+ * definicao desse simbolo sao descartados. Sem esses erros, acusa o primeiro
+ * simbolo (na ordem dos ids) usado e nunca definido, exceto no objeto
+ * relocavel, em que ele eh importado.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param finished Indica se o codigo-fonte ja acabou. Senao, apenas confere
+ * os simbolos ja definidos, sem escrever os operandos.
+ */
+void TCASM_resolve_fixups(TCASM_assembler_t* asm_ptr, bool finished) {
+  TCASM_stats_phase_t phase = TCASM_stats_enter(TCASM_STATS_PHASE_RESOLVE);
+  const TCASM_symbol_table_t* symbols = &asm_ptr->symbols;
+  const TCASM_fixup_t* error = NULL;
+  const char* message = NULL;
+  uint32_t undefined = 0;
+  unsigned int undefined_line = 0;
+  asm_ptr->fixups_unchecked = false;
+  TCASM_PROBE2(symbol_resolve, asm_ptr->code_size, asm_ptr->fixups_size);
+  
+  for (size_t i = 0; i < asm_ptr->fixups_size; ++i) {
+    const TCASM_fixup_t* fixup = &asm_ptr->fixups[i];
+    uint32_t symbol = fixup->symbol;
+    if (symbols->line[symbol] == 0) {
+      if (undefined == 0 || symbol < undefined) {
+        undefined = symbol;
+        undefined_line = fixup->line;
+      }
+      continue;
+    }
+    
+    const char* check = NULL;
+    if (symbols->type[symbol] == TCASM_SYMBOL_ADDRESS_CONST) {
+      if (fixup->use == TCASM_OBJECT_USE_WRITE)
+        check = "Escrita em memoria reservada para armazenamento de constante";
+      else if (fixup->use == TCASM_OBJECT_USE_DIV && asm_ptr->code[symbols->addr[symbol]] == 0)
+        check = "Divisao por constante inicializada com valor zero";
+    }
+    else if (symbols->type[symbol] == TCASM_SYMBOL_ADDRESS_ARRAY && fixup->offset >= symbols->value[symbol])
+      check = "Acesso a posicao invalida do vetor";
+    
+    if (check == NULL) {
+      if (finished)
+        asm_ptr->code[fixup->addr] = (uint16_t) (symbols->addr[symbol] + fixup->offset);
+    }
+    else if (error == NULL || symbols->addr[symbol] < symbols->addr[error->symbol]) {
+      error = fixup;
+      message = check;
+    }
+  }
+  
+  if (error != NULL) {
+    unsigned int line = symbols->line[error->symbol];
+    size_t size = 0;
+    for (size_t i = 0; i < asm_ptr->diagnostics_size; ++i) {
+      if (asm_ptr->diagnostics[i].line != TCASM_DIAGNOSTIC_NO_LINE && asm_ptr->diagnostics[i].line > line)
+        free(asm_ptr->diagnostics[i].message);
+      else
+        asm_ptr->diagnostics[size++] = asm_ptr->diagnostics[i];
+    }
+    asm_ptr->diagnostics_size = size;
+    TCASM_error(asm_ptr, error->line, "%s", message);
+  }
   
-  TCASM_hashtable_node_t* node;
-  TCASM_symbol_t* sym;
-  while (TCASM_reflist.size != 0) {
-    node = (TCASM_hashtable_node_t*) ((TCASM_reflist_node_t*) TCASM_reflist.first->value)->sym;
-    sym = (TCASM_symbol_t*) node->value;
-    switch (sym->type) {
+  if (finished && undefined != 0 && !asm_ptr->relocatable) {
+    const char* name = TCASM_symbol_name(symbols, undefined);
+    switch (symbols->type[undefined]) {
       case TCASM_SYMBOL_ADDRESS_TEXT:
-        if (sym->sym_union.text.ref_list.size != 0) {
-          fprintf(stderr, "Erro linha %u: Rotulo '%s' indefinido\n", ((TCASM_symbol_address_reflist_t*) sym->sym_union.text.ref_list.first->value)->line, node->key);
-          exit(EXIT_FAILURE);
-        }
-        break;
+        TCASM_error(asm_ptr, undefined_line, "Rotulo '%s' indefinido", name);
         
       case TCASM_SYMBOL_ADDRESS_VAR:
-        if (sym->sym_union.var.ref_list.size != 0) {
-          fprintf(stderr, "Erro linha %u: Variavel '%s' indefinida\n", ((TCASM_symbol_address_reflist_t*) sym->sym_union.var.ref_list.first->value)->line, node->key);
-          exit(EXIT_FAILURE);
-        }
-        break;
+        TCASM_error(asm_ptr, undefined_line, "Variavel '%s' indefinida", name);
         
       case TCASM_SYMBOL_ADDRESS_CONST:
-        if (sym->sym_union.constant.ref_list.size != 0) {
-          fprintf(stderr, "Erro linha %u: Constante '%s' indefinida\n", ((TCASM_symbol_address_reflist_t*) sym->sym_union.constant.ref_list.first->value)->line, node->key);
-          exit(EXIT_FAILURE);
-        }
-        break;
+        TCASM_error(asm_ptr, undefined_line, "Constante '%s' indefinida", name);
         
       case TCASM_SYMBOL_ADDRESS_ARRAY:
-        if (sym->sym_union.array.ref_list.size != 0) {
-          fprintf(stderr, "Erro linha %u: Vetor '%s' indefinido\n", ((TCASM_symbol_address_array_reflist_t*) sym->sym_union.varconst.ref_list.first->value)->line, node->key);
-          exit(EXIT_FAILURE);
-        }
-        break;
+        TCASM_error(asm_ptr, undefined_line, "Vetor '%s' indefinido", name);
         
       default:
         break;
     }
-    free(TCASM_reflist.first->value);
-    TCASM_list_erase(&TCASM_reflist, TCASM_reflist.first);
   }
+  TCASM_stats_leave(phase);
+}
+
+/**
+ * Funcao para inserir um dado na lista de dados, guardando a sentenca que o
+ * declarou para o mapa de enderecos. Um dado normal eh o simbolo
+ * asm_ptr->symbol_id.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param anonymous Indica se eh um dado anonimo.
+ * @param type Tipo do dado.
+ * @param value Valor da constante ou tamanho do vetor.
+ */
+void TCASM_datalist_insert(TCASM_assembler_t* asm_ptr, bool anonymous, TCASM_symbol_type_t type, uint16_t value) {
+  TCASM_datalist_node_t tmp;
+  tmp.anonymous = anonymous;
+  tmp.sym = anonymous ? 0 : asm_ptr->symbol_id;
+  tmp.type = type;
+  tmp.value = value;
+  tmp.line = asm_ptr->statement_line;
+  tmp.col = asm_ptr->statement_column;
+  tmp.map_symbol = anonymous ? 0 : TCASM_map_symbol(&asm_ptr->map, asm_ptr->word, asm_ptr->symbol_size, 0, TCASM_MAP_KIND_DATA);
+  TCASM_list_insert(&asm_ptr->datalist, NULL, &tmp);
 }
 
 /**
- * Funcao para procurar uma referencia que nao foi resolvida e acusar erro,
- * apenas quando a secao de dados vem DEPOIS da secao de texto no codigo-fonte.
+ * Funcao para registrar no mapa de enderecos as palavras montadas durante o
+ * tratamento de um char. Palavras de instrucao ficam com a coluna do simbolo
+ * que as gerou; palavras de dados, com a coluna da sentenca.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param state Estado em que as palavras foram montadas.
+ * @param first Endereco da primeira palavra montada.
  */
-void TCASM_dump_reflist_dataafter() {
-  if (TCASM_reflist.size == 0)
-    return;
-  
-  TCASM_hashtable_node_t* node;
-  TCASM_symbol_t* sym;
-  while (TCASM_reflist.size != 0) {
-    node = (TCASM_hashtable_node_t*) ((TCASM_reflist_node_t*) TCASM_reflist.first->value)->sym;
-    sym = (TCASM_symbol_t*) node->value;
-    switch (sym->type) {
-      case TCASM_SYMBOL_ADDRESS_TEXT:
-        if (sym->sym_union.text.ref_list.size != 0) {
-          fprintf(stderr, "Erro linha %u: Rotulo '%s' indefinido\n", ((TCASM_symbol_address_reflist_t*) sym->sym_union.text.ref_list.first->value)->line, node->key);
-          exit(EXIT_FAILURE);
-        }
-        break;
-        
-      case TCASM_SYMBOL_ADDRESS_VAR:
-        if (sym->sym_union.varconst.ref_list.size != 0) {
-          fprintf(stderr, "Erro linha %u: Variavel '%s' indefinida\n", ((TCASM_symbol_address_varconst_reflist_t*) sym->sym_union.varconst.ref_list.first->value)->line, node->key);
-          exit(EXIT_FAILURE);
-        }
-        break;
-        
-      case TCASM_SYMBOL_ADDRESS_CONST:
-        if (sym->sym_union.varconst.ref_list.size != 0) {
-          fprintf(stderr, "Erro linha %u: Constante '%s' indefinida\n", ((TCASM_symbol_address_varconst_reflist_t*) sym->sym_union.varconst.ref_list.first->value)->line, node->key);
-          exit(EXIT_FAILURE);
-        }
-        break;
-        
-      case TCASM_SYMBOL_ADDRESS_ARRAY:
-        if (sym->sym_union.array.ref_list.size != 0) {
-          fprintf(stderr, "Erro linha %u: Vetor '%s' indefinido\n", ((TCASM_symbol_address_array_reflist_t*) sym->sym_union.varconst.ref_list.first->value)->line, node->key);
-          exit(EXIT_FAILURE);
-        }
-        break;
-        
-      default:
-        break;
-    }
-    free(TCASM_reflist.first->value);
-    TCASM_list_erase(&TCASM_reflist, TCASM_reflist.first);
+void TCASM_map_statement(TCASM_assembler_t* asm_ptr, TCASM_state_t state, size_t first) {
+  size_t count = asm_ptr->code_size - first;
+  switch (state) {
+    case TCASM_STATE_TEXT_STATEMENT:
+    case TCASM_STATE_TEXT:
+      TCASM_map_words(&asm_ptr->map, first, count, asm_ptr->statement_line, asm_ptr->column, TCASM_MAP_KIND_OPCODE);
+      break;
+      
+    case TCASM_STATE_REGULAR:
+    case TCASM_STATE_BRANCH:
+    case TCASM_STATE_COPY:
+      TCASM_map_words(&asm_ptr->map, first, count, asm_ptr->statement_line, asm_ptr->column, TCASM_MAP_KIND_OPERAND);
+      break;
+      
+    default:
+      TCASM_map_words(&asm_ptr->map, first, count, asm_ptr->statement_line, asm_ptr->statement_column, TCASM_MAP_KIND_DATA);
+      break;
   }
 }
 
+/**
+ * Funcao para registrar o operando que esta sendo montado (em code_size),
+ * que referencia o simbolo asm_ptr->symbol_id, na tabela de operandos. O
+ * operando so eh escrito por TCASM_resolve_fixups.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param offset Posicao no vetor, ou 0.
+ */
+void TCASM_record_fixup(TCASM_assembler_t* asm_ptr, uint16_t offset) {
+  TCASM_reserve_fixups(asm_ptr, asm_ptr->fixups_size + 1);
+  TCASM_fixup_t* fixup = &asm_ptr->fixups[asm_ptr->fixups_size++];
+  fixup->addr = (uint32_t) asm_ptr->code_size;
+  fixup->symbol = asm_ptr->symbol_id;
+  fixup->line = asm_ptr->statement_line;
+  fixup->offset = offset;
+  
+  // as conferencias com constantes dependem do uso do operando (o ligador
+  // refaz as mesmas com os simbolos importados)
+  if (asm_ptr->state == TCASM_STATE_BRANCH)
+    fixup->use = TCASM_OBJECT_USE_BRANCH;
+  else if (asm_ptr->opcode == TCASM_SYMBOL_INSTRUCTION_OPCODE_STORE || asm_ptr->opcode == TCASM_SYMBOL_INSTRUCTION_OPCODE_INPUT || (asm_ptr->opcode == TCASM_SYMBOL_INSTRUCTION_OPCODE_COPY && asm_ptr->second_op))
+    fixup->use = TCASM_OBJECT_USE_WRITE;
+  else if (asm_ptr->opcode == TCASM_SYMBOL_INSTRUCTION_OPCODE_DIV)
+    fixup->use = TCASM_OBJECT_USE_DIV;
+  else
+    fixup->use = TCASM_OBJECT_USE_READ;
+}
+
 /**
  * Funcao para criar um espaco anonimo quando a secao de dados vem ANTES da
  * secao de texto no codigo-fonte.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_create_anonymous_data_databefore() {
-  if (TCASM_read_char()) {
-    fseek(TCASM_fin, -1, SEEK_CUR); // devolve o ultimo char valido lido
+void TCASM_create_anonymous_data_databefore(TCASM_assembler_t* asm_ptr) {
+  if (TCASM_read_char(asm_ptr)) {
+    --asm_ptr->cursor; // devolve o ultimo char valido lido
     
-    if (TCASM_symbol->type == TCASM_SYMBOL_DIRECTIVE_SPACE) {
+    if (asm_ptr->symbols.type[asm_ptr->symbol_id] == TCASM_SYMBOL_DIRECTIVE_SPACE) {
       // variavel
-      if (TCASM_read_lines > 0) {
-        ++TCASM_data_size;
-        TCASM_datalist_node_t tmp;
-        tmp.anonymous = true;
-        tmp.sym = (TCASM_symbol_t*) malloc(sizeof(TCASM_symbol_t));
-        tmp.sym->type = TCASM_SYMBOL_ADDRESS_VAR;
-        TCASM_list_insert(&TCASM_datalist, NULL, &tmp);
+      if (asm_ptr->read_lines > 0) {
+        ++asm_ptr->data_size;
+        TCASM_datalist_insert(asm_ptr, true, TCASM_SYMBOL_ADDRESS_VAR, 0);
         return;
       }
       // vetor
       else {
         int i;
-        if (fscanf(TCASM_fin, "%i", &i) == 1) {
-          if (TCASM_data_size + i > 65536) {
-            fprintf(stderr, "Erro linha %u: Memoria estourada\n", TCASM_statement_line);
-            exit(EXIT_FAILURE);
-          }
+        if (TCASM_read_int(asm_ptr, &i)) {
+          if (asm_ptr->data_size + i > 65536)
+            TCASM_error(asm_ptr, asm_ptr->statement_line, "Memoria estourada");
           
           if (i > 0) {
-            TCASM_data_size += i;
-            TCASM_datalist_node_t tmp;
-            tmp.anonymous = true;
-            tmp.sym = (TCASM_symbol_t*) malloc(sizeof(TCASM_symbol_t));
-            tmp.sym->type = TCASM_SYMBOL_ADDRESS_ARRAY;
-            tmp.sym->sym_union.array.size = i;
-            TCASM_list_insert(&TCASM_datalist, NULL, &tmp);
+            asm_ptr->data_size += i;
+            TCASM_datalist_insert(asm_ptr, true, TCASM_SYMBOL_ADDRESS_ARRAY, i);
             return;
           }
         }
         
-        // if (fscanf(TCASM_fin, "%i", &i) != 1 || (fscanf(TCASM_fin, "%i", &i) == 1 && i <= 0))
-        fprintf(stderr, "Erro linha %u: Tamanho invalido para vetor\n", TCASM_statement_line);
-        exit(EXIT_FAILURE);
+        // if (!TCASM_read_int(asm_ptr, &i) || (TCASM_read_int(asm_ptr, &i) && i <= 0))
+        TCASM_error(asm_ptr, asm_ptr->statement_line, "Tamanho invalido para vetor");
       }
     }
     // constante
     else {
-      TCASM_check_same_line();
+      TCASM_check_same_line(asm_ptr);
       
       // tenta ler um inteiro de 16 bits com sinal
       int i;
-      if (fscanf(TCASM_fin, "%i", &i) == 1) {
-        if (i < -32768 || i > 32767) {
-          fprintf(stderr, "Erro linha %u: Constante invalida\n", TCASM_statement_line);
-          exit(EXIT_FAILURE);
-        }
+      if (TCASM_read_int(asm_ptr, &i)) {
+        if (i < -32768 || i > 32767)
+          TCASM_error(asm_ptr, asm_ptr->statement_line, "Constante invalida");
         
-        ++TCASM_data_size;
-        TCASM_datalist_node_t tmp;
-        tmp.anonymous = true;
-        tmp.sym = (TCASM_symbol_t*) malloc(sizeof(TCASM_symbol_t));
-        tmp.sym->type = TCASM_SYMBOL_ADDRESS_CONST;
-        tmp.sym->sym_union.constant.value = i;
-        TCASM_list_insert(&TCASM_datalist, NULL, &tmp);
+        ++asm_ptr->data_size;
+        TCASM_datalist_insert(asm_ptr, true, TCASM_SYMBOL_ADDRESS_CONST, i);
         return;
       }
       
-      // if (fscanf(TCASM_fin, "%i", &i) != 1)
-      fprintf(stderr, "Erro linha %u: Constante invalida\n", TCASM_statement_line);
-      exit(EXIT_FAILURE);
+      // if (!TCASM_read_int(asm_ptr, &i))
+      TCASM_error(asm_ptr, asm_ptr->statement_line, "Constante invalida");
     }
   }
   
-  // if (!TCASM_read_char())
-  fprintf(stderr, "Erro: Arquivo fonte sem nenhuma instrucao\n");
-  exit(EXIT_FAILURE);
+  // if (!TCASM_read_char(asm_ptr))
+  TCASM_error(asm_ptr, TCASM_DIAGNOSTIC_NO_LINE, "Arquivo fonte sem nenhuma instrucao");
 }
 
 /**
  * Funcao para criar um espaco anonimo quando a secao de dados vem DEPOIS da
  * secao de texto no codigo-fonte.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_create_anonymous_data_dataafter() {
-  if (TCASM_read_char()) {
-    fseek(TCASM_fin, -1, SEEK_CUR); // devolve o ultimo char valido lido
+void TCASM_create_anonymous_data_dataafter(TCASM_assembler_t* asm_ptr) {
+  if (TCASM_read_char(asm_ptr)) {
+    --asm_ptr->cursor; // devolve o ultimo char valido lido
     
     // variavel ou vetor
-    if (TCASM_symbol->type == TCASM_SYMBOL_DIRECTIVE_SPACE) {
+    if (asm_ptr->symbols.type[asm_ptr->symbol_id] == TCASM_SYMBOL_DIRECTIVE_SPACE) {
       // variavel
-      if (TCASM_read_lines > 0) {
-        TCASM_assembled_code[TCASM_assembled_code_size++] = 0;
+      if (asm_ptr->read_lines > 0) {
+        asm_ptr->code[asm_ptr->code_size++] = 0;
         return;
       }
       // vetor
       else {
         int i;
-        if (fscanf(TCASM_fin, "%i", &i) == 1) {
-          if (TCASM_assembled_code_size + i > 65536) {
-            fprintf(stderr, "Erro linha %u: Memoria estourada\n", TCASM_statement_line);
-            exit(EXIT_FAILURE);
-          }
+        if (TCASM_read_int(asm_ptr, &i)) {
+          if (asm_ptr->code_size + i > 65536)
+            TCASM_error(asm_ptr, asm_ptr->statement_line, "Memoria estourada");
           
           if (i > 0) {
-            TCASM_write_uint16_zeroarray(TCASM_assembled_code, TCASM_assembled_code_size, i);
-            TCASM_assembled_code_size += i;
+            TCASM_write_uint16_zeroarray(asm_ptr->code, asm_ptr->code_size, i);
+            asm_ptr->code_size += i;
             return;
           }
         }
         
-        // if (fscanf(TCASM_fin, "%i", &i) != 1 || (fscanf(TCASM_fin, "%i", &i) == 1 && i <= 0))
-        fprintf(stderr, "Erro linha %u: Tamanho invalido para vetor\n", TCASM_statement_line);
-        exit(EXIT_FAILURE);
+        // if (!TCASM_read_int(asm_ptr, &i) || (TCASM_read_int(asm_ptr, &i) && i <= 0))
+        TCASM_error(asm_ptr, asm_ptr->statement_line, "Tamanho invalido para vetor");
       }
     }
     // constante
     else {
-      TCASM_check_same_line();
+      TCASM_check_same_line(asm_ptr);
       
       // tenta ler um inteiro de 16 bits com sinal
       int i;
-      if (fscanf(TCASM_fin, "%i", &i) == 1) {
-        if (i < -32768 || i > 32767) {
-          fprintf(stderr, "Erro linha %u: Constante invalida\n", TCASM_statement_line);
-          exit(EXIT_FAILURE);
-        }
+      if (TCASM_read_int(asm_ptr, &i)) {
+        if (i < -32768 || i > 32767)
+          TCASM_error(asm_ptr, asm_ptr->statement_line, "Constante invalida");
         
-        TCASM_assembled_code[TCASM_assembled_code_size++] = i;
+        asm_ptr->code[asm_ptr->code_size++] = i;
         return;
       }
       
-      // if (fscanf(TCASM_fin, "%i", &i) != 1)
-      fprintf(stderr, "Erro linha %u: Constante invalida\n", TCASM_statement_line);
-      exit(EXIT_FAILURE);
+      // if (!TCASM_read_int(asm_ptr, &i))
+      TCASM_error(asm_ptr, asm_ptr->statement_line, "Constante invalida");
     }
   }
   // variavel
-  else if (TCASM_symbol->type == TCASM_SYMBOL_DIRECTIVE_SPACE) {
-    TCASM_assembled_code[TCASM_assembled_code_size++] = 0;
+  else if (asm_ptr->symbols.type[asm_ptr->symbol_id] == TCASM_SYMBOL_DIRECTIVE_SPACE) {
+    asm_ptr->code[asm_ptr->code_size++] = 0;
     return;
   }
   
-  // if (!TCASM_read_char() || TCASM_symbol->type != TCASM_SYMBOL_DIRECTIVE_SPACE)
-  fprintf(stderr, "Erro linha %u: Sentenca invalida\n", TCASM_statement_line);
-  exit(EXIT_FAILURE);
+  // if (!TCASM_read_char(asm_ptr) || asm_ptr->symbols.type[asm_ptr->symbol_id] != TCASM_SYMBOL_DIRECTIVE_SPACE)
+  TCASM_error(asm_ptr, asm_ptr->statement_line, "Sentenca invalida");
 }
 
 /**
  * Funcao para decidir o proximo estado da maquina de acordo com a instrucao
  * que esta sendo montada.
- */
-void TCASM_decode_instruction() {
-  TCASM_opcode = TCASM_symbol->sym_union.instr.opcode;
-  TCASM_assembled_code[TCASM_assembled_code_size++] = TCASM_opcode;
-  
-  if (TCASM_opcode >= TCASM_SYMBOL_INSTRUCTION_OPCODE_JMP && TCASM_opcode <= TCASM_SYMBOL_INSTRUCTION_OPCODE_JMPZ)
-    TCASM_state = TCASM_STATE_BRANCH;
-  else if (TCASM_opcode == TCASM_SYMBOL_INSTRUCTION_OPCODE_COPY)
-    TCASM_state = TCASM_STATE_COPY;
-  else if (TCASM_opcode != TCASM_SYMBOL_INSTRUCTION_OPCODE_STOP)
-    TCASM_state = TCASM_STATE_REGULAR;
+ * @param asm_ptr Ponteiro do contexto.
+ */
+void TCASM_decode_instruction(TCASM_assembler_t* asm_ptr) {
+  asm_ptr->opcode = asm_ptr->symbols.value[asm_ptr->symbol_id];
+  asm_ptr->code[asm_ptr->code_size++] = asm_ptr->opcode;
+  
+  if (asm_ptr->opcode >= TCASM_SYMBOL_INSTRUCTION_OPCODE_JMP && asm_ptr->opcode <= TCASM_SYMBOL_INSTRUCTION_OPCODE_JMPZ)
+    asm_ptr->state = TCASM_STATE_BRANCH;
+  else if (asm_ptr->opcode == TCASM_SYMBOL_INSTRUCTION_OPCODE_COPY)
+    asm_ptr->state = TCASM_STATE_COPY;
+  else if (asm_ptr->opcode != TCASM_SYMBOL_INSTRUCTION_OPCODE_STOP)
+    asm_ptr->state = TCASM_STATE_REGULAR;
   else
-    TCASM_state = TCASM_STATE_TEXT_STATEMENT;
+    asm_ptr->state = TCASM_STATE_TEXT_STATEMENT;
 }
 
 /**
- * Funcao para criar a lista de referencias do simbolo que esta sendo
- * utilizado como operando. Cria uma referencia para a instrucao que esta
- * sendo montada e utiliza este simbolo.
+ * Funcao para registrar a primeira referencia ao simbolo que esta sendo
+ * utilizado como operando. O tipo do simbolo (variavel ou vetor) sai da
+ * sintaxe da referencia.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_state_regular_create_ref_list() {
-  TCASM_assembled_code[TCASM_assembled_code_size] = 0;
+void TCASM_state_regular_create_ref(TCASM_assembler_t* asm_ptr) {
+  asm_ptr->code[asm_ptr->code_size] = 0;
   
-  bool read_char = TCASM_read_char();
-  fseek(TCASM_fin, -1, SEEK_CUR); // devolve o ultimo char valido lido
+  bool read_char = TCASM_read_char(asm_ptr);
+  --asm_ptr->cursor; // devolve o ultimo char valido lido
   // variavel ou constante
-  if (!read_char || TCASM_read_lines != 0 || TCASM_char == ',') {
-    TCASM_symbol->type = TCASM_SYMBOL_ADDRESS_VAR;
-    
-    TCASM_symbol_address_varconst_reflist_t tmp;
-    tmp.instr_addr = TCASM_assembled_code_size - (TCASM_second_op ? 2 : 1);
-    tmp.line = TCASM_statement_line;
-    tmp.op_addr = TCASM_assembled_code_size;
-    TCASM_list_init(&TCASM_symbol->sym_union.varconst.ref_list, sizeof(TCASM_symbol_address_varconst_reflist_t));
-    TCASM_list_insert(&TCASM_symbol->sym_union.varconst.ref_list, NULL, &tmp);
+  if (!read_char || asm_ptr->read_lines != 0 || asm_ptr->ch == ',') {
+    asm_ptr->symbols.type[asm_ptr->symbol_id] = TCASM_SYMBOL_ADDRESS_VAR;
+    TCASM_record_fixup(asm_ptr, 0);
   }
   // vetor
   else {
-    TCASM_symbol->type = TCASM_SYMBOL_ADDRESS_ARRAY;
+    asm_ptr->symbols.type[asm_ptr->symbol_id] = TCASM_SYMBOL_ADDRESS_ARRAY;
     
-    if (!TCASM_read_char()) {
-      fprintf(stderr, "Erro linha %u: Indice invalido de vetor\n", TCASM_statement_line);
-      exit(EXIT_FAILURE);
-    }
-    TCASM_check_same_line();
+    if (!TCASM_read_char(asm_ptr))
+      TCASM_error(asm_ptr, asm_ptr->statement_line, "Indice invalido de vetor");
+    TCASM_check_same_line(asm_ptr);
     
-    TCASM_symbol_address_array_reflist_t tmp;
-    tmp.addr = TCASM_assembled_code_size;
-    tmp.line = TCASM_statement_line;
-    tmp.offset = TCASM_read_array_ref();
-    TCASM_list_init(&TCASM_symbol->sym_union.array.ref_list, sizeof(TCASM_symbol_address_array_reflist_t));
-    TCASM_list_insert(&TCASM_symbol->sym_union.array.ref_list, NULL, &tmp);
+    TCASM_record_fixup(asm_ptr, (uint16_t) TCASM_read_array_ref(asm_ptr));
   }
   
-  // inserindo na lista de elementos com referencias pendentes
-  TCASM_reflist_node_t tmp;
-  tmp.sym = TCASM_hashnode;
-  TCASM_list_insert(&TCASM_reflist, NULL, &tmp);
-  
-  TCASM_assembled_code_size++;
+  asm_ptr->code_size++;
 }
 
 /**
  * Funcao para adicionar uma referencia ao simbolo que acabou de ser lido
  * para ser usado como operando.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_state_regular_add_ref() {
-  switch (TCASM_symbol->type) {
-    case TCASM_SYMBOL_ADDRESS_VAR:
-      // secao de dados ANTES usa a struct TCASM_symbol_address_var_t
-      if (TCASM_data_read) {
-        TCASM_symbol_address_reflist_t tmp;
-        tmp.addr = TCASM_assembled_code_size;
-        tmp.line = TCASM_statement_line;
-        TCASM_list_insert(&TCASM_symbol->sym_union.var.ref_list, NULL, &tmp);
-      }
-      // secao de dados DEPOIS usa a struct TCASM_symbol_address_varconst_t
-      else {
-        TCASM_symbol_address_varconst_reflist_t tmp;
-        tmp.instr_addr = TCASM_assembled_code_size - (TCASM_second_op ? 2 : 1);
-        tmp.line = TCASM_statement_line;
-        tmp.op_addr = TCASM_assembled_code_size;
-        TCASM_list_insert(&TCASM_symbol->sym_union.varconst.ref_list, NULL, &tmp);
-      }
-      break;
+void TCASM_state_regular_add_ref(TCASM_assembler_t* asm_ptr) {
+  uint16_t offset = 0;
       
-    case TCASM_SYMBOL_ADDRESS_CONST:
-      // sabendo que o tipo eh CONST, sabe-se que a secao de dados veio ANTES.
-      // portanto, usa-se a struct TCASM_symbol_address_const_t
-      {
-        TCASM_symbol_address_reflist_t tmp;
-        tmp.addr = TCASM_assembled_code_size;
-        tmp.line = TCASM_statement_line;
-        TCASM_list_insert(&TCASM_symbol->sym_union.constant.ref_list, NULL, &tmp);
-      }
-      break;
+  // vetores tem a posicao depois do nome
+  if (asm_ptr->symbols.type[asm_ptr->symbol_id] == TCASM_SYMBOL_ADDRESS_ARRAY) {
+    if (!TCASM_read_char(asm_ptr))
+      TCASM_error(asm_ptr, asm_ptr->statement_line, "Indice invalido de vetor");
+    TCASM_check_same_line(asm_ptr);
       
-    case TCASM_SYMBOL_ADDRESS_ARRAY:
-      // vetores possuem apenas uma struct
-      {
-        if (!TCASM_read_char()) {
-          fprintf(stderr, "Erro linha %u: Indice invalido de vetor\n", TCASM_statement_line);
-          exit(EXIT_FAILURE);
-        }
-        TCASM_check_same_line();
-        
-        TCASM_symbol_address_array_reflist_t tmp;
-        tmp.addr = TCASM_assembled_code_size;
-        tmp.line = TCASM_statement_line;
-        tmp.offset = TCASM_read_array_ref();
-        TCASM_list_insert(&TCASM_symbol->sym_union.array.ref_list, NULL, &tmp);
-      }
-      break;
-      
-    default:
-      break;
+    offset = (uint16_t) TCASM_read_array_ref(asm_ptr);
   }
   
-  TCASM_assembled_code_size++;
+  TCASM_record_fixup(asm_ptr, offset);
+  asm_ptr->code_size++;
 }
 
 /**
  * Funcao para tratar o ultimo char lido no estado TCASM_STATE_SECTION.
  * Neste estado, a maquina esta esperando para ler a palavra chave SECTION.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_handle_state_section() {
-  // nao reclame! eh otimizacao
-  if (TCASM_char == 'S') {
-    TCASM_char = fgetc(TCASM_fin);
-    if (TCASM_char == 'E' || TCASM_char == 'e') {
-      TCASM_char = fgetc(TCASM_fin);
-      if (TCASM_char == 'C' || TCASM_char == 'c') {
-        TCASM_char = fgetc(TCASM_fin);
-        if (TCASM_char == 'T' || TCASM_char == 't') {
-          TCASM_char = fgetc(TCASM_fin);
-          if (TCASM_char == 'I' || TCASM_char == 'i') {
-            TCASM_char = fgetc(TCASM_fin);
-            if (TCASM_char == 'O' || TCASM_char == 'o') {
-              TCASM_char = fgetc(TCASM_fin);
-              if (!feof(TCASM_fin) && (TCASM_char == 'N' || TCASM_char == 'n')) {
-                TCASM_state = TCASM_STATE_SECTION_TYPE;
-                return;
-              }
-            }
-          }
-        }
-      }
-    }
+void TCASM_handle_state_section(TCASM_assembler_t* asm_ptr) {
+  if (asm_ptr->ch == 'S' && TCASM_read_keyword(asm_ptr, "ECTION", 6)) {
+    asm_ptr->state = TCASM_STATE_SECTION_TYPE;
+    return;
   }
   
-  // if (feof(TCASM_fin) || word != "SECTION")
-  fprintf(stderr, "Erro linha %u: O arquivo fonte deve iniciar com uma diretiva SECTION\n", TCASM_statement_line);
-  exit(EXIT_FAILURE);
+  // if (word != "SECTION")
+  TCASM_error(asm_ptr, asm_ptr->statement_line, "O arquivo fonte deve iniciar com uma diretiva SECTION");
 }
 
 /**
  * Funcao para tratar o ultimo char lido no estado TCASM_STATE_SECTION_TYPE.
  * Neste estado, a maquina esta esperando para ler a palavra chave TEXT, ou
  * a palavra chave DATA.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_handle_state_section_type() {
-  TCASM_check_same_line();
-  TCASM_check_new_column();
-  
-  // nao reclame! eh otimizacao
-  if (TCASM_char == 'T') {
-    TCASM_char = fgetc(TCASM_fin);
-    if (TCASM_char == 'E' || TCASM_char == 'e') {
-      TCASM_char = fgetc(TCASM_fin);
-      if (TCASM_char == 'X' || TCASM_char == 'x') {
-        TCASM_char = fgetc(TCASM_fin);
-        if (!feof(TCASM_fin) && (TCASM_char == 'T' || TCASM_char == 't')) {
-          if (TCASM_text_read) {
-            fprintf(stderr, "Erro linha %u: Secao de texto ja iniciada anteriormente\n", TCASM_statement_line);
-            exit(EXIT_FAILURE);
-          }
-          
-          TCASM_text_read = true;
-          TCASM_state = TCASM_STATE_TEXT_STATEMENT;
-          return;
-        }
-      }
-    }
+void TCASM_handle_state_section_type(TCASM_assembler_t* asm_ptr) {
+  TCASM_check_same_line(asm_ptr);
+  TCASM_check_new_column(asm_ptr);
+  
+  if (asm_ptr->ch == 'T' && TCASM_read_keyword(asm_ptr, "EXT", 3)) {
+    if (asm_ptr->text_read)
+      TCASM_error(asm_ptr, asm_ptr->statement_line, "Secao de texto ja iniciada anteriormente");
+    
+    asm_ptr->text_read = true;
+    asm_ptr->state = TCASM_STATE_TEXT_STATEMENT;
+    return;
   }
   
-  // nao reclame! eh otimizacao
-  if (TCASM_char == 'D') {
-    TCASM_char = fgetc(TCASM_fin);
-    if (TCASM_char == 'A' || TCASM_char == 'a') {
-      TCASM_char = fgetc(TCASM_fin);
-      if (TCASM_char == 'T' || TCASM_char == 't') {
-        TCASM_char = fgetc(TCASM_fin);
-        if (!feof(TCASM_fin) && (TCASM_char == 'A' || TCASM_char == 'a')) {
-          if (TCASM_data_read) {
-            fprintf(stderr, "Erro linha %u: Secao de dados ja iniciada anteriormente\n", TCASM_statement_line);
-            exit(EXIT_FAILURE);
-          }
-          
-          TCASM_data_read = true;
-          TCASM_state = !TCASM_text_read ? TCASM_STATE_DATA_STATEMENT_DATABEFORE : TCASM_STATE_DATA_STATEMENT_DATAAFTER;
-          return;
-        }
-      }
-    }
+  if (asm_ptr->ch == 'D' && TCASM_read_keyword(asm_ptr, "ATA", 3)) {
+    if (asm_ptr->data_read)
+      TCASM_error(asm_ptr, asm_ptr->statement_line, "Secao de dados ja iniciada anteriormente");
+    
+    asm_ptr->data_read = true;
+    if (asm_ptr->text_read)
+      asm_ptr->text_size = asm_ptr->code_size;
+    asm_ptr->state = !asm_ptr->text_read ? TCASM_STATE_DATA_STATEMENT_DATABEFORE : TCASM_STATE_DATA_STATEMENT_DATAAFTER;
+    return;
   }
   
-  // if (feof(TCASM_fin) || (section_type != "TEXT" && section_type != "DATA"))
-  fprintf(stderr, "Erro linha %u: Os tipos de secao permitidos sao TEXT e DATA\n", TCASM_statement_line);
-  exit(EXIT_FAILURE);
+  // if (section_type != "TEXT" && section_type != "DATA")
+  TCASM_error(asm_ptr, asm_ptr->statement_line, "Os tipos de secao permitidos sao TEXT e DATA");
 }
 
 /**
@@ -1293,59 +1512,55 @@ void TCASM_handle_state_section_type() {
  * Neste estado, a maquina esta esperando para ler uma instrucao, ou
  * um identificador, ou a diretiva SECTION se a secao de dados ainda nao foi
  * declarada.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_handle_state_text_statement() {
+void TCASM_handle_state_text_statement(TCASM_assembler_t* asm_ptr) {
   bool created;
   
-  TCASM_check_new_line();
+  TCASM_check_new_line(asm_ptr);
   
-  TCASM_read_symbol();
-  TCASM_symbol = (TCASM_symbol_t*) TCASM_hashtable_get(&TCASM_symbol_table, TCASM_word, &created);
+  TCASM_read_symbol(asm_ptr);
+  TCASM_lookup_symbol(asm_ptr, &created);
   
   // criando e definindo um rotulo
   if (created) {
-    TCASM_read_colon();
-    TCASM_symbol->type = TCASM_SYMBOL_ADDRESS_TEXT;
-    TCASM_symbol->sym_union.text.addr = TCASM_assembled_code_size;
-    TCASM_list_init(&TCASM_symbol->sym_union.text.ref_list, sizeof(TCASM_symbol_address_reflist_t)); // apenas para dizer que a lista esta vazia
-    TCASM_state = TCASM_STATE_TEXT;
+    TCASM_read_colon(asm_ptr);
+    asm_ptr->symbols.type[asm_ptr->symbol_id] = TCASM_SYMBOL_ADDRESS_TEXT;
+    asm_ptr->symbols.addr[asm_ptr->symbol_id] = asm_ptr->code_size;
+    asm_ptr->symbols.line[asm_ptr->symbol_id] = asm_ptr->statement_line;
+    TCASM_map_symbol(&asm_ptr->map, asm_ptr->word, asm_ptr->symbol_size, asm_ptr->code_size, TCASM_MAP_KIND_LABEL);
+    asm_ptr->state = TCASM_STATE_TEXT;
     return;
   }
   // definindo um rotulo
-  else if (TCASM_symbol->type == TCASM_SYMBOL_ADDRESS_TEXT) {
-    TCASM_read_colon();
-    if (TCASM_symbol->sym_union.text.ref_list.size == 0) {
-      fprintf(stderr, "Erro linha %u: Redefinindo identificador\n", TCASM_statement_line);
-      exit(EXIT_FAILURE);
-    }
-    TCASM_symbol->sym_union.text.addr = TCASM_assembled_code_size;
-    TCASM_dump_text_reflist();
-    TCASM_state = TCASM_STATE_TEXT;
+  else if (asm_ptr->symbols.type[asm_ptr->symbol_id] == TCASM_SYMBOL_ADDRESS_TEXT) {
+    TCASM_read_colon(asm_ptr);
+    if (asm_ptr->symbols.line[asm_ptr->symbol_id] != 0)
+      TCASM_error(asm_ptr, asm_ptr->statement_line, "Redefinindo identificador");
+    asm_ptr->symbols.addr[asm_ptr->symbol_id] = asm_ptr->code_size;
+    asm_ptr->symbols.line[asm_ptr->symbol_id] = asm_ptr->statement_line;
+    TCASM_map_symbol(&asm_ptr->map, asm_ptr->word, asm_ptr->symbol_size, asm_ptr->code_size, TCASM_MAP_KIND_LABEL);
+    asm_ptr->state = TCASM_STATE_TEXT;
     return;
   }
   // leitura de instrucao iniciada
-  else if (TCASM_symbol->type >= TCASM_SYMBOL_INSTRUCTION_REGULAR && TCASM_symbol->type <= TCASM_SYMBOL_INSTRUCTION_STOP) {
-    TCASM_decode_instruction();
+  else if (asm_ptr->symbols.type[asm_ptr->symbol_id] >= TCASM_SYMBOL_INSTRUCTION_REGULAR && asm_ptr->symbols.type[asm_ptr->symbol_id] <= TCASM_SYMBOL_INSTRUCTION_STOP) {
+    TCASM_decode_instruction(asm_ptr);
     return;
   }
   // palavra-chave SECTION
-  else if (TCASM_symbol->type == TCASM_SYMBOL_DIRECTIVE_SECTION) {
-    if (TCASM_data_read) {
-      fprintf(stderr, "Erro linha %u: Ambas as secoes de texto e de dados ja foram iniciadas anteriormente\n", TCASM_statement_line);
-      exit(EXIT_FAILURE);
-    }
-    TCASM_state = TCASM_STATE_SECTION_TYPE;
+  else if (asm_ptr->symbols.type[asm_ptr->symbol_id] == TCASM_SYMBOL_DIRECTIVE_SECTION) {
+    if (asm_ptr->data_read)
+      TCASM_error(asm_ptr, asm_ptr->statement_line, "Ambas as secoes de texto e de dados ja foram iniciadas anteriormente");
+    asm_ptr->state = TCASM_STATE_SECTION_TYPE;
     return;
   }
   // outra palavra-chave
-  else if (TCASM_symbol->type >= TCASM_SYMBOL_DIRECTIVE_SECTION_TYPE && TCASM_symbol->type <= TCASM_SYMBOL_DIRECTIVE_CONST) {
-    fprintf(stderr, "Erro linha %u: Sentenca invalida\n", TCASM_statement_line);
-    exit(EXIT_FAILURE);
-  }
+  else if (asm_ptr->symbols.type[asm_ptr->symbol_id] >= TCASM_SYMBOL_DIRECTIVE_SECTION_TYPE && asm_ptr->symbols.type[asm_ptr->symbol_id] <= TCASM_SYMBOL_DIRECTIVE_CONST)
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Sentenca invalida");
   
-  // if (TCASM_symbol->type == TCASM_SYMBOL_ADDRESS*)
-  fprintf(stderr, "Erro linha %u: Redefinindo identificador\n", TCASM_statement_line);
-  exit(EXIT_FAILURE);
+  // if (asm_ptr->symbols.type[asm_ptr->symbol_id] == TCASM_SYMBOL_ADDRESS*)
+  TCASM_error(asm_ptr, asm_ptr->statement_line, "Redefinindo identificador");
 }
 
 /**
@@ -1353,129 +1568,127 @@ void TCASM_handle_state_text_statement() {
  * TCASM_STATE_DATA_STATEMENT_DATABEFORE.
  * Neste estado, a maquina esta esperando para ler a palavra chave SECTION,
  * um identificador, ou um dado anonimo.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_handle_state_data_statement_databefore() {
+void TCASM_handle_state_data_statement_databefore(TCASM_assembler_t* asm_ptr) {
   bool created;
   
-  TCASM_check_new_line();
+  TCASM_check_new_line(asm_ptr);
   
-  TCASM_read_symbol();
-  TCASM_symbol = (TCASM_symbol_t*) TCASM_hashtable_get(&TCASM_symbol_table, TCASM_word, &created);
+  TCASM_read_symbol(asm_ptr);
+  TCASM_lookup_symbol(asm_ptr, &created);
   
   // memoria estourada
-  if (TCASM_data_size + 1 > 65536) {
-    fprintf(stderr, "Erro linha %u: Memoria estourada\n", TCASM_statement_line);
-    exit(EXIT_FAILURE);
-  }
+  if (asm_ptr->data_size + 1 > 65536)
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Memoria estourada");
   
   // se criou agora nao eh palavra-chave
   if (created) {
-    TCASM_read_colon();
-    TCASM_state = TCASM_STATE_DATA_CREATE_DATABEFORE;
+    TCASM_read_colon(asm_ptr);
+    asm_ptr->state = TCASM_STATE_DATA_CREATE_DATABEFORE;
     return;
   }
   // palavra-chave SECTION
-  else if (TCASM_symbol->type == TCASM_SYMBOL_DIRECTIVE_SECTION) {
-    TCASM_state = TCASM_STATE_SECTION_TYPE;
+  else if (asm_ptr->symbols.type[asm_ptr->symbol_id] == TCASM_SYMBOL_DIRECTIVE_SECTION) {
+    asm_ptr->state = TCASM_STATE_SECTION_TYPE;
     return;
   }
   // espaco anonimo
-  else if (TCASM_symbol->type == TCASM_SYMBOL_DIRECTIVE_SPACE || TCASM_symbol->type == TCASM_SYMBOL_DIRECTIVE_CONST) {
-    TCASM_create_anonymous_data_databefore();
+  else if (asm_ptr->symbols.type[asm_ptr->symbol_id] == TCASM_SYMBOL_DIRECTIVE_SPACE || asm_ptr->symbols.type[asm_ptr->symbol_id] == TCASM_SYMBOL_DIRECTIVE_CONST) {
+    TCASM_create_anonymous_data_databefore(asm_ptr);
     return;
   }
   // outra palavra-chave
-  else if (TCASM_symbol->type <= TCASM_SYMBOL_INSTRUCTION_STOP) {
-    fprintf(stderr, "Erro linha %u: Tentando definir dado com palavra-chave\n", TCASM_statement_line);
-    exit(EXIT_FAILURE);
-  }
+  else if (asm_ptr->symbols.type[asm_ptr->symbol_id] <= TCASM_SYMBOL_INSTRUCTION_STOP)
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Tentando definir dado com palavra-chave");
   
-  // if (TCASM_symbol->type == TCASM_SYMBOL_ADDRESS*)
-  fprintf(stderr, "Erro linha %u: Redefinindo identificador\n", TCASM_statement_line);
-  exit(EXIT_FAILURE);
+  // if (asm_ptr->symbols.type[asm_ptr->symbol_id] == TCASM_SYMBOL_ADDRESS*)
+  TCASM_error(asm_ptr, asm_ptr->statement_line, "Redefinindo identificador");
 }
 
 /**
  * Funcao para tratar o ultimo char lido no estado
  * TCASM_STATE_DATA_STATEMENT_DATAAFTER.
  * Neste estado, a maquina esta esperando para ler um identificador.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_handle_state_data_statement_dataafter() {
+void TCASM_handle_state_data_statement_dataafter(TCASM_assembler_t* asm_ptr) {
   bool created;
   
-  TCASM_check_new_line();
+  TCASM_check_new_line(asm_ptr);
   
-  TCASM_read_symbol();
-  TCASM_symbol = (TCASM_symbol_t*) TCASM_hashtable_get(&TCASM_symbol_table, TCASM_word, &created);
+  TCASM_read_symbol(asm_ptr);
+  TCASM_lookup_symbol(asm_ptr, &created);
   
   // memoria estourada
-  if (TCASM_assembled_code_size + 1 > 65536) {
-    fprintf(stderr, "Erro linha %u: Memoria estourada\n", TCASM_statement_line);
-    exit(EXIT_FAILURE);
-  }
+  if (asm_ptr->code_size + 1 > 65536)
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Memoria estourada");
   
-  // se criou agora nao eh palavra-chave, mas eh declaracao nao utilizada
+  // se criou agora nao eh palavra-chave, mas eh declaracao nao utilizada (no
+  // objeto relocavel, exportada)
   if (created) {
-    fprintf(stderr, "Aviso linha %u: Declaracao '%s' nao utilizada\n", TCASM_statement_line, TCASM_word);
-    TCASM_read_colon();
-    TCASM_state = TCASM_STATE_DATA_CREATE_DATAAFTER;
+    if (!asm_ptr->relocatable)
+      TCASM_warning(asm_ptr, asm_ptr->statement_line, "Declaracao '%.*s' nao utilizada", (int) asm_ptr->symbol_size, asm_ptr->word);
+    TCASM_read_colon(asm_ptr);
+    asm_ptr->symbols.addr[asm_ptr->symbol_id] = asm_ptr->code_size;
+    asm_ptr->symbols.line[asm_ptr->symbol_id] = asm_ptr->statement_line;
+    TCASM_map_symbol(&asm_ptr->map, asm_ptr->word, asm_ptr->symbol_size, asm_ptr->code_size, TCASM_MAP_KIND_DATA);
+    asm_ptr->state = TCASM_STATE_DATA_CREATE_DATAAFTER;
     return;
   }
   // definindo endereco de uma variavel ou constante
-  else if (TCASM_symbol->type == TCASM_SYMBOL_ADDRESS_VAR) {
-    if (TCASM_symbol->sym_union.varconst.ref_list.size > 0) {
-      TCASM_read_colon();
-      TCASM_state = TCASM_STATE_DATA_DEFINE_VARCONST;
+  else if (asm_ptr->symbols.type[asm_ptr->symbol_id] == TCASM_SYMBOL_ADDRESS_VAR) {
+    if (asm_ptr->symbols.line[asm_ptr->symbol_id] == 0) {
+      TCASM_read_colon(asm_ptr);
+      asm_ptr->symbols.addr[asm_ptr->symbol_id] = asm_ptr->code_size;
+      TCASM_map_symbol(&asm_ptr->map, asm_ptr->word, asm_ptr->symbol_size, asm_ptr->code_size, TCASM_MAP_KIND_DATA);
+      asm_ptr->state = TCASM_STATE_DATA_DEFINE_VARCONST;
       return;
     }
   }
   // definindo endereco de um vetor
-  else if (TCASM_symbol->type == TCASM_SYMBOL_ADDRESS_ARRAY) {
-    if (TCASM_symbol->sym_union.array.ref_list.size > 0) {
-      TCASM_read_colon();
-      TCASM_state = TCASM_STATE_DATA_DEFINE_ARRAY;
+  else if (asm_ptr->symbols.type[asm_ptr->symbol_id] == TCASM_SYMBOL_ADDRESS_ARRAY) {
+    if (asm_ptr->symbols.line[asm_ptr->symbol_id] == 0) {
+      TCASM_read_colon(asm_ptr);
+      asm_ptr->symbols.addr[asm_ptr->symbol_id] = asm_ptr->code_size;
+      TCASM_map_symbol(&asm_ptr->map, asm_ptr->word, asm_ptr->symbol_size, asm_ptr->code_size, TCASM_MAP_KIND_DATA);
+      asm_ptr->state = TCASM_STATE_DATA_DEFINE_ARRAY;
       return;
     }
   }
   // espaco anonimo
-  else if (TCASM_symbol->type == TCASM_SYMBOL_DIRECTIVE_SPACE || TCASM_symbol->type == TCASM_SYMBOL_DIRECTIVE_CONST) {
-    TCASM_create_anonymous_data_dataafter();
+  else if (asm_ptr->symbols.type[asm_ptr->symbol_id] == TCASM_SYMBOL_DIRECTIVE_SPACE || asm_ptr->symbols.type[asm_ptr->symbol_id] == TCASM_SYMBOL_DIRECTIVE_CONST) {
+    TCASM_create_anonymous_data_dataafter(asm_ptr);
     return;
   }
   // palavra-chave SECTION
-  else if (TCASM_symbol->type == TCASM_SYMBOL_DIRECTIVE_SECTION) {
-    fprintf(stderr, "Erro linha %u: Ambas as secoes de texto e de dados ja foram iniciadas anteriormente\n", TCASM_statement_line);
-    exit(EXIT_FAILURE);
-  }
+  else if (asm_ptr->symbols.type[asm_ptr->symbol_id] == TCASM_SYMBOL_DIRECTIVE_SECTION)
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Ambas as secoes de texto e de dados ja foram iniciadas anteriormente");
   // outra palavra-chave
-  else if (TCASM_symbol->type <= TCASM_SYMBOL_INSTRUCTION_STOP) {
-    fprintf(stderr, "Erro linha %u: Tentando definir dado com palavra-chave\n", TCASM_statement_line);
-    exit(EXIT_FAILURE);
-  }
+  else if (asm_ptr->symbols.type[asm_ptr->symbol_id] <= TCASM_SYMBOL_INSTRUCTION_STOP)
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Tentando definir dado com palavra-chave");
   
-  // if (TCASM_symbol->type == TCASM_SYMBOL_ADDRESS_TEXT)
-  fprintf(stderr, "Erro linha %u: Redefinindo identificador\n", TCASM_statement_line);
-  exit(EXIT_FAILURE);
+  // if (asm_ptr->symbols.type[asm_ptr->symbol_id] == TCASM_SYMBOL_ADDRESS_TEXT)
+  TCASM_error(asm_ptr, asm_ptr->statement_line, "Redefinindo identificador");
 }
 
 /**
  * Funcao para tratar o ultimo char lido no estado TCASM_STATE_TEXT.
  * Neste estado, a maquina esta esperando uma instrucao.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_handle_state_text() {
+void TCASM_handle_state_text(TCASM_assembler_t* asm_ptr) {
   bool created;
   
-  TCASM_check_same_line();
+  TCASM_check_same_line(asm_ptr);
   
-  TCASM_read_symbol();
-  TCASM_symbol = (TCASM_symbol_t*) TCASM_hashtable_get(&TCASM_symbol_table, TCASM_word, &created);
+  TCASM_read_symbol(asm_ptr);
+  TCASM_lookup_symbol(asm_ptr, &created);
   
-  if (TCASM_symbol->type < TCASM_SYMBOL_INSTRUCTION_REGULAR || TCASM_symbol->type > TCASM_SYMBOL_INSTRUCTION_STOP) {
-    fprintf(stderr, "Erro linha %u: Instrucao invalida\n", TCASM_statement_line);
-    exit(EXIT_FAILURE);
-  }
+  if (asm_ptr->symbols.type[asm_ptr->symbol_id] < TCASM_SYMBOL_INSTRUCTION_REGULAR || asm_ptr->symbols.type[asm_ptr->symbol_id] > TCASM_SYMBOL_INSTRUCTION_STOP)
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Instrucao invalida");
   
-  TCASM_decode_instruction();
+  TCASM_decode_instruction(asm_ptr);
 }
 
 /**
@@ -1483,168 +1696,158 @@ void TCASM_handle_state_text() {
  * TCASM_STATE_DATA_CREATE_DATABEFORE.
  * Neste estado, a maquina esta esperando um dado (variavel, constante
  * ou vetor).
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_handle_state_data_create_databefore() {
-  TCASM_check_same_line();
+void TCASM_handle_state_data_create_databefore(TCASM_assembler_t* asm_ptr) {
+  TCASM_check_same_line(asm_ptr);
   
-  TCASM_symbol_type_t type = TCASM_read_data_type();
+  TCASM_symbol_type_t type = TCASM_read_data_type(asm_ptr);
   // le o proximo char valido para poder checar se ocorreu uma nova linha ou nao
-  if (TCASM_read_char()) {
-    fseek(TCASM_fin, -1, SEEK_CUR); // devolve o ultimo char valido lido
+  if (TCASM_read_char(asm_ptr)) {
+    --asm_ptr->cursor; // devolve o ultimo char valido lido
     
     // variavel ou vetor
     if (type == TCASM_SYMBOL_DIRECTIVE_SPACE) {
       // variavel
-      if (TCASM_read_lines > 0) {
-        TCASM_symbol->type = TCASM_SYMBOL_ADDRESS_VAR;
-        TCASM_list_init(&TCASM_symbol->sym_union.var.ref_list, sizeof(TCASM_symbol_address_reflist_t));
-        ++TCASM_data_size;
-        TCASM_datalist_node_t tmp;
-        tmp.anonymous = false;
-        tmp.sym = TCASM_symbol;
-        TCASM_list_insert(&TCASM_datalist, NULL, &tmp);
-        TCASM_state = TCASM_STATE_DATA_STATEMENT_DATABEFORE;
+      if (asm_ptr->read_lines > 0) {
+        asm_ptr->symbols.type[asm_ptr->symbol_id] = TCASM_SYMBOL_ADDRESS_VAR;
+        asm_ptr->symbols.line[asm_ptr->symbol_id] = asm_ptr->statement_line;
+        ++asm_ptr->data_size;
+        TCASM_datalist_insert(asm_ptr, false, TCASM_SYMBOL_ADDRESS_VAR, 0);
+        asm_ptr->state = TCASM_STATE_DATA_STATEMENT_DATABEFORE;
         return;
       }
       // vetor
       else {
         int i;
-        if (fscanf(TCASM_fin, "%i", &i) == 1) {
-          if (TCASM_data_size + i > 65536) {
-            fprintf(stderr, "Erro linha %u: Memoria estourada\n", TCASM_statement_line);
-            exit(EXIT_FAILURE);
-          }
+        if (TCASM_read_int(asm_ptr, &i)) {
+          if (asm_ptr->data_size + i > 65536)
+            TCASM_error(asm_ptr, asm_ptr->statement_line, "Memoria estourada");
           
           if (i > 0) {
-            TCASM_symbol->type = TCASM_SYMBOL_ADDRESS_ARRAY;
-            TCASM_symbol->sym_union.array.size = i;
-            TCASM_list_init(&TCASM_symbol->sym_union.array.ref_list, sizeof(TCASM_symbol_address_array_reflist_t));
-            TCASM_data_size += i;
-            TCASM_datalist_node_t tmp;
-            tmp.anonymous = false;
-            tmp.sym = TCASM_symbol;
-            TCASM_list_insert(&TCASM_datalist, NULL, &tmp);
-            TCASM_state = TCASM_STATE_DATA_STATEMENT_DATABEFORE;
+            asm_ptr->symbols.type[asm_ptr->symbol_id] = TCASM_SYMBOL_ADDRESS_ARRAY;
+            asm_ptr->symbols.value[asm_ptr->symbol_id] = i;
+            asm_ptr->symbols.line[asm_ptr->symbol_id] = asm_ptr->statement_line;
+            asm_ptr->data_size += i;
+            TCASM_datalist_insert(asm_ptr, false, TCASM_SYMBOL_ADDRESS_ARRAY, i);
+            asm_ptr->state = TCASM_STATE_DATA_STATEMENT_DATABEFORE;
             return;
           }
         }
         
-        // if (fscanf(TCASM_fin, "%i", &i) != 1 || i <= 0)
-        fprintf(stderr, "Erro linha %u: Tamanho invalido para vetor\n", TCASM_statement_line);
-        exit(EXIT_FAILURE);
+        // if (!TCASM_read_int(asm_ptr, &i) || i <= 0)
+        TCASM_error(asm_ptr, asm_ptr->statement_line, "Tamanho invalido para vetor");
       }
     }
     // constante
     else {
-      TCASM_check_same_line();
+      TCASM_check_same_line(asm_ptr);
       
       // tenta ler um inteiro de 16 bits com sinal
       int i;
-      if (fscanf(TCASM_fin, "%i", &i) == 1) {
-        if (i < -32768 || i > 32767) {
-          fprintf(stderr, "Erro linha %u: Constante invalida\n", TCASM_statement_line);
-          exit(EXIT_FAILURE);
-        }
+      if (TCASM_read_int(asm_ptr, &i)) {
+        if (i < -32768 || i > 32767)
+          TCASM_error(asm_ptr, asm_ptr->statement_line, "Constante invalida");
         
-        TCASM_symbol->type = TCASM_SYMBOL_ADDRESS_CONST;
-        TCASM_symbol->sym_union.constant.value = i;
-        TCASM_list_init(&TCASM_symbol->sym_union.constant.ref_list, sizeof(TCASM_symbol_address_reflist_t));
-        ++TCASM_data_size;
-        TCASM_datalist_node_t tmp;
-        tmp.anonymous = false;
-        tmp.sym = TCASM_symbol;
-        TCASM_list_insert(&TCASM_datalist, NULL, &tmp);
-        TCASM_state = TCASM_STATE_DATA_STATEMENT_DATABEFORE;
+        asm_ptr->symbols.type[asm_ptr->symbol_id] = TCASM_SYMBOL_ADDRESS_CONST;
+        asm_ptr->symbols.value[asm_ptr->symbol_id] = i;
+        asm_ptr->symbols.line[asm_ptr->symbol_id] = asm_ptr->statement_line;
+        ++asm_ptr->data_size;
+        TCASM_datalist_insert(asm_ptr, false, TCASM_SYMBOL_ADDRESS_CONST, i);
+        asm_ptr->state = TCASM_STATE_DATA_STATEMENT_DATABEFORE;
         return;
       }
       
-      // if (fscanf(TCASM_fin, "%i", &i) != 1)
-      fprintf(stderr, "Erro linha %u: Constante invalida\n", TCASM_statement_line);
-      exit(EXIT_FAILURE);
+      // if (!TCASM_read_int(asm_ptr, &i))
+      TCASM_error(asm_ptr, asm_ptr->statement_line, "Constante invalida");
     }
   }
   
-  // if (!TCASM_read_char())
-  fprintf(stderr, "Erro: Arquivo fonte sem nenhuma instrucao\n");
-  exit(EXIT_FAILURE);
+  // if (!TCASM_read_char(asm_ptr))
+  TCASM_error(asm_ptr, TCASM_DIAGNOSTIC_NO_LINE, "Arquivo fonte sem nenhuma instrucao");
 }
 
 /**
  * Funcao para tratar o ultimo char lido no estado
  * TCASM_STATE_DATA_CREATE_DATAAFTER.
  * Neste estado, a maquina esta esperando um dado (variavel, constante
- * ou vetor).
+ * ou vetor) que nao foi utilizado na secao de texto. No objeto relocavel, o
+ * dado ganha o tipo, para ser exportado.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_handle_state_data_create_dataafter() {
-  TCASM_check_same_line();
+void TCASM_handle_state_data_create_dataafter(TCASM_assembler_t* asm_ptr) {
+  TCASM_check_same_line(asm_ptr);
   
-  TCASM_symbol_type_t type = TCASM_read_data_type();
+  TCASM_symbol_type_t type = TCASM_read_data_type(asm_ptr);
   // le o proximo char valido para poder checar se ocorreu uma nova linha ou nao
-  if (TCASM_read_char()) {
-    fseek(TCASM_fin, -1, SEEK_CUR); // devolve o ultimo char valido lido
+  if (TCASM_read_char(asm_ptr)) {
+    --asm_ptr->cursor; // devolve o ultimo char valido lido
     
     // variavel ou vetor
     if (type == TCASM_SYMBOL_DIRECTIVE_SPACE) {
       // variavel
-      if (TCASM_read_lines > 0) {
-        TCASM_assembled_code[TCASM_assembled_code_size++] = 0;
-        TCASM_state = TCASM_STATE_DATA_STATEMENT_DATAAFTER;
+      if (asm_ptr->read_lines > 0) {
+        if (asm_ptr->relocatable)
+          asm_ptr->symbols.type[asm_ptr->symbol_id] = TCASM_SYMBOL_ADDRESS_VAR;
+        asm_ptr->code[asm_ptr->code_size++] = 0;
+        asm_ptr->state = TCASM_STATE_DATA_STATEMENT_DATAAFTER;
         return;
       }
       // vetor
       else {
         int i;
-        if (fscanf(TCASM_fin, "%i", &i) == 1) {
-          if (TCASM_assembled_code_size + i > 65536) {
-            fprintf(stderr, "Erro linha %u: Memoria estourada\n", TCASM_statement_line);
-            exit(EXIT_FAILURE);
-          }
+        if (TCASM_read_int(asm_ptr, &i)) {
+          if (asm_ptr->code_size + i > 65536)
+            TCASM_error(asm_ptr, asm_ptr->statement_line, "Memoria estourada");
           
           if (i > 0) {
-            TCASM_write_uint16_zeroarray(TCASM_assembled_code, TCASM_assembled_code_size, i);
-            TCASM_assembled_code_size += i;
-            TCASM_state = TCASM_STATE_DATA_STATEMENT_DATAAFTER;
+            if (asm_ptr->relocatable) {
+              asm_ptr->symbols.type[asm_ptr->symbol_id] = TCASM_SYMBOL_ADDRESS_ARRAY;
+              asm_ptr->symbols.value[asm_ptr->symbol_id] = i;
+            }
+            TCASM_write_uint16_zeroarray(asm_ptr->code, asm_ptr->code_size, i);
+            asm_ptr->code_size += i;
+            asm_ptr->state = TCASM_STATE_DATA_STATEMENT_DATAAFTER;
             return;
           }
         }
         
-        // if (fscanf(TCASM_fin, "%i", &i) != 1 || i <= 0)
-        fprintf(stderr, "Erro linha %u: Tamanho invalido para vetor\n", TCASM_statement_line);
-        exit(EXIT_FAILURE);
+        // if (!TCASM_read_int(asm_ptr, &i) || i <= 0)
+        TCASM_error(asm_ptr, asm_ptr->statement_line, "Tamanho invalido para vetor");
       }
     }
     // constante
     else {
-      TCASM_check_same_line();
+      TCASM_check_same_line(asm_ptr);
       
       // tenta ler um inteiro de 16 bits com sinal
       int i;
-      if (fscanf(TCASM_fin, "%i", &i) == 1) {
-        if (i < -32768 || i > 32767) {
-          fprintf(stderr, "Erro linha %u: Constante invalida\n", TCASM_statement_line);
-          exit(EXIT_FAILURE);
-        }
+      if (TCASM_read_int(asm_ptr, &i)) {
+        if (i < -32768 || i > 32767)
+          TCASM_error(asm_ptr, asm_ptr->statement_line, "Constante invalida");
         
-        TCASM_assembled_code[TCASM_assembled_code_size++] = i;
-        TCASM_state = TCASM_STATE_DATA_STATEMENT_DATAAFTER;
+        if (asm_ptr->relocatable)
+          asm_ptr->symbols.type[asm_ptr->symbol_id] = TCASM_SYMBOL_ADDRESS_CONST;
+        asm_ptr->code[asm_ptr->code_size++] = i;
+        asm_ptr->state = TCASM_STATE_DATA_STATEMENT_DATAAFTER;
         return;
       }
       
-      // if (fscanf(TCASM_fin, "%i", &i) != 1)
-      fprintf(stderr, "Erro linha %u: Constante invalida\n", TCASM_statement_line);
-      exit(EXIT_FAILURE);
+      // if (!TCASM_read_int(asm_ptr, &i))
+      TCASM_error(asm_ptr, asm_ptr->statement_line, "Constante invalida");
     }
   }
   // variavel
   else if (type == TCASM_SYMBOL_DIRECTIVE_SPACE) {
-    TCASM_assembled_code[TCASM_assembled_code_size++] = 0;
-    TCASM_state = TCASM_STATE_DATA_STATEMENT_DATAAFTER;
+    if (asm_ptr->relocatable)
+      asm_ptr->symbols.type[asm_ptr->symbol_id] = TCASM_SYMBOL_ADDRESS_VAR;
+    asm_ptr->code[asm_ptr->code_size++] = 0;
+    asm_ptr->state = TCASM_STATE_DATA_STATEMENT_DATAAFTER;
     return;
   }
   
-  // if (!TCASM_read_char())
-  fprintf(stderr, "Erro linha %u: Sentenca invalida\n", TCASM_statement_line);
-  exit(EXIT_FAILURE);
+  // if (!TCASM_read_char(asm_ptr))
+  TCASM_error(asm_ptr, asm_ptr->statement_line, "Sentenca invalida");
 }
 
 /**
@@ -1653,67 +1856,65 @@ void TCASM_handle_state_data_create_dataafter() {
  * Ocorre apenas quando a secao de dados vem depois da secao de texto.
  * Neste estado, a maquina esta esperando a definicao de uma variavel ou
  * constante.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_handle_state_data_define_varconst() {
-  TCASM_check_same_line();
+void TCASM_handle_state_data_define_varconst(TCASM_assembler_t* asm_ptr) {
+  TCASM_check_same_line(asm_ptr);
   
-  TCASM_symbol_type_t type = TCASM_read_data_type();
+  TCASM_symbol_type_t type = TCASM_read_data_type(asm_ptr);
   // le o proximo char valido para poder checar se ocorreu uma nova linha ou nao
-  if (TCASM_read_char()) {
-    fseek(TCASM_fin, -1, SEEK_CUR); // devolve o ultimo char valido lido
+  if (TCASM_read_char(asm_ptr)) {
+    --asm_ptr->cursor; // devolve o ultimo char valido lido
     
     // variavel ou vetor
     if (type == TCASM_SYMBOL_DIRECTIVE_SPACE) {
       // variavel
-      if (TCASM_read_lines > 0) {
-        TCASM_symbol->type = TCASM_SYMBOL_ADDRESS_VAR;
-        TCASM_dump_var_reflist_dataafter();
-        TCASM_assembled_code[TCASM_assembled_code_size++] = 0;
-        TCASM_state = TCASM_STATE_DATA_STATEMENT_DATAAFTER;
+      if (asm_ptr->read_lines > 0) {
+        asm_ptr->symbols.type[asm_ptr->symbol_id] = TCASM_SYMBOL_ADDRESS_VAR;
+        asm_ptr->symbols.line[asm_ptr->symbol_id] = asm_ptr->statement_line;
+        asm_ptr->fixups_unchecked = true;
+        asm_ptr->code[asm_ptr->code_size++] = 0;
+        asm_ptr->state = TCASM_STATE_DATA_STATEMENT_DATAAFTER;
         return;
       }
       // vetor
-      else {
-        fprintf(stderr, "Erro linha %u: Definicao de vetor inesperada, ao esperar definicao de variavel ou constante\n", TCASM_statement_line);
-        exit(EXIT_FAILURE);
-      }
+      else
+        TCASM_error(asm_ptr, asm_ptr->statement_line, "Definicao de vetor inesperada, ao esperar definicao de variavel ou constante");
     }
     // constante
     else {
-      TCASM_check_same_line();
+      TCASM_check_same_line(asm_ptr);
       
       // tenta ler um inteiro de 16 bits com sinal
       int i;
-      if (fscanf(TCASM_fin, "%i", &i) == 1) {
-        if (i < -32768 || i > 32767) {
-          fprintf(stderr, "Erro linha %u: Constante invalida\n", TCASM_statement_line);
-          exit(EXIT_FAILURE);
-        }
+      if (TCASM_read_int(asm_ptr, &i)) {
+        if (i < -32768 || i > 32767)
+          TCASM_error(asm_ptr, asm_ptr->statement_line, "Constante invalida");
         
-        TCASM_symbol->type = TCASM_SYMBOL_ADDRESS_CONST;
-        TCASM_dump_const_reflist_dataafter(i);
-        TCASM_assembled_code[TCASM_assembled_code_size++] = i;
-        TCASM_state = TCASM_STATE_DATA_STATEMENT_DATAAFTER;
+        asm_ptr->symbols.type[asm_ptr->symbol_id] = TCASM_SYMBOL_ADDRESS_CONST;
+        asm_ptr->symbols.line[asm_ptr->symbol_id] = asm_ptr->statement_line;
+        asm_ptr->fixups_unchecked = true;
+        asm_ptr->code[asm_ptr->code_size++] = i;
+        asm_ptr->state = TCASM_STATE_DATA_STATEMENT_DATAAFTER;
         return;
       }
       
-      // if (fscanf(TCASM_fin, "%i", &i) != 1)
-      fprintf(stderr, "Erro linha %u: Constante invalida\n", TCASM_statement_line);
-      exit(EXIT_FAILURE);
+      // if (!TCASM_read_int(asm_ptr, &i))
+      TCASM_error(asm_ptr, asm_ptr->statement_line, "Constante invalida");
     }
   }
   // variavel
   else if (type == TCASM_SYMBOL_DIRECTIVE_SPACE) {
-    TCASM_symbol->type = TCASM_SYMBOL_ADDRESS_VAR;
-    TCASM_dump_var_reflist_dataafter();
-    TCASM_assembled_code[TCASM_assembled_code_size++] = 0;
-    TCASM_state = TCASM_STATE_DATA_STATEMENT_DATAAFTER;
+    asm_ptr->symbols.type[asm_ptr->symbol_id] = TCASM_SYMBOL_ADDRESS_VAR;
+    asm_ptr->symbols.line[asm_ptr->symbol_id] = asm_ptr->statement_line;
+    asm_ptr->fixups_unchecked = true;
+    asm_ptr->code[asm_ptr->code_size++] = 0;
+    asm_ptr->state = TCASM_STATE_DATA_STATEMENT_DATAAFTER;
     return;
   }
   
-  // if (!TCASM_read_char())
-  fprintf(stderr, "Erro linha %u: Sentenca invalida", TCASM_statement_line);
-  exit(EXIT_FAILURE);
+  // if (!TCASM_read_char(asm_ptr))
+  TCASM_error(asm_ptr, asm_ptr->statement_line, "Sentenca invalida");
 }
 
 /**
@@ -1721,207 +1922,1085 @@ void TCASM_handle_state_data_define_varconst() {
  * TCASM_STATE_DATA_DEFINE_ARRAY.
  * Ocorre apenas quando a secao de dados vem depois da secao de texto.
  * Neste estado, a maquina esta esperando a definicao de um vetor.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_handle_state_data_define_array() {
-  TCASM_check_same_line();
+void TCASM_handle_state_data_define_array(TCASM_assembler_t* asm_ptr) {
+  TCASM_check_same_line(asm_ptr);
   
-  TCASM_symbol_type_t type = TCASM_read_data_type();
+  TCASM_symbol_type_t type = TCASM_read_data_type(asm_ptr);
   // le o proximo char valido para poder checar se ocorreu uma nova linha ou nao
-  if (TCASM_read_char()) {
-    fseek(TCASM_fin, -1, SEEK_CUR); // devolve o ultimo char valido lido
+  if (TCASM_read_char(asm_ptr)) {
+    --asm_ptr->cursor; // devolve o ultimo char valido lido
     
     // variavel ou vetor
     if (type == TCASM_SYMBOL_DIRECTIVE_SPACE) {
       // variavel
-      if (TCASM_read_lines > 0) {
-        fprintf(stderr, "Erro linha %u: Definicao de variavel inesperada, ao esperar definicao de vetor\n", TCASM_statement_line);
-        exit(EXIT_FAILURE);
-      }
+      if (asm_ptr->read_lines > 0)
+        TCASM_error(asm_ptr, asm_ptr->statement_line, "Definicao de variavel inesperada, ao esperar definicao de vetor");
       // vetor
       else {
         int i;
-        if (fscanf(TCASM_fin, "%i", &i) == 1) {
-          if (TCASM_assembled_code_size + i > 65536) {
-            fprintf(stderr, "Erro linha %u: Memoria estourada\n", TCASM_statement_line);
-            exit(EXIT_FAILURE);
-          }
+        if (TCASM_read_int(asm_ptr, &i)) {
+          if (asm_ptr->code_size + i > 65536)
+            TCASM_error(asm_ptr, asm_ptr->statement_line, "Memoria estourada");
           
           if (i > 0) {
-            TCASM_symbol->sym_union.array.size = i;
-            TCASM_dump_array_reflist_dataafter();
-            TCASM_write_uint16_zeroarray(TCASM_assembled_code, TCASM_assembled_code_size, i);
-            TCASM_assembled_code_size += i;
-            TCASM_state = TCASM_STATE_DATA_STATEMENT_DATAAFTER;
+            asm_ptr->symbols.value[asm_ptr->symbol_id] = i;
+            asm_ptr->symbols.line[asm_ptr->symbol_id] = asm_ptr->statement_line;
+            asm_ptr->fixups_unchecked = true;
+            TCASM_write_uint16_zeroarray(asm_ptr->code, asm_ptr->code_size, i);
+            asm_ptr->code_size += i;
+            asm_ptr->state = TCASM_STATE_DATA_STATEMENT_DATAAFTER;
             return;
           }
         }
         
-        // if (fscanf(TCASM_fin, "%i", &i) != 1 || i <= 0)
-        fprintf(stderr, "Erro linha %u: Tamanho invalido para vetor\n", TCASM_statement_line);
-        exit(EXIT_FAILURE);
+        // if (!TCASM_read_int(asm_ptr, &i) || i <= 0)
+        TCASM_error(asm_ptr, asm_ptr->statement_line, "Tamanho invalido para vetor");
       }
     }
     // constante
-    else {
-      fprintf(stderr, "Erro linha %u: Definicao de constante inesperada, ao esperar definicao de vetor\n", TCASM_statement_line);
-      exit(EXIT_FAILURE);
-    }
+    else
+      TCASM_error(asm_ptr, asm_ptr->statement_line, "Definicao de constante inesperada, ao esperar definicao de vetor");
   }
   // variavel
-  else if (type == TCASM_SYMBOL_DIRECTIVE_SPACE) {
-    fprintf(stderr, "Erro linha %u: Definicao de variavel inesperada, ao esperar definicao de vetor\n", TCASM_statement_line);
-    exit(EXIT_FAILURE);
-  }
+  else if (type == TCASM_SYMBOL_DIRECTIVE_SPACE)
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Definicao de variavel inesperada, ao esperar definicao de vetor");
   
-  // (!TCASM_read_char())
-  fprintf(stderr, "Erro linha %u: Sentenca invalida\n", TCASM_statement_line);
-  exit(EXIT_FAILURE);
+  // (!TCASM_read_char(asm_ptr))
+  TCASM_error(asm_ptr, asm_ptr->statement_line, "Sentenca invalida");
 }
 
 /**
  * Funcao para tratar o ultimo char lido no estado TCASM_STATE_REGULAR.
  * Neste estado, a maquina espera ler o operando de uma instrucao que nao eh
  * desvio, nem STOP, nem COPY.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_handle_state_regular() {
+void TCASM_handle_state_regular(TCASM_assembler_t* asm_ptr) {
   bool created;
   
-  TCASM_check_same_line();
+  TCASM_check_same_line(asm_ptr);
   
-  TCASM_read_symbol();
-  TCASM_hashnode = TCASM_hashtable_get_node(&TCASM_symbol_table, TCASM_word, &created);
-  TCASM_symbol = (TCASM_symbol_t*) TCASM_hashnode->value;
+  TCASM_read_symbol(asm_ptr);
+  TCASM_lookup_symbol(asm_ptr, &created);
   
   // criado agora
   if (created) {
-    if (TCASM_data_read) {
-      fprintf(stderr, "Erro linha %u: Dado indefinido\n", TCASM_statement_line);
-      exit(EXIT_FAILURE);
-    }
+    if (asm_ptr->data_read && !asm_ptr->relocatable)
+      TCASM_error(asm_ptr, asm_ptr->statement_line, "Dado indefinido");
     
-    TCASM_state_regular_create_ref_list();
+    TCASM_state_regular_create_ref(asm_ptr);
   }
   // operando invalido se nao eh endereco de dado
-  else if (TCASM_symbol->type < TCASM_SYMBOL_ADDRESS_VAR) {
-    fprintf(stderr, "Erro linha %u: Operando invalido\n", TCASM_statement_line);
-    exit(EXIT_FAILURE);
-  }
+  else if (asm_ptr->symbols.type[asm_ptr->symbol_id] < TCASM_SYMBOL_ADDRESS_VAR)
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Operando invalido");
   // tratar constante
-  else if (TCASM_symbol->type == TCASM_SYMBOL_ADDRESS_CONST) {
+  else if (asm_ptr->symbols.type[asm_ptr->symbol_id] == TCASM_SYMBOL_ADDRESS_CONST) {
     // escrita em memoria reservada para armazenamento de constante
-    if (TCASM_opcode == TCASM_SYMBOL_INSTRUCTION_OPCODE_INPUT || TCASM_opcode == TCASM_SYMBOL_INSTRUCTION_OPCODE_STORE) {
-      fprintf(stderr, "Erro linha %u: Escrita em memoria reservada para armazenamento de constante\n", TCASM_statement_line);
-      exit(EXIT_FAILURE);
-    }
+    if (asm_ptr->opcode == TCASM_SYMBOL_INSTRUCTION_OPCODE_INPUT || asm_ptr->opcode == TCASM_SYMBOL_INSTRUCTION_OPCODE_STORE)
+      TCASM_error(asm_ptr, asm_ptr->statement_line, "Escrita em memoria reservada para armazenamento de constante");
     
     // divisao por zero
-    if (TCASM_opcode == TCASM_SYMBOL_INSTRUCTION_OPCODE_DIV && TCASM_symbol->sym_union.constant.value == 0) {
-      fprintf(stderr, "Erro linha %u: Divisao por constante inicializada com valor zero\n", TCASM_statement_line);
-      exit(EXIT_FAILURE);
-    }
+    if (asm_ptr->opcode == TCASM_SYMBOL_INSTRUCTION_OPCODE_DIV && asm_ptr->symbols.value[asm_ptr->symbol_id] == 0)
+      TCASM_error(asm_ptr, asm_ptr->statement_line, "Divisao por constante inicializada com valor zero");
     
-    TCASM_state_regular_add_ref();
+    TCASM_state_regular_add_ref(asm_ptr);
   }
   // adiciona uma referencia
   else
-    TCASM_state_regular_add_ref();
+    TCASM_state_regular_add_ref(asm_ptr);
   
-  TCASM_state = TCASM_STATE_TEXT_STATEMENT;
+  asm_ptr->state = TCASM_STATE_TEXT_STATEMENT;
 }
 
 /**
  * Funcao para tratar o ultimo char lido no estado TCASM_STATE_BRANCH.
  * Neste estado, a maquina espera ler o operando de uma instrucao de desvio.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_handle_state_branch() {
+void TCASM_handle_state_branch(TCASM_assembler_t* asm_ptr) {
   bool created;
   
-  TCASM_check_same_line();
+  TCASM_check_same_line(asm_ptr);
   
-  TCASM_read_symbol();
-  TCASM_hashnode = TCASM_hashtable_get_node(&TCASM_symbol_table, TCASM_word, &created);
-  TCASM_symbol = (TCASM_symbol_t*) TCASM_hashnode->value;
+  TCASM_read_symbol(asm_ptr);
+  TCASM_lookup_symbol(asm_ptr, &created);
   
   // criado agora
-  if (created) {
-    TCASM_symbol->type = TCASM_SYMBOL_ADDRESS_TEXT;
-    
-    TCASM_symbol_address_reflist_t tmp0;
-    tmp0.addr = TCASM_assembled_code_size++;
-    tmp0.line = TCASM_statement_line;
-    TCASM_list_init(&TCASM_symbol->sym_union.text.ref_list, sizeof(TCASM_symbol_address_reflist_t));
-    TCASM_list_insert(&TCASM_symbol->sym_union.text.ref_list, NULL, &tmp0);
-    
-    // inserindo na lista de elementos com referencias pendentes
-    TCASM_reflist_node_t tmp;
-    tmp.sym = TCASM_hashnode;
-    TCASM_list_insert(&TCASM_reflist, NULL, &tmp);
-  }
+  if (created)
+    asm_ptr->symbols.type[asm_ptr->symbol_id] = TCASM_SYMBOL_ADDRESS_TEXT;
   // operando invalido se nao eh endereco de texto
-  else if (TCASM_symbol->type != TCASM_SYMBOL_ADDRESS_TEXT) {
-    fprintf(stderr, "Erro linha %u: Operando invalido\n", TCASM_statement_line);
-    exit(EXIT_FAILURE);
-  }
-  // criado e definido anteriormente
-  else if (TCASM_symbol->sym_union.text.ref_list.size == 0) {
-    TCASM_assembled_code[TCASM_assembled_code_size++] = TCASM_symbol->sym_union.text.addr;
-  }
-  // criado anteriormente
-  else {
-    TCASM_symbol_address_reflist_t tmp;
-    tmp.addr = TCASM_assembled_code_size++;
-    tmp.line = TCASM_statement_line;
-    TCASM_list_insert(&TCASM_symbol->sym_union.text.ref_list, NULL, &tmp);
-  }
+  else if (asm_ptr->symbols.type[asm_ptr->symbol_id] != TCASM_SYMBOL_ADDRESS_TEXT)
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Operando invalido");
   
-  TCASM_state = TCASM_STATE_TEXT_STATEMENT;
+  // o rotulo pode ser definido depois, entao o operando fica para a
+  // resolucao no fim da montagem
+  TCASM_record_fixup(asm_ptr, 0);
+  asm_ptr->code[asm_ptr->code_size++] = 0;
+  
+  asm_ptr->state = TCASM_STATE_TEXT_STATEMENT;
 }
 
 /**
  * Funcao para tratar o ultimo char lido no estado TCASM_STATE_COPY.
  * Neste estado, a maquina espera ler os operandos de uma instrucao COPY.
+ * @param asm_ptr Ponteiro do contexto.
  */
-void TCASM_handle_state_copy() {
+void TCASM_handle_state_copy(TCASM_assembler_t* asm_ptr) {
   bool created;
   
-  TCASM_check_same_line();
+  TCASM_check_same_line(asm_ptr);
   
-  TCASM_read_symbol();
-  TCASM_hashnode = TCASM_hashtable_get_node(&TCASM_symbol_table, TCASM_word, &created);
-  TCASM_symbol = (TCASM_symbol_t*) TCASM_hashnode->value;
+  TCASM_read_symbol(asm_ptr);
+  TCASM_lookup_symbol(asm_ptr, &created);
   
   // criado agora
   if (created) {
-    if (TCASM_data_read) {
-      fprintf(stderr, "Erro linha %u: Dado indefinido\n", TCASM_statement_line);
-      exit(EXIT_FAILURE);
-    }
+    if (asm_ptr->data_read && !asm_ptr->relocatable)
+      TCASM_error(asm_ptr, asm_ptr->statement_line, "Dado indefinido");
     
-    TCASM_state_regular_create_ref_list();
-    if (!TCASM_second_op)
-      TCASM_read_comma();
+    TCASM_state_regular_create_ref(asm_ptr);
+    if (!asm_ptr->second_op)
+      TCASM_read_comma(asm_ptr);
   }
   // operando invalido se nao eh endereco de dado
-  else if (TCASM_symbol->type < TCASM_SYMBOL_ADDRESS_VAR) {
-    fprintf(stderr, "Erro linha %u: Operando invalido", TCASM_statement_line);
-    exit(EXIT_FAILURE);
-  }
+  else if (asm_ptr->symbols.type[asm_ptr->symbol_id] < TCASM_SYMBOL_ADDRESS_VAR)
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Operando invalido");
   // escrita em memoria reservada para armazenamento de constante
-  else if (TCASM_second_op && TCASM_symbol->type == TCASM_SYMBOL_ADDRESS_CONST) {
-    fprintf(stderr, "Erro linha %u: Escrita em memoria reservada para armazenamento de constante\n", TCASM_statement_line);
-    exit(EXIT_FAILURE);
-  }
+  else if (asm_ptr->second_op && asm_ptr->symbols.type[asm_ptr->symbol_id] == TCASM_SYMBOL_ADDRESS_CONST)
+    TCASM_error(asm_ptr, asm_ptr->statement_line, "Escrita em memoria reservada para armazenamento de constante");
   // adiciona uma referencia
   else {
-    TCASM_state_regular_add_ref();
-    if (!TCASM_second_op)
-      TCASM_read_comma();
+    TCASM_state_regular_add_ref(asm_ptr);
+    if (!asm_ptr->second_op)
+      TCASM_read_comma(asm_ptr);
   }
   
-  if (!TCASM_second_op)
-    TCASM_second_op = true;
+  if (!asm_ptr->second_op)
+    asm_ptr->second_op = true;
   else {
-    TCASM_second_op = false;
-    TCASM_state = TCASM_STATE_TEXT_STATEMENT;
+    asm_ptr->second_op = false;
+    asm_ptr->state = TCASM_STATE_TEXT_STATEMENT;
+  }
+}
+
+/**
+ * Funcao que tenta montar o codigo-fonte com varias threads. O trecho ate a
+ * diretiva SECTION TEXT e o trecho depois da secao de texto passam pela
+ * maquina de montagem normal; a secao de texto eh dividida em pedacos no
+ * inicio de linhas, e cada pedaco eh montado em paralelo em um contexto
+ * proprio. Os enderecos finais saem da soma de prefixos dos tamanhos dos
+ * pedacos, e os operandos de cada pedaco sao copiados em paralelo para a
+ * tabela de operandos da montagem completa, resolvida no fim como na
+ * montagem sequencial.
+ * @param asm_ptr Ponteiro do contexto, ja reiniciado e com o codigo-fonte
+ * em maiusculas.
+ * @return Retorna true se a montagem terminou sem erros, ou false se ela
+ * precisa ser refeita sequencialmente.
+ */
+bool TCASM_parallel_parse(TCASM_assembler_t* asm_ptr) {
+  const char* text_begin;
+  const char* text_end;
+  if (!TCASM_find_text_section(asm_ptr, &text_begin, &text_end))
+    return false;
+  
+  size_t count = asm_ptr->jobs;
+  if (count > (size_t) (text_end - text_begin)/TCASM_ASSEMBLER_CHUNK_MIN_SIZE)
+    count = (size_t) (text_end - text_begin)/TCASM_ASSEMBLER_CHUNK_MIN_SIZE;
+  if (count < 2)
+    return false;
+  
+  // divide a secao de texto em pedacos de tamanhos parecidos, cada um
+  // terminando depois de uma quebra de linha
+  TCASM_chunk_t* chunks = (TCASM_chunk_t*) calloc(count, sizeof(TCASM_chunk_t));
+  size_t size = 0;
+  for (const char* begin = text_begin; begin != text_end; ++size) {
+    const char* end = text_end;
+    if (size + 1 < count) {
+      end = text_begin + (size_t) (text_end - text_begin)*(size + 1)/count;
+      if (end < begin)
+        end = begin;
+      const char* newline = (const char*) memchr(end, '\n', text_end - end);
+      end = newline != NULL ? newline + 1 : text_end;
+    }
+    
+    TCASM_chunk_t* chunk = &chunks[size];
+    chunk->parent = asm_ptr;
+    chunk->begin = begin;
+    chunk->end = end;
+    TCASM_assembler_init(&chunk->context);
+    if (asm_ptr->map.enabled)
+      TCASM_map_enable(&chunk->context.map);
+    begin = end;
+  }
+  
+  bool ok = TCASM_parallel_run(asm_ptr, chunks, size);
+  
+  for (size_t i = 0; i < size; ++i) {
+    TCASM_assembler_destroy(&chunks[i].context);
+    free(chunks[i].global_id);
+  }
+  free(chunks);
+  return ok;
+}
+
+/**
+ * Funcao que executa as etapas da montagem paralela sobre os pedacos da
+ * secao de texto. Um erro em qualquer etapa volta para ca.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param chunks Pedacos da secao de texto, na ordem do codigo-fonte.
+ * @param count Quantidade de pedacos.
+ * @return Retorna true se a montagem terminou sem erros.
+ */
+bool TCASM_parallel_run(TCASM_assembler_t* asm_ptr, TCASM_chunk_t* chunks, size_t count) {
+  const char* source_end = asm_ptr->source_end;
+  if (setjmp(asm_ptr->error_jump) != 0) {
+    asm_ptr->source_end = source_end;
+    return false;
+  }
+  
+  // o trecho ate SECTION TEXT, com a maquina normal
+  asm_ptr->cursor = asm_ptr->source;
+  asm_ptr->line_start = asm_ptr->source;
+  asm_ptr->source_end = chunks[0].begin;
+  TCASM_read_statements(asm_ptr);
+  asm_ptr->source_end = source_end;
+  if (asm_ptr->state != TCASM_STATE_TEXT_STATEMENT || !asm_ptr->changed_line)
+    return false;
+  
+  // linha inicial de cada pedaco
+  TCASM_chunks_run(chunks, count, TCASM_chunk_count_lines);
+  chunks[0].line = asm_ptr->line;
+  for (size_t i = 1; i < count; ++i)
+    chunks[i].line = chunks[i - 1].line + chunks[i - 1].lines;
+  
+  // montagem dos pedacos
+  TCASM_chunks_run(chunks, count, TCASM_chunk_parse);
+  for (size_t i = 0; i < count; ++i)
+    if (!chunks[i].ok)
+      return false;
+  
+  // endereco de cada pedaco pela soma de prefixos dos tamanhos
+  size_t base = asm_ptr->code_size;
+  for (size_t i = 0; i < count; ++i) {
+    chunks[i].base = base;
+    base += chunks[i].context.code_size;
+  }
+  if (base > TCASM_ASSEMBLER_MEMORY_SIZE)
+    return false;
+  asm_ptr->code_size = base;
+  
+  // copia dos pedacos, simbolos da montagem completa e operandos dos pedacos
+  TCASM_chunks_run(chunks, count, TCASM_chunk_relocate);
+  if (!TCASM_chunk_merge(asm_ptr, chunks, count))
+    return false;
+  TCASM_chunks_run(chunks, count, TCASM_chunk_link);
+  
+  // o restante do codigo-fonte (secao de dados), com a maquina normal
+  TCASM_chunk_t* last = &chunks[count - 1];
+  asm_ptr->cursor = last->end;
+  asm_ptr->line_start = last->end;
+  asm_ptr->line = last->line + last->lines;
+  asm_ptr->statement_line = last->context.statement_line;
+  TCASM_read_statements(asm_ptr);
+  TCASM_finish_source(asm_ptr);
+  return true;
+}
+
+/**
+ * Funcao para verificar se uma linha do codigo-fonte comeca com a diretiva
+ * SECTION.
+ * @param p Inicio da linha.
+ * @param end Fim da linha.
+ * @param type Tipo de secao que deve vir depois da diretiva, ou NULL para
+ * aceitar qualquer continuacao.
+ * @return Retorna true se a linha comeca com a diretiva.
+ */
+bool TCASM_line_is_section(const char* p, const char* end, const char* type) {
+  p = TCASM_scan_blanks(p, end);
+  if (end - p < 7 || memcmp(p, "SECTION", 7) != 0)
+    return false;
+  p += 7;
+  if (type == NULL)
+    return p == end || TCASM_scan_identifier(p, p + 1) == p;
+  
+  const char* word = TCASM_scan_blanks(p, end);
+  size_t size = strlen(type);
+  if (word == p || (size_t) (end - word) < size || memcmp(word, type, size) != 0)
+    return false;
+  return word + size == end || TCASM_scan_identifier(word + size, word + size + 1) == word + size;
+}
+
+/**
+ * Funcao para localizar a secao de texto no codigo-fonte: ela comeca na
+ * linha seguinte a primeira linha com SECTION TEXT e termina na proxima
+ * linha que comeca com SECTION, ou no fim do codigo-fonte. A busca so olha o
+ * inicio das linhas; se ela errar, a montagem paralela encontra um estado
+ * inesperado e desiste.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param begin Ponteiro para retornar o inicio da secao.
+ * @param end Ponteiro para retornar o fim da secao.
+ * @return Retorna false se a secao nao foi encontrada ou esta vazia.
+ */
+bool TCASM_find_text_section(const TCASM_assembler_t* asm_ptr, const char** begin, const char** end) {
+  const char* source_end = asm_ptr->source_end;
+  *begin = NULL;
+  for (const char* line = asm_ptr->source; line != source_end;) {
+    const char* newline = (const char*) memchr(line, '\n', source_end - line);
+    const char* next = newline != NULL ? newline + 1 : source_end;
+    
+    if (*begin == NULL) {
+      if (TCASM_line_is_section(line, next, "TEXT"))
+        *begin = next;
+    }
+    else if (TCASM_line_is_section(line, next, NULL))
+      break;
+    line = next;
+    *end = line;
+  }
+  
+  return *begin != NULL && *begin != *end;
+}
+
+/**
+ * Funcao que executa uma etapa da montagem paralela, com uma thread para
+ * cada pedaco. A thread chamadora trata o primeiro pedaco.
+ * @param chunks Pedacos da secao de texto.
+ * @param count Quantidade de pedacos.
+ * @param step Funcao da etapa, que recebe o ponteiro do pedaco.
+ */
+void TCASM_chunks_run(TCASM_chunk_t* chunks, size_t count, void* (*step)(void*)) {
+  for (size_t i = 1; i < count; ++i)
+    chunks[i].threaded = pthread_create(&chunks[i].thread, NULL, step, &chunks[i]) == 0;
+  
+  step(&chunks[0]);
+  for (size_t i = 1; i < count; ++i) {
+    if (chunks[i].threaded)
+      pthread_join(chunks[i].thread, NULL);
+    else
+      step(&chunks[i]);
+  }
+}
+
+/**
+ * Funcao que conta as quebras de linha de um pedaco do jeito de
+ * TCASM_read_char: '\r' consome tambem o char seguinte, e comentarios vao
+ * ate a quebra de linha.
+ * @param arg Ponteiro do pedaco.
+ * @return Retorna NULL.
+ */
+void* TCASM_chunk_count_lines(void* arg) {
+  TCASM_chunk_t* chunk = (TCASM_chunk_t*) arg;
+  const char* cursor = chunk->begin;
+  const char* end = chunk->end;
+  unsigned int lines = 0;
+  
+  while (cursor != end) {
+    char c = *cursor++;
+    if (c == ';')
+      cursor = TCASM_scan_line_end(cursor, end);
+    else if (c == '\r') {
+      if (cursor == end)
+        break;
+      ++cursor;
+      ++lines;
+    }
+    else if (c == '\n')
+      ++lines;
+  }
+  
+  chunk->lines = lines;
+  return NULL;
+}
+
+/**
+ * Funcao que monta um pedaco da secao de texto no contexto do pedaco, como
+ * se a maquina de montagem tivesse acabado de ler a sentenca anterior. Os
+ * dados declarados antes da secao de texto sao copiados para a tabela de
+ * simbolos local; os rotulos de outros pedacos ficam sem definicao.
+ * @param arg Ponteiro do pedaco.
+ * @return Retorna NULL.
+ */
+void* TCASM_chunk_parse(void* arg) {
+  TCASM_chunk_t* chunk = (TCASM_chunk_t*) arg;
+  TCASM_assembler_t* parent = chunk->parent;
+  TCASM_assembler_t* asm_ptr = &chunk->context;
+  
+  TCASM_assembler_reset(asm_ptr);
+  asm_ptr->source_end = chunk->end;
+  asm_ptr->cursor = chunk->begin;
+  asm_ptr->line_start = chunk->begin;
+  asm_ptr->line = chunk->line;
+  asm_ptr->statement_line = parent->statement_line;
+  asm_ptr->changed_line = true;
+  asm_ptr->text_read = true;
+  asm_ptr->data_read = parent->data_read;
+  asm_ptr->state = TCASM_STATE_TEXT_STATEMENT;
+  
+  for (uint32_t id = TCASM_SYMBOL_KEYWORDS_SIZE; id < parent->symbols.size; ++id) {
+    const char* name = TCASM_symbol_name(&parent->symbols, id);
+    bool created;
+    uint32_t local = TCASM_symbol_lookup(&asm_ptr->symbols, name, strlen(name), &created);
+    asm_ptr->symbols.type[local] = parent->symbols.type[id];
+    asm_ptr->symbols.value[local] = parent->symbols.value[id];
+    asm_ptr->symbols.line[local] = parent->symbols.line[id];
+  }
+  
+  if (setjmp(asm_ptr->error_jump) != 0)
+    return NULL;
+  TCASM_read_statements(asm_ptr);
+  chunk->ok = asm_ptr->state == TCASM_STATE_TEXT_STATEMENT && asm_ptr->data_read == parent->data_read;
+  return NULL;
+}
+
+/**
+ * Funcao que copia o codigo e o mapa de enderecos de um pedaco para a
+ * montagem completa. Os operandos que referenciam simbolos sao todos
+ * escritos depois, pela resolucao da montagem completa.
+ * @param arg Ponteiro do pedaco.
+ * @return Retorna NULL.
+ */
+void* TCASM_chunk_relocate(void* arg) {
+  TCASM_chunk_t* chunk = (TCASM_chunk_t*) arg;
+  TCASM_assembler_t* parent = chunk->parent;
+  TCASM_assembler_t* asm_ptr = &chunk->context;
+  
+  memcpy(parent->code + chunk->base, asm_ptr->code, asm_ptr->code_size*sizeof(uint16_t));
+  if (parent->map.enabled)
+    memcpy(parent->map.words + chunk->base, asm_ptr->map.words, asm_ptr->code_size*sizeof(TCASM_map_word_t));
+  return NULL;
+}
+
+/**
+ * Funcao que junta os simbolos dos pedacos na tabela de simbolos da
+ * montagem completa, na ordem do codigo-fonte, e reserva o espaco dos
+ * operandos de cada pedaco na tabela de operandos da montagem completa.
+ * Desiste se a montagem sequencial encontraria algum erro que os pedacos
+ * nao podiam ver.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param chunks Pedacos da secao de texto.
+ * @param count Quantidade de pedacos.
+ * @return Retorna true se os pedacos sao compativeis entre si.
+ */
+bool TCASM_chunk_merge(TCASM_assembler_t* asm_ptr, TCASM_chunk_t* chunks, size_t count) {
+  uint32_t seeded = (uint32_t) asm_ptr->symbols.size;
+  size_t fixups_size = asm_ptr->fixups_size;
+  bool ok = true;
+  for (size_t i = 0; ok && i < count; ++i) {
+    ok = TCASM_chunk_merge_symbols(asm_ptr, &chunks[i], seeded);
+    chunks[i].fixups_base = fixups_size;
+    fixups_size += chunks[i].context.fixups_size;
+  }
+  
+  // todo rotulo usado precisa ter sido definido em algum pedaco
+  for (uint32_t id = seeded; ok && id < asm_ptr->symbols.size; ++id)
+    if (asm_ptr->symbols.type[id] == TCASM_SYMBOL_ADDRESS_TEXT && asm_ptr->symbols.line[id] == 0)
+      ok = false;
+  if (!ok)
+    return false;
+  TCASM_reserve_fixups(asm_ptr, fixups_size);
+  asm_ptr->fixups_size = fixups_size;
+  
+  for (size_t i = 0; i < count; ++i) {
+    const TCASM_map_t* map = &chunks[i].context.map;
+    for (size_t j = 0; j < map->symbols_size; ++j)
+      TCASM_map_symbol(&asm_ptr->map, map->symbols[j].name, strlen(map->symbols[j].name), chunks[i].base + map->symbols[j].addr, (TCASM_map_kind_t) map->symbols[j].kind);
+  }
+  return true;
+}
+
+/**
+ * Funcao que passa os simbolos de um pedaco para a tabela de simbolos da
+ * montagem completa, na ordem em que apareceram no pedaco. Os dados
+ * copiados para o pedaco por TCASM_chunk_parse tem o mesmo id nas duas
+ * tabelas.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param chunk Ponteiro do pedaco.
+ * @param seeded Quantidade de ids copiados para o pedaco.
+ * @return Retorna false se algum simbolo tem outro tipo nos pedacos
+ * anteriores, ou se um rotulo foi definido de novo.
+ */
+bool TCASM_chunk_merge_symbols(TCASM_assembler_t* asm_ptr, TCASM_chunk_t* chunk, uint32_t seeded) {
+  TCASM_symbol_table_t* local = &chunk->context.symbols;
+  TCASM_symbol_table_t* symbols = &asm_ptr->symbols;
+  chunk->global_id = (uint32_t*) malloc((local->size - TCASM_SYMBOL_KEYWORDS_SIZE)*sizeof(uint32_t));
+  
+  for (uint32_t id = TCASM_SYMBOL_KEYWORDS_SIZE; id < local->size; ++id) {
+    TCASM_symbol_type_t type = (TCASM_symbol_type_t) local->type[id];
+    uint32_t global = id;
+    if (id >= seeded) {
+      const char* name = TCASM_symbol_name(local, id);
+      bool created;
+      global = TCASM_symbol_lookup(symbols, name, strlen(name), &created);
+      if (created)
+        symbols->type[global] = type;
+      else if (symbols->type[global] != type)
+        return false;
+    }
+    chunk->global_id[id - TCASM_SYMBOL_KEYWORDS_SIZE] = global;
+    
+    // rotulo definido no pedaco
+    if (type == TCASM_SYMBOL_ADDRESS_TEXT && local->line[id] != 0) {
+      if (symbols->line[global] != 0)
+        return false;
+      symbols->line[global] = local->line[id];
+      symbols->addr[global] = chunk->base + local->addr[id];
+    }
+  }
+  
+  return true;
+}
+
+/**
+ * Funcao que copia os operandos de um pedaco para a tabela de operandos da
+ * montagem completa, com os enderecos e os ids da montagem completa.
+ * @param arg Ponteiro do pedaco.
+ * @return Retorna NULL.
+ */
+void* TCASM_chunk_link(void* arg) {
+  TCASM_chunk_t* chunk = (TCASM_chunk_t*) arg;
+  TCASM_assembler_t* asm_ptr = &chunk->context;
+  TCASM_fixup_t* fixups = chunk->parent->fixups + chunk->fixups_base;
+  
+  for (size_t i = 0; i < asm_ptr->fixups_size; ++i) {
+    fixups[i] = asm_ptr->fixups[i];
+    fixups[i].addr += (uint32_t) chunk->base;
+    fixups[i].symbol = chunk->global_id[asm_ptr->fixups[i].symbol - TCASM_SYMBOL_KEYWORDS_SIZE];
+  }
+  
+  return NULL;
+}
+
+/**
+ * Funcao que tenta montar um codigo-fonte novo a partir da ultima montagem,
+ * refazendo apenas as linhas alteradas. As linhas iguais no inicio e no fim
+ * sao reaproveitadas, e as linhas entre elas precisam estar dentro da secao
+ * de texto. Se desistir, o estado da montagem incremental fica invalido e a
+ * montagem completa refaz tudo.
+ * @param asm_ptr Ponteiro do contexto, com asm_ptr->incremental valido.
+ * @param source Codigo-fonte novo.
+ * @param size Tamanho do codigo-fonte novo.
+ * @return Retorna true se o codigo montado e os diagnosticos foram
+ * atualizados.
+ */
+bool TCASM_incremental_reuse(TCASM_assembler_t* asm_ptr, const char* source, size_t size) {
+  TCASM_incremental_t* inc = &asm_ptr->incremental;
+  const char* old = inc->source;
+  size_t old_size = inc->source_size;
+  
+  // trechos iguais no inicio e no fim
+  size_t min = old_size < size ? old_size : size;
+  size_t prefix = TCASM_common_prefix(old, source, min);
+  if (prefix == old_size && prefix == size)
+    return true;
+  size_t suffix = TCASM_common_suffix(old + old_size, source + size, min - prefix);
+  
+  // o trecho alterado eh ampliado para linhas inteiras, igual nas duas versoes
+  size_t begin = prefix;
+  while (begin > 0 && old[begin - 1] != '\n')
+    --begin;
+  size_t old_end = old_size - suffix;
+  size_t new_end = size - suffix;
+  if (old_end == 0 || old[old_end - 1] != '\n' || new_end == 0 || source[new_end - 1] != '\n') {
+    const char* newline = (const char*) memchr(old + old_end, '\n', suffix);
+    size_t extra = newline != NULL ? (size_t) (newline + 1 - (old + old_end)) : suffix;
+    old_end += extra;
+    new_end += extra;
+  }
+  if (begin < inc->text_begin || old_end > inc->text_end)
+    return false;
+  
+  // um '\r' sozinho conta como quebra de linha so para a maquina de montagem
+  for (const char* p = source + begin; (p = (const char*) memchr(p, '\r', source + new_end - p)) != NULL; ++p)
+    if (p + 1 == source + new_end || p[1] != '\n')
+      return false;
+  
+  inc->valid = false;
+  size_t first = TCASM_incremental_find_line(inc, begin);
+  size_t last = TCASM_incremental_find_line(inc, old_end);
+  uint32_t addr_begin = inc->line_addr[first];
+  uint32_t addr_end = inc->line_addr[last];
+  
+  // as linhas novas sao montadas sozinhas, com enderecos a partir de 0
+  if (!TCASM_incremental_parse(asm_ptr, source + begin, source + new_end, inc->text_line + (unsigned int) first))
+    return false;
+  TCASM_assembler_t* scratch = inc->scratch;
+  long delta = (long) scratch->code_size - (long) (addr_end - addr_begin);
+  if ((long) asm_ptr->text_size + delta <= 0 || (long) asm_ptr->code_size + delta > TCASM_ASSEMBLER_MEMORY_SIZE)
+    return false;
+  
+  // as linhas novas substituem as antigas, e o inicio e o endereco das
+  // linhas seguintes andam junto
+  size_t new_lines = TCASM_incremental_count_lines(source, begin, new_end);
+  size_t lines = inc->lines + new_lines - (last - first);
+  long line_delta = (long) new_lines - (long) (last - first);
+  long size_delta = (long) size - (long) old_size;
+  TCASM_incremental_reserve_lines(inc, lines);
+  memmove(&inc->line_offset[first + new_lines], &inc->line_offset[last], (inc->lines + 1 - last)*sizeof(uint32_t));
+  memmove(&inc->line_addr[first + new_lines], &inc->line_addr[last], (inc->lines + 1 - last)*sizeof(uint32_t));
+  for (size_t i = first + new_lines; i <= lines; ++i) {
+    inc->line_offset[i] += size_delta;
+    inc->line_addr[i] += delta;
+  }
+  inc->lines = lines;
+  if (!TCASM_incremental_lines(source, begin, new_end, scratch->code, scratch->code_size, addr_begin, &inc->line_offset[first], &inc->line_addr[first]))
+    return false;
+  
+  if (!TCASM_incremental_link(asm_ptr, addr_begin, addr_end))
+    return false;
+  for (size_t i = TCASM_incremental_find_fixup(asm_ptr, addr_begin + (uint32_t) scratch->code_size); i < asm_ptr->fixups_size; ++i)
+    asm_ptr->fixups[i].line += line_delta;
+  
+  // avisos da secao de dados depois das linhas alteradas
+  unsigned int after = inc->text_line + (unsigned int) last;
+  for (size_t i = 0; i < asm_ptr->diagnostics_size; ++i)
+    if (asm_ptr->diagnostics[i].line != TCASM_DIAGNOSTIC_NO_LINE && asm_ptr->diagnostics[i].line >= after)
+      asm_ptr->diagnostics[i].line += line_delta;
+  
+  // as duas copias do codigo-fonte recebem as linhas novas
+  TCASM_reserve_source(asm_ptr, size);
+  memmove(asm_ptr->source + new_end, asm_ptr->source + old_end, suffix);
+  memcpy(asm_ptr->source + begin, scratch->source, new_end - begin);
+  asm_ptr->source_end = asm_ptr->source + size;
+  TCASM_incremental_reserve_source(inc, size);
+  memmove(inc->source + new_end, inc->source + old_end, suffix);
+  memcpy(inc->source + begin, source + begin, new_end - begin);
+  inc->source_size = size;
+  
+  inc->text_end += size_delta;
+  asm_ptr->text_size += delta;
+  asm_ptr->code_size += delta;
+  inc->valid = true;
+  return true;
+}
+
+/**
+ * Funcao que monta um trecho de linhas da secao de texto sozinho, em
+ * inc->scratch, como se a maquina de montagem tivesse acabado de ler a
+ * sentenca anterior. Os dados sao tratados como se a secao de dados viesse
+ * depois: o tipo de cada referencia sai da sintaxe, e
+ * TCASM_incremental_link confere com a montagem completa.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param begin Inicio do trecho, no codigo-fonte recebido.
+ * @param end Fim do trecho.
+ * @param line Numero da primeira linha do trecho.
+ * @return Retorna true se o trecho foi montado sem erros e terminou entre
+ * sentencas.
+ */
+bool TCASM_incremental_parse(TCASM_assembler_t* asm_ptr, const char* begin, const char* end, unsigned int line) {
+  TCASM_incremental_t* inc = &asm_ptr->incremental;
+  if (inc->scratch == NULL) {
+    inc->scratch = (TCASM_assembler_t*) malloc(sizeof(TCASM_assembler_t));
+    TCASM_assembler_init(inc->scratch);
+  }
+  TCASM_assembler_t* scratch = inc->scratch;
+  
+  size_t size = end - begin;
+  TCASM_assembler_reset(scratch);
+  TCASM_reserve_source(scratch, size);
+  for (size_t i = 0; i < size; ++i)
+    scratch->source[i] = begin[i] >= 'a' && begin[i] <= 'z' ? begin[i] + 'A' - 'a' : begin[i];
+  scratch->source_end = scratch->source + size;
+  scratch->cursor = scratch->source;
+  scratch->line_start = scratch->source;
+  scratch->line = line;
+  scratch->statement_line = line;
+  scratch->changed_line = true;
+  scratch->text_read = true;
+  scratch->state = TCASM_STATE_TEXT_STATEMENT;
+  
+  if (setjmp(scratch->error_jump) != 0)
+    return false;
+  TCASM_read_statements(scratch);
+  return scratch->state == TCASM_STATE_TEXT_STATEMENT && !scratch->data_read;
+}
+
+/**
+ * Funcao que poe as palavras montadas em inc->scratch no lugar das palavras
+ * de addr_begin a addr_end. Confere os simbolos das linhas novas com os da
+ * montagem completa, atualiza os enderecos dos rotulos e dados, e resolve
+ * de novo os operandos das linhas novas; os demais operandos so sao
+ * resolvidos outra vez se algum endereco mudou.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param addr_begin Endereco da primeira palavra das linhas antigas.
+ * @param addr_end Endereco seguinte a ultima palavra das linhas antigas.
+ * @return Retorna false se a montagem completa poderia dar outro resultado.
+ */
+bool TCASM_incremental_link(TCASM_assembler_t* asm_ptr, uint32_t addr_begin, uint32_t addr_end) {
+  TCASM_incremental_t* inc = &asm_ptr->incremental;
+  TCASM_assembler_t* scratch = inc->scratch;
+  TCASM_symbol_table_t* symbols = &asm_ptr->symbols;
+  TCASM_symbol_table_t* local = &scratch->symbols;
+  long delta = (long) scratch->code_size - (long) (addr_end - addr_begin);
+  bool relink = delta != 0;
+  
+  // rotulos definidos nas linhas antigas deixam de existir
+  uint32_t* removed = (uint32_t*) malloc((addr_end - addr_begin + 1)*sizeof(uint32_t));
+  size_t removed_size = 0;
+  for (uint32_t id = TCASM_SYMBOL_KEYWORDS_SIZE; id < symbols->size; ++id) {
+    if (symbols->type[id] == TCASM_SYMBOL_ADDRESS_TEXT && inc->defined[id] && symbols->addr[id] >= addr_begin && symbols->addr[id] < addr_end) {
+      inc->defined[id] = false;
+      symbols->line[id] = 0;
+      removed[removed_size++] = id;
+    }
+  }
+  
+  // simbolos das linhas novas, na tabela da montagem completa
+  uint32_t* global = (uint32_t*) malloc((local->size - TCASM_SYMBOL_KEYWORDS_SIZE + 1)*sizeof(uint32_t));
+  bool ok = true;
+  for (uint32_t id = TCASM_SYMBOL_KEYWORDS_SIZE; ok && id < local->size; ++id) {
+    const char* name = TCASM_symbol_name(local, id);
+    bool created;
+    uint32_t symbol = TCASM_symbol_lookup(symbols, name, strlen(name), &created);
+    TCASM_incremental_reserve_symbols(inc, symbols->size);
+    if (created) {
+      inc->uses[symbol] = 0;
+      inc->defined[symbol] = false;
+    }
+    global[id - TCASM_SYMBOL_KEYWORDS_SIZE] = symbol;
+    
+    TCASM_symbol_type_t type = (TCASM_symbol_type_t) local->type[id];
+    TCASM_symbol_type_t global_type = (TCASM_symbol_type_t) symbols->type[symbol];
+    if (type == TCASM_SYMBOL_ADDRESS_TEXT) {
+      if ((inc->defined[symbol] || inc->uses[symbol] > 0) && global_type != TCASM_SYMBOL_ADDRESS_TEXT)
+        ok = false;
+      // rotulo definido nas linhas novas
+      else if (local->line[id] != 0) {
+        ok = !inc->defined[symbol];
+        inc->defined[symbol] = true;
+        symbols->type[symbol] = TCASM_SYMBOL_ADDRESS_TEXT;
+        relink = relink || symbols->addr[symbol] != addr_begin + local->addr[id];
+      }
+      // os demais rotulos precisam estar definidos fora das linhas antigas
+      else
+        ok = inc->defined[symbol];
+    }
+    // dados precisam estar declarados com o tipo da referencia e ja ter
+    // referencias (senao os avisos da montagem completa mudam)
+    else if (!inc->defined[symbol] || inc->uses[symbol] == 0)
+      ok = false;
+    else if (type == TCASM_SYMBOL_ADDRESS_ARRAY)
+      ok = global_type == TCASM_SYMBOL_ADDRESS_ARRAY;
+    else
+      ok = global_type == TCASM_SYMBOL_ADDRESS_VAR || global_type == TCASM_SYMBOL_ADDRESS_CONST;
+  }
+  
+  // conferencias dos operandos novos com os dados da montagem completa
+  const TCASM_fixup_t* added = scratch->fixups;
+  size_t added_size = scratch->fixups_size;
+  for (size_t i = 0; ok && i < added_size; ++i) {
+    uint32_t symbol = global[added[i].symbol - TCASM_SYMBOL_KEYWORDS_SIZE];
+    if (symbols->type[symbol] == TCASM_SYMBOL_ADDRESS_ARRAY)
+      ok = added[i].offset < symbols->value[symbol];
+    else if (symbols->type[symbol] == TCASM_SYMBOL_ADDRESS_CONST)
+      ok = added[i].use != TCASM_OBJECT_USE_WRITE && !(added[i].use == TCASM_OBJECT_USE_DIV && asm_ptr->code[symbols->addr[symbol]] == 0);
+  }
+  
+  // referencias: as das linhas novas entram e as das antigas saem
+  size_t fixup_first = TCASM_incremental_find_fixup(asm_ptr, addr_begin);
+  size_t fixup_last = TCASM_incremental_find_fixup(asm_ptr, addr_end);
+  if (ok) {
+    for (size_t i = 0; i < added_size; ++i)
+      ++inc->uses[global[added[i].symbol - TCASM_SYMBOL_KEYWORDS_SIZE]];
+    for (size_t i = fixup_first; i < fixup_last; ++i)
+      --inc->uses[asm_ptr->fixups[i].symbol];
+    
+    // um dado que ficou sem referencias ganharia um aviso, e um rotulo ainda
+    // usado precisa continuar definido
+    for (size_t i = fixup_first; ok && i < fixup_last; ++i) {
+      uint32_t symbol = asm_ptr->fixups[i].symbol;
+      if (symbols->type[symbol] == TCASM_SYMBOL_ADDRESS_TEXT)
+        ok = inc->defined[symbol] || inc->uses[symbol] == 0;
+      else
+        ok = inc->uses[symbol] > 0;
+    }
+    for (size_t i = 0; ok && i < removed_size; ++i)
+      ok = inc->defined[removed[i]] || inc->uses[removed[i]] == 0;
+  }
+  free(removed);
+  if (!ok) {
+    free(global);
+    return false;
+  }
+  
+  // rotulos depois das linhas alteradas e todos os dados andam delta
+  // posicoes; os rotulos das linhas novas recebem o endereco novo
+  if (delta != 0) {
+    for (uint32_t id = TCASM_SYMBOL_KEYWORDS_SIZE; id < symbols->size; ++id) {
+      if (!inc->defined[id])
+        continue;
+      if (symbols->type[id] != TCASM_SYMBOL_ADDRESS_TEXT || symbols->addr[id] >= addr_end)
+        symbols->addr[id] = (uint16_t) (symbols->addr[id] + delta);
+    }
+  }
+  for (uint32_t id = TCASM_SYMBOL_KEYWORDS_SIZE; id < local->size; ++id) {
+    if (local->type[id] == TCASM_SYMBOL_ADDRESS_TEXT && local->line[id] != 0) {
+      symbols->addr[global[id - TCASM_SYMBOL_KEYWORDS_SIZE]] = (uint16_t) (addr_begin + local->addr[id]);
+      symbols->line[global[id - TCASM_SYMBOL_KEYWORDS_SIZE]] = local->line[id];
+    }
+  }
+  
+  // palavras das linhas novas no lugar das antigas
+  uint16_t* code = asm_ptr->code;
+  memmove(code + addr_begin + scratch->code_size, code + addr_end, (asm_ptr->code_size - addr_end)*sizeof(uint16_t));
+  memcpy(code + addr_begin, scratch->code, scratch->code_size*sizeof(uint16_t));
+  
+  size_t fixups_size = asm_ptr->fixups_size - (fixup_last - fixup_first) + added_size;
+  TCASM_reserve_fixups(asm_ptr, fixups_size);
+  memmove(&asm_ptr->fixups[fixup_first + added_size], &asm_ptr->fixups[fixup_last], (asm_ptr->fixups_size - fixup_last)*sizeof(TCASM_fixup_t));
+  for (size_t i = 0; i < added_size; ++i) {
+    TCASM_fixup_t* fixup = &asm_ptr->fixups[fixup_first + i];
+    *fixup = added[i];
+    fixup->addr += addr_begin;
+    fixup->symbol = global[added[i].symbol - TCASM_SYMBOL_KEYWORDS_SIZE];
+  }
+  for (size_t i = fixup_first + added_size; i < fixups_size; ++i)
+    asm_ptr->fixups[i].addr += delta;
+  asm_ptr->fixups_size = fixups_size;
+  free(global);
+  
+  // resolucao dos operandos: os das linhas novas sempre, os demais apenas
+  // se algum endereco mudou
+  size_t begin = relink ? 0 : fixup_first;
+  size_t end = relink ? fixups_size : fixup_first + added_size;
+  for (size_t i = begin; i < end; ++i) {
+    const TCASM_fixup_t* fixup = &asm_ptr->fixups[i];
+    code[fixup->addr] = (uint16_t) (symbols->addr[fixup->symbol] + fixup->offset);
+  }
+  return true;
+}
+
+/**
+ * Funcao que prepara a montagem incremental depois de uma montagem completa
+ * sem erros, cujo codigo-fonte esta em inc->source: localiza a secao de
+ * texto, registra o inicio e o endereco de cada linha dela, conta as
+ * referencias a cada simbolo e guarda o endereco de cada dado referenciado.
+ * Se alguma conferencia falhar, a proxima montagem tambem eh completa.
+ * @param asm_ptr Ponteiro do contexto.
+ */
+void TCASM_incremental_build(TCASM_assembler_t* asm_ptr) {
+  TCASM_incremental_t* inc = &asm_ptr->incremental;
+  const char* source = inc->source;
+  size_t size = inc->source_size;
+  if (asm_ptr->map.enabled)
+    return;
+  
+  // um '\r' sozinho conta como quebra de linha so para a maquina de montagem
+  for (const char* p = source; (p = (const char*) memchr(p, '\r', source + size - p)) != NULL; ++p)
+    if (p + 1 == source + size || p[1] != '\n')
+      return;
+  
+  const char* text_begin;
+  const char* text_end;
+  if (!TCASM_find_text_section(asm_ptr, &text_begin, &text_end))
+    return;
+  inc->text_begin = text_begin - asm_ptr->source;
+  inc->text_end = text_end - asm_ptr->source;
+  inc->text_line = 1 + (unsigned int) (TCASM_incremental_count_lines(source, 0, inc->text_begin));
+  
+  inc->lines = TCASM_incremental_count_lines(source, inc->text_begin, inc->text_end);
+  TCASM_incremental_reserve_lines(inc, inc->lines);
+  inc->line_offset[inc->lines] = (uint32_t) inc->text_end;
+  inc->line_addr[inc->lines] = (uint32_t) asm_ptr->text_size;
+  if (!TCASM_incremental_lines(source, inc->text_begin, inc->text_end, asm_ptr->code, asm_ptr->text_size, 0, inc->line_offset, inc->line_addr))
+    return;
+  
+  TCASM_symbol_table_t* symbols = &asm_ptr->symbols;
+  TCASM_incremental_reserve_symbols(inc, symbols->size);
+  for (uint32_t id = TCASM_SYMBOL_KEYWORDS_SIZE; id < symbols->size; ++id) {
+    inc->uses[id] = 0;
+    // uma declaracao nao utilizada depois do texto fica sem tipo, mas tambem
+    // esta definida
+    inc->defined[id] = symbols->type[id] >= TCASM_SYMBOL_ADDRESS_TEXT || symbols->line[id] != 0;
+  }
+  for (size_t i = 0; i < asm_ptr->fixups_size; ++i) {
+    const TCASM_fixup_t* fixup = &asm_ptr->fixups[i];
+    if (fixup->addr >= asm_ptr->text_size)
+      return;
+    ++inc->uses[fixup->symbol];
+    if (symbols->type[fixup->symbol] != TCASM_SYMBOL_ADDRESS_TEXT)
+      symbols->addr[fixup->symbol] = (uint16_t) (asm_ptr->code[fixup->addr] - fixup->offset);
+  }
+  
+  inc->valid = true;
+}
+
+/**
+ * Funcao que percorre as linhas de um trecho da secao de texto, registrando
+ * o inicio de cada uma e o endereco da sua primeira palavra. Cada linha com
+ * algo alem de espacos e comentario eh uma sentenca com exatamente uma
+ * instrucao, cujo tamanho sai do opcode.
+ * @param source Codigo-fonte.
+ * @param begin Inicio do trecho, no inicio de uma linha.
+ * @param end Fim do trecho.
+ * @param code Palavras montadas a partir do trecho.
+ * @param size Quantidade de palavras montadas a partir do trecho.
+ * @param base Endereco da primeira palavra do trecho.
+ * @param offset Vetor para o inicio de cada linha.
+ * @param addr Vetor para o endereco de cada linha.
+ * @return Retorna false se as linhas nao correspondem as palavras montadas.
+ */
+bool TCASM_incremental_lines(const char* source, size_t begin, size_t end, const uint16_t* code, size_t size, uint32_t base, uint32_t* offset, uint32_t* addr) {
+  size_t word = 0;
+  for (size_t line = begin, i = 0; line < end; ++i) {
+    const char* newline = (const char*) memchr(source + line, '\n', end - line);
+    size_t next = newline != NULL ? (size_t) (newline + 1 - source) : end;
+    offset[i] = (uint32_t) line;
+    addr[i] = base + (uint32_t) word;
+    
+    const char* p = TCASM_scan_blanks(source + line, source + next);
+    if (p != source + next && *p != ';' && *p != '\n' && *p != '\r') {
+      if (word >= size || code[word] < TCASM_SYMBOL_INSTRUCTION_OPCODE_ADD || code[word] > TCASM_SYMBOL_INSTRUCTION_OPCODE_STOP)
+        return false;
+      if (code[word] == TCASM_SYMBOL_INSTRUCTION_OPCODE_STOP)
+        word += 1;
+      else if (code[word] == TCASM_SYMBOL_INSTRUCTION_OPCODE_COPY)
+        word += 3;
+      else
+        word += 2;
+    }
+    line = next;
+  }
+  
+  return word == size;
+}
+
+/**
+ * Funcao que conta as linhas que comecam em um trecho do codigo-fonte.
+ * @param source Codigo-fonte.
+ * @param begin Inicio do trecho, no inicio de uma linha.
+ * @param end Fim do trecho.
+ * @return Retorna a quantidade de linhas.
+ */
+size_t TCASM_incremental_count_lines(const char* source, size_t begin, size_t end) {
+  size_t lines = 0;
+  const char* p = source + begin;
+  while ((p = (const char*) memchr(p, '\n', source + end - p)) != NULL) {
+    ++lines;
+    ++p;
+  }
+  if (end > begin && source[end - 1] != '\n')
+    ++lines;
+  return lines;
+}
+
+/**
+ * Funcao para achar o primeiro operando registrado a partir de um endereco.
+ * @param asm_ptr Ponteiro do contexto.
+ * @param addr Endereco.
+ * @return Retorna o indice do operando em asm_ptr->fixups.
+ */
+size_t TCASM_incremental_find_fixup(const TCASM_assembler_t* asm_ptr, uint32_t addr) {
+  size_t low = 0, high = asm_ptr->fixups_size;
+  while (low < high) {
+    size_t mid = low + (high - low)/2;
+    if (asm_ptr->fixups[mid].addr < addr)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+/**
+ * Funcao para achar a linha da secao de texto que comeca em uma posicao do
+ * codigo-fonte.
+ * @param inc Ponteiro do estado da montagem incremental.
+ * @param offset Inicio da linha, ou inc->text_end.
+ * @return Retorna o indice da linha (inc->lines para text_end).
+ */
+size_t TCASM_incremental_find_line(const TCASM_incremental_t* inc, size_t offset) {
+  size_t low = 0, high = inc->lines;
+  while (low < high) {
+    size_t mid = low + (high - low)/2;
+    if (inc->line_offset[mid] < offset)
+      low = mid + 1;
+    else
+      high = mid;
   }
+  return low;
+}
+
+/**
+ * Funcao que garante espaco para um codigo-fonte no estado da montagem
+ * incremental, mantendo o conteudo.
+ * @param inc Ponteiro do estado da montagem incremental.
+ * @param size Tamanho do codigo-fonte.
+ */
+void TCASM_incremental_reserve_source(TCASM_incremental_t* inc, size_t size) {
+  if (inc->source != NULL && inc->source_capacity >= size)
+    return;
+  if (inc->source_capacity == 0)
+    inc->source_capacity = 65536;
+  while (inc->source_capacity < size)
+    inc->source_capacity *= 2;
+  inc->source = (char*) realloc(inc->source, inc->source_capacity);
+}
+
+/**
+ * Funcao que garante espaco para as linhas da secao de texto e a posicao
+ * final, mantendo o conteudo.
+ * @param inc Ponteiro do estado da montagem incremental.
+ * @param lines Quantidade de linhas.
+ */
+void TCASM_incremental_reserve_lines(TCASM_incremental_t* inc, size_t lines) {
+  if (inc->lines_capacity > lines)
+    return;
+  if (inc->lines_capacity == 0)
+    inc->lines_capacity = 1024;
+  while (inc->lines_capacity <= lines)
+    inc->lines_capacity *= 2;
+  inc->line_offset = (uint32_t*) realloc(inc->line_offset, inc->lines_capacity*sizeof(uint32_t));
+  inc->line_addr = (uint32_t*) realloc(inc->line_addr, inc->lines_capacity*sizeof(uint32_t));
+}
+
+/**
+ * Funcao que garante espaco para os vetores indexados pelo id do simbolo,
+ * mantendo o conteudo.
+ * @param inc Ponteiro do estado da montagem incremental.
+ * @param size Quantidade de ids.
+ */
+void TCASM_incremental_reserve_symbols(TCASM_incremental_t* inc, size_t size) {
+  if (inc->symbols_capacity >= size)
+    return;
+  if (inc->symbols_capacity == 0)
+    inc->symbols_capacity = 1024;
+  while (inc->symbols_capacity < size)
+    inc->symbols_capacity *= 2;
+  inc->uses = (uint32_t*) realloc(inc->uses, inc->symbols_capacity*sizeof(uint32_t));
+  inc->defined = (bool*) realloc(inc->defined, inc->symbols_capacity*sizeof(bool));
+}
+
+/**
+ * Funcao que mede o trecho igual no inicio de dois buffers. Compara blocos
+ * inteiros com memcmp e so procura o char diferente no bloco que nao bate.
+ * @param a Primeiro buffer.
+ * @param b Segundo buffer.
+ * @param size Tamanho maximo do trecho.
+ * @return Retorna o tamanho do trecho igual.
+ */
+size_t TCASM_common_prefix(const char* a, const char* b, size_t size) {
+  size_t i = 0;
+  while (i + 4096 <= size && memcmp(a + i, b + i, 4096) == 0)
+    i += 4096;
+  while (i < size && a[i] == b[i])
+    ++i;
+  return i;
+}
+
+/**
+ * Funcao que mede o trecho igual no fim de dois buffers.
+ * @param a_end Fim do primeiro buffer.
+ * @param b_end Fim do segundo buffer.
+ * @param size Tamanho maximo do trecho.
+ * @return Retorna o tamanho do trecho igual.
+ */
+size_t TCASM_common_suffix(const char* a_end, const char* b_end, size_t size) {
+  size_t i = 0;
+  while (i + 4096 <= size && memcmp(a_end - i - 4096, b_end - i - 4096, 4096) == 0)
+    i += 4096;
+  while (i < size && a_end[-1 - (long) i] == b_end[-1 - (long) i])
+    ++i;
+  return i;
 }
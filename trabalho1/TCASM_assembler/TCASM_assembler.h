@@ -1,6 +1,309 @@
 #ifndef TCASM_ASSEMBLER_H_
 #define TCASM_ASSEMBLER_H_
 
-void TCASM_assemble(const char* in, const char* out);
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "TCASM_list.h"
+#include "TCASM_map.h"
+#include "TCASM_object.h"
+#include "TCASM_symbol.h"
+
+/**
+ * Tamanho da memoria da maquina hipotetica, em palavras de 16 bits.
+ */
+#define TCASM_ASSEMBLER_MEMORY_SIZE 65536
+
+/**
+ * Tamanho minimo, em bytes, de cada pedaco da secao de texto na montagem
+ * paralela. Secoes menores que dois pedacos sao montadas sequencialmente.
+ */
+#define TCASM_ASSEMBLER_CHUNK_MIN_SIZE 65536
+
+/**
+ * Enumeracao dos estados da maquina de montagem.
+ */
+typedef enum {
+  TCASM_STATE_SECTION = 0,
+  TCASM_STATE_SECTION_TYPE,
+  TCASM_STATE_TEXT_STATEMENT,
+  TCASM_STATE_DATA_STATEMENT_DATABEFORE,
+  TCASM_STATE_DATA_STATEMENT_DATAAFTER,
+  TCASM_STATE_TEXT,
+  TCASM_STATE_DATA_CREATE_DATABEFORE,
+  TCASM_STATE_DATA_CREATE_DATAAFTER,
+  TCASM_STATE_DATA_DEFINE_VARCONST,
+  TCASM_STATE_DATA_DEFINE_ARRAY,
+  TCASM_STATE_REGULAR,
+  TCASM_STATE_BRANCH,
+  TCASM_STATE_COPY
+} TCASM_state_t;
+
+/**
+ * Linha de um diagnostico que nao se refere a nenhuma linha do codigo-fonte.
+ */
+#define TCASM_DIAGNOSTIC_NO_LINE ((unsigned int) -1)
+
+/**
+ * Gravidade de um diagnostico.
+ */
+typedef enum {
+  TCASM_DIAGNOSTIC_ERROR = 0,
+  TCASM_DIAGNOSTIC_WARNING
+} TCASM_diagnostic_severity_t;
+
+/**
+ * Struct de um diagnostico (erro ou aviso) de uma montagem.
+ */
+typedef struct {
+  /// Gravidade do diagnostico.
+  TCASM_diagnostic_severity_t severity;
+  
+  /// Linha do codigo-fonte, ou TCASM_DIAGNOSTIC_NO_LINE.
+  unsigned int line;
+  
+  /// Mensagem, sem o prefixo "Erro linha N: " e sem '\n'.
+  char* message;
+} TCASM_diagnostic_t;
+
+/**
+ * Struct de um operando que referencia um simbolo (rotulo ou dado). Todo
+ * operando eh registrado na tabela de operandos do contexto, que eh
+ * resolvida de uma vez no fim da montagem e reaproveitada pela montagem
+ * incremental e pelo objeto relocavel.
+ */
+typedef struct {
+  /// Endereco do operando no codigo montado.
+  uint32_t addr;
+  
+  /// Id do simbolo referenciado.
+  uint32_t symbol;
+  
+  /// Linha da sentenca no codigo-fonte.
+  uint32_t line;
+  
+  /// Posicao no vetor (0 para os demais simbolos).
+  uint16_t offset;
+  
+  /// Uso do operando (TCASM_object_use_t).
+  uint8_t use;
+} TCASM_fixup_t;
+
+/**
+ * Struct com o que a montagem incremental guarda da ultima montagem de um
+ * contexto, para montar de novo apenas as linhas alteradas da secao de
+ * texto. Todos os enderecos da secao de texto comecam em 0, e os dados vem
+ * depois dela.
+ */
+typedef struct {
+  /// Indica se a montagem incremental esta ligada. Ligado pela primeira
+  /// chamada de TCASM_assembler_update.
+  bool enabled;
+  
+  /// Indica se o estado abaixo descreve a ultima montagem, que terminou sem
+  /// erros.
+  bool valid;
+  
+  /// Indica se a ultima chamada de TCASM_assembler_update reaproveitou a
+  /// montagem anterior.
+  bool reused;
+  
+  /// Codigo-fonte da ultima montagem, como foi recebido.
+  char* source;
+  
+  /// Tamanho do codigo-fonte.
+  size_t source_size;
+  
+  /// Capacidade do buffer do codigo-fonte.
+  size_t source_capacity;
+  
+  /// Inicio da secao de texto em source (a linha seguinte a SECTION TEXT).
+  size_t text_begin;
+  
+  /// Fim da secao de texto em source.
+  size_t text_end;
+  
+  /// Numero da primeira linha da secao de texto no codigo-fonte.
+  unsigned int text_line;
+  
+  /// Inicio de cada linha da secao de texto em source, seguido de text_end.
+  uint32_t* line_offset;
+  
+  /// Endereco da primeira palavra montada a partir de cada linha da secao de
+  /// texto (ou da seguinte, se ela nao tem sentenca), seguido de text_size.
+  uint32_t* line_addr;
+  
+  /// Quantidade de linhas da secao de texto.
+  size_t lines;
+  
+  /// Capacidade dos vetores de linhas.
+  size_t lines_capacity;
+  
+  /// Quantidade de operandos que referenciam cada simbolo, indexada pelo id.
+  uint32_t* uses;
+  
+  /// Indica, para cada id, se o rotulo ou dado esta definido.
+  bool* defined;
+  
+  /// Capacidade dos vetores indexados pelo id.
+  size_t symbols_capacity;
+  
+  /// Contexto onde as linhas alteradas sao montadas, ou NULL.
+  struct TCASM_assembler_s* scratch;
+} TCASM_incremental_t;
+
+/**
+ * Struct com todo o estado de uma montagem. Contextos diferentes sao
+ * independentes, entao varias montagens podem existir no mesmo processo (as
+ * estatisticas de --stats sao de cada thread). Um contexto pode ser
+ * reutilizado: cada montagem comeca apagando o resultado da anterior.
+ */
+typedef struct TCASM_assembler_s {
+  /// Codigo-fonte inteiro, copiado para a memoria e convertido para
+  /// maiusculas.
+  char* source;
+  
+  /// Capacidade do buffer do codigo-fonte.
+  size_t source_capacity;
+  
+  /// Fim do codigo-fonte (uma posicao depois do ultimo char).
+  const char* source_end;
+  
+  /// Proximo char do codigo-fonte a ser lido.
+  const char* cursor;
+  
+  /// Tabela de simbolos (palavras-chave e identificadores), em colunas
+  /// indexadas pelo id do simbolo.
+  TCASM_symbol_table_t symbols;
+  
+  /// Codigo montado, com o tamanho exato da memoria da maquina hipotetica
+  /// (TCASM_ASSEMBLER_MEMORY_SIZE palavras).
+  uint16_t* code;
+  
+  /// Quantidade de palavras montadas.
+  size_t code_size;
+  
+  /// Quantidade de palavras da secao de texto, que sempre comeca em 0 (os
+  /// dados vem depois dela no codigo montado).
+  size_t text_size;
+  
+  /// Quantidade de palavras de dados, quando a secao de dados vem antes da
+  /// secao de texto.
+  size_t data_size;
+  
+  /// Indica se a secao de codigo ja foi lida.
+  bool text_read;
+  
+  /// Indica se a secao de dados ja foi lida.
+  bool data_read;
+  
+  /// Estado atual da maquina de montagem.
+  TCASM_state_t state;
+  
+  /// Linha sendo lida atualmente no codigo-fonte.
+  unsigned int line;
+  
+  /// Linha em que a ultima sentenca comecou.
+  unsigned int statement_line;
+  
+  /// Inicio da linha atual no codigo-fonte.
+  const char* line_start;
+  
+  /// Coluna do ultimo char valido lido. Apenas atualizada se o mapa de
+  /// enderecos esta sendo gerado.
+  unsigned int column;
+  
+  /// Coluna do inicio da sentenca atual.
+  unsigned int statement_column;
+  
+  /// Caractere que foi lido por ultimo e esta sendo tratado.
+  int ch;
+  
+  /// Quantidade de caracteres retirados do codigo-fonte na ultima leitura.
+  size_t read_chars;
+  
+  /// Quantidade de linhas retiradas do codigo-fonte na ultima leitura.
+  unsigned int read_lines;
+  
+  /// Indica se houve uma mudanca de linha. Consultada por
+  /// TCASM_check_new_line.
+  bool changed_line;
+  
+  /// Palavra sendo lida atualmente. Aponta para o proprio codigo-fonte e nao
+  /// termina em '\0'; o tamanho fica em symbol_size.
+  const char* word;
+  
+  /// Tamanho da palavra sendo lida atualmente.
+  size_t symbol_size;
+  
+  /// Id do simbolo que esta sendo definido (palavra-chave ou identificador).
+  uint32_t symbol_id;
+  
+  /// Pool de onde vem os nos de todas as listas da montagem.
+  TCASM_list_pool_t list_pool;
+  
+  /// Lista de dados declarados. Usada apenas quando a secao de dados vem
+  /// antes da secao de texto.
+  TCASM_list_t datalist;
+  
+  /// Operandos que referenciam simbolos, na ordem dos enderecos.
+  TCASM_fixup_t* fixups;
+  
+  /// Quantidade de operandos registrados.
+  size_t fixups_size;
+  
+  /// Capacidade do vetor de operandos.
+  size_t fixups_capacity;
+  
+  /// Indica se um dado foi definido na secao de dados (depois da secao de
+  /// texto) desde a ultima conferencia dos operandos. Um erro posterior so
+  /// vale se essa conferencia nao encontrar um erro anterior.
+  bool fixups_unchecked;
+  
+  /// Opcode da instrucao que esta sendo montada.
+  uint16_t opcode;
+  
+  /// Indica se esta lendo o segundo operando de um COPY.
+  bool second_op;
+  
+  /// Mapa de enderecos (desligado por padrao).
+  TCASM_map_t map;
+  
+  /// Diagnosticos da ultima montagem, na ordem em que ocorreram. Um erro
+  /// encerra a montagem, entao eh sempre o ultimo.
+  TCASM_diagnostic_t* diagnostics;
+  
+  /// Quantidade de diagnosticos.
+  size_t diagnostics_size;
+  
+  /// Capacidade do vetor de diagnosticos.
+  size_t diagnostics_capacity;
+  
+  /// Ponto de retorno de TCASM_assembler_run quando ocorre um erro.
+  jmp_buf error_jump;
+  
+  /// Quantidade de threads para montar a secao de texto (1 por padrao, que
+  /// monta sequencialmente).
+  unsigned int jobs;
+  
+  /// Indica se a montagem gera um objeto relocavel (desligado por padrao):
+  /// rotulos e dados nao definidos viram importacoes em vez de erros, e os
+  /// operandos de fixups viram relocacoes.
+  bool relocatable;
+  
+  /// Estado da montagem incremental.
+  TCASM_incremental_t incremental;
+} TCASM_assembler_t;
+
+void TCASM_assembler_init(TCASM_assembler_t* asm_ptr);
+void TCASM_assembler_destroy(TCASM_assembler_t* asm_ptr);
+bool TCASM_assembler_run(TCASM_assembler_t* asm_ptr, const char* source, size_t size);
+bool TCASM_assembler_update(TCASM_assembler_t* asm_ptr, const char* source, size_t size);
+void TCASM_assembler_print_diagnostics(const TCASM_assembler_t* asm_ptr, const char* source, FILE* out);
+void TCASM_assembler_object(const TCASM_assembler_t* asm_ptr, TCASM_object_t* object_ptr);
+bool TCASM_assemble(const char* in, const char* out, const char* map_path, const char* listing_path, unsigned int jobs, bool object);
 
 #endif /* TCASM_ASSEMBLER_H_ */
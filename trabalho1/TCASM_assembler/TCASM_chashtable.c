@@ -0,0 +1,263 @@
+#include "TCASM_chashtable.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Capacidade minima de um shard, em slots.
+ */
+#define TCASM_CHASHTABLE_MIN_SHARD_SIZE 16
+
+/**
+ * Tamanho minimo de um bloco da arena de um shard.
+ */
+#define TCASM_CHASHTABLE_CHUNK_SIZE 16384
+
+/**
+ * Alinhamento dos valores guardados na arena.
+ */
+#define TCASM_CHASHTABLE_ALIGN 16
+
+static TCASM_chashtable_shard_t* TCASM_chashtable_shard(TCASM_chashtable_t* chashtable_ptr, size_t hash);
+static TCASM_hashtable_node_t* TCASM_chashtable_find(const TCASM_chashtable_slots_t* slots, size_t hash, const char* key, size_t key_size, size_t* free_slot);
+static TCASM_hashtable_node_t* TCASM_chashtable_create_node(TCASM_chashtable_shard_t* shard, size_t value_size, const char* key, size_t key_size);
+static TCASM_chashtable_slots_t* TCASM_chashtable_alloc(size_t capacity);
+static void TCASM_chashtable_grow(TCASM_chashtable_shard_t* shard);
+
+/**
+ * Funcao para inicializar uma tabela hash concorrente. Nao pode ser chamada
+ * enquanto outra thread usa a tabela.
+ * @param chashtable_ptr Ponteiro da tabela.
+ * @param value_size Tamanho dos elementos armazenados pela tabela.
+ * @param capacity Capacidade inicial total em slots, dividida entre os
+ * shards, ou 0 para usar TCASM_HASHTABLE_DEFAULT_SIZE.
+ */
+void TCASM_chashtable_init(TCASM_chashtable_t* chashtable_ptr, size_t value_size, size_t capacity) {
+  size_t rounded = TCASM_CHASHTABLE_MIN_SHARD_SIZE;
+  while (rounded*TCASM_CHASHTABLE_SHARDS < (capacity ? capacity : TCASM_HASHTABLE_DEFAULT_SIZE))
+    rounded *= 2;
+  
+  chashtable_ptr->value_size = value_size;
+  for (int i = 0; i < TCASM_CHASHTABLE_SHARDS; ++i) {
+    TCASM_chashtable_shard_t* shard = &chashtable_ptr->shard[i];
+    shard->slots = TCASM_chashtable_alloc(rounded);
+    pthread_mutex_init(&shard->lock, NULL);
+    shard->size = 0;
+    shard->chunks = NULL;
+    shard->arena = NULL;
+    shard->arena_left = 0;
+  }
+}
+
+/**
+ * Funcao para liberar toda a memoria de uma tabela hash concorrente. Nao pode
+ * ser chamada enquanto outra thread usa a tabela. Os ponteiros de nos e
+ * valores obtidos da tabela deixam de ser validos.
+ * @param chashtable_ptr Ponteiro da tabela.
+ */
+void TCASM_chashtable_destroy(TCASM_chashtable_t* chashtable_ptr) {
+  for (int i = 0; i < TCASM_CHASHTABLE_SHARDS; ++i) {
+    TCASM_chashtable_shard_t* shard = &chashtable_ptr->shard[i];
+    while (shard->slots != NULL) {
+      TCASM_chashtable_slots_t* retired = shard->slots->retired;
+      free(shard->slots);
+      shard->slots = retired;
+    }
+    while (shard->chunks != NULL) {
+      TCASM_hashtable_chunk_t* next = shard->chunks->next;
+      free(shard->chunks);
+      shard->chunks = next;
+    }
+    pthread_mutex_destroy(&shard->lock);
+    shard->size = 0;
+  }
+}
+
+/**
+ * Funcao para obter um elemento cuja chave eh passada como argumento. Se o
+ * elemento nao existe, a funcao cria e retorna o ponteiro. Pode ser chamada
+ * por varias threads ao mesmo tempo.
+ * @param chashtable_ptr Ponteiro da tabela.
+ * @param key Chave do elemento. Nao precisa terminar em '\0'.
+ * @param key_size Tamanho da chave.
+ * @param created Ponteiro para a funcao retornar true se esta chamada criou
+ * o elemento, ou false em caso contrario. Se o ponteiro for NULL, a funcao
+ * ignora.
+ * @return Retorna o ponteiro do elemento procurado. Precisa ser castado para
+ * o tipo correto.
+ */
+void* TCASM_chashtable_get(TCASM_chashtable_t* chashtable_ptr, const char* key, size_t key_size, bool* created) {
+  return TCASM_chashtable_get_node(chashtable_ptr, key, key_size, created)->value;
+}
+
+/**
+ * Funcao para obter um elemento cuja chave eh passada como argumento. Se o
+ * elemento nao existe, a funcao cria e retorna o ponteiro. Se varias threads
+ * pedem a mesma chave nova ao mesmo tempo, todas recebem o mesmo no, e
+ * apenas uma delas recebe created igual a true. O valor de um no novo eh
+ * zerado antes de o no ficar visivel; o que cada thread escreve nele depois
+ * precisa ser sincronizado por quem usa a tabela.
+ * @param chashtable_ptr Ponteiro da tabela.
+ * @param key Chave do elemento. Nao precisa terminar em '\0'.
+ * @param key_size Tamanho da chave.
+ * @param created Ponteiro para a funcao retornar true se esta chamada criou
+ * o elemento, ou false em caso contrario. Se o ponteiro for NULL, a funcao
+ * ignora.
+ * @return Retorna o ponteiro do no que a tabela utiliza para armazenar o
+ * elemento. O ponteiro continua valido quando a tabela cresce.
+ */
+TCASM_hashtable_node_t* TCASM_chashtable_get_node(TCASM_chashtable_t* chashtable_ptr, const char* key, size_t key_size, bool* created) {
+  if (created != NULL)
+    *created = false;
+  size_t hash = TCASM_hash(key, key_size);
+  TCASM_chashtable_shard_t* shard = TCASM_chashtable_shard(chashtable_ptr, hash);
+  
+  // caminho sem trava: um vetor antigo pode nao ter a chave, mas nunca tem
+  // uma chave errada
+  size_t i;
+  TCASM_hashtable_node_t* node = TCASM_chashtable_find(__atomic_load_n(&shard->slots, __ATOMIC_ACQUIRE), hash, key, key_size, &i);
+  if (node != NULL)
+    return node;
+  
+  // procura de novo com a trava, no vetor atual, pois outra thread pode ter
+  // criado a chave ou trocado o vetor
+  pthread_mutex_lock(&shard->lock);
+  TCASM_chashtable_slots_t* slots = shard->slots;
+  node = TCASM_chashtable_find(slots, hash, key, key_size, &i);
+  if (node == NULL) {
+    if ((shard->size + 1)*4 > slots->capacity*3) {
+      TCASM_chashtable_grow(shard);
+      slots = shard->slots;
+      TCASM_chashtable_find(slots, hash, key, key_size, &i);
+    }
+    node = TCASM_chashtable_create_node(shard, chashtable_ptr->value_size, key, key_size);
+    slots->slot[i].hash = hash;
+    slots->slot[i].key_size = key_size;
+    __atomic_store_n(&slots->slot[i].node, node, __ATOMIC_RELEASE);
+    __atomic_store_n(&shard->size, shard->size + 1, __ATOMIC_RELAXED);
+    if (created != NULL)
+      *created = true;
+  }
+  pthread_mutex_unlock(&shard->lock);
+  return node;
+}
+
+/**
+ * Funcao que retorna a quantidade de elementos da tabela. Se outras threads
+ * estao inserindo, o resultado pode nao incluir as insercoes em andamento.
+ * @param chashtable_ptr Ponteiro da tabela.
+ * @return Retorna a quantidade de elementos.
+ */
+size_t TCASM_chashtable_size(TCASM_chashtable_t* chashtable_ptr) {
+  size_t size = 0;
+  for (int i = 0; i < TCASM_CHASHTABLE_SHARDS; ++i)
+    size += __atomic_load_n(&chashtable_ptr->shard[i].size, __ATOMIC_RELAXED);
+  return size;
+}
+
+/**
+ * Funcao que escolhe o shard de um hash pelos seus 8 bits altos, deixando os
+ * bits baixos para a posicao dentro do shard.
+ * @param chashtable_ptr Ponteiro da tabela.
+ * @param hash Hash da chave.
+ * @return Retorna o shard.
+ */
+TCASM_chashtable_shard_t* TCASM_chashtable_shard(TCASM_chashtable_t* chashtable_ptr, size_t hash) {
+  return &chashtable_ptr->shard[(hash >> (8*sizeof(size_t) - 8)) & (TCASM_CHASHTABLE_SHARDS - 1)];
+}
+
+/**
+ * Funcao que procura uma chave em um vetor de slots, por sondagem linear.
+ * Como nao ha remocoes, um slot vazio encerra a busca.
+ * @param slots Vetor de slots.
+ * @param hash Hash da chave.
+ * @param key Chave do elemento.
+ * @param key_size Tamanho da chave.
+ * @param free_slot Ponteiro para a funcao retornar o indice do slot vazio
+ * que encerrou a busca, se a chave nao foi encontrada.
+ * @return Retorna o no da chave, ou NULL se a chave nao esta no vetor.
+ */
+TCASM_hashtable_node_t* TCASM_chashtable_find(const TCASM_chashtable_slots_t* slots, size_t hash, const char* key, size_t key_size, size_t* free_slot) {
+  size_t mask = slots->capacity - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    const TCASM_chashtable_slot_t* slot = &slots->slot[i];
+    TCASM_hashtable_node_t* node = __atomic_load_n(&slot->node, __ATOMIC_ACQUIRE);
+    if (node == NULL) {
+      *free_slot = i;
+      return NULL;
+    }
+    if (slot->hash == hash && slot->key_size == key_size && memcmp(node->key, key, key_size) == 0)
+      return node;
+  }
+}
+
+/**
+ * Funcao que cria um no na arena do shard, junto com o valor zerado e a
+ * copia da chave. Chamada com a trava do shard.
+ * @param shard Shard da chave.
+ * @param value_size Tamanho do valor.
+ * @param key Chave do elemento.
+ * @param key_size Tamanho da chave.
+ * @return Retorna o no criado.
+ */
+TCASM_hashtable_node_t* TCASM_chashtable_create_node(TCASM_chashtable_shard_t* shard, size_t value_size, const char* key, size_t key_size) {
+  // layout: no, valor e chave, com no e valor alinhados
+  size_t node_size = (sizeof(TCASM_hashtable_node_t) + TCASM_CHASHTABLE_ALIGN - 1) & ~(size_t) (TCASM_CHASHTABLE_ALIGN - 1);
+  size_t value_space = (value_size + TCASM_CHASHTABLE_ALIGN - 1) & ~(size_t) (TCASM_CHASHTABLE_ALIGN - 1);
+  size_t size = node_size + value_space + ((key_size + TCASM_CHASHTABLE_ALIGN) & ~(size_t) (TCASM_CHASHTABLE_ALIGN - 1));
+  
+  if (shard->arena_left < size) {
+    size_t header = (sizeof(TCASM_hashtable_chunk_t) + TCASM_CHASHTABLE_ALIGN - 1) & ~(size_t) (TCASM_CHASHTABLE_ALIGN - 1);
+    size_t chunk_size = header + (size > TCASM_CHASHTABLE_CHUNK_SIZE ? size : TCASM_CHASHTABLE_CHUNK_SIZE);
+    TCASM_hashtable_chunk_t* chunk = (TCASM_hashtable_chunk_t*) malloc(chunk_size);
+    chunk->next = shard->chunks;
+    shard->chunks = chunk;
+    shard->arena = (char*) chunk + header;
+    shard->arena_left = chunk_size - header;
+  }
+  
+  TCASM_hashtable_node_t* node = (TCASM_hashtable_node_t*) shard->arena;
+  node->value = shard->arena + node_size;
+  node->key = shard->arena + node_size + value_space;
+  memset(node->value, 0, value_size);
+  memcpy(node->key, key, key_size);
+  node->key[key_size] = '\0';
+  shard->arena += size;
+  shard->arena_left -= size;
+  return node;
+}
+
+/**
+ * Funcao que aloca um vetor de slots vazio.
+ * @param capacity Quantidade de slots.
+ * @return Retorna o vetor.
+ */
+TCASM_chashtable_slots_t* TCASM_chashtable_alloc(size_t capacity) {
+  TCASM_chashtable_slots_t* slots = (TCASM_chashtable_slots_t*) calloc(1, sizeof(TCASM_chashtable_slots_t) + capacity*sizeof(TCASM_chashtable_slot_t));
+  slots->capacity = capacity;
+  slots->retired = NULL;
+  return slots;
+}
+
+/**
+ * Funcao que dobra a capacidade de um shard. O vetor novo eh preenchido
+ * inteiro antes de ser publicado, e o antigo continua valido para os
+ * leitores que ainda estao nele. Chamada com a trava do shard.
+ * @param shard Shard que sera aumentado.
+ */
+void TCASM_chashtable_grow(TCASM_chashtable_shard_t* shard) {
+  TCASM_chashtable_slots_t* old = shard->slots;
+  TCASM_chashtable_slots_t* slots = TCASM_chashtable_alloc(old->capacity*2);
+  size_t mask = slots->capacity - 1;
+  for (size_t i = 0; i < old->capacity; ++i) {
+    if (old->slot[i].node == NULL)
+      continue;
+    size_t j = old->slot[i].hash & mask;
+    while (slots->slot[j].node != NULL)
+      j = (j + 1) & mask;
+    slots->slot[j] = old->slot[i];
+  }
+  slots->retired = old;
+  __atomic_store_n(&shard->slots, slots, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,89 @@
+#ifndef TCASM_CHASHTABLE_H_
+#define TCASM_CHASHTABLE_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "TCASM_hashtable.h"
+
+/**
+ * Quantidade de shards da tabela hash concorrente (potencia de 2, ate 256).
+ * Os bits altos do hash escolhem o shard, e cada shard tem sua propria
+ * trava.
+ */
+#define TCASM_CHASHTABLE_SHARDS 64
+
+/**
+ * Struct de um slot de um shard. O no eh publicado por ultimo (store com
+ * release), depois do hash e do tamanho da chave; um slot com no NULL esta
+ * vazio.
+ */
+typedef struct {
+  size_t hash;
+  size_t key_size;
+  TCASM_hashtable_node_t* node;
+} TCASM_chashtable_slot_t;
+
+/**
+ * Struct de um vetor de slots de um shard. Quando o shard cresce, o vetor
+ * antigo continua acessivel por retired, pois leitores podem estar
+ * percorrendo ele; so eh liberado em TCASM_chashtable_destroy.
+ */
+typedef struct TCASM_chashtable_slots_s {
+  /// Quantidade de slots (potencia de 2).
+  size_t capacity;
+  
+  /// Vetor anterior do shard, ou NULL.
+  struct TCASM_chashtable_slots_s* retired;
+  
+  /// Slots.
+  TCASM_chashtable_slot_t slot[];
+} TCASM_chashtable_slots_t;
+
+/**
+ * Struct de um shard: uma tabela de enderecamento aberto com sondagem linear
+ * e sua arena de nos. Alinhado a uma linha de cache para que threads em
+ * shards diferentes nao disputem a mesma linha.
+ */
+typedef struct {
+  /// Vetor atual de slots, lido sem trava (load com acquire).
+  TCASM_chashtable_slots_t* slots;
+  
+  /// Trava das insercoes no shard.
+  pthread_mutex_t lock;
+  
+  /// Quantidade de elementos do shard.
+  size_t size;
+  
+  /// Bloco atual da arena (o primeiro da lista de blocos).
+  TCASM_hashtable_chunk_t* chunks;
+  
+  /// Proxima posicao livre no bloco atual.
+  char* arena;
+  
+  /// Bytes livres no bloco atual.
+  size_t arena_left;
+} __attribute__((aligned(64))) TCASM_chashtable_shard_t;
+
+/**
+ * Struct para armazenar uma tabela hash que pode ser compartilhada entre
+ * threads. Buscas de chaves existentes nao usam trava; a criacao de um
+ * elemento trava apenas o shard da chave. Nao ha remocoes, e os nos nunca
+ * mudam de endereco. Nao atualiza TCASM_stats.
+ */
+typedef struct {
+  /// Tamanho dos elementos armazenados pela tabela.
+  size_t value_size;
+  
+  /// Shards.
+  TCASM_chashtable_shard_t shard[TCASM_CHASHTABLE_SHARDS];
+} TCASM_chashtable_t;
+
+void TCASM_chashtable_init(TCASM_chashtable_t* chashtable_ptr, size_t value_size, size_t capacity);
+void TCASM_chashtable_destroy(TCASM_chashtable_t* chashtable_ptr);
+void* TCASM_chashtable_get(TCASM_chashtable_t* chashtable_ptr, const char* key, size_t key_size, bool* created);
+TCASM_hashtable_node_t* TCASM_chashtable_get_node(TCASM_chashtable_t* chashtable_ptr, const char* key, size_t key_size, bool* created);
+size_t TCASM_chashtable_size(TCASM_chashtable_t* chashtable_ptr);
+
+#endif /* TCASM_CHASHTABLE_H_ */
@@ -4,155 +4,290 @@
 #include <stdlib.h>
 #include <string.h>
 
-static size_t TCASM_hash(size_t array_size, const char* key, size_t* key_size);
+#if !defined(TCASM_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "TCASM_stats.h"
+
+/**
+ * Byte de controle de um slot vazio. Slots ocupados guardam os 7 bits baixos
+ * do hash, sempre nao negativos.
+ */
+#define TCASM_HASHTABLE_EMPTY ((int8_t) -128)
+
+/**
+ * Tamanho minimo de um bloco da arena.
+ */
+#define TCASM_HASHTABLE_CHUNK_SIZE 65536
+
+/**
+ * Alinhamento dos valores guardados na arena.
+ */
+#define TCASM_HASHTABLE_ALIGN 16
+
+static TCASM_hashtable_node_t* TCASM_hashtable_find(TCASM_hashtable_t* hashtable_ptr, const char* key, size_t key_size, bool* created);
+static TCASM_hashtable_node_t* TCASM_hashtable_create_node(TCASM_hashtable_t* hashtable_ptr, const char* key, size_t key_size);
+static void TCASM_hashtable_alloc(TCASM_hashtable_t* hashtable_ptr, size_t capacity);
+static void TCASM_hashtable_grow(TCASM_hashtable_t* hashtable_ptr);
+static size_t TCASM_hashtable_free_slot(const TCASM_hashtable_t* hashtable_ptr, size_t hash);
+static uint32_t TCASM_hashtable_match(const int8_t* group, int8_t value);
 
 /**
  * Funcao para inicializar uma tabela hash.
  * @param hashtable_ptr Ponteiro da tabela.
  * @param value_size Tamanho dos elementos armazenados pela tabela.
- * @param array_size Tamanho do vetor da tabela.
+ * @param capacity Capacidade inicial em slots (arredondada para uma potencia
+ * de 2), ou 0 para usar TCASM_HASHTABLE_DEFAULT_SIZE.
  */
-void TCASM_hashtable_init(TCASM_hashtable_t* hashtable_ptr, size_t value_size, size_t array_size) {
+void TCASM_hashtable_init(TCASM_hashtable_t* hashtable_ptr, size_t value_size, size_t capacity) {
   hashtable_ptr->value_size = value_size;
-  hashtable_ptr->array_size = array_size ? array_size : TCASM_HASHTABLE_DEFAULT_SIZE;
+  hashtable_ptr->size = 0;
+  hashtable_ptr->chunks = NULL;
+  hashtable_ptr->arena = NULL;
+  hashtable_ptr->arena_left = 0;
   
-  // cria um vetor de listas nao inicializadas (0 no campo value_size)
-  hashtable_ptr->array = (TCASM_list_t*) calloc(hashtable_ptr->array_size, sizeof(TCASM_list_t));
+  size_t rounded = TCASM_HASHTABLE_GROUP_SIZE;
+  while (rounded < (capacity ? capacity : TCASM_HASHTABLE_DEFAULT_SIZE))
+    rounded *= 2;
+  TCASM_hashtable_alloc(hashtable_ptr, rounded);
+}
+
+/**
+ * Funcao para liberar toda a memoria de uma tabela hash. Os ponteiros de
+ * nos e valores obtidos da tabela deixam de ser validos.
+ * @param hashtable_ptr Ponteiro da tabela.
+ */
+void TCASM_hashtable_destroy(TCASM_hashtable_t* hashtable_ptr) {
+  while (hashtable_ptr->chunks != NULL) {
+    TCASM_hashtable_chunk_t* next = hashtable_ptr->chunks->next;
+    free(hashtable_ptr->chunks);
+    hashtable_ptr->chunks = next;
+  }
+  free(hashtable_ptr->ctrl);
+  free(hashtable_ptr->slots);
+  hashtable_ptr->ctrl = NULL;
+  hashtable_ptr->slots = NULL;
+  hashtable_ptr->capacity = 0;
+  hashtable_ptr->size = 0;
 }
 
 /**
  * Funcao para obter um elemento cuja chave eh passada como argumento. Se o
  * elemento nao existe, a funcao cria e retorna o ponteiro.
  * @param hashtable_ptr Ponteiro da tabela.
- * @param key String chave do elemento.
+ * @param key Chave do elemento. Nao precisa terminar em '\0'.
+ * @param key_size Tamanho da chave.
  * @param created Ponteiro para a funcao retornar true se o elemento foi
  * criado, ou false em caso contrario. Se o ponteiro for NULL, a funcao ignora.
  * @return Retorna o ponteiro do elemento procurado. Precisa ser castado para
  * o tipo correto.
  */
-void* TCASM_hashtable_get(TCASM_hashtable_t* hashtable_ptr, const char* key, bool* created) {
+void* TCASM_hashtable_get(TCASM_hashtable_t* hashtable_ptr, const char* key, size_t key_size, bool* created) {
+  return TCASM_hashtable_get_node(hashtable_ptr, key, key_size, created)->value;
+}
+
+/**
+ * Funcao para obter um elemento cuja chave eh passada como argumento. Se o
+ * elemento nao existe, a funcao cria e retorna o ponteiro.
+ * @param hashtable_ptr Ponteiro da tabela.
+ * @param key Chave do elemento. Nao precisa terminar em '\0'.
+ * @param key_size Tamanho da chave.
+ * @param created Ponteiro para a funcao retornar true se o elemento foi
+ * criado, ou false em caso contrario. Se o ponteiro for NULL, a funcao ignora.
+ * @return Retorna o ponteiro do no que a tabela utiliza para armazenar o
+ * elemento. O ponteiro continua valido quando a tabela cresce.
+ */
+TCASM_hashtable_node_t* TCASM_hashtable_get_node(TCASM_hashtable_t* hashtable_ptr, const char* key, size_t key_size, bool* created) {
+  TCASM_stats_phase_t phase = TCASM_stats_enter(TCASM_STATS_PHASE_SYMBOLS);
+  TCASM_hashtable_node_t* node = TCASM_hashtable_find(hashtable_ptr, key, key_size, created);
+  TCASM_stats_leave(phase);
+  return node;
+}
+
+/**
+ * Funcao que faz a busca de TCASM_hashtable_get_node, criando o elemento se
+ * ele nao existe.
+ * @param hashtable_ptr Ponteiro da tabela.
+ * @param key Chave do elemento. Nao precisa terminar em '\0'.
+ * @param key_size Tamanho da chave.
+ * @param created Ponteiro para a funcao retornar true se o elemento foi
+ * criado, ou false em caso contrario. Se o ponteiro for NULL, a funcao ignora.
+ * @return Retorna o ponteiro do no que a tabela utiliza para armazenar o
+ * elemento.
+ */
+TCASM_hashtable_node_t* TCASM_hashtable_find(TCASM_hashtable_t* hashtable_ptr, const char* key, size_t key_size, bool* created) {
   if (created != NULL)
     *created = false;
-  size_t key_size;
-  TCASM_list_t* elem_list = &hashtable_ptr->array[TCASM_hash(hashtable_ptr->array_size, key, &key_size)];
-  
-  // se a lista nao esta inicializada, ela esta vazia e portanto eh necessario
-  // criar a entrada
-  if (elem_list->value_size == 0) {
-    if (created != NULL)
-      *created = true;
-    TCASM_hashtable_node_t hashtable_node;
-    hashtable_node.key = (char*) malloc(sizeof(char)*(key_size + 1));
-    hashtable_node.value = calloc(1, hashtable_ptr->value_size);
-    strcpy(hashtable_node.key, key);
-    elem_list->value_size = sizeof(TCASM_hashtable_node_t);
-    TCASM_list_insert(elem_list, NULL, &hashtable_node);
-    return ((TCASM_hashtable_node_t*) elem_list->first->value)->value;
-  }
+  size_t hash = TCASM_hash(key, key_size);
+  int8_t tag = (int8_t) (hash & 0x7F);
+  size_t mask = hashtable_ptr->capacity/TCASM_HASHTABLE_GROUP_SIZE - 1;
+  size_t group = (hash >> 7) & mask;
+  TCASM_stats.hash_lookups++;
   
-  // procura a entrada
-  TCASM_list_node_t* elem_list_node = elem_list->first;
-  while (elem_list_node != NULL) {
-    int cmp = strcmp(((TCASM_hashtable_node_t*) elem_list_node->value)->key, key);
-    // node->key == key
-    if (cmp == 0)
-      return ((TCASM_hashtable_node_t*) elem_list_node->value)->value;
-    // node->key < key
-    else if (cmp < 0)
-      elem_list_node = elem_list_node->next;
-    // node->key > key
-    else
+  // sondagem triangular pelos grupos; como nao ha remocoes, um grupo com
+  // slot vazio encerra a busca
+  for (size_t step = 1;; ++step) {
+    const int8_t* ctrl = hashtable_ptr->ctrl + group*TCASM_HASHTABLE_GROUP_SIZE;
+    TCASM_hashtable_slot_t* slots = hashtable_ptr->slots + group*TCASM_HASHTABLE_GROUP_SIZE;
+    TCASM_stats.hash_groups++;
+    
+    for (uint32_t match = TCASM_hashtable_match(ctrl, tag); match != 0; match &= match - 1) {
+      TCASM_hashtable_slot_t* slot = &slots[__builtin_ctz(match)];
+      TCASM_stats.hash_probes++;
+      if (slot->hash == hash && slot->key_size == key_size && memcmp(slot->node->key, key, key_size) == 0)
+        return slot->node;
+    }
+    
+    if (TCASM_hashtable_match(ctrl, TCASM_HASHTABLE_EMPTY) != 0)
       break;
+    group = (group + step) & mask;
   }
   
   // se nao encontrou, cria a entrada
   if (created != NULL)
     *created = true;
-  TCASM_hashtable_node_t hashtable_node;
-  hashtable_node.key = (char*) malloc(sizeof(char)*(key_size + 1));
-  hashtable_node.value = calloc(1, hashtable_ptr->value_size);
-  strcpy(hashtable_node.key, key);
-  TCASM_list_insert(elem_list, elem_list_node, &hashtable_node);
-  if (elem_list_node == NULL)
-    return ((TCASM_hashtable_node_t*) elem_list->last->value)->value;
-  return ((TCASM_hashtable_node_t*) elem_list_node->prev->value)->value;
+  if ((hashtable_ptr->size + 1)*8 > hashtable_ptr->capacity*7)
+    TCASM_hashtable_grow(hashtable_ptr);
+  size_t i = TCASM_hashtable_free_slot(hashtable_ptr, hash);
+  hashtable_ptr->ctrl[i] = tag;
+  hashtable_ptr->slots[i].hash = hash;
+  hashtable_ptr->slots[i].key_size = key_size;
+  hashtable_ptr->slots[i].node = TCASM_hashtable_create_node(hashtable_ptr, key, key_size);
+  hashtable_ptr->size++;
+  return hashtable_ptr->slots[i].node;
 }
 
 /**
- * Funcao para obter um elemento cuja chave eh passada como argumento. Se o
- * elemento nao existe, a funcao cria e retorna o ponteiro.
+ * Funcao que cria um no na arena, junto com o valor zerado e a copia da
+ * chave.
  * @param hashtable_ptr Ponteiro da tabela.
- * @param key String chave do elemento.
- * @param created Ponteiro para a funcao retornar true se o elemento foi
- * criado, ou false em caso contrario. Se o ponteiro for NULL, a funcao ignora.
- * @return Retorna o ponteiro do no de lista que a tabela utiliza para
- * armazenar o elemento.
+ * @param key Chave do elemento.
+ * @param key_size Tamanho da chave.
+ * @return Retorna o no criado.
  */
-TCASM_hashtable_node_t* TCASM_hashtable_get_node(TCASM_hashtable_t* hashtable_ptr, const char* key, bool* created) {
-  if (created != NULL)
-    *created = false;
-  size_t key_size;
-  TCASM_list_t* elem_list = &hashtable_ptr->array[TCASM_hash(hashtable_ptr->array_size, key, &key_size)];
+TCASM_hashtable_node_t* TCASM_hashtable_create_node(TCASM_hashtable_t* hashtable_ptr, const char* key, size_t key_size) {
+  // layout: no, valor e chave, com no e valor alinhados
+  size_t node_size = (sizeof(TCASM_hashtable_node_t) + TCASM_HASHTABLE_ALIGN - 1) & ~(size_t) (TCASM_HASHTABLE_ALIGN - 1);
+  size_t value_size = (hashtable_ptr->value_size + TCASM_HASHTABLE_ALIGN - 1) & ~(size_t) (TCASM_HASHTABLE_ALIGN - 1);
+  size_t size = node_size + value_size + ((key_size + TCASM_HASHTABLE_ALIGN) & ~(size_t) (TCASM_HASHTABLE_ALIGN - 1));
   
-  // se a lista nao esta inicializada, ela esta vazia e portanto eh necessario
-  // criar a entrada
-  if (elem_list->value_size == 0) {
-    if (created != NULL)
-      *created = true;
-    TCASM_hashtable_node_t hashtable_node;
-    hashtable_node.key = (char*) malloc(sizeof(char)*(key_size + 1));
-    hashtable_node.value = calloc(1, hashtable_ptr->value_size);
-    strcpy(hashtable_node.key, key);
-    elem_list->value_size = sizeof(TCASM_hashtable_node_t);
-    TCASM_list_insert(elem_list, NULL, &hashtable_node);
-    return elem_list->first->value;
+  if (hashtable_ptr->arena_left < size) {
+    size_t header = (sizeof(TCASM_hashtable_chunk_t) + TCASM_HASHTABLE_ALIGN - 1) & ~(size_t) (TCASM_HASHTABLE_ALIGN - 1);
+    size_t chunk_size = header + (size > TCASM_HASHTABLE_CHUNK_SIZE ? size : TCASM_HASHTABLE_CHUNK_SIZE);
+    TCASM_hashtable_chunk_t* chunk = (TCASM_hashtable_chunk_t*) malloc(chunk_size);
+    chunk->next = hashtable_ptr->chunks;
+    hashtable_ptr->chunks = chunk;
+    hashtable_ptr->arena = (char*) chunk + header;
+    hashtable_ptr->arena_left = chunk_size - header;
   }
   
-  // procura a entrada
-  TCASM_list_node_t* elem_list_node = elem_list->first;
-  while (elem_list_node != NULL) {
-    int cmp = strcmp(((TCASM_hashtable_node_t*) elem_list_node->value)->key, key);
-    // node->key == key
-    if (cmp == 0)
-      return elem_list_node->value;
-    // node->key < key
-    else if (cmp < 0)
-      elem_list_node = elem_list_node->next;
-    // node->key > key
-    else
-      break;
+  TCASM_hashtable_node_t* node = (TCASM_hashtable_node_t*) hashtable_ptr->arena;
+  node->value = hashtable_ptr->arena + node_size;
+  node->key = hashtable_ptr->arena + node_size + value_size;
+  memset(node->value, 0, hashtable_ptr->value_size);
+  memcpy(node->key, key, key_size);
+  node->key[key_size] = '\0';
+  hashtable_ptr->arena += size;
+  hashtable_ptr->arena_left -= size;
+  return node;
+}
+
+/**
+ * Funcao que aloca os bytes de controle e os slots de uma tabela vazia.
+ * @param hashtable_ptr Ponteiro da tabela.
+ * @param capacity Quantidade de slots.
+ */
+void TCASM_hashtable_alloc(TCASM_hashtable_t* hashtable_ptr, size_t capacity) {
+  hashtable_ptr->capacity = capacity;
+  hashtable_ptr->ctrl = (int8_t*) malloc(capacity);
+  memset(hashtable_ptr->ctrl, TCASM_HASHTABLE_EMPTY, capacity);
+  hashtable_ptr->slots = (TCASM_hashtable_slot_t*) malloc(capacity*sizeof(TCASM_hashtable_slot_t));
+}
+
+/**
+ * Funcao que dobra a capacidade da tabela, reposicionando os slots pelo hash
+ * guardado neles. Os nos nao mudam de lugar.
+ * @param hashtable_ptr Ponteiro da tabela.
+ */
+void TCASM_hashtable_grow(TCASM_hashtable_t* hashtable_ptr) {
+  int8_t* ctrl = hashtable_ptr->ctrl;
+  TCASM_hashtable_slot_t* slots = hashtable_ptr->slots;
+  size_t capacity = hashtable_ptr->capacity;
+  
+  TCASM_hashtable_alloc(hashtable_ptr, capacity*2);
+  for (size_t i = 0; i < capacity; ++i) {
+    if (ctrl[i] == TCASM_HASHTABLE_EMPTY)
+      continue;
+    size_t j = TCASM_hashtable_free_slot(hashtable_ptr, slots[i].hash);
+    hashtable_ptr->ctrl[j] = ctrl[i];
+    hashtable_ptr->slots[j] = slots[i];
   }
   
-  // se nao encontrou, cria a entrada
-  if (created != NULL)
-    *created = true;
-  TCASM_hashtable_node_t hashtable_node;
-  hashtable_node.key = (char*) malloc(sizeof(char)*(key_size + 1));
-  hashtable_node.value = calloc(1, hashtable_ptr->value_size);
-  strcpy(hashtable_node.key, key);
-  TCASM_list_insert(elem_list, elem_list_node, &hashtable_node);
-  if (elem_list_node == NULL)
-    return elem_list->last->value;
-  return elem_list_node->prev->value;
+  free(ctrl);
+  free(slots);
 }
 
 /**
- * Funcao que calcula o hash de uma chave.
- * @param array_size Tamanho do vetor da tabela.
- * @param key String chave do elemento.
- * @param key_size Ponteiro para retornar o tamanho da chave (gambiarra).
- * @return Retorna um indice no vetor de uma tabela hash.
+ * Funcao que procura o primeiro slot vazio na sequencia de sondagem de um
+ * hash.
+ * @param hashtable_ptr Ponteiro da tabela.
+ * @param hash Hash da chave.
+ * @return Retorna o indice do slot.
  */
-size_t TCASM_hash(size_t array_size, const char* key, size_t* key_size) {
-  unsigned h = 0, g, i;
-  for (i = 0; key[i] != '\0'; ++i) {
-    h = (h << 4) + key[i];
-    g = h & 0xF0000000;
-    if (g != 0) {
-       h = h ^ (g >> 24);
-       h = h ^ g;
-    }
+size_t TCASM_hashtable_free_slot(const TCASM_hashtable_t* hashtable_ptr, size_t hash) {
+  size_t mask = hashtable_ptr->capacity/TCASM_HASHTABLE_GROUP_SIZE - 1;
+  size_t group = (hash >> 7) & mask;
+  for (size_t step = 1;; ++step) {
+    uint32_t empty = TCASM_hashtable_match(hashtable_ptr->ctrl + group*TCASM_HASHTABLE_GROUP_SIZE, TCASM_HASHTABLE_EMPTY);
+    if (empty != 0)
+      return group*TCASM_HASHTABLE_GROUP_SIZE + __builtin_ctz(empty);
+    group = (group + step) & mask;
+  }
+}
+
+/**
+ * Funcao que compara um grupo de bytes de controle com um valor.
+ * @param group Primeiro byte do grupo.
+ * @param value Valor procurado.
+ * @return Retorna uma mascara com o bit i ligado se group[i] == value.
+ */
+uint32_t TCASM_hashtable_match(const int8_t* group, int8_t value) {
+#if !defined(TCASM_NO_SIMD) && defined(__SSE2__)
+  __m128i ctrl = _mm_loadu_si128((const __m128i*) group);
+  return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value)));
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < TCASM_HASHTABLE_GROUP_SIZE; ++i)
+    if (group[i] == value)
+      mask |= (uint32_t) 1 << i;
+  return mask;
+#endif
+}
+
+/**
+ * Funcao que calcula o hash de uma chave, lendo 8 bytes por vez.
+ * @param key Chave do elemento.
+ * @param key_size Tamanho da chave.
+ * @return Retorna o hash. Os 7 bits baixos vao para o byte de controle e os
+ * demais escolhem o grupo inicial.
+ */
+size_t TCASM_hash(const char* key, size_t key_size) {
+  uint64_t h = 0x9E3779B97F4A7C15ULL ^ key_size;
+  uint64_t word;
+  for (; key_size >= 8; key += 8, key_size -= 8) {
+    memcpy(&word, key, 8);
+    h = (h ^ word)*0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 31;
   }
-  *key_size = i;
-  return (h*(uint64_t) 999983)%array_size;
+  // ate 7 bytes restantes, lidos um a um para evitar um memcpy de tamanho
+  // variavel
+  word = 0;
+  for (size_t i = 0; i < key_size; ++i)
+    word |= (uint64_t) (unsigned char) key[i] << 8*i;
+  h = (h ^ word)*0xBF58476D1CE4E5B9ULL;
+  h ^= h >> 27;
+  h *= 0x94D049BB133111EBULL;
+  h ^= h >> 31;
+  return (size_t) h;
 }
@@ -3,41 +3,84 @@
 
 #include <stdbool.h>
 #include <stddef.h>
-
-#include "TCASM_list.h"
+#include <stdint.h>
 
 /**
- * Tamanho padrao do vetor da tabela hash.
+ * Capacidade inicial padrao da tabela hash, em slots. A tabela dobra de
+ * tamanho quando passa de 7/8 de ocupacao.
  */
-#define TCASM_HASHTABLE_DEFAULT_SIZE 1201
+#define TCASM_HASHTABLE_DEFAULT_SIZE 256
 
 /**
- * Struct para armazenar uma tabela hash.
+ * Quantidade de slots examinados de uma vez (um grupo de bytes de controle).
  */
-typedef struct {
-  /// Tamanho dos elementos armazenados pela tabela.
-  size_t value_size;
-  
-  /// Tamanho do vetor da tabela.
-  size_t array_size;
-  
-  /// Vetor da tabela.
-  TCASM_list_t* array;
-} TCASM_hashtable_t;
+#define TCASM_HASHTABLE_GROUP_SIZE 16
 
 /**
- * Struct de no de lista para armazenar os dados da tabela hash.
+ * Struct para armazenar os dados de um elemento da tabela hash. Os nos nunca
+ * mudam de endereco, nem quando a tabela cresce.
  */
 typedef struct {
-  /// String chave do elemento.
+  /// String chave do elemento, terminada em '\0'.
   char* key;
   
   /// Valor do elemento.
   void* value;
 } TCASM_hashtable_node_t;
 
-void TCASM_hashtable_init(TCASM_hashtable_t* hashtable_ptr, size_t value_size, size_t array_size);
-void* TCASM_hashtable_get(TCASM_hashtable_t* hashtable_ptr, const char* key, bool* created);
-TCASM_hashtable_node_t* TCASM_hashtable_get_node(TCASM_hashtable_t* hashtable_ptr, const char* key, bool* created);
+/**
+ * Struct de um slot da tabela: hash e tamanho da chave guardados junto do
+ * ponteiro do no, para que a busca so leia a chave quando o hash bate.
+ */
+typedef struct {
+  size_t hash;
+  size_t key_size;
+  TCASM_hashtable_node_t* node;
+} TCASM_hashtable_slot_t;
+
+/**
+ * Struct de um bloco da arena onde ficam os nos, os valores e as chaves.
+ */
+typedef struct TCASM_hashtable_chunk_s {
+  struct TCASM_hashtable_chunk_s* next;
+} TCASM_hashtable_chunk_t;
+
+/**
+ * Struct para armazenar uma tabela hash de enderecamento aberto. Cada slot
+ * tem um byte de controle: TCASM_HASHTABLE_EMPTY, ou os 7 bits baixos do
+ * hash da chave. A busca compara um grupo inteiro de bytes de controle de
+ * uma vez e so examina os slots cujo byte bate.
+ */
+typedef struct {
+  /// Tamanho dos elementos armazenados pela tabela.
+  size_t value_size;
+  
+  /// Quantidade de slots (potencia de 2, multiplo de TCASM_HASHTABLE_GROUP_SIZE).
+  size_t capacity;
+  
+  /// Quantidade de elementos.
+  size_t size;
+  
+  /// Bytes de controle, um por slot.
+  int8_t* ctrl;
+  
+  /// Slots.
+  TCASM_hashtable_slot_t* slots;
+  
+  /// Bloco atual da arena (o primeiro da lista de blocos).
+  TCASM_hashtable_chunk_t* chunks;
+  
+  /// Proxima posicao livre no bloco atual.
+  char* arena;
+  
+  /// Bytes livres no bloco atual.
+  size_t arena_left;
+} TCASM_hashtable_t;
+
+void TCASM_hashtable_init(TCASM_hashtable_t* hashtable_ptr, size_t value_size, size_t capacity);
+void TCASM_hashtable_destroy(TCASM_hashtable_t* hashtable_ptr);
+void* TCASM_hashtable_get(TCASM_hashtable_t* hashtable_ptr, const char* key, size_t key_size, bool* created);
+TCASM_hashtable_node_t* TCASM_hashtable_get_node(TCASM_hashtable_t* hashtable_ptr, const char* key, size_t key_size, bool* created);
+size_t TCASM_hash(const char* key, size_t key_size);
 
 #endif /* TCASM_HASHTABLE_H_ */
@@ -0,0 +1,67 @@
+#include "TCASM_intern.h"
+
+#include <stdlib.h>
+
+/**
+ * Funcao para inicializar um interner vazio.
+ * @param intern_ptr Ponteiro do interner.
+ * @param capacity Capacidade inicial da tabela hash, ou 0 para usar
+ * TCASM_HASHTABLE_DEFAULT_SIZE.
+ */
+void TCASM_intern_init(TCASM_intern_t* intern_ptr, size_t capacity) {
+  TCASM_hashtable_init(&intern_ptr->table, sizeof(uint32_t), capacity);
+  intern_ptr->capacity = intern_ptr->table.capacity;
+  intern_ptr->names = (const char**) malloc(intern_ptr->capacity*sizeof(const char*));
+  intern_ptr->size = 0;
+}
+
+/**
+ * Funcao para liberar toda a memoria de um interner. Os nomes obtidos dele
+ * deixam de ser validos.
+ * @param intern_ptr Ponteiro do interner.
+ */
+void TCASM_intern_destroy(TCASM_intern_t* intern_ptr) {
+  TCASM_hashtable_destroy(&intern_ptr->table);
+  free(intern_ptr->names);
+  intern_ptr->names = NULL;
+  intern_ptr->size = 0;
+  intern_ptr->capacity = 0;
+}
+
+/**
+ * Funcao para obter o id de uma string, criando um novo id se a string
+ * ainda nao foi vista.
+ * @param intern_ptr Ponteiro do interner.
+ * @param str String. Nao precisa terminar em '\0'.
+ * @param size Tamanho da string.
+ * @param created Ponteiro para a funcao retornar true se o id foi criado, ou
+ * false em caso contrario. Se o ponteiro for NULL, a funcao ignora.
+ * @return Retorna o id da string.
+ */
+uint32_t TCASM_intern(TCASM_intern_t* intern_ptr, const char* str, size_t size, bool* created) {
+  bool is_new;
+  TCASM_hashtable_node_t* node = TCASM_hashtable_get_node(&intern_ptr->table, str, size, &is_new);
+  if (created != NULL)
+    *created = is_new;
+  if (!is_new)
+    return *(uint32_t*) node->value;
+  
+  if (intern_ptr->size == intern_ptr->capacity) {
+    intern_ptr->capacity *= 2;
+    intern_ptr->names = (const char**) realloc(intern_ptr->names, intern_ptr->capacity*sizeof(const char*));
+  }
+  uint32_t id = (uint32_t) intern_ptr->size++;
+  intern_ptr->names[id] = node->key;
+  *(uint32_t*) node->value = id;
+  return id;
+}
+
+/**
+ * Funcao que retorna a string de um id.
+ * @param intern_ptr Ponteiro do interner.
+ * @param id Id retornado por TCASM_intern.
+ * @return Retorna a string, terminada em '\0'.
+ */
+const char* TCASM_intern_name(const TCASM_intern_t* intern_ptr, uint32_t id) {
+  return intern_ptr->names[id];
+}
@@ -0,0 +1,36 @@
+#ifndef TCASM_INTERN_H_
+#define TCASM_INTERN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "TCASM_hashtable.h"
+
+/**
+ * Struct para armazenar um conjunto de strings internadas. Cada string
+ * distinta recebe, na primeira vez em que aparece, um id de 32 bits: 0 para
+ * a primeira, 1 para a segunda, e assim por diante. Quem usa o interner
+ * guarda os ids e indexa vetores com eles, sem voltar a comparar strings.
+ */
+typedef struct {
+  /// Tabela hash de cada string para o seu id (uint32_t).
+  TCASM_hashtable_t table;
+  
+  /// Nome de cada id, terminado em '\0'. Aponta para as chaves da tabela,
+  /// que nunca mudam de endereco.
+  const char** names;
+  
+  /// Quantidade de ids.
+  size_t size;
+  
+  /// Capacidade do vetor names.
+  size_t capacity;
+} TCASM_intern_t;
+
+void TCASM_intern_init(TCASM_intern_t* intern_ptr, size_t capacity);
+void TCASM_intern_destroy(TCASM_intern_t* intern_ptr);
+uint32_t TCASM_intern(TCASM_intern_t* intern_ptr, const char* str, size_t size, bool* created);
+const char* TCASM_intern_name(const TCASM_intern_t* intern_ptr, uint32_t id);
+
+#endif /* TCASM_INTERN_H_ */
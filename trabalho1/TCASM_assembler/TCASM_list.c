@@ -1,13 +1,75 @@
 #include "TCASM_list.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "TCASM_stats.h"
+
+static size_t TCASM_list_class(size_t value_size);
+static TCASM_list_node_t* TCASM_list_pool_alloc(TCASM_list_pool_t* pool_ptr, size_t node_class);
+
+/**
+ * Funcao para inicializar um pool de nos vazio.
+ * @param pool_ptr Ponteiro do pool.
+ */
+void TCASM_list_pool_init(TCASM_list_pool_t* pool_ptr) {
+  pool_ptr->chunks = NULL;
+  pool_ptr->arena = NULL;
+  pool_ptr->arena_left = 0;
+  for (int i = 0; i < TCASM_LIST_POOL_CLASSES; ++i)
+    pool_ptr->free[i] = NULL;
+}
+
+/**
+ * Funcao para liberar de uma vez todos os nos de um pool. Todas as listas
+ * que usam o pool deixam de ser validas.
+ * @param pool_ptr Ponteiro do pool.
+ */
+void TCASM_list_pool_destroy(TCASM_list_pool_t* pool_ptr) {
+  while (pool_ptr->chunks != NULL) {
+    TCASM_list_chunk_t* next = pool_ptr->chunks->next;
+    free(pool_ptr->chunks);
+    pool_ptr->chunks = next;
+  }
+  TCASM_list_pool_init(pool_ptr);
+}
+
+/**
+ * Funcao para passar todos os blocos de um pool para outro, que passa a ser
+ * o dono dos nos que vieram deles. Os nos livres da origem sao descartados,
+ * e a origem fica vazia.
+ * @param dst Ponteiro do pool de destino.
+ * @param src Ponteiro do pool de origem.
+ */
+void TCASM_list_pool_merge(TCASM_list_pool_t* dst, TCASM_list_pool_t* src) {
+  if (src->chunks != NULL) {
+    // os blocos entram depois do bloco atual do destino
+    TCASM_list_chunk_t* last = src->chunks;
+    while (last->next != NULL)
+      last = last->next;
+    if (dst->chunks != NULL) {
+      last->next = dst->chunks->next;
+      dst->chunks->next = src->chunks;
+    }
+    else
+      dst->chunks = src->chunks;
+  }
+  TCASM_list_pool_init(src);
+}
+
 /**
  * Funcao para inicializar uma lista.
  * @param list_ptr Ponteiro para a lista a ser inicializada.
+ * @param pool_ptr Pool de onde vem os nos da lista.
+ * @param value_size Tamanho dos elementos da lista.
  */
-void TCASM_list_init(TCASM_list_t* list_ptr, size_t value_size) {
+void TCASM_list_init(TCASM_list_t* list_ptr, TCASM_list_pool_t* pool_ptr, size_t value_size) {
+  if (TCASM_list_class(value_size) >= TCASM_LIST_POOL_CLASSES) {
+    fprintf(stderr, "Erro: Elemento de lista com %zu bytes excede o tamanho maximo do pool\n", value_size);
+    exit(EXIT_FAILURE);
+  }
+  list_ptr->pool = pool_ptr;
   list_ptr->value_size = value_size;
   list_ptr->first = NULL;
   list_ptr->last = NULL;
@@ -19,11 +81,12 @@ void TCASM_list_init(TCASM_list_t* list_ptr, size_t value_size) {
  * @param list_ptr Ponteiro da lista.
  * @param position Ponteiro da posicao que o elemento ira ocupar.
  * O valor NULL insere no fim da lista.
- * @param value Valor que sera inserido.
+ * @param value Valor que sera inserido. Eh copiado para dentro do no.
+ * @return Retorna o no criado.
  */
-void TCASM_list_insert(TCASM_list_t* list_ptr, TCASM_list_node_t* position, void* value) {
-  TCASM_list_node_t* tmp = (TCASM_list_node_t*) malloc(sizeof(TCASM_list_node_t));
-  tmp->value = malloc(list_ptr->value_size);
+TCASM_list_node_t* TCASM_list_insert(TCASM_list_t* list_ptr, TCASM_list_node_t* position, const void* value) {
+  TCASM_list_node_t* tmp = TCASM_list_pool_alloc(list_ptr->pool, TCASM_list_class(list_ptr->value_size));
+  TCASM_stats.list_inserts++;
   memcpy(tmp->value, value, list_ptr->value_size);
   tmp->next = position;
   if (position != NULL) {
@@ -43,10 +106,36 @@ void TCASM_list_insert(TCASM_list_t* list_ptr, TCASM_list_node_t* position, void
       list_ptr->first = tmp;
   }
   list_ptr->size++;
+  return tmp;
 }
 
 /**
- * Funcao para remover da lista o elemento apontado por position.
+ * Funcao para mover todos os elementos de uma lista para o fim de outra, sem
+ * copiar os nos. As duas listas devem ter o mesmo tamanho de elemento, e os
+ * nos movidos passam a voltar para o pool do destino; se os pools forem
+ * diferentes, os blocos da origem precisam ser passados para o destino com
+ * TCASM_list_pool_merge.
+ * @param dst Ponteiro da lista de destino.
+ * @param src Ponteiro da lista de origem, que fica vazia.
+ */
+void TCASM_list_splice(TCASM_list_t* dst, TCASM_list_t* src) {
+  if (src->size == 0)
+    return;
+  src->first->prev = dst->last;
+  if (dst->last != NULL)
+    dst->last->next = src->first;
+  else
+    dst->first = src->first;
+  dst->last = src->last;
+  dst->size += src->size;
+  src->first = NULL;
+  src->last = NULL;
+  src->size = 0;
+}
+
+/**
+ * Funcao para remover da lista o elemento apontado por position, devolvendo
+ * o no (e o valor, que fica nele) para o pool.
  * Se position for NULL, nao remove nada.
  * @param list_ptr Ponteiro da lista que sofrera a operacao.
  * @param position Ponteiro do elemento que sera apagado.
@@ -62,6 +151,68 @@ void TCASM_list_erase(TCASM_list_t* list_ptr, TCASM_list_node_t* position) {
     position->next->prev = position->prev;
   else
     list_ptr->last = position->prev;
-  free(position);
+  TCASM_list_node_t** free_list = &list_ptr->pool->free[TCASM_list_class(list_ptr->value_size)];
+  position->next = *free_list;
+  *free_list = position;
   list_ptr->size--;
 }
+
+/**
+ * Funcao para remover todos os elementos de uma lista. Como os nos ja estao
+ * encadeados pelo campo next, a lista inteira entra na lista livre do pool
+ * de uma vez, sem percorrer os nos.
+ * @param list_ptr Ponteiro da lista.
+ */
+void TCASM_list_clear(TCASM_list_t* list_ptr) {
+  if (list_ptr->size == 0)
+    return;
+  TCASM_list_node_t** free_list = &list_ptr->pool->free[TCASM_list_class(list_ptr->value_size)];
+  list_ptr->last->next = *free_list;
+  *free_list = list_ptr->first;
+  list_ptr->first = NULL;
+  list_ptr->last = NULL;
+  list_ptr->size = 0;
+}
+
+/**
+ * Funcao que calcula a classe de tamanho dos nos de uma lista.
+ * @param value_size Tamanho dos elementos da lista.
+ * @return Retorna a classe: nos da classe c tem (c + 1)*TCASM_LIST_POOL_ALIGN
+ * bytes.
+ */
+size_t TCASM_list_class(size_t value_size) {
+  return (sizeof(TCASM_list_node_t) + value_size - 1)/TCASM_LIST_POOL_ALIGN;
+}
+
+/**
+ * Funcao que obtem um no do pool: da lista livre da classe, se houver, ou
+ * do bloco atual.
+ * @param pool_ptr Ponteiro do pool.
+ * @param node_class Classe de tamanho do no.
+ * @return Retorna o no, com valor nao inicializado.
+ */
+TCASM_list_node_t* TCASM_list_pool_alloc(TCASM_list_pool_t* pool_ptr, size_t node_class) {
+  TCASM_list_node_t* node = pool_ptr->free[node_class];
+  if (node != NULL) {
+    pool_ptr->free[node_class] = node->next;
+    TCASM_stats.list_reused++;
+    return node;
+  }
+  
+  size_t size = (node_class + 1)*TCASM_LIST_POOL_ALIGN;
+  if (pool_ptr->arena_left < size) {
+    size_t header = (sizeof(TCASM_list_chunk_t) + TCASM_LIST_POOL_ALIGN - 1) & ~(size_t) (TCASM_LIST_POOL_ALIGN - 1);
+    TCASM_list_chunk_t* chunk = (TCASM_list_chunk_t*) malloc(header + TCASM_LIST_POOL_CHUNK_SIZE);
+    chunk->next = pool_ptr->chunks;
+    pool_ptr->chunks = chunk;
+    pool_ptr->arena = (char*) chunk + header;
+    pool_ptr->arena_left = TCASM_LIST_POOL_CHUNK_SIZE;
+    TCASM_stats.list_chunks++;
+    TCASM_stats.list_bytes += header + TCASM_LIST_POOL_CHUNK_SIZE;
+  }
+  
+  node = (TCASM_list_node_t*) pool_ptr->arena;
+  pool_ptr->arena += size;
+  pool_ptr->arena_left -= size;
+  return node;
+}
@@ -4,29 +4,79 @@
 #include <stddef.h>
 
 /**
- * Struct para armazenar um no de uma lista, contendo ponteiro para o valor,
- * para o no anterior e para o proximo no.
+ * Tamanho minimo de um bloco do pool de nos.
+ */
+#define TCASM_LIST_POOL_CHUNK_SIZE 65536
+
+/**
+ * Granularidade do tamanho dos nos: cada classe do pool guarda nos de um
+ * multiplo deste tamanho, que tambem eh o alinhamento dos nos.
+ */
+#define TCASM_LIST_POOL_ALIGN 16
+
+/**
+ * Quantidade de classes de tamanho do pool (nos de ate 256 bytes, incluindo
+ * os ponteiros).
+ */
+#define TCASM_LIST_POOL_CLASSES 16
+
+/**
+ * Struct para armazenar um no de uma lista, contendo ponteiro para o no
+ * anterior, para o proximo no e o valor, guardado no proprio no.
  */
 typedef struct TCASM_list_node_s {
-  void* value;
   struct TCASM_list_node_s* prev;
   struct TCASM_list_node_s* next;
+  char value[];
 } TCASM_list_node_t;
 
 /**
- * Struct para armazenar as informacoes de uma lista, contendo o tamanho de
- * um elemento, ponteiro para o primeiro elemento, para o ultimo e uma
- * variavel para armazenar o tamanho.
+ * Struct de um bloco do pool onde ficam os nos.
+ */
+typedef struct TCASM_list_chunk_s {
+  struct TCASM_list_chunk_s* next;
+} TCASM_list_chunk_t;
+
+/**
+ * Struct para armazenar um pool de nos de lista. Os nos sao cortados de
+ * blocos grandes e, quando removidos, voltam para a lista livre da sua
+ * classe de tamanho (encadeada pelo campo next), de onde sao reaproveitados.
+ * A memoria so volta para o sistema em TCASM_list_pool_destroy.
+ */
+typedef struct {
+  /// Bloco atual (o primeiro da lista de blocos).
+  TCASM_list_chunk_t* chunks;
+  
+  /// Proxima posicao livre no bloco atual.
+  char* arena;
+  
+  /// Bytes livres no bloco atual.
+  size_t arena_left;
+  
+  /// Nos livres de cada classe de tamanho.
+  TCASM_list_node_t* free[TCASM_LIST_POOL_CLASSES];
+} TCASM_list_pool_t;
+
+/**
+ * Struct para armazenar as informacoes de uma lista, contendo o pool de onde
+ * vem os nos, o tamanho de um elemento, ponteiro para o primeiro elemento,
+ * para o ultimo e uma variavel para armazenar o tamanho.
  */
 typedef struct {
+  TCASM_list_pool_t* pool;
   size_t value_size;
   TCASM_list_node_t* first;
   TCASM_list_node_t* last;
   size_t size;
 } TCASM_list_t;
 
-void TCASM_list_init(TCASM_list_t* list_ptr, size_t value_size);
-void TCASM_list_insert(TCASM_list_t* list_ptr, TCASM_list_node_t* position, void* value);
+void TCASM_list_pool_init(TCASM_list_pool_t* pool_ptr);
+void TCASM_list_pool_destroy(TCASM_list_pool_t* pool_ptr);
+void TCASM_list_pool_merge(TCASM_list_pool_t* dst, TCASM_list_pool_t* src);
+void TCASM_list_init(TCASM_list_t* list_ptr, TCASM_list_pool_t* pool_ptr, size_t value_size);
+TCASM_list_node_t* TCASM_list_insert(TCASM_list_t* list_ptr, TCASM_list_node_t* position, const void* value);
+void TCASM_list_splice(TCASM_list_t* dst, TCASM_list_t* src);
 void TCASM_list_erase(TCASM_list_t* list_ptr, TCASM_list_node_t* position);
+void TCASM_list_clear(TCASM_list_t* list_ptr);
 
 #endif /* TCASM_LIST_H_ */
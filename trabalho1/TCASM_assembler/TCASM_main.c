@@ -1,16 +1,50 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "TCASM_assembler.h"
+#include "TCASM_stats.h"
 
 int main(int argc, char* argv[]) {
+  const char* map_path = NULL;
+  const char* listing_path = NULL;
+  int jobs = 1;
+  bool object = false;
   
-  if (argc != 3) {
-    fprintf(stderr, "Erro: Argumentos incorretos. Forma de utilizacao: ./TCASM <arquivo_entrada> <arquivo_saida>\n");
+  // opcoes antes dos arquivos de entrada e saida
+  while (argc > 3 && strncmp(argv[1], "--", 2) == 0) {
+    if (strcmp(argv[1], "--stats") == 0)
+      TCASM_stats_enable();
+    else if (strcmp(argv[1], "--object") == 0)
+      object = true;
+    else if (strcmp(argv[1], "--map") == 0 && argc > 4) {
+      map_path = argv[2];
+      ++argv;
+      --argc;
+    }
+    else if (strcmp(argv[1], "--listing") == 0 && argc > 4) {
+      listing_path = argv[2];
+      ++argv;
+      --argc;
+    }
+    else if (strcmp(argv[1], "--jobs") == 0 && argc > 4) {
+      jobs = atoi(argv[2]);
+      ++argv;
+      --argc;
+    }
+    else
+      break;
+    ++argv;
+    --argc;
+  }
+  
+  if (argc != 3 || jobs < 1) {
+    fprintf(stderr, "Erro: Argumentos incorretos. Forma de utilizacao: ./TCASM [--stats] [--map <arquivo_mapa>] [--listing <arquivo_listagem>] [--jobs <threads>] [--object] <arquivo_entrada> <arquivo_saida>\n");
     exit(EXIT_FAILURE);
   }
   
-  TCASM_assemble(argv[1], argv[2]);
+  if (!TCASM_assemble(argv[1], argv[2], map_path, listing_path, (unsigned int) jobs, object))
+    return EXIT_FAILURE;
   
   return 0;
 }
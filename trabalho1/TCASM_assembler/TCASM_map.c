@@ -0,0 +1,295 @@
+#include "TCASM_map.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void TCASM_map_put16(FILE* out, uint16_t value);
+static void TCASM_map_put32(FILE* out, uint32_t value);
+static FILE* TCASM_map_open(const char* path);
+static bool TCASM_map_write_binary(const TCASM_map_t* map_ptr, const char* map_path, const char* source, size_t size);
+static bool TCASM_map_write_listing(const TCASM_map_t* map_ptr, const char* listing_path, const char* source, const uint16_t* code, size_t size);
+
+/**
+ * Funcao para inicializar um mapa de enderecos desligado.
+ * @param map_ptr Ponteiro do mapa.
+ */
+void TCASM_map_init(TCASM_map_t* map_ptr) {
+  map_ptr->enabled = false;
+  map_ptr->words = NULL;
+  map_ptr->symbols = NULL;
+  map_ptr->symbols_size = 0;
+  map_ptr->symbols_capacity = 0;
+}
+
+/**
+ * Funcao para liberar toda a memoria de um mapa de enderecos.
+ * @param map_ptr Ponteiro do mapa.
+ */
+void TCASM_map_destroy(TCASM_map_t* map_ptr) {
+  TCASM_map_clear(map_ptr);
+  free(map_ptr->words);
+  free(map_ptr->symbols);
+  TCASM_map_init(map_ptr);
+}
+
+/**
+ * Funcao para ligar a geracao do mapa de enderecos.
+ * @param map_ptr Ponteiro do mapa.
+ */
+void TCASM_map_enable(TCASM_map_t* map_ptr) {
+  if (map_ptr->words == NULL)
+    map_ptr->words = (TCASM_map_word_t*) calloc(65536, sizeof(TCASM_map_word_t));
+  map_ptr->enabled = true;
+}
+
+/**
+ * Funcao para apagar os simbolos registrados, antes de uma nova montagem.
+ * As palavras sao sobrescritas pela propria montagem.
+ * @param map_ptr Ponteiro do mapa.
+ */
+void TCASM_map_clear(TCASM_map_t* map_ptr) {
+  for (size_t i = 0; i < map_ptr->symbols_size; ++i)
+    free(map_ptr->symbols[i].name);
+  map_ptr->symbols_size = 0;
+}
+
+/**
+ * Funcao para registrar a origem de palavras montadas.
+ * @param map_ptr Ponteiro do mapa.
+ * @param first Endereco da primeira palavra.
+ * @param count Quantidade de palavras.
+ * @param line Linha no codigo-fonte.
+ * @param col Coluna no codigo-fonte.
+ * @param kind Tipo das palavras.
+ */
+void TCASM_map_words(TCASM_map_t* map_ptr, size_t first, size_t count, unsigned int line, unsigned int col, TCASM_map_kind_t kind) {
+  if (!map_ptr->enabled)
+    return;
+  
+  if (col > UINT16_MAX)
+    col = UINT16_MAX;
+  
+  for (size_t i = first; i < first + count; ++i) {
+    map_ptr->words[i].line = line;
+    map_ptr->words[i].col = (uint16_t) col;
+    map_ptr->words[i].kind = (uint8_t) kind;
+  }
+}
+
+/**
+ * Funcao para registrar um simbolo.
+ * @param map_ptr Ponteiro do mapa.
+ * @param name Nome do simbolo (nao precisa terminar em '\0').
+ * @param name_size Tamanho do nome.
+ * @param addr Endereco do simbolo.
+ * @param kind TCASM_MAP_KIND_LABEL ou TCASM_MAP_KIND_DATA.
+ * @return Retorna o indice do simbolo, usado para corrigir o endereco de
+ * dados que so sao alocados no fim da montagem.
+ */
+size_t TCASM_map_symbol(TCASM_map_t* map_ptr, const char* name, size_t name_size, size_t addr, TCASM_map_kind_t kind) {
+  if (!map_ptr->enabled)
+    return 0;
+  
+  if (map_ptr->symbols_size == map_ptr->symbols_capacity) {
+    map_ptr->symbols_capacity = map_ptr->symbols_capacity ? 2*map_ptr->symbols_capacity : 64;
+    map_ptr->symbols = (TCASM_map_symbol_t*) realloc(map_ptr->symbols, map_ptr->symbols_capacity*sizeof(TCASM_map_symbol_t));
+  }
+  
+  TCASM_map_symbol_t* symbol = &map_ptr->symbols[map_ptr->symbols_size];
+  symbol->name = (char*) malloc(name_size + 1);
+  memcpy(symbol->name, name, name_size);
+  symbol->name[name_size] = '\0';
+  symbol->addr = (uint16_t) addr;
+  symbol->kind = (uint8_t) kind;
+  
+  return map_ptr->symbols_size++;
+}
+
+/**
+ * Funcao para escrever o mapa binario e a listagem pedidos.
+ * @param map_ptr Ponteiro do mapa.
+ * @param map_path Arquivo do mapa binario, ou NULL.
+ * @param listing_path Arquivo da listagem, ou NULL.
+ * @param source Nome do arquivo fonte.
+ * @param code Codigo montado.
+ * @param size Quantidade de palavras montadas.
+ * @return Retorna false se algum arquivo nao pode ser aberto.
+ */
+bool TCASM_map_write(const TCASM_map_t* map_ptr, const char* map_path, const char* listing_path, const char* source, const uint16_t* code, size_t size) {
+  if (!map_ptr->enabled)
+    return true;
+  
+  if (map_path != NULL && !TCASM_map_write_binary(map_ptr, map_path, source, size))
+    return false;
+  if (listing_path != NULL && !TCASM_map_write_listing(map_ptr, listing_path, source, code, size))
+    return false;
+  return true;
+}
+
+/**
+ * Funcao para escrever o mapa binario em um arquivo ja aberto (que pode ser
+ * um buffer em memoria, como os de open_memstream). O formato esta descrito
+ * no README.
+ * @param map_ptr Ponteiro do mapa.
+ * @param out Arquivo de saida.
+ * @param source Nome do arquivo fonte.
+ * @param size Quantidade de palavras montadas.
+ */
+void TCASM_map_serialize(const TCASM_map_t* map_ptr, FILE* out, const char* source, size_t size) {
+  size_t source_size = strlen(source);
+  fwrite("TCSM", 1, 4, out);
+  TCASM_map_put16(out, 1);
+  TCASM_map_put16(out, 0);
+  TCASM_map_put32(out, (uint32_t) size);
+  TCASM_map_put32(out, (uint32_t) map_ptr->symbols_size);
+  TCASM_map_put32(out, (uint32_t) source_size);
+  fwrite(source, 1, source_size, out);
+  
+  for (size_t i = 0; i < size; ++i) {
+    TCASM_map_put32(out, map_ptr->words[i].line);
+    TCASM_map_put16(out, map_ptr->words[i].col);
+    fputc(map_ptr->words[i].kind, out);
+    fputc(0, out);
+  }
+  
+  for (size_t i = 0; i < map_ptr->symbols_size; ++i) {
+    size_t name_size = strlen(map_ptr->symbols[i].name);
+    TCASM_map_put16(out, map_ptr->symbols[i].addr);
+    fputc(map_ptr->symbols[i].kind, out);
+    fputc(0, out);
+    TCASM_map_put16(out, (uint16_t) name_size);
+    fwrite(map_ptr->symbols[i].name, 1, name_size, out);
+  }
+}
+
+/**
+ * Funcao para escrever um inteiro de 16 bits em little-endian.
+ * @param out Arquivo de saida.
+ * @param value Inteiro escrito.
+ */
+void TCASM_map_put16(FILE* out, uint16_t value) {
+  fputc(value & 0xFF, out);
+  fputc(value >> 8, out);
+}
+
+/**
+ * Funcao para escrever um inteiro de 32 bits em little-endian.
+ * @param out Arquivo de saida.
+ * @param value Inteiro escrito.
+ */
+void TCASM_map_put32(FILE* out, uint32_t value) {
+  TCASM_map_put16(out, value & 0xFFFF);
+  TCASM_map_put16(out, value >> 16);
+}
+
+/**
+ * Funcao para abrir um arquivo de saida do mapa, avisando na saida de erro
+ * se nao for possivel.
+ * @param path Nome do arquivo.
+ * @return Retorna o arquivo aberto, ou NULL.
+ */
+FILE* TCASM_map_open(const char* path) {
+  FILE* out;
+  if ((out = fopen(path, "wb")) == NULL)
+    fprintf(stderr, "Erro: Nao foi possivel abrir o arquivo \"%s\" para escrita\n", path);
+  return out;
+}
+
+/**
+ * Funcao para escrever o mapa binario. O formato esta descrito no README.
+ * @param map_ptr Ponteiro do mapa.
+ * @param map_path Arquivo do mapa binario.
+ * @param source Nome do arquivo fonte.
+ * @param size Quantidade de palavras montadas.
+ * @return Retorna false se o arquivo nao pode ser aberto.
+ */
+bool TCASM_map_write_binary(const TCASM_map_t* map_ptr, const char* map_path, const char* source, size_t size) {
+  FILE* out = TCASM_map_open(map_path);
+  if (out == NULL)
+    return false;
+  
+  TCASM_map_serialize(map_ptr, out, source, size);
+  fclose(out);
+  return true;
+}
+
+/**
+ * Funcao para escrever a listagem: cada sentenca do fonte ao lado do
+ * endereco e das palavras montadas a partir dela, seguida dos simbolos.
+ * @param map_ptr Ponteiro do mapa.
+ * @param listing_path Arquivo da listagem.
+ * @param source Nome do arquivo fonte.
+ * @param code Codigo montado.
+ * @param size Quantidade de palavras montadas.
+ * @return Retorna false se algum arquivo nao pode ser aberto.
+ */
+bool TCASM_map_write_listing(const TCASM_map_t* map_ptr, const char* listing_path, const char* source, const uint16_t* code, size_t size) {
+  // carrega o fonte inteiro e indexa o inicio de cada linha
+  FILE* fin;
+  if ((fin = fopen(source, "rb")) == NULL) {
+    fprintf(stderr, "Erro: Nao foi possivel abrir o arquivo \"%s\" para leitura\n", source);
+    return false;
+  }
+  fseek(fin, 0, SEEK_END);
+  long text_size = ftell(fin);
+  fseek(fin, 0, SEEK_SET);
+  char* text = (char*) malloc(text_size + 1);
+  text_size = (long) fread(text, 1, text_size, fin);
+  text[text_size] = '\0';
+  fclose(fin);
+  
+  size_t lines_size = 1;
+  for (long i = 0; i < text_size; ++i)
+    if (text[i] == '\n')
+      ++lines_size;
+  char** lines = (char**) malloc((lines_size + 1)*sizeof(char*));
+  lines[0] = NULL;
+  lines[1] = text;
+  for (long i = 0, line = 1; i < text_size; ++i) {
+    if (text[i] == '\n') {
+      text[i] = '\0';
+      if (i > 0 && text[i - 1] == '\r')
+        text[i - 1] = '\0';
+      lines[++line] = &text[i + 1];
+    }
+  }
+  
+  FILE* out = TCASM_map_open(listing_path);
+  if (out == NULL) {
+    free(lines);
+    free(text);
+    return false;
+  }
+  fprintf(out, "; Listagem TCASM de %s\n", source);
+  fprintf(out, "; end  palavras                    linha:col  fonte\n");
+  
+  // agrupa palavras consecutivas vindas da mesma sentenca
+  for (size_t first = 0; first < size;) {
+    const TCASM_map_word_t* word = &map_ptr->words[first];
+    size_t last = first + 1;
+    while (last < size && map_ptr->words[last].line == word->line && map_ptr->words[last].kind != TCASM_MAP_KIND_OPCODE)
+      ++last;
+    
+    char words[40];
+    int words_size = 0;
+    for (size_t i = first; i < last && i < first + 4; ++i)
+      words_size += sprintf(&words[words_size], "%04x ", code[i]);
+    if (last - first > 4)
+      sprintf(&words[words_size], "(%zu)", last - first);
+    
+    const char* line = word->line > 0 && word->line <= lines_size ? lines[word->line] : "";
+    fprintf(out, "%04zx  %-27s %6u:%-3u  %s\n", first, words, (unsigned int) word->line, (unsigned int) word->col, line);
+    
+    first = last;
+  }
+  
+  fprintf(out, "\n; Simbolos\n");
+  for (size_t i = 0; i < map_ptr->symbols_size; ++i)
+    fprintf(out, "%04x  %-6s %s\n", map_ptr->symbols[i].addr, map_ptr->symbols[i].kind == TCASM_MAP_KIND_LABEL ? "rotulo" : "dado", map_ptr->symbols[i].name);
+  
+  fclose(out);
+  free(lines);
+  free(text);
+  return true;
+}
@@ -0,0 +1,81 @@
+#ifndef TCASM_MAP_H_
+#define TCASM_MAP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Tipo de uma palavra montada ou de um simbolo no mapa de enderecos.
+ */
+typedef enum {
+  TCASM_MAP_KIND_NONE = 0,
+  TCASM_MAP_KIND_OPCODE,
+  TCASM_MAP_KIND_OPERAND,
+  TCASM_MAP_KIND_DATA,
+  TCASM_MAP_KIND_LABEL
+} TCASM_map_kind_t;
+
+/**
+ * Struct com a origem de uma palavra montada no codigo-fonte.
+ */
+typedef struct {
+  /// Linha no codigo-fonte (a partir de 1).
+  uint32_t line;
+  
+  /// Coluna no codigo-fonte (a partir de 1).
+  uint16_t col;
+  
+  /// Tipo da palavra (TCASM_map_kind_t).
+  uint8_t kind;
+  
+  /// Sempre 0.
+  uint8_t reserved;
+} TCASM_map_word_t;
+
+/**
+ * Struct com um simbolo (rotulo ou dado) do mapa de enderecos.
+ */
+typedef struct {
+  /// Nome do simbolo.
+  char* name;
+  
+  /// Endereco do simbolo no codigo montado.
+  uint16_t addr;
+  
+  /// TCASM_MAP_KIND_LABEL ou TCASM_MAP_KIND_DATA.
+  uint8_t kind;
+} TCASM_map_symbol_t;
+
+/**
+ * Struct com o mapa de enderecos de uma montagem.
+ */
+typedef struct {
+  /// Indica se o mapa esta sendo gerado. Sem ele, nada eh registrado.
+  bool enabled;
+  
+  /// Origem de cada palavra montada (65536 posicoes, alocadas ao ligar o
+  /// mapa).
+  TCASM_map_word_t* words;
+  
+  /// Simbolos, na ordem em que foram definidos.
+  TCASM_map_symbol_t* symbols;
+  
+  /// Quantidade de simbolos.
+  size_t symbols_size;
+  
+  /// Capacidade do vetor de simbolos.
+  size_t symbols_capacity;
+} TCASM_map_t;
+
+void TCASM_map_init(TCASM_map_t* map_ptr);
+void TCASM_map_destroy(TCASM_map_t* map_ptr);
+void TCASM_map_enable(TCASM_map_t* map_ptr);
+void TCASM_map_clear(TCASM_map_t* map_ptr);
+void TCASM_map_words(TCASM_map_t* map_ptr, size_t first, size_t count, unsigned int line, unsigned int col, TCASM_map_kind_t kind);
+size_t TCASM_map_symbol(TCASM_map_t* map_ptr, const char* name, size_t name_size, size_t addr, TCASM_map_kind_t kind);
+void TCASM_map_serialize(const TCASM_map_t* map_ptr, FILE* out, const char* source, size_t size);
+bool TCASM_map_write(const TCASM_map_t* map_ptr, const char* map_path, const char* listing_path, const char* source, const uint16_t* code, size_t size);
+
+#endif /* TCASM_MAP_H_ */
@@ -0,0 +1,375 @@
+#include "TCASM_object.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "TCASM_hashtable.h"
+
+/**
+ * Struct com a definicao de um nome entre todos os modulos ligados.
+ */
+typedef struct {
+  /// Modulo e indice do simbolo que define o nome.
+  uint32_t object;
+  uint32_t symbol;
+  
+  /// Quantidade de modulos que definem o nome.
+  uint32_t definitions;
+} TCASM_object_definition_t;
+
+static void TCASM_object_put16(FILE* out, uint16_t value);
+static void TCASM_object_put32(FILE* out, uint32_t value);
+static uint16_t TCASM_object_get16(FILE* in);
+static uint32_t TCASM_object_get32(FILE* in);
+static bool TCASM_object_valid(const TCASM_object_t* object_ptr);
+static void TCASM_object_error(const char* name, uint32_t line, const char* message, const char* symbol, FILE* errors);
+
+/**
+ * Funcao para inicializar um objeto vazio.
+ * @param object_ptr Ponteiro do objeto.
+ */
+void TCASM_object_init(TCASM_object_t* object_ptr) {
+  memset(object_ptr, 0, sizeof(TCASM_object_t));
+}
+
+/**
+ * Funcao para liberar toda a memoria de um objeto, que volta a ficar vazio.
+ * @param object_ptr Ponteiro do objeto.
+ */
+void TCASM_object_destroy(TCASM_object_t* object_ptr) {
+  for (size_t i = 0; i < object_ptr->symbols_size; ++i)
+    free(object_ptr->symbols[i].name);
+  free(object_ptr->symbols);
+  free(object_ptr->relocations);
+  free(object_ptr->code);
+  TCASM_object_init(object_ptr);
+}
+
+/**
+ * Funcao para escrever um objeto em um arquivo ja aberto. O formato esta
+ * descrito no README.
+ * @param object_ptr Ponteiro do objeto.
+ * @param out Arquivo de saida.
+ */
+void TCASM_object_serialize(const TCASM_object_t* object_ptr, FILE* out) {
+  fwrite("TCSO", 1, 4, out);
+  TCASM_object_put16(out, 2);
+  TCASM_object_put16(out, 0);
+  TCASM_object_put32(out, (uint32_t) object_ptr->code_size);
+  TCASM_object_put32(out, (uint32_t) object_ptr->text_size);
+  TCASM_object_put32(out, (uint32_t) object_ptr->symbols_size);
+  TCASM_object_put32(out, (uint32_t) object_ptr->relocations_size);
+  
+  for (size_t i = 0; i < object_ptr->code_size; ++i)
+    TCASM_object_put16(out, object_ptr->code[i]);
+  
+  for (size_t i = 0; i < object_ptr->symbols_size; ++i) {
+    const TCASM_object_symbol_t* symbol = &object_ptr->symbols[i];
+    size_t name_size = strlen(symbol->name);
+    fputc(symbol->kind, out);
+    fputc(0, out);
+    TCASM_object_put16(out, symbol->addr);
+    TCASM_object_put16(out, symbol->size);
+    TCASM_object_put16(out, (uint16_t) name_size);
+    fwrite(symbol->name, 1, name_size, out);
+  }
+  
+  for (size_t i = 0; i < object_ptr->relocations_size; ++i) {
+    const TCASM_object_relocation_t* relocation = &object_ptr->relocations[i];
+    TCASM_object_put32(out, relocation->addr);
+    TCASM_object_put32(out, relocation->symbol);
+    TCASM_object_put32(out, relocation->line);
+    TCASM_object_put16(out, relocation->offset);
+    fputc(relocation->use, out);
+    fputc(relocation->indexed, out);
+  }
+}
+
+/**
+ * Funcao para ler um objeto de um arquivo ja aberto. O conteudo anterior do
+ * objeto eh liberado.
+ * @param object_ptr Ponteiro do objeto.
+ * @param in Arquivo de entrada.
+ * @return Retorna false se o arquivo nao eh um objeto valido (o objeto fica
+ * vazio).
+ */
+bool TCASM_object_deserialize(TCASM_object_t* object_ptr, FILE* in) {
+  TCASM_object_destroy(object_ptr);
+  char magic[4];
+  if (fread(magic, 1, 4, in) != 4 || memcmp(magic, "TCSO", 4) != 0 || TCASM_object_get16(in) != 2)
+    return false;
+  TCASM_object_get16(in);
+  size_t code_size = TCASM_object_get32(in);
+  size_t text_size = TCASM_object_get32(in);
+  size_t symbols_size = TCASM_object_get32(in);
+  size_t relocations_size = TCASM_object_get32(in);
+  if (feof(in) || code_size > 65536 || text_size > code_size || relocations_size > code_size || symbols_size > code_size + relocations_size)
+    return false;
+  
+  object_ptr->code = (uint16_t*) malloc((code_size + 1)*sizeof(uint16_t));
+  object_ptr->code_size = code_size;
+  object_ptr->text_size = text_size;
+  for (size_t i = 0; i < code_size; ++i)
+    object_ptr->code[i] = TCASM_object_get16(in);
+  
+  object_ptr->symbols = (TCASM_object_symbol_t*) calloc(symbols_size + 1, sizeof(TCASM_object_symbol_t));
+  for (size_t i = 0; i < symbols_size && !feof(in); ++i) {
+    TCASM_object_symbol_t* symbol = &object_ptr->symbols[i];
+    symbol->kind = (uint8_t) fgetc(in);
+    fgetc(in);
+    symbol->addr = TCASM_object_get16(in);
+    symbol->size = TCASM_object_get16(in);
+    size_t name_size = TCASM_object_get16(in);
+    symbol->name = (char*) malloc(name_size + 1);
+    symbol->name[fread(symbol->name, 1, name_size, in)] = '\0';
+    object_ptr->symbols_size++;
+  }
+  
+  object_ptr->relocations = (TCASM_object_relocation_t*) malloc((relocations_size + 1)*sizeof(TCASM_object_relocation_t));
+  object_ptr->relocations_size = relocations_size;
+  for (size_t i = 0; i < relocations_size; ++i) {
+    TCASM_object_relocation_t* relocation = &object_ptr->relocations[i];
+    relocation->addr = TCASM_object_get32(in);
+    relocation->symbol = TCASM_object_get32(in);
+    relocation->line = TCASM_object_get32(in);
+    relocation->offset = TCASM_object_get16(in);
+    relocation->use = (uint8_t) fgetc(in);
+    relocation->indexed = (uint8_t) fgetc(in);
+  }
+  
+  if (feof(in) || ferror(in) || object_ptr->symbols_size != symbols_size || !TCASM_object_valid(object_ptr)) {
+    TCASM_object_destroy(object_ptr);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Funcao que liga varios objetos em um codigo montado absoluto. As secoes de
+ * texto vem primeiro, na ordem dos objetos (a execucao comeca pelo texto do
+ * primeiro), seguidas dos dados de todos eles. Cada simbolo importado eh
+ * procurado entre os simbolos definidos dos outros modulos e precisa ser
+ * definido por exatamente um deles; nomes definidos por mais de um modulo
+ * so sao erro se algum modulo os importa. Os erros sao escritos em errors,
+ * com o nome do objeto e a linha do fonte do modulo, e todos sao
+ * informados.
+ * @param objects Objetos.
+ * @param names Nome de cada objeto, para as mensagens de erro.
+ * @param count Quantidade de objetos.
+ * @param code Vetor com TCASM_ASSEMBLER_MEMORY_SIZE (65536) palavras para o
+ * codigo ligado.
+ * @param size Ponteiro para retornar a quantidade de palavras ligadas.
+ * @param errors Arquivo para os erros.
+ * @return Retorna true se a ligacao terminou sem erros.
+ */
+bool TCASM_object_link(const TCASM_object_t* objects, const char* const* names, size_t count, uint16_t* code, size_t* size, FILE* errors) {
+  // bases de cada modulo: todos os textos, depois todos os dados
+  size_t* text_base = (size_t*) malloc((count + 1)*sizeof(size_t));
+  size_t* data_base = (size_t*) malloc((count + 1)*sizeof(size_t));
+  size_t* first_symbol = (size_t*) malloc((count + 1)*sizeof(size_t));
+  size_t total = 0, symbols_size = 0;
+  for (size_t i = 0; i < count; ++i) {
+    text_base[i] = total;
+    total += objects[i].text_size;
+    first_symbol[i] = symbols_size;
+    symbols_size += objects[i].symbols_size;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    data_base[i] = total;
+    total += objects[i].code_size - objects[i].text_size;
+  }
+  if (total > 65536) {
+    fprintf(errors, "Erro: Memoria estourada\n");
+    free(text_base);
+    free(data_base);
+    free(first_symbol);
+    return false;
+  }
+  
+  // nomes definidos, com o primeiro modulo que define cada um
+  TCASM_hashtable_t definitions;
+  TCASM_hashtable_init(&definitions, sizeof(TCASM_object_definition_t), TCASM_HASHTABLE_DEFAULT_SIZE);
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t k = 0; k < objects[i].symbols_size; ++k) {
+      const TCASM_object_symbol_t* symbol = &objects[i].symbols[k];
+      if (symbol->kind == TCASM_OBJECT_SYMBOL_IMPORT)
+        continue;
+      bool created;
+      TCASM_object_definition_t* definition = (TCASM_object_definition_t*) TCASM_hashtable_get(&definitions, symbol->name, strlen(symbol->name), &created);
+      if (created) {
+        definition->object = (uint32_t) i;
+        definition->symbol = (uint32_t) k;
+      }
+      definition->definitions++;
+    }
+  }
+  
+  // definicao de cada simbolo (o proprio, se definido no modulo) e o seu
+  // endereco final
+  TCASM_object_definition_t* targets = (TCASM_object_definition_t*) malloc((symbols_size + 1)*sizeof(TCASM_object_definition_t));
+  uint16_t* addrs = (uint16_t*) malloc((symbols_size + 1)*sizeof(uint16_t));
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t k = 0; k < objects[i].symbols_size; ++k) {
+      const TCASM_object_symbol_t* symbol = &objects[i].symbols[k];
+      TCASM_object_definition_t* target = &targets[first_symbol[i] + k];
+      if (symbol->kind == TCASM_OBJECT_SYMBOL_IMPORT) {
+        bool created;
+        *target = *(TCASM_object_definition_t*) TCASM_hashtable_get(&definitions, symbol->name, strlen(symbol->name), &created);
+        continue;
+      }
+      target->object = (uint32_t) i;
+      target->symbol = (uint32_t) k;
+      target->definitions = 1;
+      if (symbol->kind == TCASM_OBJECT_SYMBOL_LABEL)
+        addrs[first_symbol[i] + k] = (uint16_t) (text_base[i] + symbol->addr);
+      else
+        addrs[first_symbol[i] + k] = (uint16_t) (data_base[i] + symbol->addr - objects[i].text_size);
+    }
+  }
+  
+  for (size_t i = 0; i < count; ++i) {
+    const TCASM_object_t* object = &objects[i];
+    memcpy(code + text_base[i], object->code, object->text_size*sizeof(uint16_t));
+    memcpy(code + data_base[i], object->code + object->text_size, (object->code_size - object->text_size)*sizeof(uint16_t));
+  }
+  
+  // relocacoes: as de simbolos importados passam pelas mesmas conferencias
+  // que o montador faz dentro de um modulo
+  bool ok = true;
+  bool* reported = (bool*) calloc(symbols_size + 1, sizeof(bool));
+  for (size_t i = 0; i < count; ++i) {
+    const TCASM_object_t* object = &objects[i];
+    for (size_t r = 0; r < object->relocations_size; ++r) {
+      const TCASM_object_relocation_t* relocation = &object->relocations[r];
+      size_t symbol_index = first_symbol[i] + relocation->symbol;
+      const TCASM_object_definition_t* target = &targets[symbol_index];
+      const char* name = object->symbols[relocation->symbol].name;
+      const char* message = NULL;
+      if (target->definitions == 0)
+        message = "Simbolo '%s' indefinido";
+      else if (target->definitions > 1)
+        message = "Simbolo '%s' definido em mais de um modulo";
+      if (message != NULL) {
+        if (!reported[symbol_index])
+          TCASM_object_error(names[i], relocation->line, message, name, errors);
+        reported[symbol_index] = true;
+        ok = false;
+        continue;
+      }
+      
+      const TCASM_object_t* target_object = &objects[target->object];
+      const TCASM_object_symbol_t* definition = &target_object->symbols[target->symbol];
+      if ((relocation->use == TCASM_OBJECT_USE_BRANCH) != (definition->kind == TCASM_OBJECT_SYMBOL_LABEL))
+        message = "Operando '%s' invalido";
+      else if (relocation->indexed && definition->kind == TCASM_OBJECT_SYMBOL_VAR)
+        message = "Definicao de variavel '%s' inesperada, ao esperar definicao de vetor";
+      else if (relocation->indexed && definition->kind == TCASM_OBJECT_SYMBOL_CONST)
+        message = "Definicao de constante '%s' inesperada, ao esperar definicao de vetor";
+      else if (!relocation->indexed && definition->kind == TCASM_OBJECT_SYMBOL_ARRAY)
+        message = "Definicao de vetor '%s' inesperada, ao esperar definicao de variavel ou constante";
+      else if (definition->kind == TCASM_OBJECT_SYMBOL_CONST && relocation->use == TCASM_OBJECT_USE_WRITE)
+        message = "Escrita na constante '%s'";
+      else if (definition->kind == TCASM_OBJECT_SYMBOL_CONST && relocation->use == TCASM_OBJECT_USE_DIV && target_object->code[definition->addr] == 0)
+        message = "Divisao pela constante '%s', inicializada com valor zero";
+      else if (definition->kind != TCASM_OBJECT_SYMBOL_LABEL && relocation->offset >= definition->size)
+        message = "Acesso a posicao invalida do vetor '%s'";
+      if (message != NULL) {
+        TCASM_object_error(names[i], relocation->line, message, name, errors);
+        ok = false;
+        continue;
+      }
+      
+      size_t site = relocation->addr < object->text_size ? text_base[i] + relocation->addr : data_base[i] + relocation->addr - object->text_size;
+      code[site] = (uint16_t) (addrs[first_symbol[target->object] + target->symbol] + relocation->offset);
+    }
+  }
+  
+  *size = total;
+  free(reported);
+  free(addrs);
+  free(targets);
+  TCASM_hashtable_destroy(&definitions);
+  free(text_base);
+  free(data_base);
+  free(first_symbol);
+  return ok;
+}
+
+/**
+ * Funcao para escrever um inteiro de 16 bits em little-endian.
+ * @param out Arquivo de saida.
+ * @param value Inteiro escrito.
+ */
+void TCASM_object_put16(FILE* out, uint16_t value) {
+  fputc(value & 0xFF, out);
+  fputc(value >> 8, out);
+}
+
+/**
+ * Funcao para escrever um inteiro de 32 bits em little-endian.
+ * @param out Arquivo de saida.
+ * @param value Inteiro escrito.
+ */
+void TCASM_object_put32(FILE* out, uint32_t value) {
+  TCASM_object_put16(out, value & 0xFFFF);
+  TCASM_object_put16(out, value >> 16);
+}
+
+/**
+ * Funcao para ler um inteiro de 16 bits em little-endian.
+ * @param in Arquivo de entrada.
+ * @return Retorna o inteiro lido (lixo no fim do arquivo, que quem chama
+ * confere com feof).
+ */
+uint16_t TCASM_object_get16(FILE* in) {
+  uint16_t low = (uint16_t) fgetc(in) & 0xFF;
+  return (uint16_t) (low | (((uint16_t) fgetc(in) & 0xFF) << 8));
+}
+
+/**
+ * Funcao para ler um inteiro de 32 bits em little-endian.
+ * @param in Arquivo de entrada.
+ * @return Retorna o inteiro lido.
+ */
+uint32_t TCASM_object_get32(FILE* in) {
+  uint32_t low = TCASM_object_get16(in);
+  return low | ((uint32_t) TCASM_object_get16(in) << 16);
+}
+
+/**
+ * Funcao que confere se os simbolos e as relocacoes de um objeto lido
+ * apontam para dentro dele, para que o ligador nao precise conferir.
+ * @param object_ptr Ponteiro do objeto.
+ * @return Retorna true se o objeto eh consistente.
+ */
+bool TCASM_object_valid(const TCASM_object_t* object_ptr) {
+  for (size_t i = 0; i < object_ptr->symbols_size; ++i) {
+    const TCASM_object_symbol_t* symbol = &object_ptr->symbols[i];
+    if (symbol->kind > TCASM_OBJECT_SYMBOL_ARRAY)
+      return false;
+    if (symbol->kind == TCASM_OBJECT_SYMBOL_LABEL && symbol->addr >= object_ptr->text_size)
+      return false;
+    if (symbol->kind >= TCASM_OBJECT_SYMBOL_VAR && (symbol->size == 0 || symbol->addr < object_ptr->text_size || (size_t) symbol->addr + symbol->size > object_ptr->code_size))
+      return false;
+  }
+  for (size_t i = 0; i < object_ptr->relocations_size; ++i) {
+    const TCASM_object_relocation_t* relocation = &object_ptr->relocations[i];
+    if (relocation->addr >= object_ptr->code_size || relocation->symbol >= object_ptr->symbols_size || relocation->use > TCASM_OBJECT_USE_DIV || relocation->indexed > 1 || (relocation->indexed && relocation->use == TCASM_OBJECT_USE_BRANCH))
+      return false;
+  }
+  return true;
+}
+
+/**
+ * Funcao para escrever um erro de ligacao.
+ * @param name Nome do objeto.
+ * @param line Linha do fonte do modulo.
+ * @param message Mensagem, com um %s para o nome do simbolo.
+ * @param symbol Nome do simbolo.
+ * @param errors Arquivo para os erros.
+ */
+void TCASM_object_error(const char* name, uint32_t line, const char* message, const char* symbol, FILE* errors) {
+  fprintf(errors, "%s: Erro linha %u: ", name, (unsigned int) line);
+  fprintf(errors, message, symbol);
+  fputc('\n', errors);
+}
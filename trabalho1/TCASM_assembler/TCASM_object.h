@@ -0,0 +1,107 @@
+#ifndef TCASM_OBJECT_H_
+#define TCASM_OBJECT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Tipo de um simbolo de um objeto relocavel.
+ */
+typedef enum {
+  TCASM_OBJECT_SYMBOL_IMPORT = 0,
+  TCASM_OBJECT_SYMBOL_LABEL,
+  TCASM_OBJECT_SYMBOL_VAR,
+  TCASM_OBJECT_SYMBOL_CONST,
+  TCASM_OBJECT_SYMBOL_ARRAY
+} TCASM_object_symbol_kind_t;
+
+/**
+ * Uso de um operando que referencia um simbolo, para as conferencias que o
+ * ligador faz com os simbolos importados.
+ */
+typedef enum {
+  TCASM_OBJECT_USE_BRANCH = 0,
+  TCASM_OBJECT_USE_READ,
+  TCASM_OBJECT_USE_WRITE,
+  TCASM_OBJECT_USE_DIV
+} TCASM_object_use_t;
+
+/**
+ * Struct com um simbolo (definido ou importado) de um objeto relocavel.
+ */
+typedef struct {
+  /// Nome do simbolo, terminado em '\0'.
+  char* name;
+  
+  /// Tipo do simbolo (TCASM_object_symbol_kind_t).
+  uint8_t kind;
+  
+  /// Endereco no codigo do objeto (0 para importados).
+  uint16_t addr;
+  
+  /// Quantidade de palavras (tamanho do vetor, 1 para os demais dados e 0
+  /// para rotulos e importados).
+  uint16_t size;
+} TCASM_object_symbol_t;
+
+/**
+ * Struct com uma relocacao: um operando que recebe o endereco final de um
+ * simbolo mais uma posicao.
+ */
+typedef struct {
+  /// Endereco do operando no codigo do objeto.
+  uint32_t addr;
+  
+  /// Indice do simbolo no objeto.
+  uint32_t symbol;
+  
+  /// Linha da referencia no codigo-fonte do modulo.
+  uint32_t line;
+  
+  /// Posicao no vetor (0 para os demais simbolos).
+  uint16_t offset;
+  
+  /// Uso do operando (TCASM_object_use_t).
+  uint8_t use;
+  
+  /// 1 se o operando tem posicao de vetor (NOME[i]), 0 caso contrario.
+  uint8_t indexed;
+} TCASM_object_relocation_t;
+
+/**
+ * Struct com um objeto relocavel: o codigo montado de um modulo, com
+ * enderecos a partir de 0, e o que o ligador precisa para reposiciona-lo.
+ * O codigo comeca pela secao de texto, seguida dos dados.
+ */
+typedef struct {
+  /// Codigo montado.
+  uint16_t* code;
+  
+  /// Quantidade de palavras montadas.
+  size_t code_size;
+  
+  /// Quantidade de palavras da secao de texto.
+  size_t text_size;
+  
+  /// Simbolos definidos e importados, na ordem em que apareceram.
+  TCASM_object_symbol_t* symbols;
+  
+  /// Quantidade de simbolos.
+  size_t symbols_size;
+  
+  /// Relocacoes, na ordem dos enderecos.
+  TCASM_object_relocation_t* relocations;
+  
+  /// Quantidade de relocacoes.
+  size_t relocations_size;
+} TCASM_object_t;
+
+void TCASM_object_init(TCASM_object_t* object_ptr);
+void TCASM_object_destroy(TCASM_object_t* object_ptr);
+void TCASM_object_serialize(const TCASM_object_t* object_ptr, FILE* out);
+bool TCASM_object_deserialize(TCASM_object_t* object_ptr, FILE* in);
+bool TCASM_object_link(const TCASM_object_t* objects, const char* const* names, size_t count, uint16_t* code, size_t* size, FILE* errors);
+
+#endif /* TCASM_OBJECT_H_ */
@@ -0,0 +1,23 @@
+#ifndef TCASM_PROBES_H_
+#define TCASM_PROBES_H_
+
+/**
+ * Pontos de instrumentacao USDT do montador (provider "tcasm"). Quando
+ * <sys/sdt.h> esta disponivel, cada ponto vira um nop com uma nota ELF
+ * (.note.stapsdt) que bpftrace, perf e SystemTap encontram sozinhos; sem o
+ * cabecalho, os pontos nao geram codigo nenhum.
+ */
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define TCASM_PROBE1(name, a) DTRACE_PROBE1(tcasm, name, a)
+#define TCASM_PROBE2(name, a, b) DTRACE_PROBE2(tcasm, name, a, b)
+#endif
+#endif
+
+#ifndef TCASM_PROBE1
+#define TCASM_PROBE1(name, a) do {} while (0)
+#define TCASM_PROBE2(name, a, b) do {} while (0)
+#endif
+
+#endif /* TCASM_PROBES_H_ */
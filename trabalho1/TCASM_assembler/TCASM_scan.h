@@ -0,0 +1,148 @@
+#ifndef TCASM_SCAN_H_
+#define TCASM_SCAN_H_
+
+/**
+ * Varredura de classes de caracteres do codigo-fonte (ja em maiusculas):
+ * fim de identificador, fim de uma sequencia de espacos e tabs, e fim de
+ * linha dentro de um comentario. Quando o compilador gera AVX2 (-mavx2) ou
+ * SSE2 (padrao em x86-64), cada funcao classifica 32 ou 16 bytes de uma vez
+ * e termina os ultimos bytes com o laco escalar; definir TCASM_NO_SIMD
+ * forca o laco escalar em tudo. Os dois caminhos devolvem sempre a mesma
+ * posicao.
+ */
+
+#include <stdint.h>
+
+#if !defined(TCASM_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define TCASM_SCAN_WIDTH 32
+#define TCASM_SCAN_NAME "avx2"
+#elif !defined(TCASM_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define TCASM_SCAN_WIDTH 16
+#define TCASM_SCAN_NAME "sse2"
+#else
+#define TCASM_SCAN_NAME "scalar"
+#endif
+
+#ifdef TCASM_SCAN_WIDTH
+#if TCASM_SCAN_WIDTH == 32
+typedef __m256i TCASM_scan_block_t;
+#define TCASM_SCAN_LOAD(p) _mm256_loadu_si256((const __m256i*) (p))
+#define TCASM_SCAN_SET1(c) _mm256_set1_epi8(c)
+#define TCASM_SCAN_EQ(a, b) _mm256_cmpeq_epi8(a, b)
+#define TCASM_SCAN_GT(a, b) _mm256_cmpgt_epi8(a, b)
+#define TCASM_SCAN_AND(a, b) _mm256_and_si256(a, b)
+#define TCASM_SCAN_OR(a, b) _mm256_or_si256(a, b)
+#define TCASM_SCAN_MASK(a) ((uint32_t) _mm256_movemask_epi8(a))
+#else
+typedef __m128i TCASM_scan_block_t;
+#define TCASM_SCAN_LOAD(p) _mm_loadu_si128((const __m128i*) (p))
+#define TCASM_SCAN_SET1(c) _mm_set1_epi8(c)
+#define TCASM_SCAN_EQ(a, b) _mm_cmpeq_epi8(a, b)
+#define TCASM_SCAN_GT(a, b) _mm_cmpgt_epi8(a, b)
+#define TCASM_SCAN_AND(a, b) _mm_and_si128(a, b)
+#define TCASM_SCAN_OR(a, b) _mm_or_si128(a, b)
+#define TCASM_SCAN_MASK(a) ((uint32_t) _mm_movemask_epi8(a))
+#endif
+
+// bits de mascara validos em um bloco
+#define TCASM_SCAN_FULL ((uint32_t) ((1ULL << TCASM_SCAN_WIDTH) - 1))
+
+/**
+ * Marca os bytes de um bloco que estao entre lo e hi (inclusive). A
+ * comparacao eh com sinal, entao bytes >= 0x80 nunca sao marcados.
+ */
+static inline TCASM_scan_block_t TCASM_scan_range(TCASM_scan_block_t block, char lo, char hi) {
+  return TCASM_SCAN_AND(TCASM_SCAN_GT(block, TCASM_SCAN_SET1((char) (lo - 1))), TCASM_SCAN_GT(TCASM_SCAN_SET1((char) (hi + 1)), block));
+}
+#endif
+
+/**
+ * Funcao que avanca sobre os caracteres de um identificador.
+ * @param p Primeiro char a ser examinado.
+ * @param end Fim do codigo-fonte.
+ * @return Retorna o primeiro char que nao eh 'A'-'Z', '0'-'9' ou '_', ou end.
+ */
+static inline const char* TCASM_scan_identifier_scalar(const char* p, const char* end) {
+  for (; p != end; ++p) {
+    char c = *p;
+    if ((c < 'A' || c > 'Z') && (c != '_') && (c < '0' || c > '9'))
+      break;
+  }
+  return p;
+}
+
+/**
+ * Funcao que avanca sobre uma sequencia de espacos e tabs.
+ * @param p Primeiro char a ser examinado.
+ * @param end Fim do codigo-fonte.
+ * @return Retorna o primeiro char que nao eh ' ' ou '\t', ou end.
+ */
+static inline const char* TCASM_scan_blanks_scalar(const char* p, const char* end) {
+  while (p != end && (*p == ' ' || *p == '\t'))
+    ++p;
+  return p;
+}
+
+/**
+ * Funcao que avanca ate o fim da linha.
+ * @param p Primeiro char a ser examinado.
+ * @param end Fim do codigo-fonte.
+ * @return Retorna o primeiro '\r' ou '\n', ou end.
+ */
+static inline const char* TCASM_scan_line_end_scalar(const char* p, const char* end) {
+  while (p != end && *p != '\r' && *p != '\n')
+    ++p;
+  return p;
+}
+
+/**
+ * Mesmo que TCASM_scan_identifier_scalar, em blocos quando possivel.
+ */
+static inline const char* TCASM_scan_identifier(const char* p, const char* end) {
+#ifdef TCASM_SCAN_WIDTH
+  for (; end - p >= TCASM_SCAN_WIDTH; p += TCASM_SCAN_WIDTH) {
+    TCASM_scan_block_t block = TCASM_SCAN_LOAD(p);
+    TCASM_scan_block_t ident = TCASM_SCAN_OR(TCASM_SCAN_OR(TCASM_scan_range(block, 'A', 'Z'), TCASM_scan_range(block, '0', '9')), TCASM_SCAN_EQ(block, TCASM_SCAN_SET1('_')));
+    uint32_t stop = ~TCASM_SCAN_MASK(ident) & TCASM_SCAN_FULL;
+    if (stop != 0)
+      return p + __builtin_ctz(stop);
+  }
+#endif
+  return TCASM_scan_identifier_scalar(p, end);
+}
+
+/**
+ * Mesmo que TCASM_scan_blanks_scalar, em blocos quando possivel.
+ */
+static inline const char* TCASM_scan_blanks(const char* p, const char* end) {
+#ifdef TCASM_SCAN_WIDTH
+  for (; end - p >= TCASM_SCAN_WIDTH; p += TCASM_SCAN_WIDTH) {
+    TCASM_scan_block_t block = TCASM_SCAN_LOAD(p);
+    TCASM_scan_block_t blank = TCASM_SCAN_OR(TCASM_SCAN_EQ(block, TCASM_SCAN_SET1(' ')), TCASM_SCAN_EQ(block, TCASM_SCAN_SET1('\t')));
+    uint32_t stop = ~TCASM_SCAN_MASK(blank) & TCASM_SCAN_FULL;
+    if (stop != 0)
+      return p + __builtin_ctz(stop);
+  }
+#endif
+  return TCASM_scan_blanks_scalar(p, end);
+}
+
+/**
+ * Mesmo que TCASM_scan_line_end_scalar, em blocos quando possivel.
+ */
+static inline const char* TCASM_scan_line_end(const char* p, const char* end) {
+#ifdef TCASM_SCAN_WIDTH
+  for (; end - p >= TCASM_SCAN_WIDTH; p += TCASM_SCAN_WIDTH) {
+    TCASM_scan_block_t block = TCASM_SCAN_LOAD(p);
+    TCASM_scan_block_t eol = TCASM_SCAN_OR(TCASM_SCAN_EQ(block, TCASM_SCAN_SET1('\r')), TCASM_SCAN_EQ(block, TCASM_SCAN_SET1('\n')));
+    uint32_t stop = TCASM_SCAN_MASK(eol);
+    if (stop != 0)
+      return p + __builtin_ctz(stop);
+  }
+#endif
+  return TCASM_scan_line_end_scalar(p, end);
+}
+
+#endif /* TCASM_SCAN_H_ */
@@ -0,0 +1,95 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "TCASM_stats.h"
+
+#include <sys/resource.h>
+#include <time.h>
+
+__thread TCASM_stats_t TCASM_stats;
+
+static uint64_t TCASM_stats_now();
+
+/**
+ * Funcao para ligar a coleta de estatisticas. A montagem comeca na fase de
+ * leitura do fonte.
+ */
+void TCASM_stats_enable() {
+  TCASM_stats.enabled = true;
+  TCASM_stats.phase = TCASM_STATS_PHASE_LEX;
+  TCASM_stats.phase_start = TCASM_stats_now();
+}
+
+/**
+ * Funcao para trocar a fase atual, acumulando o tempo gasto na anterior.
+ * @param phase Fase que comeca.
+ * @return Retorna a fase anterior, que deve ser passada para
+ * TCASM_stats_leave.
+ */
+TCASM_stats_phase_t TCASM_stats_enter(TCASM_stats_phase_t phase) {
+  TCASM_stats_phase_t previous = TCASM_stats.phase;
+  if (TCASM_stats.enabled) {
+    uint64_t now = TCASM_stats_now();
+    TCASM_stats.phase_time[previous] += now - TCASM_stats.phase_start;
+    TCASM_stats.phase_start = now;
+    TCASM_stats.phase = phase;
+  }
+  return previous;
+}
+
+/**
+ * Funcao para voltar para a fase anterior a um TCASM_stats_enter.
+ * @param previous Fase retornada por TCASM_stats_enter.
+ */
+void TCASM_stats_leave(TCASM_stats_phase_t previous) {
+  TCASM_stats_enter(previous);
+}
+
+/**
+ * Funcao para imprimir as estatisticas da montagem.
+ * @param out Arquivo de saida.
+ * @param table Tabela de simbolos usada na montagem.
+ */
+void TCASM_stats_print(FILE* out, const TCASM_hashtable_t* table) {
+  static const char* names[TCASM_STATS_PHASE_COUNT] = {
+    "leitura do fonte",
+    "tabela de simbolos",
+    "resolucao de referencias",
+    "escrita da saida"
+  };
+  
+  TCASM_stats_enter(TCASM_stats.phase);
+  
+  uint64_t total = 0;
+  for (int i = 0; i < TCASM_STATS_PHASE_COUNT; ++i)
+    total += TCASM_stats.phase_time[i];
+  
+  fprintf(out, "Tempo por fase:\n");
+  for (int i = 0; i < TCASM_STATS_PHASE_COUNT; ++i)
+    fprintf(out, "  %-26s %10.3f ms  %5.1f%%\n", names[i], TCASM_stats.phase_time[i]/1e6, total ? 100.0*TCASM_stats.phase_time[i]/total : 0.0);
+  fprintf(out, "  %-26s %10.3f ms\n", "total", total/1e6);
+  
+  fprintf(out, "Tabela hash:\n");
+  fprintf(out, "  simbolos                   %10zu\n", table->size);
+  fprintf(out, "  slots                      %10zu (%.1f%% ocupados)\n", table->capacity, table->capacity ? 100.0*table->size/table->capacity : 0.0);
+  fprintf(out, "  buscas                     %10zu\n", TCASM_stats.hash_lookups);
+  fprintf(out, "  grupos examinados          %10zu (%.2f por busca)\n", TCASM_stats.hash_groups, TCASM_stats.hash_lookups ? (double) TCASM_stats.hash_groups/TCASM_stats.hash_lookups : 0.0);
+  fprintf(out, "  comparacoes de chave       %10zu (%.2f por busca)\n", TCASM_stats.hash_probes, TCASM_stats.hash_lookups ? (double) TCASM_stats.hash_probes/TCASM_stats.hash_lookups : 0.0);
+  
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  
+  fprintf(out, "Memoria:\n");
+  fprintf(out, "  TCASM_list_insert          %10zu (%zu nos reaproveitados)\n", TCASM_stats.list_inserts, TCASM_stats.list_reused);
+  fprintf(out, "  blocos do pool de nos      %10zu (%zu bytes)\n", TCASM_stats.list_chunks, TCASM_stats.list_bytes);
+  fprintf(out, "  pico (maxrss)              %10ld KiB\n", usage.ru_maxrss);
+}
+
+/**
+ * Funcao que retorna o tempo monotonico atual.
+ * @return Retorna o tempo em nanossegundos.
+ */
+uint64_t TCASM_stats_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec*1000000000 + ts.tv_nsec;
+}
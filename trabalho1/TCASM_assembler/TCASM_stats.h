@@ -0,0 +1,70 @@
+#ifndef TCASM_STATS_H_
+#define TCASM_STATS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "TCASM_hashtable.h"
+
+/**
+ * Enumeracao das fases da montagem medidas pela opcao --stats. O tempo de
+ * cada fase eh exclusivo: uma busca na tabela de simbolos feita durante a
+ * leitura do fonte conta apenas como tabela de simbolos.
+ */
+typedef enum {
+  TCASM_STATS_PHASE_LEX = 0,
+  TCASM_STATS_PHASE_SYMBOLS,
+  TCASM_STATS_PHASE_RESOLVE,
+  TCASM_STATS_PHASE_WRITE,
+  TCASM_STATS_PHASE_COUNT
+} TCASM_stats_phase_t;
+
+/**
+ * Struct com as estatisticas coletadas durante a montagem. Cada thread tem
+ * as suas, entao montagens em threads diferentes nao disputam os contadores.
+ */
+typedef struct {
+  /// Indica se a opcao --stats foi passada. Sem ela, nenhum tempo eh medido.
+  bool enabled;
+  
+  /// Fase atual.
+  TCASM_stats_phase_t phase;
+  
+  /// Instante em que a fase atual comecou, em nanossegundos.
+  uint64_t phase_start;
+  
+  /// Tempo acumulado em cada fase, em nanossegundos.
+  uint64_t phase_time[TCASM_STATS_PHASE_COUNT];
+  
+  /// Quantidade de buscas na tabela hash.
+  size_t hash_lookups;
+  
+  /// Quantidade de grupos de slots examinados durante as buscas.
+  size_t hash_groups;
+  
+  /// Quantidade de chaves comparadas durante as buscas.
+  size_t hash_probes;
+  
+  /// Quantidade de chamadas a TCASM_list_insert.
+  size_t list_inserts;
+  
+  /// Quantidade de nos de lista reaproveitados da lista livre do pool.
+  size_t list_reused;
+  
+  /// Quantidade de blocos alocados pelos pools de nos de lista.
+  size_t list_chunks;
+  
+  /// Bytes alocados pelos pools de nos de lista.
+  size_t list_bytes;
+} TCASM_stats_t;
+
+extern __thread TCASM_stats_t TCASM_stats;
+
+void TCASM_stats_enable();
+TCASM_stats_phase_t TCASM_stats_enter(TCASM_stats_phase_t phase);
+void TCASM_stats_leave(TCASM_stats_phase_t previous);
+void TCASM_stats_print(FILE* out, const TCASM_hashtable_t* table);
+
+#endif /* TCASM_STATS_H_ */
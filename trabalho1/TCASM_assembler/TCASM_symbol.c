@@ -1,82 +1,164 @@
 #include "TCASM_symbol.h"
 
 #include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
 
 /**
- * Funcao para inicializar a tabela de simbolos com os simbolos pre-definidos.
- * @param table Ponteiro da tabela hash que sera utilizada.
+ * Struct de uma palavra-chave: nome, tamanho do nome, tipo e opcode (apenas
+ * instrucoes).
  */
-void TCASM_symbol_init(TCASM_hashtable_t* table) {
-  TCASM_symbol_t* sym;
-  
-  sym = (TCASM_symbol_t*) TCASM_hashtable_get(table, "SECTION", NULL);
-  sym->type = TCASM_SYMBOL_DIRECTIVE_SECTION;
+typedef struct {
+  const char* name;
+  size_t name_size;
+  TCASM_symbol_type_t type;
+  uint16_t opcode;
+} TCASM_symbol_keyword_t;
 
-  sym = (TCASM_symbol_t*) TCASM_hashtable_get(table, "SPACE", NULL);
-  sym->type = TCASM_SYMBOL_DIRECTIVE_SPACE;
-  
-  sym = (TCASM_symbol_t*) TCASM_hashtable_get(table, "CONST", NULL);
-  sym->type = TCASM_SYMBOL_DIRECTIVE_CONST;
+/**
+ * Palavras-chave indexadas pelo hash perfeito de TCASM_symbol_keyword.
+ * Gerada por tools/TCASM_keyword_hash.py; posicoes sem palavra-chave tem nome
+ * NULL. Sao apenas lidas, por isso podem ser compartilhadas por qualquer
+ * montagem.
+ */
+static const TCASM_symbol_keyword_t TCASM_symbol_keywords[TCASM_SYMBOL_KEYWORDS_SIZE] = {
+  [0] = {"JMPN", 4, TCASM_SYMBOL_INSTRUCTION_REGULAR, TCASM_SYMBOL_INSTRUCTION_OPCODE_JMPN},
+  [4] = {"DATA", 4, TCASM_SYMBOL_DIRECTIVE_SECTION_TYPE, 0},
+  [7] = {"COPY", 4, TCASM_SYMBOL_INSTRUCTION_COPY, TCASM_SYMBOL_INSTRUCTION_OPCODE_COPY},
+  [8] = {"JMPZ", 4, TCASM_SYMBOL_INSTRUCTION_REGULAR, TCASM_SYMBOL_INSTRUCTION_OPCODE_JMPZ},
+  [10] = {"CONST", 5, TCASM_SYMBOL_DIRECTIVE_CONST, 0},
+  [11] = {"JMP", 3, TCASM_SYMBOL_INSTRUCTION_REGULAR, TCASM_SYMBOL_INSTRUCTION_OPCODE_JMP},
+  [12] = {"JMPP", 4, TCASM_SYMBOL_INSTRUCTION_REGULAR, TCASM_SYMBOL_INSTRUCTION_OPCODE_JMPP},
+  [14] = {"STORE", 5, TCASM_SYMBOL_INSTRUCTION_REGULAR, TCASM_SYMBOL_INSTRUCTION_OPCODE_STORE},
+  [15] = {"STOP", 4, TCASM_SYMBOL_INSTRUCTION_STOP, TCASM_SYMBOL_INSTRUCTION_OPCODE_STOP},
+  [16] = {"SUB", 3, TCASM_SYMBOL_INSTRUCTION_REGULAR, TCASM_SYMBOL_INSTRUCTION_OPCODE_SUB},
+  [17] = {"DIV", 3, TCASM_SYMBOL_INSTRUCTION_REGULAR, TCASM_SYMBOL_INSTRUCTION_OPCODE_DIV},
+  [18] = {"LOAD", 4, TCASM_SYMBOL_INSTRUCTION_REGULAR, TCASM_SYMBOL_INSTRUCTION_OPCODE_LOAD},
+  [20] = {"ADD", 3, TCASM_SYMBOL_INSTRUCTION_REGULAR, TCASM_SYMBOL_INSTRUCTION_OPCODE_ADD},
+  [22] = {"SPACE", 5, TCASM_SYMBOL_DIRECTIVE_SPACE, 0},
+  [23] = {"MULT", 4, TCASM_SYMBOL_INSTRUCTION_REGULAR, TCASM_SYMBOL_INSTRUCTION_OPCODE_MULT},
+  [26] = {"INPUT", 5, TCASM_SYMBOL_INSTRUCTION_REGULAR, TCASM_SYMBOL_INSTRUCTION_OPCODE_INPUT},
+  [27] = {"OUTPUT", 6, TCASM_SYMBOL_INSTRUCTION_REGULAR, TCASM_SYMBOL_INSTRUCTION_OPCODE_OUTPUT},
+  [28] = {"SECTION", 7, TCASM_SYMBOL_DIRECTIVE_SECTION, 0},
+  [30] = {"TEXT", 4, TCASM_SYMBOL_DIRECTIVE_SECTION_TYPE, 0},
+};
 
-  sym = (TCASM_symbol_t*) TCASM_hashtable_get(table, "TEXT", NULL);
-  sym->type = TCASM_SYMBOL_DIRECTIVE_SECTION_TYPE;
-  
-  sym = (TCASM_symbol_t*) TCASM_hashtable_get(table, "DATA", NULL);
-  sym->type = TCASM_SYMBOL_DIRECTIVE_SECTION_TYPE;
-  
-  sym = (TCASM_symbol_t*) TCASM_hashtable_get(table, "ADD", NULL);
-  sym->type = TCASM_SYMBOL_INSTRUCTION_REGULAR;
-  sym->sym_union.instr.opcode = TCASM_SYMBOL_INSTRUCTION_OPCODE_ADD;
-  
-  sym = (TCASM_symbol_t*) TCASM_hashtable_get(table, "SUB", NULL);
-  sym->type = TCASM_SYMBOL_INSTRUCTION_REGULAR;
-  sym->sym_union.instr.opcode = TCASM_SYMBOL_INSTRUCTION_OPCODE_SUB;
-  
-  sym = (TCASM_symbol_t*) TCASM_hashtable_get(table, "MULT", NULL);
-  sym->type = TCASM_SYMBOL_INSTRUCTION_REGULAR;
-  sym->sym_union.instr.opcode = TCASM_SYMBOL_INSTRUCTION_OPCODE_MULT;
-  
-  sym = (TCASM_symbol_t*) TCASM_hashtable_get(table, "DIV", NULL);
-  sym->type = TCASM_SYMBOL_INSTRUCTION_REGULAR;
-  sym->sym_union.instr.opcode = TCASM_SYMBOL_INSTRUCTION_OPCODE_DIV;
-  
-  sym = (TCASM_symbol_t*) TCASM_hashtable_get(table, "JMP", NULL);
-  sym->type = TCASM_SYMBOL_INSTRUCTION_REGULAR;
-  sym->sym_union.instr.opcode = TCASM_SYMBOL_INSTRUCTION_OPCODE_JMP;
-  
-  sym = (TCASM_symbol_t*) TCASM_hashtable_get(table, "JMPN", NULL);
-  sym->type = TCASM_SYMBOL_INSTRUCTION_REGULAR;
-  sym->sym_union.instr.opcode = TCASM_SYMBOL_INSTRUCTION_OPCODE_JMPN;
-  
-  sym = (TCASM_symbol_t*) TCASM_hashtable_get(table, "JMPP", NULL);
-  sym->type = TCASM_SYMBOL_INSTRUCTION_REGULAR;
-  sym->sym_union.instr.opcode = TCASM_SYMBOL_INSTRUCTION_OPCODE_JMPP;
-  
-  sym = (TCASM_symbol_t*) TCASM_hashtable_get(table, "JMPZ", NULL);
-  sym->type = TCASM_SYMBOL_INSTRUCTION_REGULAR;
-  sym->sym_union.instr.opcode = TCASM_SYMBOL_INSTRUCTION_OPCODE_JMPZ;
-  
-  sym = (TCASM_symbol_t*) TCASM_hashtable_get(table, "COPY", NULL);
-  sym->type = TCASM_SYMBOL_INSTRUCTION_COPY;
-  sym->sym_union.instr.opcode = TCASM_SYMBOL_INSTRUCTION_OPCODE_COPY;
-  
-  sym = (TCASM_symbol_t*) TCASM_hashtable_get(table, "LOAD", NULL);
-  sym->type = TCASM_SYMBOL_INSTRUCTION_REGULAR;
-  sym->sym_union.instr.opcode = TCASM_SYMBOL_INSTRUCTION_OPCODE_LOAD;
-  
-  sym = (TCASM_symbol_t*) TCASM_hashtable_get(table, "STORE", NULL);
-  sym->type = TCASM_SYMBOL_INSTRUCTION_REGULAR;
-  sym->sym_union.instr.opcode = TCASM_SYMBOL_INSTRUCTION_OPCODE_STORE;
-  
-  sym = (TCASM_symbol_t*) TCASM_hashtable_get(table, "INPUT", NULL);
-  sym->type = TCASM_SYMBOL_INSTRUCTION_REGULAR;
-  sym->sym_union.instr.opcode = TCASM_SYMBOL_INSTRUCTION_OPCODE_INPUT;
-  
-  sym = (TCASM_symbol_t*) TCASM_hashtable_get(table, "OUTPUT", NULL);
-  sym->type = TCASM_SYMBOL_INSTRUCTION_REGULAR;
-  sym->sym_union.instr.opcode = TCASM_SYMBOL_INSTRUCTION_OPCODE_OUTPUT;
-  
-  sym = (TCASM_symbol_t*) TCASM_hashtable_get(table, "STOP", NULL);
-  sym->type = TCASM_SYMBOL_INSTRUCTION_STOP;
-  sym->sym_union.instr.opcode = TCASM_SYMBOL_INSTRUCTION_OPCODE_STOP;
+static int TCASM_symbol_keyword(const char* word, size_t size);
+static void TCASM_symbol_table_grow(TCASM_symbol_table_t* table_ptr);
+
+/**
+ * Funcao para inicializar uma tabela de simbolos contendo apenas as
+ * palavras-chave.
+ * @param table_ptr Ponteiro da tabela.
+ * @param capacity Capacidade inicial de identificadores, ou 0 para usar
+ * TCASM_HASHTABLE_DEFAULT_SIZE.
+ */
+void TCASM_symbol_table_init(TCASM_symbol_table_t* table_ptr, size_t capacity) {
+  TCASM_intern_init(&table_ptr->identifiers, capacity);
+  table_ptr->capacity = TCASM_SYMBOL_KEYWORDS_SIZE + table_ptr->identifiers.capacity;
+  table_ptr->type = (uint8_t*) calloc(table_ptr->capacity, sizeof(uint8_t));
+  table_ptr->addr = (uint16_t*) calloc(table_ptr->capacity, sizeof(uint16_t));
+  table_ptr->value = (uint16_t*) calloc(table_ptr->capacity, sizeof(uint16_t));
+  table_ptr->line = (unsigned int*) calloc(table_ptr->capacity, sizeof(unsigned int));
+  table_ptr->size = TCASM_SYMBOL_KEYWORDS_SIZE;
+  for (int i = 0; i < TCASM_SYMBOL_KEYWORDS_SIZE; ++i) {
+    table_ptr->type[i] = TCASM_symbol_keywords[i].type;
+    table_ptr->value[i] = TCASM_symbol_keywords[i].opcode;
+  }
+}
+
+/**
+ * Funcao para liberar toda a memoria de uma tabela de simbolos.
+ * @param table_ptr Ponteiro da tabela.
+ */
+void TCASM_symbol_table_destroy(TCASM_symbol_table_t* table_ptr) {
+  TCASM_intern_destroy(&table_ptr->identifiers);
+  free(table_ptr->type);
+  free(table_ptr->addr);
+  free(table_ptr->value);
+  free(table_ptr->line);
+  table_ptr->type = NULL;
+  table_ptr->addr = NULL;
+  table_ptr->value = NULL;
+  table_ptr->line = NULL;
+  table_ptr->size = 0;
+  table_ptr->capacity = 0;
+}
+
+/**
+ * Funcao para obter o id de uma palavra. Palavras-chave sao reconhecidas sem
+ * acessar a tabela hash; qualquer outra palavra eh internada, e ganha um id
+ * novo, zerado, se ainda nao existe.
+ * @param table_ptr Ponteiro da tabela.
+ * @param word Palavra em maiusculas. Nao precisa terminar em '\0'.
+ * @param size Tamanho da palavra.
+ * @param created Ponteiro para a funcao retornar true se o simbolo foi
+ * criado, ou false em caso contrario.
+ * @return Retorna o id do simbolo.
+ */
+uint32_t TCASM_symbol_lookup(TCASM_symbol_table_t* table_ptr, const char* word, size_t size, bool* created) {
+  int keyword = TCASM_symbol_keyword(word, size);
+  if (keyword >= 0) {
+    *created = false;
+    return (uint32_t) keyword;
+  }
+  
+  uint32_t id = TCASM_SYMBOL_KEYWORDS_SIZE + TCASM_intern(&table_ptr->identifiers, word, size, created);
+  if (*created) {
+    if (table_ptr->size == table_ptr->capacity)
+      TCASM_symbol_table_grow(table_ptr);
+    table_ptr->size++;
+  }
+  return id;
+}
+
+/**
+ * Funcao que retorna o nome de um identificador.
+ * @param table_ptr Ponteiro da tabela.
+ * @param id Id do identificador (nao pode ser palavra-chave).
+ * @return Retorna o nome, terminado em '\0'.
+ */
+const char* TCASM_symbol_name(const TCASM_symbol_table_t* table_ptr, uint32_t id) {
+  return TCASM_intern_name(&table_ptr->identifiers, id - TCASM_SYMBOL_KEYWORDS_SIZE);
+}
+
+/**
+ * Funcao para reconhecer uma palavra-chave (diretiva ou instrucao) sem
+ * acessar a tabela hash. O hash usa o tamanho e tres chars da palavra, e nao
+ * tem colisoes entre as palavras-chave; a unica candidata eh entao comparada
+ * inteira.
+ * @param word Palavra em maiusculas. Nao precisa terminar em '\0'.
+ * @param size Tamanho da palavra.
+ * @return Retorna a posicao da palavra-chave na tabela, que eh tambem o seu
+ * id, ou -1 se a palavra nao eh uma palavra-chave.
+ */
+int TCASM_symbol_keyword(const char* word, size_t size) {
+  if (size < 3 || size > 7)
+    return -1;
+  
+  // constantes encontradas por tools/TCASM_keyword_hash.py
+  size_t hash = (size + (unsigned char) word[0] + 22*(unsigned char) word[1] + 6*(unsigned char) word[size - 1]) & (TCASM_SYMBOL_KEYWORDS_SIZE - 1);
+  const TCASM_symbol_keyword_t* keyword = &TCASM_symbol_keywords[hash];
+  if (keyword->name_size != size || memcmp(word, keyword->name, size) != 0)
+    return -1;
+  return (int) hash;
+}
+
+/**
+ * Funcao que dobra a capacidade dos vetores da tabela, zerando as posicoes
+ * novas.
+ * @param table_ptr Ponteiro da tabela.
+ */
+void TCASM_symbol_table_grow(TCASM_symbol_table_t* table_ptr) {
+  size_t old = table_ptr->capacity;
+  size_t capacity = old*2;
+  table_ptr->type = (uint8_t*) realloc(table_ptr->type, capacity*sizeof(uint8_t));
+  table_ptr->addr = (uint16_t*) realloc(table_ptr->addr, capacity*sizeof(uint16_t));
+  table_ptr->value = (uint16_t*) realloc(table_ptr->value, capacity*sizeof(uint16_t));
+  table_ptr->line = (unsigned int*) realloc(table_ptr->line, capacity*sizeof(unsigned int));
+  memset(table_ptr->type + old, 0, (capacity - old)*sizeof(uint8_t));
+  memset(table_ptr->addr + old, 0, (capacity - old)*sizeof(uint16_t));
+  memset(table_ptr->value + old, 0, (capacity - old)*sizeof(uint16_t));
+  memset(table_ptr->line + old, 0, (capacity - old)*sizeof(unsigned int));
+  table_ptr->capacity = capacity;
 }
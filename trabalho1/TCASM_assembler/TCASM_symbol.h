@@ -1,16 +1,23 @@
 #ifndef TCASM_SYMBOL_H_
 #define TCASM_SYMBOL_H_
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
-#include "TCASM_hashtable.h"
-#include "TCASM_list.h"
+#include "TCASM_intern.h"
 
 /**
  * Define o tamanho maximo de um identificador.
  */
 #define TCASM_SYMBOL_MAX_IDENTIFIER_SIZE 1000
 
+/**
+ * Tamanho da tabela de palavras-chave (potencia de 2), que tambem eh o
+ * primeiro id de identificador na tabela de simbolos.
+ */
+#define TCASM_SYMBOL_KEYWORDS_SIZE 32
+
 /**
  * Possiveis valores para o tipo de um simbolo.
  */
@@ -49,137 +56,41 @@ enum {
 };
 
 /**
- * Struct para armazenar as informacoes de um tipo de instrucao.
- */
-typedef struct {
-  /// Contem o opcode do tipo de instrucao.
-  uint16_t opcode;
-} TCASM_symbol_instruction_t;
-
-/**
- * Struct para armazenar as informacoes de um endereco de instrucao.
- */
-typedef struct {
-  /// Armazenara o endereco do rotulo a partir do momento em que
-  /// ele for definido.
-  uint16_t addr;
-  
-  /// Lista de referencias ao endereco.
-  TCASM_list_t ref_list;
-} TCASM_symbol_address_text_t;
-
-/**
- * Struct para armazenar as informacoes de um endereco de uma variavel.
- * Utilizado apenas quando a secao de dados vem ANTES da secao de texto no
- * codigo fonte.
- */
-typedef struct {
-  /// Lista de referencias ao endereco.
-  TCASM_list_t ref_list;
-} TCASM_symbol_address_var_t;
-
-/**
- * Struct para armazenar as informacoes de um endereco de uma constante.
- * Utilizado apenas quando a secao de dados vem ANTES da secao de texto no
- * codigo fonte.
- */
-typedef struct {
-  /// Valor da constante em complemento de 2. (Nao eh pq o TIPO nao tem sinal
-  /// que os bits nao estao la bonitinhos.)
-  uint16_t value;
-  
-  /// Lista de referencias ao endereco.
-  TCASM_list_t ref_list;
-} TCASM_symbol_address_const_t;
-
-/**
- * Struct para armazenar as informacoes de uma referencia a um endereco de
- * instrucao, variavel ou constante.
- */
-typedef struct {
-  /// Linha da referencia no codigo-fonte.
-  unsigned int line;
-  
-  /// Endereco do operando que precisa ser atualizado no codigo montado.
-  uint16_t addr;
-} TCASM_symbol_address_reflist_t;
-
-/**
- * Struct para armazenar as informacoes de um endereco de uma variavel ou
- * de uma constante.
- * Utilizado apenas quando a secao de dados vem DEPOIS da secao de texto no
- * codigo fonte.
- */
-typedef struct {
-  /// Lista de referencias ao endereco.
-  TCASM_list_t ref_list;
-} TCASM_symbol_address_varconst_t;
-
-/**
- * Struct para armazenar os dados de uma referencia a uma variavel ou constante.
- * Utilizado apenas quando a secao de dados vem DEPOIS da secao de texto no
- * codigo fonte.
+ * Struct para armazenar a tabela de simbolos em colunas: cada simbolo eh um
+ * id, e cada informacao do simbolo fica em um vetor proprio indexado pelo
+ * id. Os ids 0 a TCASM_SYMBOL_KEYWORDS_SIZE - 1 sao as posicoes da tabela de
+ * palavras-chave (somente leitura); os identificadores vem depois, na ordem
+ * em que aparecem no codigo-fonte. Um identificador novo comeca zerado.
  */
 typedef struct {
-  /// Indica o endereco no codigo montado da instrucao que fez a referencia.
-  uint16_t instr_addr;
-  
-  /// Salva a linha da instrucao que referencia o vetor.
-  unsigned int line;
+  /// Nomes dos identificadores. O identificador de id i tem id
+  /// i - TCASM_SYMBOL_KEYWORDS_SIZE no interner.
+  TCASM_intern_t identifiers;
   
-  /// Indica o endereco no codigo montado do operando a ser atualizado.
-  uint16_t op_addr;
-} TCASM_symbol_address_varconst_reflist_t;
+  /// Quantidade de ids (palavras-chave e identificadores).
+  size_t size;
 
-/**
- * Struct para armazenar as informacoes de um endereco de vetor.
- */
-typedef struct {
-  /// Tamanho do vetor.
-  uint16_t size;
+  /// Capacidade dos vetores.
+  size_t capacity;
   
-  /// Lista de referencias ao endereco.
-  TCASM_list_t ref_list;
-} TCASM_symbol_address_array_t;
-
-/**
- * Struct para armazenar os dados de uma referencia a um vetor.
- */
-typedef struct {
-  /// Offset de posicao no vetor utilizado na referencia.
-  uint16_t offset;
+  /// Tipo de cada simbolo (valores de TCASM_symbol_type_t).
+  uint8_t* type;
   
-  /// Salva a linha da instrucao que referencia o vetor.
-  unsigned int line;
+  /// Endereco de cada rotulo, a partir do momento em que ele for definido.
+  uint16_t* addr;
   
-  /// Indica o endereco no codigo montado do operando a ser atualizado.
-  uint16_t addr;
-} TCASM_symbol_address_array_reflist_t;
-
-/**
- * Union para armazenar as informacoes dos diferentes tipos de simbolos.
- */
-typedef union {
-  TCASM_symbol_instruction_t instr;
-  TCASM_symbol_address_text_t text;
-  TCASM_symbol_address_var_t var;
-  TCASM_symbol_address_const_t constant;
-  TCASM_symbol_address_varconst_t varconst;
-  TCASM_symbol_address_array_t array;
-} TCASM_symbol_union_t;
-
-/**
- * Struct para armazenar as informacoes de um simbolo.
- * Aqui, um simbolo pode ser um identificador ou uma palavra-chave.
- */
-typedef struct {
-  /// Tipo de acordo com a enumeracao.
-  TCASM_symbol_type_t type;
+  /// Valor de cada constante (em complemento de 2), tamanho de cada vetor ou
+  /// opcode de cada instrucao.
+  uint16_t* value;
   
-  ///< Union de armazenamento de informacoes para diferentes tipos de simbolos.
-  TCASM_symbol_union_t sym_union;
-} TCASM_symbol_t;
-
-void TCASM_symbol_init(TCASM_hashtable_t* table);
+  /// Linha em que cada rotulo ou dado foi definido, ou 0 enquanto ele foi
+  /// apenas referenciado.
+  unsigned int* line;
+} TCASM_symbol_table_t;
+
+void TCASM_symbol_table_init(TCASM_symbol_table_t* table_ptr, size_t capacity);
+void TCASM_symbol_table_destroy(TCASM_symbol_table_t* table_ptr);
+uint32_t TCASM_symbol_lookup(TCASM_symbol_table_t* table_ptr, const char* word, size_t size, bool* created);
+const char* TCASM_symbol_name(const TCASM_symbol_table_t* table_ptr, uint32_t id);
 
 #endif /* TCASM_SYMBOL_H_ */
@@ -1,8 +1,35 @@
-
+#include <atomic>
+#include <csignal>
+#include <cerrno>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <limits>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ USDT probes (provider "tcasm"): load, input, output, stop and
+ error. With <sys/sdt.h> each one is a nop plus a .note.stapsdt
+ entry that bpftrace, perf and SystemTap can attach to; without it
+ they compile to nothing. None of them is in the dispatch path.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define TCASM_PROBE2(name, a, b) DTRACE_PROBE2(tcasm, name, a, b)
+#endif
+#endif
+
+#ifndef TCASM_PROBE2
+#define TCASM_PROBE2(name, a, b) do {} while (0)
+#endif
 
 using namespace std;
 
@@ -10,71 +37,586 @@ typedef int16_t word;
 typedef uint16_t uword;
 
 static uword data[0x10000];
-static uword pc = 0;
-static word acc = 0;
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Flight recorder, always on. Dumped to stderr when the program dies
+ with an error or on a fatal signal.
+
+ Recording every instruction would cost about as much as the
+ dispatch itself, so only jumps are recorded: each entry packs the
+ jump's pc, acc and the low 32 bits of its sequence number (1 for
+ the first jump) in a single 64-bit store. The full sequence number
+ of the newest entry is published in jumps right after the store, so
+ it stays exact past 2^32 jumps; an entry whose stored bits don't
+ match the sequence expected at its slot was overwritten by a jump
+ that isn't published yet. The instructions between two jumps are
+ recovered from code memory when the recorder is dumped.
+
+ The pc isn't published either, so a fatal signal can't tell where
+ run() is. SIGINT, SIGTERM and SIGQUIT are left pending while run()
+ executes and taken at the next jump (straight-line code always
+ reaches one), where pc and acc are exact. INPUT and OUTPUT publish
+ their pc and acc, because a signal that arrives while they block
+ is taken right away.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static const unsigned FlightRecorderSize = 256;
+static uint64_t flightRecorder[FlightRecorderSize];
+static uint64_t jumps;
+
+enum
+{
+  MachineIdle,
+  MachineRunning,
+  MachineInIo
+};
+
+static volatile sig_atomic_t machineState;
+static volatile sig_atomic_t pendingSignal;
+static volatile uword ioPc;
+static volatile word ioAcc;
+
+// instructions shown by a dump
+static const unsigned FlightRecorderLines = 64;
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Metrics, exported in Prometheus text format with --metrics on
+ SIGUSR1, every --metrics-interval seconds and when the program
+ ends. run() counts instructions in a register and publishes the
+ count at each jump, next to the flight recorder store, so a dump
+ may lag by one basic block. The current pc is the jump the flight
+ recorder published last. I/O counters are only touched by INPUT and
+ OUTPUT, which cost far more than the bookkeeping.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static uint64_t retired;
+static uint64_t inputs;
+static uint64_t outputs;
+static uint64_t ioBlocked;  // nanoseconds
+
+static const char *metricsTarget = NULL;
+static std::string metricsTemporary;
+static uint64_t metricsStart;
+static uint64_t metricsLastTime;
+static uint64_t metricsLastRetired;
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Memory heatmap counters, one entry per address. Only touched when
+ the machine runs with --heatmap.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static uint64_t fetches[0x10000];
+static uint64_t reads[0x10000];
+static uint64_t writes[0x10000];
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Heatmap file layout (little-endian):
+   char     magic[4]   "TCHM"
+   uint16   version    2
+   uint16   reserved   0
+   uint32   image      words loaded from the program file
+   uint32   count      number of records that follow
+ followed by one record per touched address, in address order:
+   uint16   addr
+   uint8    kind       bit 0: fetched as code, bit 1: accessed as data
+   uint8    reserved   0
+   uint64   fetches
+   uint64   reads
+   uint64   writes
+ Version 1 had 32-bit counters, which wrapped on long runs.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+enum
+{
+  HeatmapCode = 1,
+  HeatmapData = 2
+};
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Appends a number to a buffer. Async-signal-safe.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static char *putNumber(char *out, int64_t value)
+{
+  char digits[24];
+  int n = 0;
+  uint64_t v = value < 0 ? -(uint64_t)value : (uint64_t)value;
+
+  do
+  {
+    digits[n++] = (char)('0' + v % 10);
+    v /= 10;
+  } while (v);
+
+  if (value < 0)
+    *out++ = '-';
+
+  while (n)
+    *out++ = digits[--n];
+
+  return out;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Appends a string to a buffer. Async-signal-safe.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static char *putString(char *out, const char *s)
+{
+  while (*s)
+    *out++ = *s++;
+
+  return out;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ One instruction of a flight recorder dump. acc is only known at
+ the recorded jumps and at the instruction that failed. A gap marks
+ a stretch of code that could not be recovered.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+struct Trace
+{
+  uword pc;
+  word acc;
+  bool hasAcc;
+  bool gap;
+};
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Appends an instruction to the dump window, dropping the oldest one
+ once the window is full.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void trace(Trace *window, unsigned &count, uword pc, word acc, bool hasAcc, bool gap = false)
+{
+  Trace &t = window[count++ % FlightRecorderLines];
+
+  t.pc = pc;
+  t.acc = acc;
+  t.hasAcc = hasAcc;
+  t.gap = gap;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Walks the straight-line code from pc up to (not including) end.
+ If end can't be reached without another jump, which only happens
+ if the program rewrote its own code (or its code was corrupted)
+ after running it, nothing is traced but a gap at pc, and returns
+ false.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static bool traceBlock(Trace *window, unsigned &count, uword pc, uword end)
+{
+  uword at = pc;
+
+  for (unsigned steps = 0; at != end; ++steps)
+  {
+    uword opcode = data[at];
+
+    if (opcode == 0 || (opcode >= 5 && opcode <= 8) || opcode >= 14 || steps > 0xFFFF)
+    {
+      trace(window, count, pc, 0, false, true);
+      return false;
+    }
+
+    at += opcode == 9 ? 3 : 2;
+  }
+
+  for (; pc != end; pc += data[pc] == 9 ? 3 : 2)
+    trace(window, count, pc, 0, false);
+
+  return true;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Writes the last instructions executed to a file descriptor, oldest
+ first. If failed is true, pc and acc are the state at the start of
+ the instruction that failed or was interrupted; otherwise the trail
+ ends at the last jump. Gaps in the trail, where the code was
+ rewritten after it ran, are marked as such. Async-signal-safe, so
+ it can run from a handler.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void dumpFlightRecorder(int fd, bool failed, uword pc, word acc)
+{
+  static const char *const names[] =
+  {
+    "?", "ADD", "SUB", "MULT", "DIV", "JMP", "JMPN", "JMPP", "JMPZ",
+    "COPY", "LOAD", "STORE", "INPUT", "OUTPUT", "STOP"
+  };
+
+  Trace window[FlightRecorderLines];
+  unsigned count = 0;
+  uint64_t last = jumps;
+  atomic_signal_fence(memory_order_acquire);
+  uint64_t first = last > FlightRecorderSize ? last - FlightRecorderSize + 1 : 1;
+
+  // the program starts at 0, so with every jump still recorded the
+  // trail is complete
+  bool known = first == 1;
+  uword next = 0;
+
+  for (uint64_t seq = first; seq <= last; ++seq)
+  {
+    uint64_t entry = flightRecorder[seq & (FlightRecorderSize - 1)];
+
+    if ((uint32_t)(entry >> 32) != (uint32_t)seq)
+    {
+      known = false;
+      continue;
+    }
+
+    uword at = (uword)entry;
+    word value = (word)(entry >> 16);
+    uword opcode = data[at];
+
+    if (known)
+      traceBlock(window, count, next, at);
+
+    trace(window, count, at, value, true);
+
+    bool taken = opcode == 5 || (opcode == 6 && value < 0) ||
+      (opcode == 7 && value > 0) || (opcode == 8 && value == 0);
+
+    next = taken ? data[(uword)(at + 1)] : (uword)(at + 2);
+    known = true;
+  }
+
+  if (failed)
+  {
+    traceBlock(window, count, next, pc);
+    trace(window, count, pc, acc, true);
+  }
+
+  char line[128];
+  char *out = line;
+  unsigned shown = count < FlightRecorderLines ? count : FlightRecorderLines;
+  bool reliable = true;
+
+  for (unsigned i = count - shown; i < count; ++i)
+    reliable = reliable && !window[i % FlightRecorderLines].gap;
+
+  out = putString(out, "Flight recorder: last ");
+  out = putNumber(out, shown);
+  out = putString(out, " instructions, ");
+  out = putNumber(out, (int64_t)last);
+  out = putString(out, " jumps executed.\n");
+  write(fd, line, out - line);
+
+  if (!reliable)
+  {
+    out = putString(line, "Trail truncated/unreliable: code was rewritten after it ran.\n");
+    write(fd, line, out - line);
+  }
+
+  for (unsigned i = count - shown; i < count; ++i)
+  {
+    const Trace &t = window[i % FlightRecorderLines];
+    uword opcode = data[t.pc];
+
+    if (t.gap)
+    {
+      out = putString(line, "  ... trail truncated: code from pc=");
+      out = putNumber(out, t.pc);
+      out = putString(out, " to the next jump was rewritten after it ran\n");
+      write(fd, line, out - line);
+      continue;
+    }
+
+    out = line;
+    out = putString(out, "  pc=");
+    out = putNumber(out, t.pc);
+    out = putString(out, " op=");
+    out = putNumber(out, opcode);
+    out = putString(out, " (");
+    out = putString(out, names[opcode < 15 ? opcode : 0]);
+    out = putString(out, ")");
+
+    if (t.hasAcc)
+    {
+      out = putString(out, " acc=");
+      out = putNumber(out, t.acc);
+    }
+
+    out = putString(out, "\n");
+    write(fd, line, out - line);
+  }
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Dumps the flight recorder up to pc, then lets the signal take its
+ default action.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void dieOnSignal(int sig, bool failed, uword pc, word acc)
+{
+  machineState = MachineIdle;
+  dumpFlightRecorder(STDERR_FILENO, failed, pc, acc);
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Handles a fatal signal: leaves it pending if run() can take it at
+ the next jump, or else dumps the flight recorder right away. A
+ synchronous signal (SIGSEGV, ...) in the middle of run() can only
+ be dumped up to the last jump.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void onFatalSignal(int sig)
+{
+  bool deferrable = sig == SIGINT || sig == SIGTERM || sig == SIGQUIT;
+
+  if (machineState == MachineRunning && deferrable)
+    pendingSignal = sig;
+  else
+    dieOnSignal(sig, machineState == MachineInIo, ioPc, ioAcc);
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Monotonic time in nanoseconds. Async-signal-safe.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static uint64_t now()
+{
+  timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Appends a duration in nanoseconds as decimal seconds.
+ Async-signal-safe.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static char *putSeconds(char *out, uint64_t ns)
+{
+  char fraction[10];
+  uint64_t rest = ns % 1000000000;
+
+  for (int i = 8; i >= 0; --i, rest /= 10)
+    fraction[i] = (char)('0' + rest % 10);
+  fraction[9] = '\0';
+
+  out = putNumber(out, (int64_t)(ns / 1000000000));
+  *out++ = '.';
+  return putString(out, fraction);
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Appends one metric with its HELP and TYPE lines.
+ Async-signal-safe.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static char *putMetric(char *out, const char *name, const char *type, const char *help)
+{
+  out = putString(out, "# HELP ");
+  out = putString(out, name);
+  out = putString(out, " ");
+  out = putString(out, help);
+  out = putString(out, "\n# TYPE ");
+  out = putString(out, name);
+  out = putString(out, " ");
+  out = putString(out, type);
+  out = putString(out, "\n");
+  out = putString(out, name);
+  return putString(out, " ");
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Writes a whole buffer to a file or socket. A closed socket fails
+ with EPIPE instead of raising SIGPIPE. Async-signal-safe.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static bool writeAll(int fd, const char *buffer, size_t size, bool isSocket)
+{
+  while (size)
+  {
+    ssize_t n = isSocket ? send(fd, buffer, size, MSG_NOSIGNAL) : write(fd, buffer, size);
+
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+
+    buffer += n;
+    size -= n;
+  }
+
+  return true;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Writes the metrics to the --metrics target: a Unix socket for
+ "unix:<path>", which gets one connection per dump, or else a file,
+ replaced atomically. Async-signal-safe.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static bool writeMetrics()
+{
+  int saved = errno;
+  uint64_t time = now();
+  uint64_t count = retired;
+  uint64_t elapsed = time - metricsLastTime;
+  uint64_t rate = elapsed ? (uint64_t)((double)(count - metricsLastRetired) * 1e9 / elapsed) : 0;
+  uint64_t last = jumps;
+  atomic_signal_fence(memory_order_acquire);
+  uword pc = last ? (uword)flightRecorder[last & (FlightRecorderSize - 1)] : 0;
+
+  metricsLastTime = time;
+  metricsLastRetired = count;
+
+  char buffer[2048];
+  char *out = buffer;
+
+  out = putMetric(out, "tcasm_instructions_retired_total", "counter", "Instructions executed, up to the last jump.");
+  out = putNumber(out, (int64_t)count);
+  out = putString(out, "\n");
+  out = putMetric(out, "tcasm_instructions_per_second", "gauge", "Instructions executed per second since the previous dump.");
+  out = putNumber(out, (int64_t)rate);
+  out = putString(out, "\n");
+  out = putMetric(out, "tcasm_inputs_total", "counter", "INPUT instructions executed.");
+  out = putNumber(out, (int64_t)inputs);
+  out = putString(out, "\n");
+  out = putMetric(out, "tcasm_outputs_total", "counter", "OUTPUT instructions executed.");
+  out = putNumber(out, (int64_t)outputs);
+  out = putString(out, "\n");
+  out = putMetric(out, "tcasm_io_blocked_seconds_total", "counter", "Time spent blocked in INPUT and OUTPUT.");
+  out = putSeconds(out, ioBlocked);
+  out = putString(out, "\n");
+  out = putMetric(out, "tcasm_pc", "gauge", "Address of the last jump executed.");
+  out = putNumber(out, pc);
+  out = putString(out, "\n");
+  out = putMetric(out, "tcasm_uptime_seconds", "gauge", "Time since the program was loaded.");
+  out = putSeconds(out, time - metricsStart);
+  out = putString(out, "\n");
+
+  bool ok;
+
+  if (strncmp(metricsTarget, "unix:", 5) == 0)
+  {
+    sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, metricsTarget + 5, sizeof addr.sun_path - 1);
+
+    ok = fd >= 0 && connect(fd, (sockaddr*)&addr, sizeof addr) == 0 && writeAll(fd, buffer, out - buffer, true);
+
+    if (fd >= 0)
+      close(fd);
+  }
+  else
+  {
+    int fd = open(metricsTemporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    ok = fd >= 0 && writeAll(fd, buffer, out - buffer, false);
+
+    if (fd >= 0)
+      ok = close(fd) == 0 && ok;
+
+    ok = ok && rename(metricsTemporary.c_str(), metricsTarget) == 0;
+  }
+
+  errno = saved;
+  return ok;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Dumps the metrics on SIGUSR1 or when the interval timer fires.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void onMetricsSignal(int)
+{
+  writeMetrics();
+}
 
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
  Reads the next word in the file.
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
-inline static uword read()
+template <bool heatmap>
+inline static uword read(uword &pc)
 {
+  if (heatmap)
+    ++fetches[pc];
   return data[pc++];
 }
 
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
  Treats the next word as an address then return its value.
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
-inline static word &mem()
+template <bool heatmap>
+inline static word load(uword &pc)
 {
-  return ((word*)data)[read()];
+  uword addr = read<heatmap>(pc);
+  if (heatmap)
+    ++reads[addr];
+  return ((word*)data)[addr];
 }
 
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
- Application's entry point.
+ Treats the next word as an address then stores a value there.
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
-int main(int argc, char *argv[])
+template <bool heatmap>
+inline static void store(uword &pc, word value)
 {
-  if (argc < 2)
+  uword addr = read<heatmap>(pc);
+  if (heatmap)
+    ++writes[addr];
+  ((word*)data)[addr] = value;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Records a jump in the flight recorder and publishes the number of
+ instructions executed so far. Takes a pending fatal signal first,
+ with the jump as the interrupted instruction.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+inline static void record(uint64_t &seq, uint64_t count, uword pc, word acc)
+{
+  if (pendingSignal)
   {
-    printf("Invalid syntax.\n");
-    return 1;
+    retired = count - 1;
+    dieOnSignal(pendingSignal, true, pc, acc);
   }
 
-  std::string path = argv[1];
+  ++seq;
+  flightRecorder[seq & (FlightRecorderSize - 1)] = pc | (uint64_t)(uword)acc << 16 | (uint64_t)(uint32_t)seq << 32;
+  atomic_signal_fence(memory_order_release);
+  jumps = seq;
+  retired = count;
+}
 
-  for (int i = 2; i < argc; ++i)
-  {
-    path += " ";
-    path += argv[i];
-  }
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Runs the loaded program until STOP. Returns the process exit code.
+ pc and acc are kept local so they can live in registers.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+template <bool heatmap>
+static int run()
+{
+  uword pc = 0;
+  word acc = 0;
+  uint64_t seq = 0;
+  uint64_t count = 0;
 
-  FILE *file = fopen(path.c_str(), "rb");
-  fread(data, 2, 0xFFFF, file);
-  fclose(file);
+  machineState = MachineRunning;
 
   while (data[pc] != 14)
   {
-    switch (read())
+    ++count;
+
+    switch (read<heatmap>(pc))
     {
     case 1:
-      acc += mem();
+      acc += load<heatmap>(pc);
       break;
 
     case 2:
-      acc -= mem();
+      acc -= load<heatmap>(pc);
       break;
 
     case 3:
-      acc *= mem();
+      acc *= load<heatmap>(pc);
       break;
 
     case 4:
       {
-        word aux = mem();
+        word aux = load<heatmap>(pc);
 
         if (aux == 0)
         {
+          TCASM_PROBE2(error, pc - 2, "Division by zero.");
           printf("Division by zero.\n");
+          fflush(stdout);
+          machineState = MachineIdle;
+          dumpFlightRecorder(STDERR_FILENO, true, pc - 2, acc);
+          retired = count;
           return 1;
         }
 
@@ -83,59 +625,269 @@ int main(int argc, char *argv[])
       break;
 
     case 5:
-      pc = read();
+      record(seq, count, pc - 1, acc);
+      pc = read<heatmap>(pc);
       break;
 
     case 6:
-      pc = acc < 0 ? read() : pc + 1;
+      record(seq, count, pc - 1, acc);
+      pc = acc < 0 ? read<heatmap>(pc) : pc + 1;
       break;
 
     case 7:
-      pc = acc > 0 ? read() : pc + 1;
+      record(seq, count, pc - 1, acc);
+      pc = acc > 0 ? read<heatmap>(pc) : pc + 1;
       break;
 
     case 8:
-      pc = acc == 0 ? read() : pc + 1;
+      record(seq, count, pc - 1, acc);
+      pc = acc == 0 ? read<heatmap>(pc) : pc + 1;
       break;
 
     case 9:
-      {
-        word &aux = mem();
-        mem() = aux;
-      }
+      store<heatmap>(pc, load<heatmap>(pc));
       break;
 
     case 10:
-      acc = mem();
+      acc = load<heatmap>(pc);
       break;
 
     case 11:
-      mem() = acc;
+      store<heatmap>(pc, acc);
       break;
 
     case 12:
       {
         int i;
+        uint64_t start = now();
+
+        ioPc = pc - 1;
+        ioAcc = acc;
+        machineState = MachineInIo;
+
+        int status = scanf("%i", &i);
+
+        machineState = MachineRunning;
+        ioBlocked += now() - start;
+        ++inputs;
+        TCASM_PROBE2(input, pc - 1, status == 1 ? i : 0);
 
-        if (scanf("%i", &i) != 1 || i < -32768 || i > 32767)
+        if (status != 1 || i < -32768 || i > 32767)
         {
+          TCASM_PROBE2(error, pc - 1, "Invalid input.");
           printf("Invalid input.\n");
+          fflush(stdout);
+          machineState = MachineIdle;
+          dumpFlightRecorder(STDERR_FILENO, true, pc - 1, acc);
+          retired = count;
           return 1;
         }
 
-        mem() = (word)i;
+        store<heatmap>(pc, (word)i);
       }
       break;
 
     case 13:
-      printf("%d\n", mem());
+      {
+        word value = load<heatmap>(pc);
+        uint64_t start = now();
+
+        ioPc = pc - 2;
+        ioAcc = acc;
+        machineState = MachineInIo;
+        printf("%d\n", value);
+        machineState = MachineRunning;
+        ioBlocked += now() - start;
+        ++outputs;
+        TCASM_PROBE2(output, pc - 2, value);
+      }
       break;
 
     default:
+      TCASM_PROBE2(error, pc - 1, "Unknown instruction code.");
       printf("Unknown instruction code.\n");
+      fflush(stdout);
+      machineState = MachineIdle;
+      dumpFlightRecorder(STDERR_FILENO, true, pc - 1, acc);
+      retired = count;
       return 1;
     }
   }
 
+  if (pendingSignal)
+    dieOnSignal(pendingSignal, true, pc, acc);
+
+  machineState = MachineIdle;
+
+  // STOP retires too
+  retired = count + 1;
+  TCASM_PROBE2(stop, pc, retired);
+
+  // the STOP word is fetched too, even though the loop never reads it
+  if (heatmap)
+    ++fetches[pc];
+
   return 0;
 }
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Writes the heatmap counters to a file. Only touched addresses
+ are written.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static bool writeHeatmap(const char *path, uint32_t image)
+{
+  FILE *file = fopen(path, "wb");
+
+  if (file == NULL)
+    return false;
+
+  uint32_t count = 0;
+
+  for (uint32_t addr = 0; addr < 0x10000; ++addr)
+    if (fetches[addr] || reads[addr] || writes[addr])
+      ++count;
+
+  uint16_t version = 2, reserved = 0;
+
+  fwrite("TCHM", 1, 4, file);
+  fwrite(&version, 2, 1, file);
+  fwrite(&reserved, 2, 1, file);
+  fwrite(&image, 4, 1, file);
+  fwrite(&count, 4, 1, file);
+
+  for (uint32_t addr = 0; addr < 0x10000; ++addr)
+  {
+    if (!fetches[addr] && !reads[addr] && !writes[addr])
+      continue;
+
+    uint16_t a = (uint16_t)addr;
+    uint8_t kind[2] =
+    {
+      (uint8_t)((fetches[addr] ? HeatmapCode : 0) | (reads[addr] || writes[addr] ? HeatmapData : 0)),
+      0
+    };
+
+    fwrite(&a, 2, 1, file);
+    fwrite(kind, 1, 2, file);
+    fwrite(&fetches[addr], 8, 1, file);
+    fwrite(&reads[addr], 8, 1, file);
+    fwrite(&writes[addr], 8, 1, file);
+  }
+
+  return fclose(file) == 0;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ Application's entry point.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+int main(int argc, char *argv[])
+{
+  const char *heatmapPath = NULL;
+  double metricsInterval = 0;
+  int first = 1;
+
+  for (; first + 1 < argc && strncmp(argv[first], "--", 2) == 0; first += 2)
+  {
+    if (strcmp(argv[first], "--heatmap") == 0)
+      heatmapPath = argv[first + 1];
+    else if (strcmp(argv[first], "--metrics") == 0)
+      metricsTarget = argv[first + 1];
+    else if (strcmp(argv[first], "--metrics-interval") == 0)
+    {
+      char *end;
+
+      metricsInterval = strtod(argv[first + 1], &end);
+
+      if (*end || metricsInterval <= 0)
+      {
+        printf("Invalid syntax.\n");
+        return 1;
+      }
+    }
+    else
+      break;
+  }
+
+  if (argc <= first)
+  {
+    printf("Invalid syntax.\n");
+    return 1;
+  }
+
+  std::string path = argv[first];
+
+  for (int i = first + 1; i < argc; ++i)
+  {
+    path += " ";
+    path += argv[i];
+  }
+
+  signal(SIGINT, onFatalSignal);
+  signal(SIGTERM, onFatalSignal);
+  signal(SIGQUIT, onFatalSignal);
+  signal(SIGSEGV, onFatalSignal);
+  signal(SIGBUS, onFatalSignal);
+  signal(SIGFPE, onFatalSignal);
+
+  FILE *file = fopen(path.c_str(), "rb");
+  size_t image = fread(data, 2, 0xFFFF, file);
+  fclose(file);
+  TCASM_PROBE2(load, path.c_str(), image);
+
+  if (metricsTarget != NULL)
+  {
+    struct sigaction action;
+
+    metricsTemporary = std::string(metricsTarget) + ".tmp";
+    metricsStart = metricsLastTime = now();
+
+    memset(&action, 0, sizeof action);
+    action.sa_handler = onMetricsSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaddset(&action.sa_mask, SIGUSR1);
+    sigaddset(&action.sa_mask, SIGALRM);
+    sigaction(SIGUSR1, &action, NULL);
+    sigaction(SIGALRM, &action, NULL);
+
+    if (metricsInterval > 0)
+    {
+      itimerval timer;
+
+      timer.it_interval.tv_sec = (time_t)metricsInterval;
+      timer.it_interval.tv_usec = (suseconds_t)((metricsInterval - timer.it_interval.tv_sec) * 1000000);
+
+      if (timer.it_interval.tv_sec == 0 && timer.it_interval.tv_usec == 0)
+        timer.it_interval.tv_usec = 1;
+
+      timer.it_value = timer.it_interval;
+      setitimer(ITIMER_REAL, &timer, NULL);
+    }
+  }
+
+  int status = heatmapPath == NULL ? run<false>() : run<true>();
+
+  if (heatmapPath != NULL && !writeHeatmap(heatmapPath, (uint32_t)image))
+  {
+    fprintf(stderr, "Could not write heatmap to %s.\n", heatmapPath);
+    return 1;
+  }
+
+  if (metricsTarget != NULL)
+  {
+    sigset_t blocked;
+
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGUSR1);
+    sigaddset(&blocked, SIGALRM);
+    sigprocmask(SIG_BLOCK, &blocked, NULL);
+
+    if (!writeMetrics())
+    {
+      fprintf(stderr, "Could not write metrics to %s.\n", metricsTarget);
+      return 1;
+    }
+  }
+
+  return status;
+}
@@ -2,8 +2,14 @@
 #include <sys/stat.h>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
 #include <vector>
 
+#include "TCASM_IA-32_ELF_generator.h"
+
 typedef int16_t word;
 typedef uint16_t uword;
 
@@ -43,6 +49,70 @@ struct Elf32_Phdr
   uint32_t p_align;
 };
 
+//
+// Cabeçalho de seção do ELF.
+//
+struct Elf32_Shdr
+{
+  uint32_t sh_name;
+  uint32_t sh_type;
+  uint32_t sh_flags;
+  uint32_t sh_addr;
+  uint32_t sh_offset;
+  uint32_t sh_size;
+  uint32_t sh_link;
+  uint32_t sh_info;
+  uint32_t sh_addralign;
+  uint32_t sh_entsize;
+};
+
+//
+// Entrada da tabela de símbolos do ELF.
+//
+struct Elf32_Sym
+{
+  uint32_t st_name;
+  uint32_t st_value;
+  uint32_t st_size;
+  uint8_t st_info;
+  uint8_t st_other;
+  uint16_t st_shndx;
+};
+
+//
+// Símbolo lido do mapa de endereços gerado pelo montador (--map).
+//
+struct MapSymbol
+{
+  unsigned addr;
+  uint8_t kind;
+  std::string name;
+};
+
+//
+// Origem no fonte de uma palavra TCASM, lida do mapa de endereços.
+//
+struct MapWord
+{
+  unsigned line;
+  unsigned col;
+  uint8_t kind;
+};
+
+//
+// Seção que não é carregada na memória, escrita depois da imagem do programa.
+//
+struct ExtraSection
+{
+  const char *name;
+  uint32_t type;
+  uint32_t link;
+  uint32_t info;
+  uint32_t align;
+  uint32_t entsize;
+  std::string data;
+};
+
 //
 // Os procedimentos GetInt e PutInt necessários, usados na primeira parte do trabalho, já montados.
 //
@@ -73,71 +143,480 @@ static const unsigned LoadAddress = 0x08048000;
 static const unsigned StartOffset = sizeof(Elf32_Ehdr) + sizeof(Elf32_Phdr) + 192;
 
 //
-// O arquivo de entrada.
+// Offsets de GetInt e PutInt dentro de GetAndPutInt. Os 8 primeiros bytes são o buffer de E/S.
+//
+static const unsigned GetIntOffset = 8;
+static const unsigned PutIntOffset = 96;
+
+//
+// Tipos de símbolo do mapa de endereços (TCASM_map_kind_t no montador).
 //
-static FILE *entrada;
+static const uint8_t MapKindOpcode = 1;
+static const uint8_t MapKindData = 3;
+static const uint8_t MapKindLabel = 4;
 
 //
-// Última word lida do arquivo.
+// Índices das seções do arquivo de saída.
 //
-static uword code;
+enum { SectionNull, SectionText, SectionData, SectionSymtab, SectionStrtab };
 
 //
-// Arquivo final.
+// Estado de uma tradução. Cada tradução tem o seu, então várias podem ser feitas ao mesmo tempo.
 //
-std::vector<uint8_t> output;
+struct Generator
+{
+  // programa TCASM montado e posição da próxima palavra a ser lida
+  const uword *input;
+  size_t inputSize;
+  size_t position;
+
+  // última word lida
+  uword code;
+
+  // arquivo final
+  std::vector<uint8_t> output;
+
+  // início de cada bloco básico (endereço TCASM), com o nome do rótulo que começa nele, se houver
+  std::map<unsigned, std::string> blocks;
+
+  // endereço TCASM da instrução STOP, que termina o código traduzido
+  unsigned stopAddress;
+
+  // símbolos do mapa de endereços, se algum foi passado
+  std::vector<MapSymbol> mapSymbols;
+
+  // origem de cada palavra do mapa de endereços e nome do arquivo fonte montado
+  std::vector<MapWord> mapWords;
+  std::string mapSource;
+};
 
 //
-// Lê uma palavra do arquivo de entrada.
+// Mapa de endereços em memória sendo lido.
 //
-inline static uword read()
+struct MapReader
 {
-  fread(&code, 2, 1, entrada);
-  return code;
+  const uint8_t *data;
+  const uint8_t *end;
+};
+
+//
+// Lê uma palavra do programa de entrada. Depois do fim, lê STOP, para que um programa sem STOP
+// também termine.
+//
+inline static uword read(Generator &g)
+{
+  g.code = g.position < g.inputSize ? g.input[g.position] : 14;
+  g.position++;
+  return g.code;
 }
 
 //
 // Coloca um byte na saída.
 //
-inline static void putByte(uint8_t x)
+inline static void putByte(Generator &g, uint8_t x)
 {
-  output.push_back(x);
+  g.output.push_back(x);
 }
 
 //
 // Coloca uma word na saída.
 //
-inline static void putWord(int x)
+inline static void putWord(Generator &g, int x)
 {
-  output.push_back((uint8_t)(x & 0xFF));
-  output.push_back((uint8_t)((x >> 8) & 0xFF));
-  output.push_back((uint8_t)((x >> 16) & 0xFF));
-  output.push_back((uint8_t)((x >> 24) & 0xFF));
+  g.output.push_back((uint8_t)(x & 0xFF));
+  g.output.push_back((uint8_t)((x >> 8) & 0xFF));
+  g.output.push_back((uint8_t)((x >> 16) & 0xFF));
+  g.output.push_back((uint8_t)((x >> 24) & 0xFF));
 }
 
 //
 // Coloca um endereço de dados no arquivo de saída.
 //
-inline static void putDataAddress()
+inline static void putDataAddress(Generator &g)
 {
-  putWord(LoadAddress + StartOffset + (read() + 1) * 6);
+  putWord(g, LoadAddress + StartOffset + (read(g) + 1) * 6);
 }
 
 //
 // Coloca um endereço de jump no arquivo de saída.
 //
-inline static void putJumpAddress()
+inline static void putJumpAddress(Generator &g)
 {
-  int addr = read() * 6;
-  addr -= output.size() + 4;
-  putWord(addr);
+  g.blocks[read(g)];
+  int addr = g.code * 6;
+  addr -= g.output.size() + 4;
+  putWord(g, addr);
+}
+
+//
+// Converte um endereço TCASM em endereço virtual no programa de saída. As palavras depois do
+// STOP ficam deslocadas de uma posição, pois o STOP traduzido ocupa 12 bytes.
+//
+static unsigned nativeAddress(const Generator &g, unsigned addr)
+{
+  return LoadAddress + StartOffset + (addr <= g.stopAddress ? addr : addr + 1) * 6;
+}
+
+//
+// Lê bytes do mapa de endereços.
+//
+static bool readMapBytes(MapReader &reader, void *buf, unsigned size)
+{
+  if ((size_t)(reader.end - reader.data) < size)
+    return false;
+  memcpy(buf, reader.data, size);
+  reader.data += size;
+  return true;
+}
+
+//
+// Lê um inteiro little-endian de 16 ou 32 bits.
+//
+static bool readMapInt(MapReader &reader, unsigned size, unsigned &value)
+{
+  uint8_t buf[4];
+  if (!readMapBytes(reader, buf, size))
+    return false;
+  value = 0;
+  for (unsigned i = size; i-- > 0;)
+    value = (value << 8) | buf[i];
+  return true;
+}
+
+//
+// Lê o mapa de endereços gerado pelo montador (formato descrito no README do montador).
+//
+static bool readMap(Generator &g, const uint8_t *data, size_t size)
+{
+  MapReader reader = { data, data + size };
+
+  char magic[4];
+  unsigned version = 0, reserved = 0, words = 0, symbols = 0, sourceSize = 0;
+  bool ok = readMapBytes(reader, magic, 4) && memcmp(magic, "TCSM", 4) == 0 &&
+            readMapInt(reader, 2, version) && version == 1 && readMapInt(reader, 2, reserved) &&
+            readMapInt(reader, 4, words) && readMapInt(reader, 4, symbols) && readMapInt(reader, 4, sourceSize);
+
+  g.mapSource.resize(ok ? sourceSize : 0);
+  ok = ok && (sourceSize == 0 || readMapBytes(reader, &g.mapSource[0], sourceSize));
+
+  for (unsigned i = 0; ok && i < words; i++)
+  {
+    MapWord word;
+    unsigned kind;
+    ok = readMapInt(reader, 4, word.line) && readMapInt(reader, 2, word.col) && readMapInt(reader, 2, kind);
+    word.kind = (uint8_t)kind;
+    if (ok)
+      g.mapWords.push_back(word);
+  }
+
+  for (unsigned i = 0; ok && i < symbols; i++)
+  {
+    MapSymbol symbol;
+    unsigned kind = 0, size = 0;
+    ok = readMapInt(reader, 2, symbol.addr) && readMapInt(reader, 2, kind) && readMapInt(reader, 2, size);
+    symbol.kind = (uint8_t)kind;
+    symbol.name.resize(size);
+    ok = ok && (size == 0 || readMapBytes(reader, &symbol.name[0], size));
+    if (ok)
+      g.mapSymbols.push_back(symbol);
+  }
+
+  return ok;
+}
+
+//
+// Acrescenta um nome a uma tabela de strings do ELF e retorna seu offset.
+//
+static uint32_t addString(std::string &table, const std::string &name)
+{
+  uint32_t offset = (uint32_t)table.size();
+  table += name;
+  table += '\0';
+  return offset;
+}
+
+//
+// Acrescenta um símbolo global à tabela de símbolos.
+//
+static void addSymbol(std::vector<Elf32_Sym> &symtab, std::string &strtab, const std::string &name,
+                      unsigned value, unsigned size, uint8_t type, uint16_t section)
+{
+  Elf32_Sym sym = { addString(strtab, name), value, size, (uint8_t)((1 << 4) | type), 0, section };
+  symtab.push_back(sym);
+}
+
+//
+// Monta a tabela de símbolos: um símbolo de função para cada bloco básico (com o nome do rótulo
+// TCASM, se conhecido), GetInt, PutInt e os dados.
+//
+static void buildSymbols(const Generator &g, std::vector<Elf32_Sym> &symtab, std::string &strtab, const char *source)
+{
+  const uint8_t STT_OBJECT = 1, STT_FUNC = 2, STT_FILE = 4;
+
+  Elf32_Sym null = {};
+  symtab.push_back(null);
+  Elf32_Sym file = { addString(strtab, source), 0, 0, STT_FILE, 0, 0xFFF1 };
+  symtab.push_back(file);
+
+  addSymbol(symtab, strtab, "GetInt", LoadAddress + sizeof(Elf32_Ehdr) + sizeof(Elf32_Phdr) + GetIntOffset,
+            PutIntOffset - GetIntOffset, STT_FUNC, SectionText);
+  addSymbol(symtab, strtab, "PutInt", LoadAddress + sizeof(Elf32_Ehdr) + sizeof(Elf32_Phdr) + PutIntOffset,
+            192 - PutIntOffset, STT_FUNC, SectionText);
+
+  for (std::map<unsigned, std::string>::const_iterator it = g.blocks.begin(); it != g.blocks.end(); ++it)
+  {
+    std::map<unsigned, std::string>::const_iterator next = it;
+    unsigned end = ++next != g.blocks.end() ? nativeAddress(g, next->first) : nativeAddress(g, g.stopAddress) + 12;
+    char name[16];
+    snprintf(name, sizeof(name), "tcasm_%04x", it->first);
+    addSymbol(symtab, strtab, it->second.empty() ? name : it->second, nativeAddress(g, it->first),
+              end - nativeAddress(g, it->first), STT_FUNC, SectionText);
+  }
+
+  unsigned dataEnd = LoadAddress + StartOffset + (unsigned)g.output.size();
+  std::map<unsigned, std::string> data;
+  for (size_t i = 0; i < g.mapSymbols.size(); i++)
+    if (g.mapSymbols[i].kind == MapKindData && g.mapSymbols[i].addr > g.stopAddress)
+      data[g.mapSymbols[i].addr] = g.mapSymbols[i].name;
+  if (data.empty())
+    addSymbol(symtab, strtab, "tcasm_data", nativeAddress(g, g.stopAddress + 1),
+              dataEnd - nativeAddress(g, g.stopAddress + 1), STT_OBJECT, SectionData);
+  for (std::map<unsigned, std::string>::iterator it = data.begin(); it != data.end(); ++it)
+  {
+    std::map<unsigned, std::string>::iterator next = it;
+    unsigned end = ++next != data.end() ? nativeAddress(g, next->first) : dataEnd;
+    addSymbol(symtab, strtab, it->second, nativeAddress(g, it->first), end - nativeAddress(g, it->first), STT_OBJECT,
+              SectionData);
+  }
+}
+
+//
+// Acrescenta um inteiro little-endian de 1, 2 ou 4 bytes a uma seção.
+//
+static void appendInt(std::string &data, unsigned value, unsigned size)
+{
+  for (unsigned i = 0; i < size; i++)
+    data += (char)((value >> (8 * i)) & 0xFF);
+}
+
+//
+// Acrescenta um inteiro LEB128 (sem ou com sinal) a uma seção DWARF.
+//
+static void appendULEB(std::string &data, unsigned value)
+{
+  do
+  {
+    uint8_t byte = value & 0x7F;
+    value >>= 7;
+    data += (char)(value != 0 ? byte | 0x80 : byte);
+  } while (value != 0);
+}
+
+static void appendSLEB(std::string &data, int value)
+{
+  bool more = true;
+  while (more)
+  {
+    uint8_t byte = value & 0x7F;
+    value >>= 7;
+    more = !((value == 0 && !(byte & 0x40)) || (value == -1 && (byte & 0x40)));
+    data += (char)(more ? byte | 0x80 : byte);
+  }
+}
+
+//
+// Gera as seções DWARF 2 a partir do mapa de endereços: .debug_line com a linha e a coluna do fonte
+// TCASM de cada instrução traduzida e um .debug_info com uma única unidade de compilação cobrindo o
+// código traduzido.
+//
+static void buildDebug(const Generator &g, std::string &abbrev, std::string &info, std::string &line)
+{
+  unsigned lowPc = nativeAddress(g, 0), highPc = nativeAddress(g, g.stopAddress) + 12;
+
+  // .debug_abbrev: compile_unit sem filhos
+  appendULEB(abbrev, 1);
+  appendULEB(abbrev, 0x11);                   // DW_TAG_compile_unit
+  abbrev += '\0';                             // DW_CHILDREN_no
+  const unsigned attributes[][2] =
+  {
+    { 0x03, 0x08 },                           // DW_AT_name, DW_FORM_string
+    { 0x25, 0x08 },                           // DW_AT_producer, DW_FORM_string
+    { 0x13, 0x05 },                           // DW_AT_language, DW_FORM_data2
+    { 0x10, 0x06 },                           // DW_AT_stmt_list, DW_FORM_data4
+    { 0x11, 0x01 },                           // DW_AT_low_pc, DW_FORM_addr
+    { 0x12, 0x01 },                           // DW_AT_high_pc, DW_FORM_addr
+  };
+  for (unsigned i = 0; i < sizeof(attributes) / sizeof(attributes[0]); i++)
+  {
+    appendULEB(abbrev, attributes[i][0]);
+    appendULEB(abbrev, attributes[i][1]);
+  }
+  abbrev.append(3, '\0');
+
+  // .debug_info
+  std::string die;
+  appendULEB(die, 1);
+  die += g.mapSource;
+  die += '\0';
+  die += "TCASM_IA-32_ELF_generator";
+  die += '\0';
+  appendInt(die, 0x8001, 2);                  // DW_LANG_Mips_Assembler
+  appendInt(die, 0, 4);
+  appendInt(die, lowPc, 4);
+  appendInt(die, highPc, 4);
+  appendInt(info, (unsigned)die.size() + 7, 4);
+  appendInt(info, 2, 2);
+  appendInt(info, 0, 4);
+  appendInt(info, 4, 1);
+  info += die;
+
+  // .debug_line: cabeçalho com um único arquivo, sem diretórios
+  static const uint8_t standardOpcodeLengths[12] = { 0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1 };
+  std::string header;
+  appendInt(header, 1, 1);                    // minimum_instruction_length
+  appendInt(header, 1, 1);                    // default_is_stmt
+  appendInt(header, (uint8_t)-5, 1);          // line_base
+  appendInt(header, 14, 1);                   // line_range
+  appendInt(header, 13, 1);                   // opcode_base
+  header.append((const char *)standardOpcodeLengths, 12);
+  header += '\0';
+  header += g.mapSource;
+  header += '\0';
+  header.append(4, '\0');                     // diretório, data e tamanho; fim da lista
+
+  std::string program;
+  program += '\0';                            // DW_LNE_set_address
+  appendULEB(program, 5);
+  program += (char)2;
+  appendInt(program, lowPc, 4);
+
+  unsigned address = lowPc, row = 1, column = 0;
+  for (unsigned i = 0; i <= g.stopAddress && i < g.mapWords.size(); i++)
+  {
+    const MapWord &word = g.mapWords[i];
+    if (word.kind != MapKindOpcode)
+      continue;
+    if (word.line != row)
+    {
+      program += (char)3;                     // DW_LNS_advance_line
+      appendSLEB(program, (int)word.line - (int)row);
+      row = word.line;
+    }
+    if (word.col != column)
+    {
+      program += (char)5;                     // DW_LNS_set_column
+      appendULEB(program, word.col);
+      column = word.col;
+    }
+    if (nativeAddress(g, i) != address)
+    {
+      program += (char)2;                     // DW_LNS_advance_pc
+      appendULEB(program, nativeAddress(g, i) - address);
+      address = nativeAddress(g, i);
+    }
+    program += (char)1;                       // DW_LNS_copy
+  }
+  program += (char)2;
+  appendULEB(program, highPc - address);
+  program += '\0';                            // DW_LNE_end_sequence
+  appendULEB(program, 1);
+  program += (char)1;
+
+  appendInt(line, (unsigned)(2 + 4 + header.size() + program.size()), 4);
+  appendInt(line, 2, 2);
+  appendInt(line, (unsigned)header.size(), 4);
+  line += header;
+  line += program;
+}
+
+//
+// Acrescenta bytes ao arquivo ELF.
+//
+static void append(std::vector<uint8_t> &file, const void *data, size_t size)
+{
+  file.insert(file.end(), (const uint8_t *)data, (const uint8_t *)data + size);
 }
 
 //
 // Escreve um arquivo ELF.
 //
-static void writeElf(FILE *file)
+static void writeElf(const Generator &g, std::vector<uint8_t> &file, const char *source)
 {
+  // seções que não são carregadas: símbolos e, se houver mapa, informação de depuração
+  std::vector<Elf32_Sym> symtab;
+  std::string strtab(1, '\0');
+  buildSymbols(g, symtab, strtab, source);
+
+  std::vector<ExtraSection> extra(2);
+  extra[0].name = ".symtab";
+  extra[0].type = 2;
+  extra[0].link = SectionStrtab;
+  extra[0].info = 2;
+  extra[0].align = 4;
+  extra[0].entsize = sizeof(Elf32_Sym);
+  extra[0].data.assign((const char *)&symtab[0], symtab.size() * sizeof(Elf32_Sym));
+  extra[1].name = ".strtab";
+  extra[1].type = 3;
+  extra[1].align = 1;
+  extra[1].data = strtab;
+
+  if (!g.mapWords.empty())
+  {
+    const char *names[3] = { ".debug_abbrev", ".debug_info", ".debug_line" };
+    extra.resize(5);
+    buildDebug(g, extra[2].data, extra[3].data, extra[4].data);
+    for (unsigned i = 2; i < 5; i++)
+    {
+      extra[i].name = names[i - 2];
+      extra[i].type = 1;
+      extra[i].align = 1;
+    }
+  }
+
+  extra.resize(extra.size() + 1);
+  extra.back().name = ".shstrtab";
+  extra.back().type = 3;
+  extra.back().align = 1;
+
+  unsigned shnum = SectionSymtab + (unsigned)extra.size();
+  unsigned imageSize = StartOffset + (unsigned)g.output.size();
+  unsigned codeSize = 192 + g.stopAddress * 6 + 12;
+
+  std::vector<Elf32_Shdr> shdr(shnum, Elf32_Shdr());
+  std::string &shstrtab = extra.back().data;
+  shstrtab.assign(1, '\0');
+  shdr[SectionText].sh_name = addString(shstrtab, ".text");
+  shdr[SectionText].sh_type = 1;
+  shdr[SectionText].sh_flags = 2 | 4;
+  shdr[SectionText].sh_addr = LoadAddress + sizeof(Elf32_Ehdr) + sizeof(Elf32_Phdr);
+  shdr[SectionText].sh_offset = sizeof(Elf32_Ehdr) + sizeof(Elf32_Phdr);
+  shdr[SectionText].sh_size = codeSize;
+  shdr[SectionText].sh_addralign = 1;
+  shdr[SectionData].sh_name = addString(shstrtab, ".data");
+  shdr[SectionData].sh_type = 1;
+  shdr[SectionData].sh_flags = 1 | 2;
+  shdr[SectionData].sh_addr = LoadAddress + shdr[SectionText].sh_offset + codeSize;
+  shdr[SectionData].sh_offset = shdr[SectionText].sh_offset + codeSize;
+  shdr[SectionData].sh_size = imageSize - shdr[SectionData].sh_offset;
+  shdr[SectionData].sh_addralign = 1;
+
+  unsigned offset = imageSize;
+  for (unsigned i = 0; i < extra.size(); i++)
+  {
+    Elf32_Shdr &h = shdr[SectionSymtab + i];
+    h.sh_name = addString(shstrtab, extra[i].name);
+    h.sh_type = extra[i].type;
+    h.sh_link = extra[i].link;
+    h.sh_info = extra[i].info;
+    h.sh_addralign = extra[i].align;
+    h.sh_entsize = extra[i].entsize;
+    offset = (offset + extra[i].align - 1) & ~(extra[i].align - 1);
+    h.sh_offset = offset;
+    h.sh_size = (uint32_t)extra[i].data.size();
+    offset += h.sh_size;
+  }
+  unsigned shdrOffset = (offset + 3) & ~3u;
+
   // elf header
   Elf32_Ehdr ehdr =
   {
@@ -153,14 +632,14 @@ static void writeElf(FILE *file)
     1,
     LoadAddress + StartOffset,
     sizeof(Elf32_Ehdr),
-    0,
+    shdrOffset,
     0,
     sizeof(Elf32_Ehdr),
     sizeof(Elf32_Phdr),
     1,
-    40,
-    0,
-    0
+    sizeof(Elf32_Shdr),
+    (uint16_t)shnum,
+    (uint16_t)(shnum - 1)
   };
 
   // program header table
@@ -170,204 +649,310 @@ static void writeElf(FILE *file)
     0,
     LoadAddress,
     LoadAddress,
-    StartOffset + (unsigned)output.size(),
-    StartOffset + (unsigned)output.size(),
+    StartOffset + (unsigned)g.output.size(),
+    StartOffset + (unsigned)g.output.size(),
     7,
     4
   };
 
   // escreve no arquivo
-  fwrite(&ehdr, sizeof(Elf32_Ehdr), 1, file);
-  fwrite(&phdr, sizeof(Elf32_Phdr), 1, file);
-  fwrite(GetAndPutInt, 1, 192, file);
-  fwrite(&output[0], 1, output.size(), file);
+  file.reserve(shdrOffset + shnum * sizeof(Elf32_Shdr));
+  append(file, &ehdr, sizeof(Elf32_Ehdr));
+  append(file, &phdr, sizeof(Elf32_Phdr));
+  append(file, GetAndPutInt, 192);
+  append(file, &g.output[0], g.output.size());
+
+  // seções extras e cabeçalhos de seção, fora do segmento carregado (resize completa o alinhamento
+  // com zeros)
+  for (unsigned i = 0; i < extra.size(); i++)
+  {
+    file.resize(shdr[SectionSymtab + i].sh_offset);
+    append(file, extra[i].data.data(), extra[i].data.size());
+  }
+  file.resize(shdrOffset);
+  append(file, &shdr[0], shnum * sizeof(Elf32_Shdr));
 }
 
 //
-// Ponto de entrada.
+// Traduz o programa de entrada para IA-32.
 //
-int main(int argc, char** argv)
+static void translate(Generator &g)
 {
-  FILE *saida;
-
-  if (argc != 3)
-  {
-    fprintf(stderr, "Parameters: <input_file> <output_file>\n");
-    return 0;
-  }
-
-  if ((entrada = fopen(argv[1], "rb")) == NULL)
-  {
-    fprintf(stderr, "Impossible to open input file %s\n", argv[1]);
-    return 0;
-  }
-
-  if ((saida = fopen(argv[2], "wb")) == NULL)
-  {
-    fprintf(stderr, "Impossible to open output file %s\n", argv[2]);
-    return 0;
-  }
-
   // traduz as instruções
-  while (read() != 14)
+  g.blocks[0];
+  while (read(g) != 14)
   {
-    switch (code)
+    uword opcode = g.code;
+    switch (g.code)
     {
       // add    ACC <-- ACC + MEM[OP]
     case 1:
-      putByte(0x66);
-      putByte(0x03);
-      putByte(0x05);
-      putDataAddress();
+      putByte(g, 0x66);
+      putByte(g, 0x03);
+      putByte(g, 0x05);
+      putDataAddress(g);
       break;
 
       // sub    ACC <-- ACC - MEM[OP]
     case 2:
-      putByte(0x66);
-      putByte(0x2B);
-      putByte(0x05);
-      putDataAddress();
+      putByte(g, 0x66);
+      putByte(g, 0x2B);
+      putByte(g, 0x05);
+      putDataAddress(g);
       break;
 
       // mult   ACC <-- ACC * MEM[OP]
     case 3:
-      putByte(0x66);
-      putByte(0x0F);
-      putByte(0xAF);
-      putByte(0x05);
-      putDataAddress();
+      putByte(g, 0x66);
+      putByte(g, 0x0F);
+      putByte(g, 0xAF);
+      putByte(g, 0x05);
+      putDataAddress(g);
       break;
 
       // div    ACC <-- ACC / MEM[OP]
     case 4:
-      putByte(0x66);
-      putByte(0x99);
-      putByte(0x66);
-      putByte(0xF7);
-      putByte(0x3D);
-      putDataAddress();
+      putByte(g, 0x66);
+      putByte(g, 0x99);
+      putByte(g, 0x66);
+      putByte(g, 0xF7);
+      putByte(g, 0x3D);
+      putDataAddress(g);
       break;
 
       // jmp    PC <-- OP
     case 5:
-      putByte(0xE9);
-      putJumpAddress();
-      putByte(0x90);
-      putByte(0x90);
+      putByte(g, 0xE9);
+      putJumpAddress(g);
+      putByte(g, 0x90);
+      putByte(g, 0x90);
       break;
 
       // jmpn   Se ACC < 0, PC <-- OP
     case 6:
-      putByte(0x66);
-      putByte(0x83);
-      putByte(0xF8);
-      putByte(0x00);
-
-      putByte(0x0F);
-      putByte(0x8C);
-      putJumpAddress();
+      putByte(g, 0x66);
+      putByte(g, 0x83);
+      putByte(g, 0xF8);
+      putByte(g, 0x00);
+
+      putByte(g, 0x0F);
+      putByte(g, 0x8C);
+      putJumpAddress(g);
       break;
 
       // jmpp   Se ACC > 0, PC <-- OP
     case 7:
-      putByte(0x66);
-      putByte(0x83);
-      putByte(0xF8);
-      putByte(0x00);
-
-      putByte(0x0F);
-      putByte(0x8F);
-      putJumpAddress();
+      putByte(g, 0x66);
+      putByte(g, 0x83);
+      putByte(g, 0xF8);
+      putByte(g, 0x00);
+
+      putByte(g, 0x0F);
+      putByte(g, 0x8F);
+      putJumpAddress(g);
       break;
 
       // jmpz   Se ACC = 0, PC <-- OP
     case 8:
-      putByte(0x66);
-      putByte(0x83);
-      putByte(0xF8);
-      putByte(0x00);
-
-      putByte(0x0F);
-      putByte(0x84);
-      putJumpAddress();
+      putByte(g, 0x66);
+      putByte(g, 0x83);
+      putByte(g, 0xF8);
+      putByte(g, 0x00);
+
+      putByte(g, 0x0F);
+      putByte(g, 0x84);
+      putJumpAddress(g);
       break;
 
       // copy   MEM[OP2] <-- MEM[OP1]
     case 9:
-      putByte(0x66);
-      putByte(0x8B);
-      putByte(0x1D);
-      putDataAddress();
-      putByte(0x66);
-      putByte(0x89);
-      putByte(0x1D);
-      putDataAddress();
+      putByte(g, 0x66);
+      putByte(g, 0x8B);
+      putByte(g, 0x1D);
+      putDataAddress(g);
+      putByte(g, 0x66);
+      putByte(g, 0x89);
+      putByte(g, 0x1D);
+      putDataAddress(g);
       break;
 
       // load   ACC <-- MEM[OP]
     case 10:
-      putByte(0x66);
-      putByte(0xA1);
-      putDataAddress();
-      putByte(0x90);
+      putByte(g, 0x66);
+      putByte(g, 0xA1);
+      putDataAddress(g);
+      putByte(g, 0x90);
       break;
 
       // store  MEM[OP] <-- ACC
     case 11:
-      putByte(0x66);
-      putByte(0xA3);
-      putDataAddress();
-      putByte(0x90);
+      putByte(g, 0x66);
+      putByte(g, 0xA3);
+      putDataAddress(g);
+      putByte(g, 0x90);
       break;
 
       // input  MEM[OP] <-- STDIN
     case 12:
-      putByte(0xE8);
-      putWord(-(int)(output.size() + 4 + 184));
+      putByte(g, 0xE8);
+      putWord(g, -(int)(g.output.size() + 4 + 184));
 
-      putByte(0x66);
-      putByte(0x89);
-      putByte(0x1D);
-      putDataAddress();
+      putByte(g, 0x66);
+      putByte(g, 0x89);
+      putByte(g, 0x1D);
+      putDataAddress(g);
       break;
 
       // output STDOUT <-- MEM[OP]
     case 13:
-      putByte(0x66);
-      putByte(0x8B);
-      putByte(0x1D);
-      putDataAddress();
+      putByte(g, 0x66);
+      putByte(g, 0x8B);
+      putByte(g, 0x1D);
+      putDataAddress(g);
 
-      putByte(0xE8);
-      putWord(-(int)(output.size() + 4 + 96));
+      putByte(g, 0xE8);
+      putWord(g, -(int)(g.output.size() + 4 + 96));
       break;
     }
 
     // cada palavra (16 bits) no arquivo original deve corresponder a 6 bytes em x86.
-    while ((output.size() % 6) != 0)
-      putByte(0x90);
+    while ((g.output.size() % 6) != 0)
+      putByte(g, 0x90);
+
+    // um desvio termina o bloco básico
+    if (opcode >= 5 && opcode <= 8)
+      g.blocks[(unsigned)g.output.size() / 6];
   }
+  g.stopAddress = (unsigned)g.output.size() / 6;
+
+  // rótulos também começam blocos; desvios para fora do código não
+  for (size_t i = 0; i < g.mapSymbols.size(); i++)
+    if (g.mapSymbols[i].kind == MapKindLabel)
+      g.blocks[g.mapSymbols[i].addr] = g.mapSymbols[i].name;
+  g.blocks.erase(g.blocks.upper_bound(g.stopAddress), g.blocks.end());
 
   // stop
-  putByte(0xB8);
-  putWord(0x01);
-  putByte(0xBB);
-  putWord(0x00);
-  putByte(0xCD);
-  putByte(0x80);
+  putByte(g, 0xB8);
+  putWord(g, 0x01);
+  putByte(g, 0xBB);
+  putWord(g, 0x00);
+  putByte(g, 0xCD);
+  putByte(g, 0x80);
 
   // data section
-  while (fread(&code, 2, 1, entrada) > 0)
+  while (g.position < g.inputSize)
   {
-    putWord(code);
-    putByte(0);
-    putByte(0);
+    putWord(g, g.input[g.position++]);
+    putByte(g, 0);
+    putByte(g, 0);
+  }
+}
+
+//
+// Traduz um programa TCASM montado para um executável ELF IA-32 em memória (veja o cabeçalho).
+//
+uint8_t *TCASM_generate_elf(const uint16_t *code, size_t size, const uint8_t *map, size_t mapSize,
+                            const char *source, size_t *elfSize)
+{
+  Generator g;
+  g.input = code;
+  g.inputSize = size;
+  g.position = 0;
+  g.code = 0;
+  g.stopAddress = 0;
+  if (map != NULL && !readMap(g, map, mapSize))
+    return NULL;
+
+  translate(g);
+  std::vector<uint8_t> file;
+  writeElf(g, file, source);
+
+  uint8_t *elf = (uint8_t *)malloc(file.size());
+  memcpy(elf, &file[0], file.size());
+  *elfSize = file.size();
+  return elf;
+}
+
+#ifndef TCASM_NO_MAIN
+
+//
+// Lê um arquivo inteiro para a memória.
+//
+static bool readFile(const char *path, std::vector<uint8_t> &data)
+{
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return false;
+
+  uint8_t buf[65536];
+  size_t size;
+  while ((size = fread(buf, 1, sizeof(buf), file)) > 0)
+    data.insert(data.end(), buf, buf + size);
+  fclose(file);
+  return true;
+}
+
+//
+// Ponto de entrada.
+//
+int main(int argc, char** argv)
+{
+  FILE *saida;
+  std::vector<uint8_t> map;
+  const char *mapPath = NULL;
+
+  if (argc == 5 && strcmp(argv[1], "--map") == 0)
+  {
+    mapPath = argv[2];
+    if (!readFile(mapPath, map))
+    {
+      fprintf(stderr, "Impossible to read map file %s\n", mapPath);
+      return 0;
+    }
+    argv += 2;
+    argc -= 2;
+  }
+
+  if (argc != 3)
+  {
+    fprintf(stderr, "Parameters: [--map <map_file>] <input_file> <output_file>\n");
+    return 0;
+  }
+
+  std::vector<uint8_t> entrada;
+  if (!readFile(argv[1], entrada))
+  {
+    fprintf(stderr, "Impossible to open input file %s\n", argv[1]);
+    return 0;
+  }
+
+  // palavras de 16 bits; um byte final sem par é ignorado
+  std::vector<uword> code(entrada.size() / 2);
+  if (!code.empty())
+    memcpy(&code[0], &entrada[0], code.size() * 2);
+
+  size_t elfSize;
+  uint8_t *elf = TCASM_generate_elf(code.empty() ? NULL : &code[0], code.size(), mapPath ? &map[0] : NULL,
+                                    map.size(), argv[1], &elfSize);
+  if (elf == NULL)
+  {
+    fprintf(stderr, "Impossible to read map file %s\n", mapPath);
+    return 0;
+  }
+
+  if ((saida = fopen(argv[2], "wb")) == NULL)
+  {
+    fprintf(stderr, "Impossible to open output file %s\n", argv[2]);
+    free(elf);
+    return 0;
   }
 
   // termina
-  fclose(entrada);
-  writeElf(saida);
+  fwrite(elf, 1, elfSize, saida);
   fclose(saida);
+  free(elf);
   chmod(argv[2], 0775);
   return 0;
 }
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef TCASM_IA32_ELF_GENERATOR_H_
+#define TCASM_IA32_ELF_GENERATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Traduz um programa TCASM montado (size palavras de code) para um executável ELF IA-32, sem ler nem
+// escrever arquivos. map é o conteúdo de um mapa de endereços gerado pelo montador (mapSize bytes),
+// ou NULL, e source é o nome do arquivo gravado no símbolo STT_FILE. Não usa estado global, então
+// pode ser chamada por várias threads ao mesmo tempo. Retorna o executável, alocado com malloc, e o
+// seu tamanho em elfSize, ou NULL se o mapa é inválido.
+//
+uint8_t *TCASM_generate_elf(const uint16_t *code, size_t size, const uint8_t *map, size_t mapSize,
+                            const char *source, size_t *elfSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TCASM_IA32_ELF_GENERATOR_H_ */
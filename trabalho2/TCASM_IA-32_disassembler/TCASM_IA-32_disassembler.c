@@ -1,3 +1,5 @@
+#include "TCASM_IA-32_disassembler.h"
+
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -6,20 +8,24 @@
 typedef int16_t word;
 typedef uint16_t uword;
 
-static FILE* fin;
-static FILE* fout;
-static uword code;
-static uword size = 0;
+// state of one disassembly, so that many can run at the same time
+typedef struct {
+  const uword* input;
+  size_t input_size;
+  uword code;
+  unsigned size;
+} disassembler;
 
-// reads the next word in the file and increments the size counter
-inline static uword read() {
-  fread(&code, sizeof(uword), 1, fin);
-  ++size;
-  return code;
+// reads the next word of the input and increments the size counter; past the end, reads a stop, so
+// that a program without stop also ends
+inline static uword read(disassembler* d) {
+  d->code = d->size < d->input_size ? d->input[d->size] : 14;
+  ++d->size;
+  return d->code;
 }
 
 // outputs file begining
-inline static void init() {
+inline static void init(FILE* fout) {
   fprintf(fout, "\nglobal _start\n");
   
   fprintf(fout, "\nsection .bss\n");
@@ -107,97 +113,84 @@ inline static void init() {
   fprintf(fout, "\n_start:\n");
 }
 
-int main(int argc, char** argv) {
-  
-  if (argc != 3) {
-    fprintf(stderr, "Parameters: <input_file> <output_file>\n");
-    return 0;
-  }
-  
-  if ((fin = fopen(argv[1], "rb")) == NULL) {
-    fprintf(stderr, "Impossible to open input file %s\n", argv[1]);
-    return 0;
-  }
-  
-  if ((fout = fopen(argv[2], "w")) == NULL) {
-    fprintf(stderr, "Impossible to open output file %s\n", argv[2]);
-    return 0;
-  }
+// disassembles a TCASM program to NASM (see the header)
+void TCASM_disassemble(const uint16_t* code, size_t size, FILE* fout) {
+  disassembler d = {code, size, 0, 0};
   
   // generating text section
-  init();
-  while (read() != 14) {
-    fprintf(fout, "instr%d:\n", size - 1);
-    switch (code) {
+  init(fout);
+  while (read(&d) != 14) {
+    fprintf(fout, "instr%u:\n", d.size - 1);
+    switch (d.code) {
       // add    ACC <-- ACC + MEM[OP]
       case 1:
-        fprintf(fout, "    add ax, [var%d]\n", read());
+        fprintf(fout, "    add ax, [var%d]\n", read(&d));
         break;
       
       // sub    ACC <-- ACC - MEM[OP]
       case 2:
-        fprintf(fout, "    sub ax, [var%d]\n", read());
+        fprintf(fout, "    sub ax, [var%d]\n", read(&d));
         break;
       
       // mult   ACC <-- ACC * MEM[OP]
       case 3:
-        fprintf(fout, "    imul ax, [var%d]\n", read());
+        fprintf(fout, "    imul ax, [var%d]\n", read(&d));
         break;
       
       // div    ACC <-- ACC / MEM[OP]
       case 4:
         fprintf(fout, "    cwd\n");
-        fprintf(fout, "    idiv word [var%d]\n", read());
+        fprintf(fout, "    idiv word [var%d]\n", read(&d));
         break;
       
       // jmp    PC <-- OP
       case 5:
-        fprintf(fout, "    jmp instr%d\n", read());
+        fprintf(fout, "    jmp instr%d\n", read(&d));
         break;
       
       // jmpn   Se ACC < 0, PC <-- OP
       case 6:
         fprintf(fout, "    cmp ax, 0\n");
-        fprintf(fout, "    jl instr%d\n", read());
+        fprintf(fout, "    jl instr%d\n", read(&d));
         break;
       
       // jmpp   Se ACC > 0, PC <-- OP
       case 7:
         fprintf(fout, "    cmp ax, 0\n");
-        fprintf(fout, "    jg instr%d\n", read());
+        fprintf(fout, "    jg instr%d\n", read(&d));
         break;
       
       // jmpz   Se ACC = 0, PC <-- OP
       case 8:
         fprintf(fout, "    cmp ax, 0\n");
-        fprintf(fout, "    je instr%d\n", read());
+        fprintf(fout, "    je instr%d\n", read(&d));
         break;
       
       // copy   MEM[OP2] <-- MEM[OP1]
       case 9:
-        fprintf(fout, "    mov bx, [var%d]\n", read());
-        fprintf(fout, "    mov [var%d], bx\n", read());
+        fprintf(fout, "    mov bx, [var%d]\n", read(&d));
+        fprintf(fout, "    mov [var%d], bx\n", read(&d));
         break;
       
       // load   ACC <-- MEM[OP]
       case 10:
-        fprintf(fout, "    mov ax, [var%d]\n", read());
+        fprintf(fout, "    mov ax, [var%d]\n", read(&d));
         break;
       
       // store  MEM[OP] <-- ACC
       case 11:
-        fprintf(fout, "    mov [var%d], ax\n", read());
+        fprintf(fout, "    mov [var%d], ax\n", read(&d));
         break;
       
       // input  MEM[OP] <-- STDIN
       case 12:
         fprintf(fout, "    call GetInt\n");
-        fprintf(fout, "    mov [var%d], bx\n", read());
+        fprintf(fout, "    mov [var%d], bx\n", read(&d));
         break;
       
       // output STDOUT <-- MEM[OP]
       case 13:
-        fprintf(fout, "    mov bx, [var%d]\n", read());
+        fprintf(fout, "    mov bx, [var%d]\n", read(&d));
         fprintf(fout, "    call PutInt\n");
         break;
       
@@ -208,20 +201,63 @@ int main(int argc, char** argv) {
   }
   
   // stop
-  fprintf(fout, "\ninstr%d:\n", size - 1);
+  fprintf(fout, "\ninstr%u:\n", d.size - 1);
   fprintf(fout, "    mov eax, 1\n");
   fprintf(fout, "    mov ebx, 0\n");
   fprintf(fout, "    int 80h\n");
   
   // generating the data section
   fprintf(fout, "\nsection .data\n");
-  while (fread(&code, sizeof(uword), 1, fin) > 0) {
-    fprintf(fout, "    var%d: dw %d\n", size, (word)code);
-    ++size;
+  while (d.size < d.input_size) {
+    fprintf(fout, "    var%u: dw %d\n", d.size, (word)d.input[d.size]);
+    ++d.size;
+  }
+}
+
+#ifndef TCASM_NO_MAIN
+
+// reads the whole input file to memory
+static uword* read_file(FILE* fin, size_t* size) {
+  size_t capacity = 65536, bytes = 0, read_bytes;
+  char* buf = (char*) malloc(capacity);
+  while ((read_bytes = fread(buf + bytes, 1, capacity - bytes, fin)) > 0) {
+    bytes += read_bytes;
+    if (bytes == capacity)
+      buf = (char*) realloc(buf, capacity *= 2);
+  }
+  // a last byte without a pair is ignored
+  *size = bytes / sizeof(uword);
+  return (uword*) buf;
+}
+
+int main(int argc, char** argv) {
+  FILE* fin;
+  FILE* fout;
+  
+  if (argc != 3) {
+    fprintf(stderr, "Parameters: <input_file> <output_file>\n");
+    return 0;
+  }
+  
+  if ((fin = fopen(argv[1], "rb")) == NULL) {
+    fprintf(stderr, "Impossible to open input file %s\n", argv[1]);
+    return 0;
+  }
+  
+  if ((fout = fopen(argv[2], "w")) == NULL) {
+    fprintf(stderr, "Impossible to open output file %s\n", argv[2]);
+    return 0;
   }
   
+  size_t size;
+  uword* code = read_file(fin, &size);
+  TCASM_disassemble(code, size, fout);
+  
+  free(code);
   fclose(fin);
   fclose(fout);
   
   return 0;
 }
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef TCASM_IA32_DISASSEMBLER_H_
+#define TCASM_IA32_DISASSEMBLER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// disassembles a TCASM program (size words of code) to NASM source for IA-32, written to fout; it
+// uses no global state, so many threads can call it at the same time
+void TCASM_disassemble(const uint16_t* code, size_t size, FILE* fout);
+
+#endif /* TCASM_IA32_DISASSEMBLER_H_ */